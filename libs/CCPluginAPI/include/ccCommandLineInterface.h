@@ -20,6 +20,7 @@
 #include "CCPluginAPI.h"
 
 //qCC_db
+#include <ccAtomicProgress.h>
 #include <ccPointCloud.h>
 
 //qCC_io
@@ -239,6 +240,10 @@ public: //virtual methods
 
 	//! Returns a (shared) progress dialog (if any is available)
 	virtual ccProgressDialog* progressDialog();
+	//! Returns a progress callback (the shared progress dialog if any, or a headless one)
+	/** Never returns nullptr. The headless callback costs almost nothing.
+	**/
+	virtual CCCoreLib::GenericProgressCallback* progressCallback();
 	//! Returns a (widget) parent (if any is available)
 	virtual QDialog* widgetParent();
 
@@ -375,4 +380,7 @@ protected: //members
 
 	//! File loading parameters
 	CLLoadParameters m_loadingParameters;
+
+	//! Headless progress callback (see progressCallback)
+	ccAtomicProgress m_headlessProgress;
 };
@@ -0,0 +1,282 @@
+#pragma once
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                    COPYRIGHT: CloudCompare project                     #
+//#                                                                        #
+//##########################################################################
+
+#include "CCPluginAPI.h"
+
+//CCCoreLib
+#include <GenericProgressCallback.h>
+
+//Qt
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+
+//system
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+class ccHObject;
+
+//! Background job (see ccJobScheduler)
+class CCPLUGIN_LIB_API ccJob
+{
+public:
+
+	//! Job process (called in a worker thread)
+	/** \return success
+	**/
+	using Process = std::function<bool(ccJob&)>;
+
+	//! Completion callback (called in the main thread)
+	/** This is where the results should be added to the DB tree.
+	**/
+	using Completion = std::function<void(ccJob&, bool success)>;
+
+	//! Returns the job unique ID
+	inline unsigned id() const { return m_id; }
+	//! Returns the job name
+	inline const QString& name() const { return m_name; }
+	//! Returns the entities used by the job
+	/** The entities that are deleted while the job is pending or running are
+		removed from this list (main thread only).
+	**/
+	inline const std::vector<ccHObject*>& entities() const { return m_entities; }
+	//! Returns whether the job still uses an entity (i.e. it hasn't been deleted meanwhile)
+	inline bool uses(const ccHObject* entity) const { return std::find(m_entities.begin(), m_entities.end(), entity) != m_entities.end(); }
+
+	//! Returns the number of threads granted to the job
+	/** The process should not use more threads than this.
+	**/
+	inline int threadCount() const { return m_threadCount; }
+
+	//! Returns the current progress (percent)
+	inline int progress() const { return m_progress.load(); }
+	//! Sets the current progress (thread-safe)
+	inline void setProgress(int percent) { m_progress.store(percent); }
+
+	//! Returns whether the job has been canceled (thread-safe)
+	inline bool isCanceled() const { return m_canceled.load(); }
+	//! Requests the job to stop (thread-safe)
+	/** It's up to the process to check isCanceled regularly.
+	**/
+	inline void cancel() { m_canceled.store(true); }
+
+	//! Returns a progress callback forwarding the progress and cancel state of the job
+	/** To be passed to the CCCoreLib algorithms.
+	**/
+	CCCoreLib::GenericProgressCallback* progressCallback() { return &m_progressCallback; }
+
+protected:
+
+	friend class ccJobScheduler;
+
+	//! Progress callback adapter
+	class ProgressCallback : public CCCoreLib::GenericProgressCallback
+	{
+	public:
+		explicit ProgressCallback(ccJob& job) : m_job(job) {}
+
+		//inherited from GenericProgressCallback
+		void update(float percent) override { m_job.setProgress(static_cast<int>(percent)); }
+		void setMethodTitle(const char* /*methodTitle*/) override {}
+		void setInfo(const char* /*infoStr*/) override {}
+		void start() override { m_job.setProgress(0); }
+		void stop() override { m_job.setProgress(100); }
+		bool isCancelRequested() override { return m_job.isCanceled(); }
+
+	protected:
+		ccJob& m_job;
+	};
+
+	//! Constructor
+	ccJob(unsigned id, const QString& name);
+
+	//! Job unique ID
+	unsigned m_id;
+	//! Job name
+	QString m_name;
+	//! Entities used by the job
+	std::vector<ccHObject*> m_entities;
+	//! Requested number of threads
+	int m_requestedThreadCount = 1;
+	//! Granted number of threads
+	int m_threadCount = 0;
+	//! Job process
+	Process m_process;
+	//! Completion callback
+	Completion m_completion;
+	//! Current progress (percent)
+	std::atomic<int> m_progress;
+	//! Cancel flag
+	std::atomic<bool> m_canceled;
+	//! Process result
+	std::atomic<bool> m_success;
+	//! Last reported progress (main thread only)
+	int m_lastReportedProgress = -1;
+	//! Progress callback adapter
+	ProgressCallback m_progressCallback;
+};
+
+//! Shared scheduler for long-running jobs on entities
+/** Jobs run in the background (so that the GUI is not blocked) and
+	several jobs can run concurrently, as long as:
+	- they don't use the same entities (jobs on the same entity are
+	run in their submission order)
+	- the total number of threads they use doesn't exceed the global
+	thread budget (see setThreadBudget)
+
+	The entities used by a job are locked from its submission to its
+	completion, so that the user can't delete them from the DB tree.
+	Locking doesn't prevent all deletions though (e.g. when the whole DB
+	is unloaded or when a parent is deleted), nor any modification:
+	- the scheduler is notified of the deletion of the entities and removes
+	them from their jobs (see ccJob::uses)
+	- the job process should work on a private copy of the data it reads
+	(taken when the job is submitted)
+	- the completion callback should only access the entities that are
+	still used by the job
+
+	\warning The scheduler must be used from the main thread only.
+**/
+class CCPLUGIN_LIB_API ccJobScheduler : public QObject
+{
+	Q_OBJECT
+
+public:
+
+	//! Returns the unique instance
+	static ccJobScheduler* Instance();
+
+	//! Job description
+	struct Description
+	{
+		//! Job name
+		QString name;
+		//! Entities used by the job
+		std::vector<ccHObject*> entities;
+		//! Requested number of threads (clamped to the thread budget)
+		int threadCount = 1;
+		//! Job process (called in a worker thread)
+		ccJob::Process process;
+		//! Completion callback (called in the main thread, optional)
+		ccJob::Completion completion;
+	};
+
+	//! Submits a new job
+	/** \return the job ID (or 0 if the description is invalid)
+	**/
+	unsigned submit(const Description& description);
+
+	//! Cancels a job (pending or running)
+	void cancel(unsigned jobID);
+
+	//! Cancels all the jobs
+	void cancelAll();
+
+	//! Returns the number of pending and running jobs
+	inline size_t jobCount() const { return m_pending.size() + m_running.size(); }
+
+	//! Returns whether an entity is used by a pending or running job
+	bool isBusy(const ccHObject* entity) const;
+
+	//! Returns the global thread budget
+	inline int threadBudget() const { return m_threadBudget; }
+	//! Sets the global thread budget
+	/** By default, the budget is ccQtHelpers::GetMaxThreadCount().
+	**/
+	void setThreadBudget(int threadCount);
+
+Q_SIGNALS:
+
+	//! Emitted when a job is submitted
+	void jobQueued(unsigned jobID, QString name);
+	//! Emitted when a job starts
+	void jobStarted(unsigned jobID, QString name);
+	//! Emitted (regularly) when the progress of a running job changes
+	void jobProgress(unsigned jobID, int percent);
+	//! Emitted when a job is finished (after its completion callback)
+	void jobFinished(unsigned jobID, bool success);
+
+	//! Emitted by the worker threads (internal)
+	void processDone(unsigned jobID);
+
+protected:
+
+	using JobPtr = std::shared_ptr<ccJob>;
+
+	//! Default constructor
+	explicit ccJobScheduler(QObject* parent = nullptr);
+
+	//! Destructor
+	~ccJobScheduler() override;
+
+	//! Starts the pending jobs that can be started
+	void schedule();
+	//! Starts a job
+	void start(JobPtr job);
+	//! Finalizes a job (main thread)
+	void onProcessDone(unsigned jobID);
+	//! Reports the progress of the running jobs
+	void reportProgress();
+	//! Locks the entities of a job
+	void lockEntities(const ccJob& job);
+	//! Restores the lock state of the entities of a job
+	void unlockEntities(const ccJob& job);
+	//! Cancels a pending job (and calls its completion callback)
+	void cancelPending(JobPtr job);
+	//! Removes a deleted entity from the jobs (main thread)
+	void onEntityDeleted(const ccHObject* entity);
+
+	//! Notifies the scheduler when an entity used by a job is deleted
+	class EntityWatcher;
+	friend class EntityWatcher;
+
+	//! Lock information of an entity used by one or several jobs
+	struct EntityLock
+	{
+		//! Number of jobs using the entity
+		int jobCount = 0;
+		//! Entity lock state before the first job
+		bool wasLocked = false;
+	};
+
+	//! Pending jobs (in submission order)
+	std::list<JobPtr> m_pending;
+	//! Running jobs
+	std::list<JobPtr> m_running;
+	//! Global thread budget
+	int m_threadBudget;
+	//! Number of threads used by the running jobs
+	int m_usedThreads;
+	//! Last job ID
+	unsigned m_lastJobID;
+	//! Worker threads
+	QThreadPool m_threadPool;
+	//! Progress reporting timer
+	QTimer m_progressTimer;
+	//! Entities used by the pending and running jobs
+	std::map<ccHObject*, EntityLock> m_lockedEntities;
+	//! Deletion watcher (declared as a dependency of the locked entities)
+	EntityWatcher* m_entityWatcher;
+};
@@ -18,6 +18,7 @@
 #include <QDir>
 
 #include "ccGenericMesh.h"
+#include "ccProgressDialog.h"
 
 #include "ccCommandLineInterface.h"
 
@@ -172,6 +173,16 @@ ccProgressDialog *ccCommandLineInterface::progressDialog()
 	return nullptr;
 }
 
+CCCoreLib::GenericProgressCallback* ccCommandLineInterface::progressCallback()
+{
+	ccProgressDialog* pDlg = progressDialog();
+	if (pDlg)
+	{
+		return pDlg;
+	}
+	return &m_headlessProgress;
+}
+
 QDialog *ccCommandLineInterface::widgetParent()
 {
 	return nullptr;
@@ -0,0 +1,428 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                    COPYRIGHT: CloudCompare project                     #
+//#                                                                        #
+//##########################################################################
+
+#include "ccJobScheduler.h"
+
+//Local
+#include "ccQtHelpers.h"
+
+//qCC_db
+#include <ccHObject.h>
+#include <ccLog.h>
+
+//Qt
+#include <QCoreApplication>
+#include <QRunnable>
+
+//system
+#include <algorithm>
+#include <cassert>
+
+//! Progress reporting interval (ms)
+static const int s_progressInterval = 200;
+
+ccJob::ccJob(unsigned id, const QString& name)
+	: m_id(id)
+	, m_name(name)
+	, m_progress(0)
+	, m_canceled(false)
+	, m_success(false)
+	, m_progressCallback(*this)
+{
+}
+
+//! Runs the process of a job in a worker thread
+class ccJobRunnable : public QRunnable
+{
+public:
+	ccJobRunnable(std::shared_ptr<ccJob> job, ccJobScheduler* scheduler, std::function<void(ccJob&)> run)
+		: m_job(job)
+		, m_scheduler(scheduler)
+		, m_run(run)
+	{
+		setAutoDelete(true);
+	}
+
+	void run() override
+	{
+		m_run(*m_job);
+		//queued to the main thread
+		Q_EMIT m_scheduler->processDone(m_job->id());
+	}
+
+protected:
+	std::shared_ptr<ccJob> m_job;
+	ccJobScheduler* m_scheduler;
+	std::function<void(ccJob&)> m_run;
+};
+
+//! Notifies the scheduler when an entity used by a job is deleted
+class ccJobScheduler::EntityWatcher : public ccHObject
+{
+public:
+	explicit EntityWatcher(ccJobScheduler& scheduler)
+		: ccHObject("Job entity watcher")
+		, m_scheduler(scheduler)
+	{}
+
+	//inherited from ccHObject
+	void onDeletionOf(const ccHObject* obj) override
+	{
+		m_scheduler.onEntityDeleted(obj);
+		ccHObject::onDeletionOf(obj);
+	}
+
+protected:
+	ccJobScheduler& m_scheduler;
+};
+
+ccJobScheduler* ccJobScheduler::Instance()
+{
+	static ccJobScheduler* s_instance = nullptr;
+	if (!s_instance)
+	{
+		s_instance = new ccJobScheduler(QCoreApplication::instance());
+	}
+	return s_instance;
+}
+
+ccJobScheduler::ccJobScheduler(QObject* parent/*=nullptr*/)
+	: QObject(parent)
+	, m_threadBudget(std::max(1, ccQtHelpers::GetMaxThreadCount()))
+	, m_usedThreads(0)
+	, m_lastJobID(0)
+	, m_entityWatcher(new EntityWatcher(*this))
+{
+	//the jobs run with their own threads (i.e. they don't take the threads of the global pool)
+	m_threadPool.setMaxThreadCount(m_threadBudget);
+
+	connect(this, &ccJobScheduler::processDone, this, &ccJobScheduler::onProcessDone, Qt::QueuedConnection);
+
+	m_progressTimer.setInterval(s_progressInterval);
+	connect(&m_progressTimer, &QTimer::timeout, this, &ccJobScheduler::reportProgress);
+}
+
+ccJobScheduler::~ccJobScheduler()
+{
+	for (auto& lockedEntity : m_lockedEntities)
+	{
+		lockedEntity.first->removeDependencyWith(m_entityWatcher);
+	}
+	m_lockedEntities.clear();
+
+	delete m_entityWatcher;
+	m_entityWatcher = nullptr;
+}
+
+unsigned ccJobScheduler::submit(const Description& description)
+{
+	if (!description.process)
+	{
+		assert(false);
+		return 0;
+	}
+
+	JobPtr job(new ccJob(++m_lastJobID, description.name));
+	job->m_entities = description.entities;
+	job->m_entities.erase(std::remove(job->m_entities.begin(), job->m_entities.end(), nullptr), job->m_entities.end());
+	job->m_requestedThreadCount = std::max(1, description.threadCount);
+	job->m_process = description.process;
+	job->m_completion = description.completion;
+
+	//lock the entities right away so that they can't be deleted while the job is pending
+	lockEntities(*job);
+
+	m_pending.push_back(job);
+	ccLog::PrintDebug(QString("[ccJobScheduler] Job #%1 '%2' queued (%3 thread(s) requested)").arg(job->id()).arg(job->name()).arg(job->m_requestedThreadCount));
+	Q_EMIT jobQueued(job->id(), job->name());
+
+	schedule();
+
+	return job->id();
+}
+
+bool ccJobScheduler::isBusy(const ccHObject* entity) const
+{
+	for (const std::list<JobPtr>* jobs : { &m_running, &m_pending })
+	{
+		for (const JobPtr& job : *jobs)
+		{
+			if (std::find(job->m_entities.begin(), job->m_entities.end(), entity) != job->m_entities.end())
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void ccJobScheduler::cancel(unsigned jobID)
+{
+	for (const JobPtr& job : m_running)
+	{
+		if (job->id() == jobID)
+		{
+			//the process will stop by itself (hopefully)
+			job->cancel();
+			return;
+		}
+	}
+
+	for (std::list<JobPtr>::iterator it = m_pending.begin(); it != m_pending.end(); ++it)
+	{
+		JobPtr job = *it;
+		if (job->id() == jobID)
+		{
+			m_pending.erase(it);
+			cancelPending(job);
+			//other jobs may be waiting for the same entities
+			schedule();
+			return;
+		}
+	}
+}
+
+void ccJobScheduler::cancelAll()
+{
+	for (const JobPtr& job : m_running)
+	{
+		job->cancel();
+	}
+
+	//the pending jobs won't be started at all
+	std::list<JobPtr> pending;
+	std::swap(pending, m_pending);
+	for (const JobPtr& job : pending)
+	{
+		cancelPending(job);
+	}
+}
+
+void ccJobScheduler::cancelPending(JobPtr job)
+{
+	job->cancel();
+	unlockEntities(*job);
+	if (job->m_completion)
+	{
+		job->m_completion(*job, false);
+	}
+	Q_EMIT jobFinished(job->id(), false);
+}
+
+void ccJobScheduler::lockEntities(const ccJob& job)
+{
+	for (ccHObject* entity : job.m_entities)
+	{
+		EntityLock& lock = m_lockedEntities[entity];
+		if (lock.jobCount++ == 0)
+		{
+			lock.wasLocked = entity->isLocked();
+			entity->setLocked(true);
+			//locking doesn't prevent all deletions
+			entity->addDependency(m_entityWatcher, ccHObject::DP_NOTIFY_OTHER_ON_DELETE);
+		}
+	}
+}
+
+void ccJobScheduler::unlockEntities(const ccJob& job)
+{
+	for (ccHObject* entity : job.m_entities)
+	{
+		std::map<ccHObject*, EntityLock>::iterator it = m_lockedEntities.find(entity);
+		if (it == m_lockedEntities.end())
+		{
+			assert(false);
+			continue;
+		}
+		if (--it->second.jobCount == 0)
+		{
+			//restore the original lock state once the last job is done
+			entity->setLocked(it->second.wasLocked);
+			entity->removeDependencyWith(m_entityWatcher);
+			m_lockedEntities.erase(it);
+		}
+	}
+}
+
+void ccJobScheduler::onEntityDeleted(const ccHObject* entity)
+{
+	std::map<ccHObject*, EntityLock>::iterator it = m_lockedEntities.find(const_cast<ccHObject*>(entity));
+	if (it == m_lockedEntities.end())
+	{
+		return;
+	}
+	m_lockedEntities.erase(it);
+
+	//the jobs must not access this entity anymore
+	for (std::list<JobPtr>* jobs : { &m_running, &m_pending })
+	{
+		for (const JobPtr& job : *jobs)
+		{
+			std::vector<ccHObject*>& entities = job->m_entities;
+			entities.erase(std::remove(entities.begin(), entities.end(), entity), entities.end());
+		}
+	}
+
+	ccLog::PrintDebug("[ccJobScheduler] An entity used by a job has been deleted");
+}
+
+void ccJobScheduler::setThreadBudget(int threadCount)
+{
+	m_threadBudget = std::max(1, threadCount);
+	//the running jobs keep their threads
+	m_threadPool.setMaxThreadCount(std::max(m_threadBudget, static_cast<int>(m_running.size())));
+
+	schedule();
+}
+
+void ccJobScheduler::schedule()
+{
+	//entities used by the running jobs or by the pending jobs that come first
+	std::vector<ccHObject*> usedEntities;
+	for (const JobPtr& job : m_running)
+	{
+		usedEntities.insert(usedEntities.end(), job->m_entities.begin(), job->m_entities.end());
+	}
+
+	for (std::list<JobPtr>::iterator it = m_pending.begin(); it != m_pending.end(); )
+	{
+		JobPtr job = *it;
+
+		bool conflict = false;
+		for (ccHObject* entity : job->m_entities)
+		{
+			if (std::find(usedEntities.begin(), usedEntities.end(), entity) != usedEntities.end())
+			{
+				conflict = true;
+				break;
+			}
+		}
+
+		if (conflict)
+		{
+			//this job must wait for the previous jobs on the same entities
+			usedEntities.insert(usedEntities.end(), job->m_entities.begin(), job->m_entities.end());
+			++it;
+			continue;
+		}
+
+		int threadCount = std::min(job->m_requestedThreadCount, m_threadBudget);
+		if (m_usedThreads != 0 && m_usedThreads + threadCount > m_threadBudget)
+		{
+			//not enough threads left (we don't let the smaller jobs overtake this one)
+			break;
+		}
+
+		it = m_pending.erase(it);
+		job->m_threadCount = threadCount;
+		start(job);
+		usedEntities.insert(usedEntities.end(), job->m_entities.begin(), job->m_entities.end());
+	}
+}
+
+void ccJobScheduler::start(JobPtr job)
+{
+	m_usedThreads += job->m_threadCount;
+	m_running.push_back(job);
+	if (m_threadPool.maxThreadCount() < static_cast<int>(m_running.size()))
+	{
+		m_threadPool.setMaxThreadCount(static_cast<int>(m_running.size()));
+	}
+
+	ccLog::PrintDebug(QString("[ccJobScheduler] Job #%1 '%2' started (%3 thread(s))").arg(job->id()).arg(job->name()).arg(job->m_threadCount));
+	Q_EMIT jobStarted(job->id(), job->name());
+
+	m_threadPool.start(new ccJobRunnable(job, this, [](ccJob& job)
+	{
+		bool success = false;
+		if (!job.isCanceled())
+		{
+			try
+			{
+				success = job.m_process(job);
+			}
+			catch (const std::bad_alloc&)
+			{
+				ccLog::Warning(QString("[ccJobScheduler] Job '%1': not enough memory").arg(job.name()));
+			}
+			catch (const std::exception& e)
+			{
+				ccLog::Warning(QString("[ccJobScheduler] Job '%1' failed: %2").arg(job.name(), e.what()));
+			}
+		}
+		job.m_success.store(success);
+	}));
+
+	if (!m_progressTimer.isActive())
+	{
+		m_progressTimer.start();
+	}
+}
+
+void ccJobScheduler::onProcessDone(unsigned jobID)
+{
+	std::list<JobPtr>::iterator it = std::find_if(m_running.begin(), m_running.end(), [jobID](const JobPtr& job) { return job->id() == jobID; });
+	if (it == m_running.end())
+	{
+		assert(false);
+		return;
+	}
+
+	JobPtr job = *it;
+	m_running.erase(it);
+	m_usedThreads -= job->m_threadCount;
+	assert(m_usedThreads >= 0);
+
+	//restore the entities lock state
+	unlockEntities(*job);
+
+	bool success = job->m_success.load() && !job->isCanceled();
+	ccLog::PrintDebug(QString("[ccJobScheduler] Job #%1 '%2' %3").arg(job->id()).arg(job->name()).arg(success ? "finished" : (job->isCanceled() ? "canceled" : "failed")));
+
+	if (success)
+	{
+		job->m_lastReportedProgress = 100;
+		Q_EMIT jobProgress(job->id(), 100);
+	}
+
+	//commit the results (main thread)
+	if (job->m_completion)
+	{
+		job->m_completion(*job, success);
+	}
+	Q_EMIT jobFinished(job->id(), success);
+
+	if (m_running.empty())
+	{
+		m_progressTimer.stop();
+	}
+
+	schedule();
+}
+
+void ccJobScheduler::reportProgress()
+{
+	for (const JobPtr& job : m_running)
+	{
+		int progress = job->progress();
+		if (progress != job->m_lastReportedProgress)
+		{
+			job->m_lastReportedProgress = progress;
+			Q_EMIT jobProgress(job->id(), progress);
+		}
+	}
+}
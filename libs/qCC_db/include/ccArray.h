@@ -25,6 +25,7 @@
 #include <CCShareable.h>
 
 //System
+#include <algorithm>
 #include <vector>
 
 //! Shareable array that can be properly inserted in the DB tree
@@ -139,7 +140,8 @@ protected:
 	virtual ~ccArray() {}
 
 	//inherited from ccHObject
-	inline bool toFile_MeOnly(QFile& out, short dataVersion) const override { return ccSerializationHelper::GenericArrayToFile<Type, N, ComponentType>(*this, out); }
+	inline short minimumFileVersion_MeOnly() const override { return std::max(ccHObject::minimumFileVersion_MeOnly(), ccSerializationHelper::GenericArrayToFileMinVersion(this->size())); }
+	inline bool toFile_MeOnly(QFile& out, short dataVersion) const override { return ccSerializationHelper::GenericArrayToFile<Type, N, ComponentType>(*this, out, dataVersion); }
 	inline bool fromFile_MeOnly(QFile& in, short dataVersion, int flags, LoadedIDMap& oldToNewIDMap) override { return ccSerializationHelper::GenericArrayFromFile<Type, N, ComponentType>(*this, in, dataVersion); }
 
 };
@@ -0,0 +1,112 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_ARRAY_CODEC_HEADER
+#define CC_ARRAY_CODEC_HEADER
+
+//Local
+#include "qCC_db.h"
+
+//System
+#include <cstdint>
+
+class QFile;
+class TestBinFilter;
+
+//! Compressed array codec for BIN files (see ccSerializationHelper::GenericArrayToFile)
+/** The array is split in chunks that are filtered (byte shuffling or delta coding)
+	and compressed independently, in parallel. The chunks are preceded by an index
+	(end offset of each chunk) so that any chunk can be accessed directly.
+
+	Layout (after the standard array header, where the component count is flagged
+	with CompressedFlag):
+	- filter (1 byte)
+	- component size (1 byte)
+	- number of elements per chunk (4 bytes)
+	- number of chunks (4 bytes)
+	- end offset of each chunk, relative to the start of the first one (8 bytes each)
+	- compressed chunks
+**/
+class QCC_DB_LIB_API ccArrayCodec
+{
+public:
+
+	//! Minimum file version for compressed arrays
+	static const short MinFileVersion = 55;
+
+	//! Flag set on the component count of the compressed arrays
+	static const uint8_t CompressedFlag = 0x80;
+
+	//! Filters (applied before compression)
+	enum Filter : uint8_t
+	{
+		NO_FILTER = 0,		/**< No filter **/
+		BYTE_SHUFFLE = 1,	/**< The n-th bytes of all the components are grouped (for floating point values) **/
+		BYTE_DELTA = 2,		/**< Each byte is replaced by its difference with the same byte of the previous element (for colors, normals, indexes) **/
+	};
+
+	//! Sets whether the arrays should be compressed when saved (disabled by default)
+	static void SetCompressionEnabled(bool state);
+	//! Returns whether the arrays should be compressed when saved
+	static bool IsCompressionEnabled();
+
+	//! Default number of elements from which an array is saved with a 64-bit element count
+	static const uint64_t DefaultLargeArrayThreshold = 0xFFFFFFFF;
+
+	//! Returns the number of elements from which an array is saved with a 64-bit element count
+	static uint64_t LargeArrayThreshold();
+
+	//! Writes the (compressed) data of an array
+	/** \param out output file (must be seekable)
+		\param data array data
+		\param elementCount number of elements
+		\param elementSize size of an element (in bytes)
+		\param componentSize size of a component (in bytes)
+		\param filter filter to apply before compression
+		\return success
+	**/
+	static bool Write(	QFile& out,
+						const void* data,
+						uint64_t elementCount,
+						unsigned elementSize,
+						unsigned componentSize,
+						Filter filter);
+
+	//! Reads the (compressed) data of an array
+	/** \param in input file
+		\param data output array data (must be already allocated)
+		\param elementCount number of elements
+		\param elementSize size of an element (in bytes)
+		\return success
+	**/
+	static bool Read(	QFile& in,
+						void* data,
+						uint64_t elementCount,
+						unsigned elementSize);
+
+private:
+	//the 'large array' threshold can only be changed by the tests
+	friend class ::TestBinFilter;
+
+	//! Sets the number of elements from which an array is saved with a 64-bit element count
+	/** So that the 64-bit header can be tested with small arrays.
+		The value is clamped to DefaultLargeArrayThreshold.
+	**/
+	static void SetLargeArrayThreshold(uint64_t elementCount);
+};
+
+#endif //CC_ARRAY_CODEC_HEADER
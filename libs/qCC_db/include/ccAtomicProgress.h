@@ -0,0 +1,94 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_ATOMIC_PROGRESS_HEADER
+#define CC_ATOMIC_PROGRESS_HEADER
+
+//Local
+#include "qCC_db.h"
+
+//CCCoreLib
+#include <GenericProgressCallback.h>
+
+//Qt
+#include <QMutex>
+#include <QString>
+
+//System
+#include <atomic>
+
+//! Headless progress indicator (lock-free)
+/** Implements the GenericProgressCallback interface with atomic counters
+	only: updating the progress never blocks, never processes the Qt events
+	and never emits any signal, so it can be called from any thread.
+
+	The progress can be sampled (from any thread) with value(), or ignored
+	(e.g. in command line mode, where it can be used as a 'null' callback).
+**/
+class QCC_DB_LIB_API ccAtomicProgress : public CCCoreLib::GenericProgressCallback
+{
+public:
+
+	//! Default constructor
+	ccAtomicProgress();
+
+	//! Destructor (virtual)
+	virtual ~ccAtomicProgress() = default;
+
+	//inherited method
+	inline void update(float percent) override { m_value.store(static_cast<int>(percent), std::memory_order_relaxed); }
+	inline void setMethodTitle(const char* methodTitle) override { setMethodTitle(QString(methodTitle)); }
+	inline void setInfo(const char* infoStr) override { setInfo(QString(infoStr)); }
+	inline bool isCancelRequested() override { return m_cancelRequested.load(std::memory_order_relaxed); }
+	void start() override;
+	void stop() override;
+
+	//! setMethodTitle with a QString as argument
+	void setMethodTitle(const QString& methodTitle);
+	//! setInfo with a QString as argument
+	void setInfo(const QString& infoStr);
+
+	//! Returns the current progress value (percent)
+	inline int value() const { return m_value.load(std::memory_order_relaxed); }
+	//! Returns whether the process is running (i.e. between start and stop)
+	inline bool isRunning() const { return m_running.load(); }
+	//! Returns the current method title
+	QString methodTitle() const;
+	//! Returns the current info
+	QString info() const;
+
+	//! Requests the process to stop
+	inline void cancel() { m_cancelRequested.store(true); }
+
+protected:
+
+	//! Current progress value (percent)
+	std::atomic<int> m_value;
+	//! Whether the process is running
+	std::atomic<bool> m_running;
+	//! Whether cancel has been requested
+	std::atomic<bool> m_cancelRequested;
+
+	//! Mutex (for the texts only)
+	mutable QMutex m_textMutex;
+	//! Method title
+	QString m_methodTitle;
+	//! Info
+	QString m_info;
+};
+
+#endif //CC_ATOMIC_PROGRESS_HEADER
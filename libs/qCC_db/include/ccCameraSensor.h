@@ -441,7 +441,9 @@ public: //misc
 	bool computeUncertainty(CCCoreLib::ReferenceCloud* points, std::vector< Vector3Tpl<ScalarType> >& accuracy/*, bool lensDistortion*/);
 
 	//! Undistorts an image based on the sensor distortion parameters
-	/** \warning Only works with the simple radial distortion model for now (see RadialDistortionParameters).
+	/** Each pixel of the undistorted image is (bilinearly) interpolated at its distorted position
+		in the input image. Pixels that fall outside of the input image are left black.
+		\warning Only works with the simple radial distortion model for now (see RadialDistortionParameters).
 		\param image input image
 		\return undistorted image (or a null one if an error occurred)
 	**/
@@ -28,6 +28,7 @@
 #include <QObject>
 
 class ccClipBoxPart;
+class ccVisibilitySelection;
 
 //! Clipping box
 class QCC_DB_LIB_API ccClipBox : public QObject, public ccHObject, public ccInteractor
@@ -103,7 +104,9 @@ public:
 	void shift(const CCVector3& v);
 
 	//! Flags the points of a given cloud depending on whether they are inside or outside of this clipping box
-	/** \param cloud point cloud
+	/** If the cloud has an octree, its cells are classified first so that only the points
+		of the cells straddling the box borders are tested individually.
+		\param cloud point cloud
 		\param visTable visibility flags
 		\param shrink Whether the box is shrinking (faster) or not
 	**/
@@ -111,6 +114,14 @@ public:
 							ccGenericPointCloud::VisibilityTableType* visTable,
 							bool shrink = false) const;
 
+	//! Selects the points of a given cloud that are inside this clipping box
+	/** Compact version of flagPointsInside (the selection is reset).
+		\param cloud point cloud
+		\param selection output selection
+		\return false if there's not enough memory
+	**/
+	bool selectPointsInside(ccGenericPointCloud* cloud, ccVisibilitySelection& selection) const;
+
 	//! Resets box
 	void reset();
 
@@ -45,6 +45,18 @@ public:
 	static int OrientNormals(	ccPointCloud* theCloud,
 								unsigned char octreeLevel,
 								ccProgressDialog* progressCb = nullptr);
+
+	//! Static entry point (multi-seed, concurrent version)
+	/** The octree cells are split in regions (i.e. cells of a coarser level) in which
+		independent fronts are propagated concurrently. The orientations of the resulting
+		patches are then made consistent by a consensus vote along their borders (the
+		strongest consensus first).
+		\return 1 on success, 0 or a negative value otherwise
+	**/
+	static int OrientNormalsConcurrently(	ccPointCloud* theCloud,
+											unsigned char octreeLevel,
+											ccProgressDialog* progressCb = nullptr);
+
 	//! Default constructor
 	ccFastMarchingForNormsDirection();
 
@@ -33,6 +33,7 @@ namespace CCCoreLib
 }
 	
 class ccOctreeProxy;
+class ccVisibilitySelection;
 
 /***************************************************
 				ccGenericPointCloud
@@ -183,6 +184,15 @@ public:
 		\return the visible points as a ReferenceCloud
 	**/
 	virtual CCCoreLib::ReferenceCloud* getTheVisiblePoints(const VisibilityTableType* visTable = nullptr, bool silent = false, CCCoreLib::ReferenceCloud* selection = nullptr) const;
+
+	//! Returns a ReferenceCloud equivalent to a compact selection
+	/** The point indexes are gathered in parallel.
+		\param pointSelection points selection (must have the same size as the cloud)
+		\param silent don't issue warnings if no point is selected
+		\param selection input reference cloud to be used (optional)
+		\return the selected points as a ReferenceCloud
+	**/
+	CCCoreLib::ReferenceCloud* getTheSelectedPoints(const ccVisibilitySelection& pointSelection, bool silent = false, CCCoreLib::ReferenceCloud* selection = nullptr) const;
 	
 	//! Returns whether the visibility array is allocated or not
 	virtual bool isVisibilityTableInstantiated() const;
@@ -231,6 +241,30 @@ public:
 	**/
 	virtual bool removeVisiblePoints(VisibilityTableType* visTable = nullptr, std::vector<int>* newIndexes = nullptr) = 0;
 
+	//! Creates a new point cloud with only the selected points (compact selection version)
+	/** By default, the selection is converted to a visibility table and
+		createNewCloudFromVisibilitySelection is called.
+		\param[in]  pointSelection points selection (must have the same size as the cloud)
+		\param[in]  removeSelectedPoints if true, the selected points are also removed from the current point cloud
+		\param[out] newIndexesOfRemainingPoints the new indexes of the remaining points (if removeSelectedPoints is true - optional).
+		            Must be initially empty or have the same size as the original cloud.
+		\param[in]  silent don't issue a warning message if there's no point to keep
+		\return new point cloud with the selected points (or the same cloud if all points are selected)
+	**/
+	virtual ccGenericPointCloud* createNewCloudFromSelection(	const ccVisibilitySelection& pointSelection,
+																bool removeSelectedPoints = false,
+																std::vector<int>* newIndexesOfRemainingPoints = nullptr,
+																bool silent = false);
+
+	//! Removes all the selected points (compact selection version)
+	/** By default, the selection is converted to a visibility table and
+		removeVisiblePoints is called.
+		\param pointSelection points selection (must have the same size as the cloud)
+		\param newIndexes optional: stores the new indexes of the points (either an index >= 0 if kept, or -1 if not). Must be initially empty or have the same size as the original cloud.
+		\return success
+	**/
+	virtual bool removeSelectedPoints(const ccVisibilitySelection& pointSelection, std::vector<int>* newIndexes = nullptr);
+
 	//! Applies a rigid transformation (rotation + translation)
 	virtual void applyRigidTransformation(const ccGLMatrix& trans) = 0;
 
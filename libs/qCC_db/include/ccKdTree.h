@@ -74,7 +74,15 @@ public:
 	typedef std::unordered_set<Leaf*> LeafSet;
 
 	//! Returns the neighbor leaves around a given cell
-	bool getNeighborLeaves(BaseNode* cell, ccKdTree::LeafSet& neighbors, const int* userDataFilter = nullptr);
+	/** \param cell cell
+		\param neighbors output neighbor leaves
+		\param userDataFilter only the leaves with this user data value are returned (optional)
+		\param subTreeRoot only the leaves below this node are returned (optional)
+	**/
+	bool getNeighborLeaves(BaseNode* cell, ccKdTree::LeafSet& neighbors, const int* userDataFilter = nullptr, BaseNode* subTreeRoot = nullptr);
+
+	//! Returns the root node
+	inline BaseNode* getRootNode() const { return m_root; }
 
 	//! Returns associated (generic) point cloud
 	inline ccGenericPointCloud* associatedGenericCloud() const { return m_associatedGenericCloud; }
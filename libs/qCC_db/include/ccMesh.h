@@ -403,11 +403,10 @@ public:
 	//! Transforms the mesh per-triangle normals
 	void transformTriNormals(const ccGLMatrix& trans);
 
-	//! Default octree level for the 'mergeDuplicatedVertices' algorithm
-	static const unsigned char DefaultMergeDuplicateVerticesLevel = 10;
-
 	//! Merges duplicated vertices
-	bool mergeDuplicatedVertices(unsigned char octreeLevel = DefaultMergeDuplicateVerticesLevel, QWidget* parentWidget = nullptr);
+	/** The duplicated vertices are found with a voxel grid (see ccVoxelGrid::FindDuplicates).
+	**/
+	bool mergeDuplicatedVertices(QWidget* parentWidget = nullptr);
 
 protected: //methods
 
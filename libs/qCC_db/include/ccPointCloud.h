@@ -29,10 +29,14 @@
 #include "ccColorScale.h"
 #include "ccNormalVectors.h"
 #include "ccWaveform.h"
+#include "ccWaveformBlockStorage.h"
 
 //Qt
 #include <QGLBuffer>
 
+//System
+#include <functional>
+
 class ccScalarField;
 class ccPolyline;
 class ccMesh;
@@ -359,8 +363,13 @@ public: //normals computation/orientation
 									ccProgressDialog* pDlg = nullptr );
 
 	//! Orient normals with Fast Marching
+	/** \param level octree level
+		\param pDlg progress dialog (optional)
+		\param concurrent whether to propagate several fronts concurrently (see ccFastMarchingForNormsDirection::OrientNormalsConcurrently)
+	**/
 	bool orientNormalsWithFM(		unsigned char level,
-									ccProgressDialog* pDlg = nullptr);
+									ccProgressDialog* pDlg = nullptr,
+									bool concurrent = false);
 
 	//! Toggle the drawing of normals as small lines
 	void showNormalsAsLines(bool state);
@@ -401,14 +410,26 @@ public: //waveform (e.g. from airborne scanners)
 	bool hasFWF() const;
 
 	//! Returns a proxy on a given waveform
+	/** \warning If the FWF data is packed, the proxy relies on an internal cache
+		(i.e. the method is not thread-safe and the proxy is only valid until
+		the next call). See the other version of this method in this case.
+	**/
 	ccWaveformProxy waveformProxy(unsigned index) const;
 
+	//! Returns a proxy on a given waveform (with an external cache for packed FWF data)
+	/** Use one cache per thread. The proxy is only valid as long as the cache is not
+		used for another waveform.
+	**/
+	ccWaveformProxy waveformProxy(unsigned index, ccWaveformBlockStorage::Cache& cache) const;
+
 	//! Waveform descriptors set
 	using FWFDescriptorSet = QMap<uint8_t, WaveformDescriptor>;
 
 	//! Waveform data container
 	using FWFDataContainer = std::vector<uint8_t>;
 	using SharedFWFDataContainer = QSharedPointer<const FWFDataContainer>;
+	//! Packed (block-compressed) waveform data container
+	using SharedFWFBlockStorage = QSharedPointer<const ccWaveformBlockStorage>;
 
 	//! Gives access to the FWF descriptors
 	FWFDescriptorSet& fwfDescriptors() { return m_fwfDescriptors; }
@@ -426,9 +447,35 @@ public: //waveform (e.g. from airborne scanners)
 	bool resizeTheFWFTable();
 
 	//! Gives access to the associated FWF data container
-	SharedFWFDataContainer& fwfData() { return m_fwfData; }
+	/** The FWF data is unpacked first if necessary (see packFWFData).
+	**/
+	SharedFWFDataContainer& fwfData() { unpackFWFData(); return m_fwfData; }
 	//! Gives access to the associated FWF data container (const version)
-	const SharedFWFDataContainer& fwfData() const { return m_fwfData; }
+	/** The FWF data is unpacked first if necessary (see packFWFData).
+	**/
+	const SharedFWFDataContainer& fwfData() const { const_cast<ccPointCloud*>(this)->unpackFWFData(); return m_fwfData; }
+
+	//! Packs the associated FWF data (block compression)
+	/** The raw FWF data container is replaced by a block-compressed one (see
+		ccWaveformBlockStorage). The waveforms remain accessible through
+		waveformProxy without decompressing the whole data. The data is
+		unpacked on demand (see fwfData).
+		\param compressionLevel compression level (-1 = default, 0 = none, 9 = max)
+		\return success
+	**/
+	bool packFWFData(int compressionLevel = -1);
+
+	//! Unpacks the associated FWF data
+	/** Does nothing if the data is not packed.
+		\return success
+	**/
+	bool unpackFWFData();
+
+	//! Returns whether the associated FWF data is packed
+	inline bool isFWFDataPacked() const { return !m_fwfBlocks.isNull(); }
+
+	//! Gives access to the packed FWF data container (if any)
+	inline const SharedFWFBlockStorage& fwfBlocks() const { return m_fwfBlocks; }
 
 	//! Compresses the associated FWF data container
 	/** As the container is shared, the compressed version will be potentially added to the memory
@@ -486,6 +533,12 @@ public: //other methods
 																bool silent = false,
 																CCCoreLib::ReferenceCloud* selection = nullptr) override;
 	bool removeVisiblePoints(VisibilityTableType* visTable = nullptr, std::vector<int>* newIndexes = nullptr) override;
+	/** \warning if removeSelectedPoints is true, any attached octree will be deleted, as well as the visibility table. **/
+	ccGenericPointCloud* createNewCloudFromSelection(	const ccVisibilitySelection& pointSelection,
+														bool removeSelectedPoints = false,
+														std::vector<int>* newIndexesOfRemainingPoints = nullptr,
+														bool silent = false) override;
+	bool removeSelectedPoints(const ccVisibilitySelection& pointSelection, std::vector<int>* newIndexes = nullptr) override;
 	void applyRigidTransformation(const ccGLMatrix& trans) override;
 	inline void refreshBB() override { invalidateBoundingBox(); }
 
@@ -626,6 +679,8 @@ public: //other methods
 		bool blendGrayscale = false;
 		unsigned char blendGrayscaleThreshold = 0;
 		double blendGrayscalePercent = 0.5;
+		//! Whether to use the voxel grid engine instead of the octree (faster, approximate for the mean/Gaussian/bilateral filters)
+		bool useVoxelGrid = false;
 	};
 
 	//! Applies a spatial Gaussian filter on RGB colors
@@ -844,6 +899,9 @@ protected:
 	**/
 	void swapPoints(unsigned firstIndex, unsigned secondIndex) override;
 
+	//! Removes the points for which a predicate returns true (see removeVisiblePoints)
+	bool removePoints(const std::function<bool(unsigned)>& toRemove, std::vector<int>* newIndexes);
+
 protected: // variable members
 
 	//! Colors
@@ -965,6 +1023,11 @@ protected: //waveform (e.g. from airborne scanners)
 	//! Waveforms raw data storage
 	SharedFWFDataContainer m_fwfData;
 
+	//! Waveforms packed data storage (exclusive with m_fwfData)
+	SharedFWFBlockStorage m_fwfBlocks;
+	//! Decompressed block cache (see waveformProxy)
+	mutable ccWaveformBlockStorage::Cache m_fwfBlockCache;
+
 	bool m_normalsDrawnAsLines;
 
 	struct NormalLineParameters
@@ -24,6 +24,7 @@
 //Qt
 #include <QProgressDialog>
 #include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QTimer>
 
 //CCCoreLib
@@ -74,14 +75,15 @@ protected:
 
 	//! Refreshes the progress
 	/** Should only be called in the main Qt thread!
-		This slot is automatically called by 'update' (in Qt::QueuedConnection mode).
+		This slot is called at a fixed rate by the refresh timer (the
+		progress value itself is only stored by 'update', so that the
+		processes can report their progress at almost no cost).
 	**/
 	void refresh();
 
-Q_SIGNALS:
-
-	//! Schedules a call to refresh
-	void scheduleRefresh();
+	//inherited from QProgressDialog
+	void showEvent(QShowEvent* event) override;
+	void hideEvent(QHideEvent* event) override;
 
 protected:
 
@@ -90,6 +92,12 @@ protected:
 
 	//! Last displayed progress value (percent)
 	QAtomicInt m_lastRefreshValue;
+
+	//! Refresh timer (samples the progress value)
+	QTimer m_refreshTimer;
+
+	//! Time since the last events processing (when the process runs in the main thread)
+	QElapsedTimer m_eventsTimer;
 };
 
 #endif //CC_PROGRESS_DIALOG_HEADER
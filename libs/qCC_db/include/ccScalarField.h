@@ -168,6 +168,8 @@ public:
 	inline bool logScale() const { return m_logScale; }
 
 	//inherited
+	/** The values are scanned by chunks (see ccChunk), in parallel.
+	**/
 	void computeMinAndMax() override;
 
 	//! Returns associated color scale
@@ -190,7 +192,20 @@ public:
 	};
 
 	//! Returns associated histogram values (for display)
-	inline const Histogram& getHistogram() const { return m_histogram; }
+	/** The histogram is computed on demand (see computeHistogram).
+	**/
+	const Histogram& getHistogram() const;
+
+	//! Computes the histogram of the values over [getMin() ; getMax()]
+	/** If the class count divides the size of the fine histogram (2^14), the histogram
+		is derived from it (the fine histogram is computed on demand, once after each update
+		of the min and max values) so that the values are not scanned again. Otherwise
+		the values are scanned.
+		\param classCount number of classes
+		\param histogram output histogram
+		\return success
+	**/
+	bool computeHistogram(unsigned classCount, Histogram& histogram) const;
 
 	//! Returns whether the scalar field in its current configuration MAY have 'hidden' values or not
 	/** 'Hidden' values are typically NaN values or values outside of the 'displayed' interval
@@ -227,6 +242,12 @@ protected: //methods
 	//! Updates saturation values
 	void updateSaturationBounds();
 
+	//! Updates the display parameters once the min and max values have changed
+	void onMinAndMaxUpdated();
+
+	//! Scans the values to compute a histogram over [getMin() ; getMax()] (in parallel)
+	bool scanHistogram(unsigned classCount, std::vector<unsigned>& histogram) const;
+
 	//! Normalizes a scalar value between 0 and 1 (wrt to current parameters)
 	/**	\param val scalar value
 		\return a number between 0 and 1 if inside displayed range or -1 otherwise
@@ -268,8 +289,14 @@ protected: //members
 	//! Number of color ramps steps (for display)
 	unsigned m_colorRampSteps;
 
-	//! Associated histogram values (for display)
-	Histogram m_histogram;
+	//! Fine histogram (over [min ; max], computed on demand)
+	mutable std::vector<unsigned> m_fineHistogram;
+
+	//! Associated histogram values (for display, computed on demand)
+	mutable Histogram m_histogram;
+
+	//! Whether the associated histogram is up to date
+	mutable bool m_histogramIsValid;
 
 	//! Modification flag
 	/** Any modification to the scalar field values or parameters
@@ -19,6 +19,7 @@
 #define CC_SERIALIZABLE_OBJECT_HEADER
 
 //Local
+#include "ccArrayCodec.h"
 #include "ccLog.h"
 
 //CCCoreLib
@@ -28,6 +29,8 @@
 //System
 #include <cassert>
 #include <cstdint>
+#include <limits>
+#include <type_traits>
 
 //Qt
 #include <QDataStream>
@@ -158,12 +161,24 @@ public:
 	//! Returns the minimum file version to save/load a 'generic array'
 	static short GenericArrayToFileMinVersion() { return 20;  }
 
+	//! Minimum file version for arrays with more than 2^32-1 elements (64-bit element count)
+	static const short LargeArrayMinFileVersion = 56;
+
+	//! Returns the minimum file version to save/load a 'generic array' with a given number of elements
+	static short GenericArrayToFileMinVersion(size_t elementCount)
+	{
+		return (static_cast<::uint64_t>(elementCount) < ccArrayCodec::LargeArrayThreshold() ? GenericArrayToFileMinVersion() : LargeArrayMinFileVersion);
+	}
+
 	//! Helper: saves a vector to file
-	/** \param data vector to save (must be allocated)
+	/** The array is compressed if the compression is enabled (see ccArrayCodec)
+		and if the target file version supports it.
+		\param data vector to save (must be allocated)
 		\param out output file (must be already opened)
+		\param dataVersion target file version
 		\return success
 	**/
-	template <class Type, int N, class ComponentType> static bool GenericArrayToFile(const std::vector<Type>& data, QFile& out)
+	template <class Type, int N, class ComponentType> static bool GenericArrayToFile(const std::vector<Type>& data, QFile& out, short dataVersion = 0)
 	{
 		assert(out.isOpen() && (out.openMode() & QIODevice::WriteOnly));
 		
@@ -173,15 +188,49 @@ public:
 		//	return ccSerializableObject::MemoryError();
 		//}
 
+		bool compressed = (!data.empty() && dataVersion >= ccArrayCodec::MinFileVersion && ccArrayCodec::IsCompressionEnabled());
+
 		//component count (dataVersion>=20)
 		::uint8_t componentCount = static_cast<::uint8_t>(N);
+		if (compressed)
+		{
+			//compressed array (dataVersion>=55)
+			componentCount |= ccArrayCodec::CompressedFlag;
+		}
 		if (out.write((const char*)&componentCount, 1) < 0)
 			return ccSerializableObject::WriteError();
 
 		//element count = array size (dataVersion>=20)
-		::uint32_t elementCount = static_cast<::uint32_t>(data.size());
-		if (out.write((const char*)&elementCount, 4) < 0)
-			return ccSerializableObject::WriteError();
+		::uint64_t elementCount = static_cast<::uint64_t>(data.size());
+		if (elementCount < ccArrayCodec::LargeArrayThreshold())
+		{
+			::uint32_t elementCount32 = static_cast<::uint32_t>(elementCount);
+			if (out.write((const char*)&elementCount32, 4) < 0)
+				return ccSerializableObject::WriteError();
+		}
+		else if (dataVersion >= LargeArrayMinFileVersion)
+		{
+			//64-bit element count (dataVersion>=56)
+			::uint32_t tag = LargeArrayCountTag;
+			if (	out.write((const char*)&tag, 4) < 0
+				||	out.write((const char*)&elementCount, 8) < 0)
+				return ccSerializableObject::WriteError();
+		}
+		else
+		{
+			//we don't want to silently truncate the array!
+			ccLog::Warning(QString("[BIN] Array too big (%1 elements) for file version %2.%3").arg(elementCount).arg(dataVersion / 10).arg(dataVersion % 10));
+			return false;
+		}
+
+		if (compressed)
+		{
+			//byte shuffling for the floating point values (coordinates, scalars), delta coding for the others (colors, normals, indexes)
+			ccArrayCodec::Filter filter = (std::is_floating_point<ComponentType>::value ? ccArrayCodec::BYTE_SHUFFLE : ccArrayCodec::BYTE_DELTA);
+			if (!ccArrayCodec::Write(out, data.data(), elementCount, sizeof(Type), sizeof(ComponentType), filter))
+				return ccSerializableObject::WriteError();
+			return true;
+		}
 
 		//array data (dataVersion>=20)
 		{
@@ -211,8 +260,9 @@ public:
 	template <class Type, int N, class ComponentType> static bool GenericArrayFromFile(std::vector<Type>& data, QFile& in, short dataVersion)
 	{
 		::uint8_t componentCount = 0;
-		::uint32_t elementCount = 0;
-		if (!ReadArrayHeader(in, dataVersion, componentCount, elementCount))
+		::uint64_t elementCount = 0;
+		bool compressed = false;
+		if (!ReadArrayHeader(in, dataVersion, componentCount, elementCount, compressed))
 		{
 			return false;
 		}
@@ -226,14 +276,21 @@ public:
 			//try to allocate memory
 			try
 			{
-				data.resize(elementCount);
+				data.resize(static_cast<size_t>(elementCount));
 			}
 			catch (const std::bad_alloc&)
 			{
 				return ccSerializableObject::MemoryError();
 			}
 
-			//array data (dataVersion>=20)
+			if (compressed)
+			{
+				//compressed array (dataVersion>=55)
+				assert(sizeof(ComponentType) * N == sizeof(Type));
+				if (!ccArrayCodec::Read(in, data.data(), elementCount, sizeof(Type)))
+					return ccSerializableObject::ReadError();
+			}
+			else //array data (dataVersion>=20)
 			{
 				//Apparently Qt and/or Windows don't like to read too many bytes in a row...
 				static const qint64 MaxElementPerChunk = (static_cast<qint64>(1) << 24);
@@ -265,8 +322,9 @@ public:
 	template <class Type, int N, class ComponentType, class FileComponentType> static bool GenericArrayFromTypedFile(std::vector<Type>& data, QFile& in, short dataVersion)
 	{
 		::uint8_t componentCount = 0;
-		::uint32_t elementCount = 0;
-		if (!ReadArrayHeader(in, dataVersion, componentCount, elementCount))
+		::uint64_t elementCount = 0;
+		bool compressed = false;
+		if (!ReadArrayHeader(in, dataVersion, componentCount, elementCount, compressed))
 		{
 			return false;
 		}
@@ -280,20 +338,45 @@ public:
 			//try to allocate memory
 			try
 			{
-				data.resize(elementCount);
+				data.resize(static_cast<size_t>(elementCount));
 			}
 			catch (const std::bad_alloc&)
 			{
 				return ccSerializableObject::MemoryError();
 			}
 
+			if (compressed)
+			{
+				//compressed array (dataVersion>=55): we decompress it first, then convert the values
+				std::vector<FileComponentType> fileData;
+				try
+				{
+					fileData.resize(static_cast<size_t>(elementCount) * N);
+				}
+				catch (const std::bad_alloc&)
+				{
+					return ccSerializableObject::MemoryError();
+				}
+
+				if (!ccArrayCodec::Read(in, fileData.data(), elementCount, sizeof(FileComponentType) * N))
+					return ccSerializableObject::ReadError();
+
+				ComponentType* _data = (ComponentType*)data.data();
+				for (FileComponentType value : fileData)
+				{
+					*_data++ = static_cast<ComponentType>(value);
+				}
+
+				return true;
+			}
+
 			//array data (dataVersion>=20)
 			//--> sadly we can't read it as a block...
 			//we must convert each element, value by value!
 			FileComponentType dummyArray[N] = { 0 };
 
 			ComponentType* _data = (ComponentType*)data.data();
-			for (unsigned i = 0; i < elementCount; ++i)
+			for (::uint64_t i = 0; i < elementCount; ++i)
 			{
 				if (in.read((char*)dummyArray, sizeof(FileComponentType) * N) >= 0)
 				{
@@ -314,10 +397,14 @@ public:
 
 protected:
 
+	//! Tag written in place of the 32-bit element count when the 64-bit count follows (dataVersion>=56)
+	static const ::uint32_t LargeArrayCountTag = 0xFFFFFFFF;
+
 	static bool ReadArrayHeader(QFile& in,
 								short dataVersion,
 								::uint8_t &componentCount,
-								::uint32_t &elementCount)
+								::uint64_t &elementCount,
+								bool& compressed)
 	{
 		assert(in.isOpen() && (in.openMode() & QIODevice::ReadOnly));
 
@@ -328,9 +415,31 @@ protected:
 		if (in.read((char*)&componentCount, 1) < 0)
 			return ccSerializableObject::ReadError();
 
+		//compressed array (dataVersion>=55)
+		compressed = (dataVersion >= ccArrayCodec::MinFileVersion && (componentCount & ccArrayCodec::CompressedFlag));
+		if (compressed)
+		{
+			componentCount &= ~ccArrayCodec::CompressedFlag;
+		}
+
 		//element count = array size (dataVersion>=20)
-		if (in.read((char*)&elementCount, 4) < 0)
+		::uint32_t elementCount32 = 0;
+		if (in.read((char*)&elementCount32, 4) < 0)
 			return ccSerializableObject::ReadError();
+		elementCount = elementCount32;
+
+		if (dataVersion >= LargeArrayMinFileVersion && elementCount32 == LargeArrayCountTag)
+		{
+			//64-bit element count (dataVersion>=56)
+			if (in.read((char*)&elementCount, 8) < 0)
+				return ccSerializableObject::ReadError();
+		}
+
+		if (elementCount > static_cast<::uint64_t>(std::numeric_limits<size_t>::max()))
+		{
+			//can't be addressed on this system (32 bits)
+			return ccSerializableObject::CorruptError();
+		}
 
 		return true;
 	}
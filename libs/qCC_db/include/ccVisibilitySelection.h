@@ -0,0 +1,185 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_VISIBILITY_SELECTION_HEADER
+#define CC_VISIBILITY_SELECTION_HEADER
+
+//Local
+#include "qCC_db.h"
+
+//System
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+//! Compact points selection (alternative to the byte-per-point visibility table)
+/** The selection is either stored as a bitset (with the number of selected points
+	before each block of bits, so that the rank of any selected point can be
+	computed quickly and the selection can be extracted in parallel), or as a list
+	of ranges of consecutive indexes (for spatially coherent selections).
+
+	The bitset mode is the default one. The selection can be converted to ranges
+	with compact() once it won't be modified anymore.
+**/
+class QCC_DB_LIB_API ccVisibilitySelection
+{
+public:
+
+	//! Range of consecutive selected indexes [first ; last[
+	struct Range
+	{
+		unsigned first;
+		unsigned last;
+	};
+
+	//! Default constructor
+	ccVisibilitySelection() = default;
+
+	//! Resets the selection with a given number of points (none of them being selected)
+	/** \warning May throw std::bad_alloc
+	**/
+	void resize(unsigned count);
+
+	//! Releases the memory
+	void clear();
+
+	//! Returns the number of points (selected or not)
+	inline unsigned size() const { return m_size; }
+
+	//! Selects a point (bitset mode only)
+	/** \warning Not thread-safe (several points share the same word)
+	**/
+	inline void select(unsigned index)
+	{
+		assert(!m_compacted && index < m_size);
+		m_words[index >> 6] |= (static_cast<uint64_t>(1) << (index & 63));
+		m_ranksValid = false;
+	}
+
+	//! Selects a point (bitset mode only) from concurrent OpenMP threads
+	/** The bit is set atomically, so that several threads can select points
+		sharing the same word. The ranks are not invalidated here: the selection
+		must have been reset (see resize) beforehand.
+	**/
+	inline void selectConcurrently(unsigned index)
+	{
+		assert(!m_compacted && !m_ranksValid && index < m_size);
+		uint64_t& word = m_words[index >> 6];
+		const uint64_t bit = (static_cast<uint64_t>(1) << (index & 63));
+#if defined(_OPENMP)
+		#pragma omp atomic
+#endif
+		word |= bit;
+	}
+
+	//! Unselects a point (bitset mode only)
+	/** \warning Not thread-safe (several points share the same word)
+	**/
+	inline void unselect(unsigned index)
+	{
+		assert(!m_compacted && index < m_size);
+		m_words[index >> 6] &= ~(static_cast<uint64_t>(1) << (index & 63));
+		m_ranksValid = false;
+	}
+
+	//! Returns whether a point is selected
+	bool isSelected(unsigned index) const;
+
+	//! Sets the selection state of each point with a predicate (evaluated in parallel)
+	/** \warning May throw std::bad_alloc
+	**/
+	void assign(unsigned count, const std::function<bool(unsigned)>& predicate);
+
+	//! Sets the selection from a visibility table (POINT_VISIBLE = selected)
+	/** \warning May throw std::bad_alloc
+	**/
+	void fromVisibilityTable(const std::vector<unsigned char>& visTable);
+
+	//! Converts the selection to a visibility table (selected = POINT_VISIBLE)
+	/** \warning May throw std::bad_alloc
+	**/
+	void toVisibilityTable(std::vector<unsigned char>& visTable) const;
+
+	//! Returns the number of selected points
+	unsigned count() const;
+
+	//! Converts the selection to ranges if it is coherent enough
+	/** The bitset is kept if the ranges would take more than half of its memory.
+		Once compacted, the selection can't be modified anymore (see resize).
+		\return whether the selection has been converted to ranges
+	**/
+	bool compact();
+
+	//! Returns whether the selection is stored as ranges
+	inline bool isCompacted() const { return m_compacted; }
+
+	//! Calls a function for each selected point (in increasing index order)
+	template<class Func> void forEachSelected(Func func) const
+	{
+		if (m_compacted)
+		{
+			for (const Range& range : m_ranges)
+			{
+				for (unsigned i = range.first; i < range.last; ++i)
+				{
+					func(i);
+				}
+			}
+		}
+		else
+		{
+			for (size_t w = 0; w < m_words.size(); ++w)
+			{
+				uint64_t word = m_words[w];
+				for (unsigned i = static_cast<unsigned>(w << 6); word != 0; ++i, word >>= 1)
+				{
+					if (word & 1)
+					{
+						func(i);
+					}
+				}
+			}
+		}
+	}
+
+	//! Calls a function for each selected point, in parallel
+	/** The function receives the rank of the point in the selection (i.e. its index
+		in the output if the selected points are extracted) and its own index.
+	**/
+	void forEachSelectedInParallel(const std::function<void(unsigned rank, unsigned index)>& func) const;
+
+protected:
+
+	//! Updates the number of selected points before each block
+	void updateRanks() const;
+
+	//! Number of points
+	unsigned m_size = 0;
+	//! Selection bits (bitset mode)
+	std::vector<uint64_t> m_words;
+	//! Number of selected points before each block of words (bitset mode)
+	mutable std::vector<unsigned> m_blockRanks;
+	//! Whether the ranks are up to date
+	mutable bool m_ranksValid = false;
+	//! Selected ranges (ranges mode)
+	std::vector<Range> m_ranges;
+	//! Whether the selection is stored as ranges
+	bool m_compacted = false;
+};
+
+#endif //CC_VISIBILITY_SELECTION_HEADER
@@ -0,0 +1,158 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_VOXEL_GRID_HEADER
+#define CC_VOXEL_GRID_HEADER
+
+//Local
+#include "qCC_db.h"
+
+//CCCoreLib
+#include <CCGeom.h>
+
+//System
+#include <cstdint>
+#include <vector>
+
+namespace CCCoreLib
+{
+	class GenericIndexedCloudPersist;
+	class GenericProgressCallback;
+}
+
+//! Sparse regular voxel grid (lightweight alternative to the octree)
+/** Only the non-empty voxels are stored, sorted by key (i.e. by Z, then Y, then X),
+	so that the voxels of a same row are contiguous. The point indexes are sorted
+	by voxel.
+
+	The voxel positions are relative to the (minimum corner of the) cloud bounding box.
+**/
+class QCC_DB_LIB_API ccVoxelGrid
+{
+public:
+
+	//! Non-empty voxel
+	struct Voxel
+	{
+		//! Index of the first point (in pointIndexes)
+		unsigned start;
+		//! Number of points
+		unsigned count;
+	};
+
+	//! Number of bits per dimension (in the voxel keys)
+	static const unsigned KeyBits = 21;
+	//! Maximum number of voxels per dimension
+	static const int MaxDimension = (1 << KeyBits);
+
+	//! Default constructor
+	ccVoxelGrid();
+
+	//! Builds the grid
+	/** \param cloud point cloud
+		\param voxelSize voxel size
+		\return false if the voxel size is too small or if there is not enough memory
+	**/
+	bool build(CCCoreLib::GenericIndexedCloudPersist& cloud, PointCoordinateType voxelSize);
+
+	//! Releases the memory
+	void clear();
+
+	//! Returns the voxel size
+	inline PointCoordinateType voxelSize() const { return m_voxelSize; }
+	//! Returns the grid origin (minimum corner)
+	inline const CCVector3& origin() const { return m_origin; }
+
+	//! Returns the number of non-empty voxels
+	inline size_t voxelCount() const { return m_voxels.size(); }
+	//! Returns a voxel
+	inline const Voxel& voxel(size_t index) const { return m_voxels[index]; }
+	//! Returns the key of a voxel
+	inline uint64_t voxelKey(size_t index) const { return m_keys[index]; }
+	//! Returns the position of a voxel
+	inline Tuple3i voxelPosition(size_t index) const { return Position(m_keys[index]); }
+	//! Returns the point indexes (sorted by voxel)
+	inline const std::vector<unsigned>& pointIndexes() const { return m_pointIndexes; }
+	//! Returns the index of the i-th point of a voxel
+	inline unsigned pointIndex(const Voxel& voxel, unsigned i) const { return m_pointIndexes[voxel.start + i]; }
+
+	//! Returns the position of the voxel including a given point
+	Tuple3i positionOf(const CCVector3& P) const;
+
+	//! Returns the index of the voxel at a given position (or -1 if it's empty)
+	int64_t find(const Tuple3i& pos) const;
+
+	//! Returns the indexes of the non-empty voxels in a cube around a given position
+	/** \param pos cube center (voxel position)
+		\param range cube half size (in voxels)
+		\param voxelIndexes output voxel indexes (sorted)
+	**/
+	void getNeighbors(const Tuple3i& pos, int range, std::vector<size_t>& voxelIndexes) const;
+
+	//! Finds the duplicate points (i.e. the points closer than a given tolerance)
+	/** A point is a duplicate if it is close to a previous (non duplicate) point.
+		The first close point of each point is searched in parallel (voxel by voxel,
+		the search stopping at the first match so that clusters of coincident points
+		don't cost a comparison per pair). The duplicates are then resolved in index
+		order, so that the result doesn't depend on the number of threads.
+		\param cloud point cloud
+		\param tolerance maximum distance between duplicate points
+		\param rootIndexes output remapping table: index of the (non duplicate) point
+		each point is merged with (or its own index if it's not a duplicate)
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success
+	**/
+	static bool FindDuplicates(	CCCoreLib::GenericIndexedCloudPersist& cloud,
+								double tolerance,
+								std::vector<unsigned>& rootIndexes,
+								CCCoreLib::GenericProgressCallback* progressCb = nullptr);
+
+	//! Returns the key corresponding to a voxel position
+	static inline uint64_t Key(const Tuple3i& pos)
+	{
+		return	static_cast<uint64_t>(pos.x)
+			|	(static_cast<uint64_t>(pos.y) << KeyBits)
+			|	(static_cast<uint64_t>(pos.z) << (2 * KeyBits));
+	}
+
+	//! Returns the voxel position corresponding to a key
+	static inline Tuple3i Position(uint64_t key)
+	{
+		static const uint64_t Mask = (uint64_t(1) << KeyBits) - 1;
+		return Tuple3i(	static_cast<int>(key & Mask),
+						static_cast<int>((key >> KeyBits) & Mask),
+						static_cast<int>(key >> (2 * KeyBits)) );
+	}
+
+protected:
+
+	//! Voxel size
+	PointCoordinateType m_voxelSize;
+	//! Grid origin
+	CCVector3 m_origin;
+	//! Grid dimensions
+	Tuple3i m_dimensions;
+
+	//! Non-empty voxels (sorted by key)
+	std::vector<Voxel> m_voxels;
+	//! Voxel keys (same order as m_voxels)
+	std::vector<uint64_t> m_keys;
+	//! Point indexes (sorted by voxel)
+	std::vector<unsigned> m_pointIndexes;
+};
+
+#endif //CC_VOXEL_GRID_HEADER
@@ -0,0 +1,66 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_VOXEL_GRID_FILTER_HEADER
+#define CC_VOXEL_GRID_FILTER_HEADER
+
+//Local
+#include "ccPointCloud.h"
+
+//! Voxel grid accelerated spatial filters (RGB colors and/or scalar field)
+/** Multi-threaded alternative to the octree based filters (see ccPointCloud::applyFilterToRGB).
+	The neighborhood of each point is the sphere of radius 3*sigma, as with the octree.
+
+	- Median filter: the candidate neighbors are gathered once per voxel (of size 1.5*sigma)
+	  then the exact median of the neighbors inside the sphere is computed by selection.
+	  The result may still differ from the octree version, which writes the filtered
+	  colors in place (i.e. some neighbors may already be filtered when they are read)
+	- Mean and Gaussian filters: the points are first aggregated per voxel (of size sigma)
+	  and each point is then filtered with the aggregates (count, centroid and mean values)
+	  of the neighboring voxels (approximation)
+	- Bilateral filter: the aggregates are further split by scalar value (in bins of size
+	  sigmaSF), as in a bilateral grid (approximation)
+
+	The input colors and scalar values are not modified while the filter is computed
+	(the result doesn't depend on the processing order).
+	As with the octree version, the scalar values are read from the current 'output'
+	scalar field and written in the current 'input' scalar field.
+**/
+class QCC_DB_LIB_API ccVoxelGridFilter
+{
+public:
+
+	//! Applies a spatial filter
+	/** \param cloud point cloud
+		\param sigma filter variance (spatial)
+		\param sigmaSF if strictly positive, the variance for the bilateral filter (scalar field)
+		\param options filter options (type, burnt out colors threshold, grayscale blending)
+		\param filterColors whether the colors should be filtered
+		\param filterSF whether the scalar field should be filtered
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success
+	**/
+	static bool Apply(	ccPointCloud& cloud,
+						PointCoordinateType sigma,
+						PointCoordinateType sigmaSF,
+						const ccPointCloud::RgbFilterOptions& options,
+						bool filterColors,
+						bool filterSF,
+						CCCoreLib::GenericProgressCallback* progressCb = nullptr);
+};
+
+#endif //CC_VOXEL_GRID_FILTER_HEADER
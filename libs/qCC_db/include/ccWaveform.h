@@ -166,10 +166,27 @@ public:
 	//! Default constructor
 	ccWaveformProxy(const ccWaveform& w, const WaveformDescriptor& d, const uint8_t* storage)
 		: m_w(w)
+		, m_storageW(w)
 		, m_d(d)
 		, m_storage(storage)
 	{}
 
+	//! Constructor for a waveform stored in a partial buffer (e.g. a decompressed block)
+	/** \param w waveform
+		\param d descriptor
+		\param buffer buffer containing the waveform data
+		\param bufferOffset offset of the buffer in the whole FWF data (the waveform data starts at buffer + w.dataOffset() - bufferOffset)
+	**/
+	ccWaveformProxy(const ccWaveform& w, const WaveformDescriptor& d, const uint8_t* buffer, uint64_t bufferOffset)
+		: m_w(w)
+		, m_storageW(w)
+		, m_d(d)
+		, m_storage(buffer)
+	{
+		assert(!buffer || w.dataOffset() >= bufferOffset);
+		m_storageW.setDataOffset(w.dataOffset() - bufferOffset);
+	}
+
 	//! Returns whether the waveform (proxy) is valid or not
 	inline bool isValid() const { return m_storage && m_w.descriptorID() != 0 && m_d.numberOfSamples != 0; }
 
@@ -179,19 +196,19 @@ public:
 	inline uint8_t descriptorID() const { return m_w.descriptorID(); }
 
 	//! Returns the (raw) value of a given sample
-	inline uint32_t getRawSample(uint32_t i) const { return m_w.getRawSample(i, m_d, m_storage); }
+	inline uint32_t getRawSample(uint32_t i) const { return m_storageW.getRawSample(i, m_d, m_storage); }
 
 	//! Returns the (real) value of a given sample (in volts)
-	inline double getSample(uint32_t i) const { return m_w.getSample(i, m_d, m_storage); }
+	inline double getSample(uint32_t i) const { return m_storageW.getSample(i, m_d, m_storage); }
 
 	//! Returns the range of (real) samples
-	inline double getRange(double& minVal, double& maxVal) const { return m_w.getRange(minVal, maxVal, m_d, m_storage); }
+	inline double getRange(double& minVal, double& maxVal) const { return m_storageW.getRange(minVal, maxVal, m_d, m_storage); }
 
 	//! Decodes the samples and store them in a vector
-	inline bool decodeSamples(std::vector<double>& values) const { return m_w.decodeSamples(values, m_d, m_storage); }
+	inline bool decodeSamples(std::vector<double>& values) const { return m_storageW.decodeSamples(values, m_d, m_storage); }
 
 	//! Exports (real) samples to an ASCII file
-	inline bool toASCII(const QString& filename) const { return m_w.toASCII(filename, m_d, m_storage); }
+	inline bool toASCII(const QString& filename) const { return m_storageW.toASCII(filename, m_d, m_storage); }
 
 	//! Returns the sample position in 3D
 	inline CCVector3 getSamplePos(float i, const CCVector3& P0) const { return m_w.getSamplePos(i, P0, m_d); }
@@ -200,7 +217,7 @@ public:
 	inline uint32_t byteCount() const { return m_w.byteCount(); }
 
 	//! Gives access to the internal data
-	inline const uint8_t* data() const { return m_w.data(m_storage); }
+	inline const uint8_t* data() const { return m_storageW.data(m_storage); }
 
 	//! Returns the beam direction
 	inline const CCVector3f& beamDir() const { return m_w.beamDir(); }
@@ -220,6 +237,8 @@ protected: //members
 
 	//! Associated ccWaveform instance
 	const ccWaveform& m_w;
+	//! Copy of the waveform with its data offset relative to the storage
+	ccWaveform m_storageW;
 	//! Associated descriptor
 	const WaveformDescriptor& m_d;
 	//! Associated storage data
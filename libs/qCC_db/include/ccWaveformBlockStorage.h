@@ -0,0 +1,142 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_WAVEFORM_BLOCK_STORAGE_HEADER
+#define CC_WAVEFORM_BLOCK_STORAGE_HEADER
+
+//Local
+#include "ccSerializableObject.h"
+#include "ccWaveform.h"
+
+//Qt
+#include <QByteArray>
+
+//System
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+class ccPointCloud;
+
+//! Block-compressed full-waveform data
+/** Alternative to the raw FWF data container of ccPointCloud (see ccPointCloud::fwfData).
+	The data is split in blocks that are compressed independently (samples are delta
+	encoded, then deflated), so that the blocks can be compressed and decompressed in
+	parallel, and each waveform can be accessed without decompressing the whole data.
+
+	Blocks are only cut between waveforms (i.e. a waveform is never split over two blocks).
+	See ccPointCloud::packFWFData.
+**/
+class QCC_DB_LIB_API ccWaveformBlockStorage : public ccSerializableObject
+{
+public:
+
+	//! Default (uncompressed) size of the blocks
+	static const uint32_t DefaultBlockSize = (1 << 20);
+
+	//! Minimum file version for block-compressed FWF data
+	static const short MinFileVersion = 57;
+
+	//! Decompressed block cache
+	/** Keeps the last decompressed block. Use one instance per thread (and per storage).
+	**/
+	struct Cache
+	{
+		size_t blockIndex = std::numeric_limits<size_t>::max();
+		std::vector<uint8_t> data;
+	};
+
+	//! Default constructor
+	ccWaveformBlockStorage() = default;
+
+	//! Compresses the FWF data of a cloud
+	/** \param cloud cloud with FWF data
+		\param blockSize approximate (uncompressed) size of the blocks
+		\param compressionLevel compression level (-1 = default, 0 = none, 9 = max)
+		\return success
+	**/
+	bool compress(const ccPointCloud& cloud, uint32_t blockSize = DefaultBlockSize, int compressionLevel = -1);
+
+	//! Decompresses the whole data (in parallel)
+	/** The output can be used as the FWF data container of the cloud (same offsets).
+		\return success
+	**/
+	bool decompress(std::vector<uint8_t>& data) const;
+
+	//! Releases the memory
+	void clear();
+
+	//! Returns the number of blocks
+	inline size_t blockCount() const { return m_blocks.size(); }
+
+	//! Returns the (uncompressed) data size
+	inline uint64_t size() const { return m_size; }
+
+	//! Returns the compressed data size
+	uint64_t compressedSize() const;
+
+	//! Returns the (decompressed) block containing a given waveform
+	/** Decompresses the corresponding block in the cache if necessary.
+		\warning The returned pointer is only valid for this waveform (and the other ones
+		of the same block) and as long as the cache is not used for another block.
+		\param w waveform
+		\param cache decompressed block cache
+		\param blockOffset offset of the block in the (uncompressed) data
+		\return the block data (the waveform data starts at w.dataOffset() - blockOffset)
+		or nullptr if the waveform data is not available
+	**/
+	const uint8_t* blockData(const ccWaveform& w, Cache& cache, uint64_t& blockOffset) const;
+
+	//! Returns a proxy on a given waveform of the (compressed) cloud
+	/** See ccPointCloud::waveformProxy and blockData.
+	**/
+	ccWaveformProxy waveformProxy(const ccPointCloud& cloud, unsigned index, Cache& cache) const;
+
+	//inherited from ccSerializableObject
+	bool isSerializable() const override { return true; }
+	bool toFile(QFile& out, short dataVersion) const override;
+	bool fromFile(QFile& in, short dataVersion, int flags, LoadedIDMap& oldToNewIDMap) override;
+	short minimumFileVersion() const override { return MinFileVersion; }
+
+protected:
+
+	//! Compressed block
+	struct Block
+	{
+		//! Offset of the first byte (in the uncompressed data)
+		uint64_t firstByte = 0;
+		//! Uncompressed size
+		uint32_t byteCount = 0;
+		//! Delta encoding stride (i.e. size of the samples)
+		uint8_t stride = 1;
+		//! Compressed data
+		QByteArray data;
+	};
+
+	//! Decompresses a block
+	static bool DecompressBlock(const Block& block, uint8_t* output);
+
+	//! Returns the index of the block containing a given byte (or blockCount() if none)
+	size_t findBlock(uint64_t byte) const;
+
+	//! Blocks (ordered by offset)
+	std::vector<Block> m_blocks;
+	//! Uncompressed data size
+	uint64_t m_size = 0;
+};
+
+#endif //CC_WAVEFORM_BLOCK_STORAGE_HEADER
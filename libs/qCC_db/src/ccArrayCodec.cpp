@@ -0,0 +1,361 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccArrayCodec.h"
+
+//Local
+#include "ccLog.h"
+
+//Qt
+#include <QByteArray>
+#include <QFile>
+
+//System
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(_OPENMP)
+//OpenMP
+#include <omp.h>
+#endif
+
+//! Approximate (uncompressed) size of the chunks
+static const unsigned s_chunkByteSize = (1 << 22); //4 Mb
+
+//! Whether the arrays should be compressed when saved
+static std::atomic<bool> s_compressionEnabled(false);
+
+void ccArrayCodec::SetCompressionEnabled(bool state)
+{
+	s_compressionEnabled = state;
+}
+
+bool ccArrayCodec::IsCompressionEnabled()
+{
+	return s_compressionEnabled;
+}
+
+//! Number of elements from which an array is saved with a 64-bit element count
+static std::atomic<uint64_t> s_largeArrayThreshold(ccArrayCodec::DefaultLargeArrayThreshold);
+
+void ccArrayCodec::SetLargeArrayThreshold(uint64_t elementCount)
+{
+	s_largeArrayThreshold = (elementCount < DefaultLargeArrayThreshold ? elementCount : DefaultLargeArrayThreshold);
+}
+
+uint64_t ccArrayCodec::LargeArrayThreshold()
+{
+	return s_largeArrayThreshold;
+}
+
+//! Returns the number of chunks
+static uint64_t ChunkCount(uint64_t elementCount, uint32_t elementsPerChunk)
+{
+	return (elementCount + elementsPerChunk - 1) / elementsPerChunk;
+}
+
+//! Filters and compresses a chunk
+static QByteArray EncodeChunk(	const uint8_t* input,
+								size_t byteCount,
+								unsigned elementSize,
+								unsigned componentSize,
+								ccArrayCodec::Filter filter)
+{
+	try
+	{
+		std::vector<uint8_t> filtered(byteCount);
+		switch (filter)
+		{
+		case ccArrayCodec::BYTE_SHUFFLE:
+		{
+			size_t valueCount = byteCount / componentSize;
+			for (size_t v = 0; v < valueCount; ++v)
+			{
+				for (unsigned b = 0; b < componentSize; ++b)
+				{
+					filtered[b * valueCount + v] = input[v * componentSize + b];
+				}
+			}
+			break;
+		}
+		case ccArrayCodec::BYTE_DELTA:
+		{
+			for (size_t j = 0; j < byteCount; ++j)
+			{
+				filtered[j] = static_cast<uint8_t>(j >= elementSize ? input[j] - input[j - elementSize] : input[j]);
+			}
+			break;
+		}
+		default:
+		{
+			std::copy(input, input + byteCount, filtered.begin());
+			break;
+		}
+		}
+
+		return qCompress(filtered.data(), static_cast<int>(byteCount));
+	}
+	catch (const std::bad_alloc&)
+	{
+		return QByteArray();
+	}
+}
+
+//! Decompresses and unfilters a chunk
+static bool DecodeChunk(const QByteArray& chunk,
+						uint8_t* output,
+						size_t byteCount,
+						unsigned elementSize,
+						unsigned componentSize,
+						ccArrayCodec::Filter filter)
+{
+	QByteArray filtered = qUncompress(chunk);
+	if (static_cast<size_t>(filtered.size()) != byteCount)
+	{
+		//corrupted chunk (or not enough memory)
+		return false;
+	}
+
+	const uint8_t* input = reinterpret_cast<const uint8_t*>(filtered.constData());
+	switch (filter)
+	{
+	case ccArrayCodec::BYTE_SHUFFLE:
+	{
+		size_t valueCount = byteCount / componentSize;
+		for (size_t v = 0; v < valueCount; ++v)
+		{
+			for (unsigned b = 0; b < componentSize; ++b)
+			{
+				output[v * componentSize + b] = input[b * valueCount + v];
+			}
+		}
+		break;
+	}
+	case ccArrayCodec::BYTE_DELTA:
+	{
+		for (size_t j = 0; j < byteCount; ++j)
+		{
+			output[j] = static_cast<uint8_t>(j >= elementSize ? input[j] + output[j - elementSize] : input[j]);
+		}
+		break;
+	}
+	default:
+	{
+		std::copy(input, input + byteCount, output);
+		break;
+	}
+	}
+
+	return true;
+}
+
+bool ccArrayCodec::Write(	QFile& out,
+							const void* data,
+							uint64_t elementCount,
+							unsigned elementSize,
+							unsigned componentSize,
+							Filter filter)
+{
+	if (elementSize == 0 || componentSize == 0 || componentSize > 255 || elementSize % componentSize != 0)
+	{
+		assert(false);
+		return false;
+	}
+
+	uint32_t elementsPerChunk = std::max(1u, s_chunkByteSize / elementSize);
+	uint64_t chunkCount = ChunkCount(elementCount, elementsPerChunk);
+	if (chunkCount > std::numeric_limits<uint32_t>::max())
+	{
+		return false;
+	}
+
+	//header
+	{
+		uint8_t header[10];
+		header[0] = static_cast<uint8_t>(filter);
+		header[1] = static_cast<uint8_t>(componentSize);
+		uint32_t _chunkCount = static_cast<uint32_t>(chunkCount);
+		memcpy(header + 2, &elementsPerChunk, 4);
+		memcpy(header + 6, &_chunkCount, 4);
+		if (out.write(reinterpret_cast<const char*>(header), 10) < 0)
+			return false;
+	}
+
+	//chunk index (written once the chunks are compressed)
+	std::vector<uint64_t> chunkEnds;
+	try
+	{
+		chunkEnds.resize(chunkCount, 0);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccArrayCodec] Not enough memory");
+		return false;
+	}
+	qint64 indexPos = out.pos();
+	if (chunkCount != 0 && out.write(reinterpret_cast<const char*>(chunkEnds.data()), static_cast<qint64>(chunkCount * sizeof(uint64_t))) < 0)
+		return false;
+
+	//the chunks are compressed in parallel (by batches) and written in order
+	int batchSize = 1;
+#if defined(_OPENMP)
+	batchSize = omp_get_max_threads();
+#endif
+	std::vector<QByteArray> compressedChunks(batchSize);
+
+	const uint8_t* input = static_cast<const uint8_t*>(data);
+	uint64_t chunkEnd = 0;
+	for (uint64_t batchStart = 0; batchStart < chunkCount; batchStart += batchSize)
+	{
+		int currentBatchSize = static_cast<int>(std::min<uint64_t>(batchSize, chunkCount - batchStart));
+#if defined(_OPENMP)
+		#pragma omp parallel for num_threads(batchSize)
+#endif
+		for (int i = 0; i < currentBatchSize; ++i)
+		{
+			uint64_t chunkIndex = batchStart + i;
+			uint64_t firstElement = chunkIndex * elementsPerChunk;
+			size_t byteCount = static_cast<size_t>(std::min<uint64_t>(elementsPerChunk, elementCount - firstElement) * elementSize);
+			compressedChunks[i] = EncodeChunk(input + firstElement * elementSize, byteCount, elementSize, componentSize, filter);
+		}
+
+		for (int i = 0; i < currentBatchSize; ++i)
+		{
+			QByteArray& chunk = compressedChunks[i];
+			if (chunk.isEmpty())
+			{
+				ccLog::Warning("[ccArrayCodec] Failed to compress the data (not enough memory?)");
+				return false;
+			}
+			if (out.write(chunk) < 0)
+				return false;
+
+			chunkEnd += static_cast<uint64_t>(chunk.size());
+			chunkEnds[batchStart + i] = chunkEnd;
+			chunk.clear();
+		}
+	}
+
+	//now we can write the index
+	if (chunkCount != 0)
+	{
+		qint64 endPos = out.pos();
+		if (	!out.seek(indexPos)
+			||	out.write(reinterpret_cast<const char*>(chunkEnds.data()), static_cast<qint64>(chunkCount * sizeof(uint64_t))) < 0
+			||	!out.seek(endPos))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ccArrayCodec::Read(QFile& in,
+						void* data,
+						uint64_t elementCount,
+						unsigned elementSize)
+{
+	//header
+	uint8_t header[10];
+	if (in.read(reinterpret_cast<char*>(header), 10) != 10)
+		return false;
+
+	Filter filter = static_cast<Filter>(header[0]);
+	unsigned componentSize = header[1];
+	uint32_t elementsPerChunk = 0;
+	uint32_t chunkCount = 0;
+	memcpy(&elementsPerChunk, header + 2, 4);
+	memcpy(&chunkCount, header + 6, 4);
+
+	if (	filter > BYTE_DELTA
+		||	componentSize == 0
+		||	elementSize % componentSize != 0
+		||	elementsPerChunk == 0
+		||	ChunkCount(elementCount, elementsPerChunk) != chunkCount)
+	{
+		ccLog::Warning("[ccArrayCodec] Invalid compressed array header");
+		return false;
+	}
+
+	//chunk index
+	std::vector<uint64_t> chunkEnds;
+	try
+	{
+		chunkEnds.resize(chunkCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccArrayCodec] Not enough memory");
+		return false;
+	}
+	qint64 indexSize = static_cast<qint64>(chunkCount) * sizeof(uint64_t);
+	if (chunkCount != 0 && in.read(reinterpret_cast<char*>(chunkEnds.data()), indexSize) != indexSize)
+		return false;
+
+	//the chunks are read in order and decompressed in parallel (by batches)
+	int batchSize = 1;
+#if defined(_OPENMP)
+	batchSize = omp_get_max_threads();
+#endif
+	std::vector<QByteArray> compressedChunks(batchSize);
+	std::vector<uint8_t> failed(batchSize, 0);
+
+	uint8_t* output = static_cast<uint8_t*>(data);
+	uint64_t chunkStart = 0;
+	for (uint32_t batchStart = 0; batchStart < chunkCount; batchStart += batchSize)
+	{
+		int currentBatchSize = static_cast<int>(std::min<uint32_t>(batchSize, chunkCount - batchStart));
+		for (int i = 0; i < currentBatchSize; ++i)
+		{
+			uint64_t chunkEnd = chunkEnds[batchStart + i];
+			if (chunkEnd <= chunkStart)
+			{
+				ccLog::Warning("[ccArrayCodec] Invalid chunk index");
+				return false;
+			}
+			qint64 chunkSize = static_cast<qint64>(chunkEnd - chunkStart);
+			compressedChunks[i] = in.read(chunkSize);
+			if (compressedChunks[i].size() != chunkSize)
+				return false;
+			chunkStart = chunkEnd;
+		}
+
+#if defined(_OPENMP)
+		#pragma omp parallel for num_threads(batchSize)
+#endif
+		for (int i = 0; i < currentBatchSize; ++i)
+		{
+			uint64_t firstElement = static_cast<uint64_t>(batchStart + i) * elementsPerChunk;
+			size_t byteCount = static_cast<size_t>(std::min<uint64_t>(elementsPerChunk, elementCount - firstElement) * elementSize);
+			failed[i] = DecodeChunk(compressedChunks[i], output + firstElement * elementSize, byteCount, elementSize, componentSize, filter) ? 0 : 1;
+			compressedChunks[i].clear();
+		}
+
+		if (std::find(failed.begin(), failed.begin() + currentBatchSize, 1) != failed.begin() + currentBatchSize)
+		{
+			ccLog::Warning("[ccArrayCodec] Failed to decompress the data (corrupted file or not enough memory?)");
+			return false;
+		}
+	}
+
+	return true;
+}
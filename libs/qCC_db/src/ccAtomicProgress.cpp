@@ -0,0 +1,64 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccAtomicProgress.h"
+
+//Qt
+#include <QMutexLocker>
+
+ccAtomicProgress::ccAtomicProgress()
+	: m_value(0)
+	, m_running(false)
+	, m_cancelRequested(false)
+{
+}
+
+void ccAtomicProgress::start()
+{
+	m_value.store(0);
+	m_cancelRequested.store(false);
+	m_running.store(true);
+}
+
+void ccAtomicProgress::stop()
+{
+	m_running.store(false);
+}
+
+void ccAtomicProgress::setMethodTitle(const QString& methodTitle)
+{
+	QMutexLocker locker(&m_textMutex);
+	m_methodTitle = methodTitle;
+}
+
+void ccAtomicProgress::setInfo(const QString& infoStr)
+{
+	QMutexLocker locker(&m_textMutex);
+	m_info = infoStr;
+}
+
+QString ccAtomicProgress::methodTitle() const
+{
+	QMutexLocker locker(&m_textMutex);
+	return m_methodTitle;
+}
+
+QString ccAtomicProgress::info() const
+{
+	QMutexLocker locker(&m_textMutex);
+	return m_info;
+}
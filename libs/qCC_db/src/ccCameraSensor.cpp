@@ -30,8 +30,14 @@
 
 //Qt
 #include <QDir>
+#include <QMutex>
 #include <QTextStream>
 
+#if defined(_OPENMP)
+//OpenMP
+#include <omp.h>
+#endif
+
 ccCameraSensor::IntrinsicParameters::IntrinsicParameters()
 	: vertFocal_pix(1.0f)
 	, skew(0)
@@ -1044,6 +1050,107 @@ bool ccCameraSensor::computeUncertainty(CCCoreLib::ReferenceCloud* points, std::
 	return true;
 }
 
+//! Undistortion remap table (position in the original image of each pixel of the undistorted image)
+struct UndistortionMap
+{
+	using Shared = QSharedPointer<UndistortionMap>;
+
+	//! Parameters the map depends on
+	struct Key
+	{
+		int width = 0;
+		int height = 0;
+		float k1 = 0.0f;
+		float k2 = 0.0f;
+		float k3 = 0.0f;
+		float horizFocal_pix = 0.0f;
+		float vertFocal_pix = 0.0f;
+		float cx = 0.0f;
+		float cy = 0.0f;
+
+		bool operator == (const Key& other) const
+		{
+			return	width == other.width && height == other.height
+				&&	k1 == other.k1 && k2 == other.k2 && k3 == other.k3
+				&&	horizFocal_pix == other.horizFocal_pix && vertFocal_pix == other.vertFocal_pix
+				&&	cx == other.cx && cy == other.cy;
+		}
+	};
+
+	Key key;
+	//! Original image coordinates (x, y) of each pixel
+	std::vector<float> coords;
+};
+
+//! Maximum number of undistortion maps kept in cache (typically one per camera and image size)
+static const size_t s_maxUndistortionMapCount = 8;
+//! Undistortion maps cache (most recently used first)
+static std::vector<UndistortionMap::Shared> s_undistortionMaps;
+//! Undistortion maps cache mutex
+static QMutex s_undistortionMapsMutex;
+
+//! Returns the undistortion map corresponding to a given set of parameters (computed once and cached)
+static UndistortionMap::Shared GetUndistortionMap(const UndistortionMap::Key& key)
+{
+	{
+		QMutexLocker locker(&s_undistortionMapsMutex);
+		for (size_t i = 0; i < s_undistortionMaps.size(); ++i)
+		{
+			if (s_undistortionMaps[i]->key == key)
+			{
+				UndistortionMap::Shared map = s_undistortionMaps[i];
+				s_undistortionMaps.erase(s_undistortionMaps.begin() + i);
+				s_undistortionMaps.insert(s_undistortionMaps.begin(), map);
+				return map;
+			}
+		}
+	}
+
+	UndistortionMap::Shared map(new UndistortionMap);
+	map->key = key;
+	try
+	{
+		map->coords.resize(2 * static_cast<size_t>(key.width) * key.height);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return UndistortionMap::Shared(nullptr);
+	}
+
+	float vf2 = key.vertFocal_pix * key.vertFocal_pix;
+	float hf2 = key.horizFocal_pix * key.horizFocal_pix;
+
+#if defined(_OPENMP)
+	#pragma omp parallel for num_threads(omp_get_max_threads())
+#endif
+	for (int j = 0; j < key.height; ++j)
+	{
+		float y = j - key.cy;
+		float y2 = y * y;
+		float* coords = map->coords.data() + 2 * static_cast<size_t>(j) * key.width;
+		for (int i = 0; i < key.width; ++i)
+		{
+			float x = i - key.cx;
+			float x2 = x * x;
+
+			float p2 = x2 / hf2 + y2 / vf2; //p = pix/f
+			float rp = 1.0f + p2 * (key.k1 + p2 * (key.k2 + p2 * key.k3)); //r(p) = 1.0 + k1 * ||p||^2 + k2 * ||p||^4 + k3 * ||p||^6
+			coords[2 * i] = rp * x + key.cx;
+			coords[2 * i + 1] = rp * y + key.cy;
+		}
+	}
+
+	QMutexLocker locker(&s_undistortionMapsMutex);
+	s_undistortionMaps.insert(s_undistortionMaps.begin(), map);
+	if (s_undistortionMaps.size() > s_maxUndistortionMapCount)
+	{
+		s_undistortionMaps.pop_back();
+	}
+
+	return map;
+}
+
 //see http://opencv.willowgarage.com/documentation/cpp/camera_calibration_and_3d_reconstruction.html
 QImage ccCameraSensor::undistort(const QImage& image) const
 {
@@ -1095,51 +1202,92 @@ QImage ccCameraSensor::undistort(const QImage& image) const
 				return QImage();
 			}
 			newImage.fill(0);
+			if (image.format() == QImage::Format_Indexed8)
+			{
+				newImage.setColorTable(image.colorTable());
+			}
 
-			float vertFocal_pix = getVertFocal_pix() * xScale;
-			float horizFocal_pix = getHorizFocal_pix() * yScale;
-			float vf2 = vertFocal_pix * vertFocal_pix;
-			float hf2 = horizFocal_pix * horizFocal_pix;
-			float cx = m_intrinsicParams.principal_point[0] * xScale;
-			float cy = m_intrinsicParams.principal_point[1] * yScale;
-			k1 *= rScale;
-			k2 *= rScale;
-			k3 *= rScale;
+			//the remap table is shared by all the images with the same size and the same parameters
+			UndistortionMap::Key key;
+			key.width = width;
+			key.height = height;
+			key.vertFocal_pix = getVertFocal_pix() * xScale;
+			key.horizFocal_pix = getHorizFocal_pix() * yScale;
+			key.cx = m_intrinsicParams.principal_point[0] * xScale;
+			key.cy = m_intrinsicParams.principal_point[1] * yScale;
+			key.k1 = k1 * rScale;
+			key.k2 = k2 * rScale;
+			key.k3 = k3 * rScale;
+
+			UndistortionMap::Shared map = GetUndistortionMap(key);
+			if (!map)
+			{
+				ccLog::Warning("[ccCameraSensor::undistort] Not enough memory!");
+				return QImage();
+			}
 
 			assert((image.depth() % 8) == 0);
 			int depth = image.depth() / 8;
-			int bytesPerLine = image.bytesPerLine();
-			const uchar* iImageBits = image.bits();
-			uchar* oImageBits = newImage.bits();
 
-			//image undistortion
+			//bilinear interpolation is only possible if the channels are stored as bytes
+			int channelCount = 0;
+			switch (image.format())
 			{
-				for (int i = 0; i < width; ++i)
+			case QImage::Format_RGB32:
+			case QImage::Format_ARGB32:
+			case QImage::Format_ARGB32_Premultiplied:
+			case QImage::Format_RGBX8888:
+			case QImage::Format_RGBA8888:
+			case QImage::Format_RGBA8888_Premultiplied:
+			case QImage::Format_RGB888:
+			case QImage::Format_Grayscale8:
+				channelCount = depth;
+				break;
+			default:
+				//nearest neighbor
+				break;
+			}
+
+			//image undistortion: each output pixel pulls its value from its (distorted) position
+			//in the input image, so that the result has no holes nor overwritten pixels (as
+			//opposed to the former forward 'splatting' of the input pixels)
+#if defined(_OPENMP)
+			#pragma omp parallel for num_threads(omp_get_max_threads())
+#endif
+			for (int j = 0; j < height; ++j)
+			{
+				const float* coords = map->coords.data() + 2 * static_cast<size_t>(j) * width;
+				uchar* oPixel = newImage.scanLine(j);
+				for (int i = 0; i < width; ++i, oPixel += depth)
 				{
-					float x = i - cx;
-					float x2 = x*x;
-					for (int j = 0; j < height; ++j)
+					float eqx = coords[2 * i];
+					float eqy = coords[2 * i + 1];
+					//NaN coordinates would pass the range tests below
+					if (!std::isfinite(eqx) || !std::isfinite(eqy) || eqx < 0 || eqx >= width || eqy < 0 || eqy >= height)
+					{
+						continue;
+					}
+
+					int pixx = static_cast<int>(eqx);
+					int pixy = static_cast<int>(eqy);
+					const uchar* iPixel00 = image.constScanLine(pixy) + pixx * depth;
+
+					if (channelCount == 0)
 					{
-						float y = j - cy;
-						float y2 = y*y;
-
-						float p2 = x2 / hf2 + y2 / vf2; //p = pix/f
-						float rp = 1.0f + p2 * (k1 + p2 * (k2 + p2 * k3)); //r(p) = 1.0 + k1 * ||p||^2 + k2 * ||p||^4 + k3 * ||p||^6
-						float eqx = rp * x + cx;
-						float eqy = rp * y + cy;
-
-						int pixx = static_cast<int>(eqx);
-						int pixy = static_cast<int>(eqy);
-						if (	pixx >= 0
-							&&	pixx < width
-							&&	pixy >= 0
-							&&	pixy < height)
-						{
-							const uchar* iPixel = iImageBits + j * bytesPerLine + i * depth;
-							uchar* oPixel = oImageBits + pixy * bytesPerLine + pixx * depth;
-							memcpy(oPixel, iPixel, depth);
-							//newImage.setPixel(i, j, image.pixel(pixx, pixy));
-						}
+						memcpy(oPixel, iPixel00, depth);
+						continue;
+					}
+
+					//bilinear interpolation
+					int dx = (pixx + 1 < width ? depth : 0);
+					const uchar* iPixel10 = (pixy + 1 < height ? image.constScanLine(pixy + 1) + pixx * depth : iPixel00);
+					float fx = eqx - pixx;
+					float fy = eqy - pixy;
+					for (int c = 0; c < channelCount; ++c)
+					{
+						float top = iPixel00[c] + fx * (iPixel00[dx + c] - iPixel00[c]);
+						float bottom = iPixel10[c] + fx * (iPixel10[dx + c] - iPixel10[c]);
+						oPixel[c] = static_cast<uchar>(top + fy * (bottom - top) + 0.5f);
 					}
 				}
 			}
@@ -1789,6 +1937,19 @@ bool ccCameraSensor::computeOrthoRectificationParams(	const ccImage* image,
 	return true;
 }
 
+//! Returns a 32 bits version of an image (so that its pixels can be read directly as QRgb values)
+static QImage To32BitsImage(const QImage& image)
+{
+	switch (image.format())
+	{
+	case QImage::Format_RGB32:
+	case QImage::Format_ARGB32:
+		return image;
+	default:
+		return image.convertToFormat(QImage::Format_ARGB32);
+	}
+}
+
 ccImage* ccCameraSensor::orthoRectifyAsImageDirect(	const ccImage* image,
 													PointCoordinateType Z0,
 													double& pixelSize,
@@ -1916,32 +2077,55 @@ ccImage* ccCameraSensor::orthoRectifyAsImageDirect(	const ccImage* image,
 	if (orthoImage.isNull()) //not enough memory!
 		return nullptr;
 
+	QImage sourceImage = To32BitsImage(image->data());
+	if (sourceImage.isNull()) //not enough memory!
+		return nullptr;
+
+	//the sensor pose is the same for all pixels
+	ccIndexedTransformation trans;
+	if (!getActiveAbsoluteTransformation(trans))
+		return nullptr;
+	ccIndexedTransformation invTrans = trans.inverse();
+
 	const QRgb blackValue = qRgb(0, 0, 0);
 	const QRgb blackAlphaZero = qRgba(0, 0, 0, 0);
 
-	for (unsigned i = 0; i < w; ++i)
+	//we access the scanlines directly (QImage::pixel and QImage::setPixel are much slower)
+	const uchar* sourceBits = sourceImage.constBits();
+	int sourceBytesPerLine = sourceImage.bytesPerLine();
+	uchar* orthoBits = orthoImage.bits();
+	int orthoBytesPerLine = orthoImage.bytesPerLine();
+
+	int _h = static_cast<int>(h);
+#if defined(_OPENMP)
+	#pragma omp parallel for num_threads(omp_get_max_threads())
+#endif
+	for (int j = 0; j < _h; ++j)
 	{
-		PointCoordinateType xip = static_cast<PointCoordinateType>(minC[0] + i*_pixelSize);
-		for (unsigned j = 0; j < h; ++j)
+		PointCoordinateType yip = static_cast<PointCoordinateType>(minC[1] + j*_pixelSize);
+		QRgb* orthoLine = reinterpret_cast<QRgb*>(orthoBits + static_cast<size_t>(_h - 1 - j) * orthoBytesPerLine);
+
+		for (unsigned i = 0; i < w; ++i)
 		{
-			PointCoordinateType yip = static_cast<PointCoordinateType>(minC[1] + j*_pixelSize);
+			PointCoordinateType xip = static_cast<PointCoordinateType>(minC[0] + i*_pixelSize);
 
 			QRgb rgb = blackValue; //output pixel is (transparent) black by default
 
 			CCVector3 P3D(xip,yip,Z0);
+			invTrans.apply(P3D);
 			CCVector2 imageCoord;
-			if (fromGlobalCoordToImageCoord(P3D,imageCoord,undistortImages))
+			if (fromLocalCoordToImageCoord(P3D,imageCoord,undistortImages))
 			{
 				int x = static_cast<int>(imageCoord.x);
 				int y = static_cast<int>(imageCoord.y);
 				if (x >= 0 && x < width && y >= 0 && y < height)
 				{
-					rgb = image->data().pixel(x,y);
+					rgb = reinterpret_cast<const QRgb*>(sourceBits + static_cast<size_t>(y) * sourceBytesPerLine)[x];
 				}
 			}
 
 			//pure black pixels are treated as transparent ones!
-			orthoImage.setPixel(i, h - 1 - j, rgb != blackValue ? rgb : blackAlphaZero);
+			orthoLine[i] = (rgb != blackValue ? rgb : blackAlphaZero);
 		}
 	}
 
@@ -2068,17 +2252,33 @@ ccImage* ccCameraSensor::orthoRectifyAsImage(	const ccImage* image,
 	if (orthoImage.isNull()) //not enough memory!
 		return nullptr;
 
+	QImage sourceImage = To32BitsImage(image->data());
+	if (sourceImage.isNull()) //not enough memory!
+		return nullptr;
+
 	const QRgb blackValue = qRgb(0, 0, 0);
 	const QRgb blackAlphaZero = qRgba(0, 0, 0, 0);
 
-	for (unsigned i = 0; i < w; ++i)
+	//we access the scanlines directly (QImage::pixel and QImage::setPixel are much slower)
+	const uchar* sourceBits = sourceImage.constBits();
+	int sourceBytesPerLine = sourceImage.bytesPerLine();
+	uchar* orthoBits = orthoImage.bits();
+	int orthoBytesPerLine = orthoImage.bytesPerLine();
+
+	int _h = static_cast<int>(h);
+#if defined(_OPENMP)
+	#pragma omp parallel for num_threads(omp_get_max_threads())
+#endif
+	for (int j = 0; j < _h; ++j)
 	{
-		double xip = minC[0] + static_cast<double>(i)*_pixelSize;
-		for (unsigned j = 0; j < h; ++j)
+		double yip = minC[1] + static_cast<double>(j)*_pixelSize;
+		QRgb* orthoLine = reinterpret_cast<QRgb*>(orthoBits + static_cast<size_t>(_h - 1 - j) * orthoBytesPerLine);
+
+		for (unsigned i = 0; i < w; ++i)
 		{
 			QRgb rgb = blackValue; //output pixel is (transparent) black by default
 
-			double yip = minC[1] + static_cast<double>(j)*_pixelSize;
+			double xip = minC[0] + static_cast<double>(i)*_pixelSize;
 			double q = (c2*xip - a2)*(c1*yip - b1) - (c2*yip - b2)*(c1*xip - a1);
 			double p = (a0 - xip)*(c1*yip - b1) - (b0 - yip)*(c1*xip - a1);
 			double yi = p / q;
@@ -2095,12 +2295,12 @@ ccImage* ccCameraSensor::orthoRectifyAsImage(	const ccImage* image,
 
 				if (x >= 0 && x < width)
 				{
-					rgb = image->data().pixel(x, y);
+					rgb = reinterpret_cast<const QRgb*>(sourceBits + static_cast<size_t>(y) * sourceBytesPerLine)[x];
 				}
 			}
 
 			//pure black pixels are treated as transparent ones!
-			orthoImage.setPixel(i, h - 1 - j, rgb != blackValue ? rgb : blackAlphaZero);
+			orthoLine[i] = (rgb != blackValue ? rgb : blackAlphaZero);
 		}
 	}
 
@@ -2110,6 +2310,88 @@ ccImage* ccCameraSensor::orthoRectifyAsImage(	const ccImage* image,
 	return new ccImage(orthoImage,getName());
 }
 
+//! Ortho-rectifies one image of a set (see ccCameraSensor::OrthoRectifyAsImages)
+/** \return the ortho-rectified image (or a null image if not enough memory)
+**/
+static QImage OrthoRectifyImage(const QImage& image,
+								const double a[3], const double b[3], const double c[3],
+								const double minC[2], const double maxC[2],
+								double pixelSize)
+{
+	double dx = maxC[0] - minC[0];
+	double dy = maxC[1] - minC[1];
+
+	int width = image.width();
+	int height = image.height();
+	unsigned w = static_cast<unsigned>(ceil(dx / pixelSize));
+	unsigned h = static_cast<unsigned>(ceil(dy / pixelSize));
+
+	QImage orthoImage(w, h, QImage::Format_ARGB32);
+	if (orthoImage.isNull()) //not enough memory!
+	{
+		return QImage();
+	}
+
+	QImage sourceImage = To32BitsImage(image);
+	if (sourceImage.isNull()) //not enough memory!
+	{
+		return QImage();
+	}
+
+	//ortho rectification parameters
+	const double& a0 = a[0];
+	const double& a1 = a[1];
+	const double& a2 = a[2];
+	const double& b0 = b[0];
+	const double& b1 = b[1];
+	const double& b2 = b[2];
+	//const double& c0 = c[0];
+	const double& c1 = c[1];
+	const double& c2 = c[2];
+
+	const uchar* sourceBits = sourceImage.constBits();
+	int sourceBytesPerLine = sourceImage.bytesPerLine();
+	uchar* orthoBits = orthoImage.bits();
+	int orthoBytesPerLine = orthoImage.bytesPerLine();
+
+	for (unsigned j = 0; j < h; ++j)
+	{
+		double yip = minC[1] + static_cast<double>(j)*pixelSize;
+		QRgb* orthoLine = reinterpret_cast<QRgb*>(orthoBits + static_cast<size_t>(h - 1 - j) * orthoBytesPerLine);
+
+		for (unsigned i = 0; i < w; ++i)
+		{
+			double xip = minC[0] + static_cast<double>(i)*pixelSize;
+			double q = (c2*xip - a2)*(c1*yip - b1) - (c2*yip - b2)*(c1*xip - a1);
+			double p = (a0 - xip)*(c1*yip - b1) - (b0 - yip)*(c1*xip - a1);
+			double yi = p / q;
+
+			q = (c1*xip - a1)*(c2*yip - b2) - (c1*yip - b1)*(c2*xip - a2);
+			p = (a0 - xip)*(c2*yip - b2) - (b0 - yip)*(c2*xip - a2);
+			double  xi = p / q;
+
+			xi += 0.5 * width;
+			yi += 0.5 * height;
+
+			int x = static_cast<int>(xi);
+			int y = static_cast<int>(yi);
+			if (x >= 0 && x < width && y >= 0 && y < height)
+			{
+				QRgb rgb = reinterpret_cast<const QRgb*>(sourceBits + static_cast<size_t>(y) * sourceBytesPerLine)[x];
+				//pure black pixels are treated as transparent ones!
+				if (qRed(rgb) + qGreen(rgb) + qBlue(rgb) > 0)
+					orthoLine[i] = rgb;
+				else
+					orthoLine[i] = qRgba(qRed(rgb), qGreen(rgb), qBlue(rgb), 0);
+			}
+			else
+				orthoLine[i] = qRgba(255, 0, 255, 0);
+		}
+	}
+
+	return orthoImage;
+}
+
 bool ccCameraSensor::OrthoRectifyAsImages(	std::vector<ccImage*> images,
 											double a[], double b[], double c[],
 											unsigned maxSize,
@@ -2251,112 +2533,90 @@ bool ccCameraSensor::OrthoRectifyAsImages(	std::vector<ccImage*> images,
 		}
 	}
 
-	//projet each image accordingly
-	for (size_t k = 0; k < count; ++k)
+	//project the images by batches (one image per thread)
+	size_t batchSize = 1;
+#if defined(_OPENMP)
+	batchSize = static_cast<size_t>(std::max(1, omp_get_max_threads()));
+#endif
+	std::vector<QImage> orthoImages;
+
+	for (size_t batchStart = 0; batchStart < count; batchStart += batchSize)
 	{
-		double* minC = &minCorners[2 * k];
-		double* maxC = &maxCorners[2 * k];
-		double dx = maxC[0] - minC[0];
-		double dy = maxC[1] - minC[1];
+		int batchCount = static_cast<int>(std::min(batchSize, count - batchStart));
+		orthoImages.clear();
+		orthoImages.resize(batchCount);
 
-		ccImage* image = images[k];
-		unsigned width = images[k]->getW();
-		unsigned height = images[k]->getH();
-		unsigned w = static_cast<unsigned>(ceil(dx / pixelSize));
-		unsigned h = static_cast<unsigned>(ceil(dy / pixelSize));
+#if defined(_OPENMP)
+		#pragma omp parallel for num_threads(batchCount) schedule(dynamic)
+#endif
+		for (int n = 0; n < batchCount; ++n)
+		{
+			size_t k = batchStart + n;
+			orthoImages[n] = OrthoRectifyImage(	images[k]->data(),
+												a + k * 3, b + k * 3, c + k * 3,
+												&minCorners[2 * k], &maxCorners[2 * k],
+												pixelSize);
+		}
 
-		QImage orthoImage(w, h, QImage::Format_ARGB32);
-		if (orthoImage.isNull()) //not enough memory!
+		//then save them (in the input order)
+		for (int n = 0; n < batchCount; ++n)
 		{
-			//clear mem.
-			if (result)
+			size_t k = batchStart + n;
+			double* minC = &minCorners[2 * k];
+			double* maxC = &maxCorners[2 * k];
+
+			ccImage* image = images[k];
+			QImage& orthoImage = orthoImages[n];
+			if (orthoImage.isNull()) //not enough memory!
 			{
-				while (!result->empty())
+				//clear mem.
+				if (result)
 				{
-					delete result->back();
-					result->pop_back();
+					while (!result->empty())
+					{
+						delete result->back();
+						result->pop_back();
+					}
 				}
+				ccLog::Warning("[OrthoRectifyAsImages] Not enough memory!");
+				return false;
 			}
-			ccLog::Warning("[OrthoRectifyAsImages] Not enough memory!");
-			return false;
-		}
-
-		//ortho rectification parameters
-		const double& a0 = a[k * 3];
-		const double& a1 = a[k * 3 + 1];
-		const double& a2 = a[k * 3 + 2];
-		const double& b0 = b[k * 3];
-		const double& b1 = b[k * 3 + 1];
-		const double& b2 = b[k * 3 + 2];
-		//const double& c0 = c[k*3];
-		const double& c1 = c[k * 3 + 1];
-		const double& c2 = c[k * 3 + 2];
+			unsigned w = static_cast<unsigned>(orthoImage.width());
+			unsigned h = static_cast<unsigned>(orthoImage.height());
 
-		for (unsigned i = 0; i < w; ++i)
-		{
-			double xip = minC[0] + static_cast<double>(i)*pixelSize;
-			for (unsigned j = 0; j < h; ++j)
+			//eventually compute relative pos
+			if (relativePos)
 			{
-				double yip = minC[1] + static_cast<double>(j)*pixelSize;
-				double q = (c2*xip - a2)*(c1*yip - b1) - (c2*yip - b2)*(c1*xip - a1);
-				double p = (a0 - xip)*(c1*yip - b1) - (b0 - yip)*(c1*xip - a1);
-				double yi = p / q;
-
-				q = (c1*xip - a1)*(c2*yip - b2) - (c1*yip - b1)*(c2*xip - a2);
-				p = (a0 - xip)*(c2*yip - b2) - (b0 - yip)*(c2*xip - a2);
-				double  xi = p / q;
+				double xShift = (minC[0] - minCorners[0]) / pixelSize;
+				double yShift = (minC[1] - minCorners[1]) / pixelSize;
+				relativePos->emplace_back(xShift, yShift);
+			}
 
-				xi += 0.5 * width;
-				yi += 0.5 * height;
+			if (outputDir)
+			{
+				//export image
+				QString exportFilename = QString("ortho_rectified_%1.png").arg(image->getName());
+				orthoImage.save(outputDir->absoluteFilePath(exportFilename));
 
-				int x = static_cast<int>(xi);
-				int y = static_cast<int>(yi);
-				if (x >= 0 && x < static_cast<int>(width) && y >= 0 && y < static_cast<int>(height))
+				//export meta-data
+				QFile f(outputDir->absoluteFilePath("ortho_rectification_log.txt"));
+				if (f.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) //always append
 				{
-					QRgb rgb = image->data().pixel(x, y);
-					//pure black pixels are treated as transparent ones!
-					if (qRed(rgb) + qGreen(rgb) + qBlue(rgb) > 0)
-						orthoImage.setPixel(i, h - 1 - j, rgb);
-					else
-						orthoImage.setPixel(i, h - 1 - j, qRgba(qRed(rgb), qGreen(rgb), qBlue(rgb), 0));
+					double xShiftGlobal = (minC[0] - globalCorners[0]) / pixelSize;
+					double yShiftGlobal = (minC[1] - globalCorners[1]) / pixelSize;
+					QTextStream stream(&f);
+					stream.setRealNumberNotation(QTextStream::FixedNotation);
+					stream.setRealNumberPrecision(6);
+					stream << "Image" << ' ' << exportFilename << ' ';
+					stream << "Local3DBBox" << ' ' << minC[0] << ' ' << minC[1] << ' ' << maxC[0] << ' ' << maxC[1] << ' ';
+					stream << "Local2DBBox" << ' ' << xShiftGlobal << ' ' << yShiftGlobal << ' ' << xShiftGlobal + static_cast<double>(w - 1) << ' ' << yShiftGlobal + static_cast<double>(h - 1) << endl;
+					f.close();
 				}
-				else
-					orthoImage.setPixel(i, h - 1 - j, qRgba(255, 0, 255, 0));
 			}
-		}
-
-		//eventually compute relative pos
-		if (relativePos)
-		{
-			double xShift = (minC[0] - minCorners[0]) / pixelSize;
-			double yShift = (minC[1] - minCorners[1]) / pixelSize;
-			relativePos->emplace_back(xShift, yShift);
-		}
-
-		if (outputDir)
-		{
-			//export image
-			QString exportFilename = QString("ortho_rectified_%1.png").arg(image->getName());
-			orthoImage.save(outputDir->absoluteFilePath(exportFilename));
 
-			//export meta-data
-			QFile f(outputDir->absoluteFilePath("ortho_rectification_log.txt"));
-			if (f.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) //always append
-			{
-				double xShiftGlobal = (minC[0] - globalCorners[0]) / pixelSize;
-				double yShiftGlobal = (minC[1] - globalCorners[1]) / pixelSize;
-				QTextStream stream(&f);
-				stream.setRealNumberNotation(QTextStream::FixedNotation);
-				stream.setRealNumberPrecision(6);
-				stream << "Image" << ' ' << exportFilename << ' ';
-				stream << "Local3DBBox" << ' ' << minC[0] << ' ' << minC[1] << ' ' << maxC[0] << ' ' << maxC[1] << ' ';
-				stream << "Local2DBBox" << ' ' << xShiftGlobal << ' ' << yShiftGlobal << ' ' << xShiftGlobal + static_cast<double>(w - 1) << ' ' << yShiftGlobal + static_cast<double>(h - 1) << endl;
-				f.close();
-			}
+			if (result)
+				result->push_back(new ccImage(orthoImage, image->getName()));
 		}
-
-		if (result)
-			result->push_back(new ccImage(orthoImage, image->getName()));
 	}
 
 	return true;
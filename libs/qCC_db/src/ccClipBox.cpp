@@ -24,10 +24,13 @@
 #include "ccCone.h"
 #include "ccCylinder.h"
 #include "ccHObjectCaster.h"
+#include "ccOctree.h"
 #include "ccSphere.h"
 #include "ccTorus.h"
+#include "ccVisibilitySelection.h"
 
 //system
+#include <algorithm>
 #include <cassert>
 
 #if defined(_OPENMP)
@@ -544,6 +547,190 @@ void ccClipBox::shift(const CCVector3& v)
 	Q_EMIT boxModified(&m_box);
 }
 
+//! Axis-aligned region (expressed in the clipping box coordinate system)
+struct ClipBoxRegion
+{
+	CCVector3 minCorner;
+	CCVector3 maxCorner;
+
+	//! Returns whether this region intersects another one
+	bool intersects(const ClipBoxRegion& other) const
+	{
+		return	minCorner.x <= other.maxCorner.x && maxCorner.x >= other.minCorner.x
+			&&	minCorner.y <= other.maxCorner.y && maxCorner.y >= other.minCorner.y
+			&&	minCorner.z <= other.maxCorner.z && maxCorner.z >= other.minCorner.z;
+	}
+
+	//! Returns whether this region contains another one
+	bool contains(const ClipBoxRegion& other) const
+	{
+		return	minCorner.x <= other.minCorner.x && maxCorner.x >= other.maxCorner.x
+			&&	minCorner.y <= other.minCorner.y && maxCorner.y >= other.maxCorner.y
+			&&	minCorner.z <= other.minCorner.z && maxCorner.z >= other.maxCorner.z;
+	}
+};
+
+//! Position of a set of points relatively to the clipping box
+enum class ClipBoxCellPosition { INSIDE, OUTSIDE, STRADDLING };
+
+//! Range of points (in the octree) to be flagged by ccClipBox::flagPointsInside
+struct ClipBoxCellRange
+{
+	unsigned begin; //first index in the octree 'points and cell codes' table
+	unsigned end; //last index + 1
+	ClipBoxCellPosition position;
+};
+
+//! Octree cells smaller than this are not subdivided anymore (their points are tested individually)
+static const unsigned s_clipBoxMinCellPopulation = 256;
+
+//! Octree-based classification of the points for ccClipBox::flagPointsInside
+class ClipBoxCellClassifier
+{
+public:
+
+	ClipBoxCellClassifier(	const CCCoreLib::DgmOctree& octree,
+							const ccBBox& box,
+							const ccGLMatrix* transMat)
+		: m_octree(octree)
+		, m_codes(octree.pointsAndTheirCellCodes())
+		, m_transMat(transMat)
+	{
+		m_box.minCorner = box.minCorner();
+		m_box.maxCorner = box.maxCorner();
+	}
+
+	//! Classifies the whole octree
+	void classify(std::vector<ClipBoxCellRange>& ranges) const
+	{
+		classifyChildren(0, static_cast<unsigned>(m_codes.size()), 0, ranges);
+	}
+
+protected:
+
+	//! Returns the (transformed) region corresponding to an octree cell
+	ClipBoxRegion getCellRegion(CCCoreLib::DgmOctree::CellCode truncatedCode, unsigned char level) const
+	{
+		CCVector3 cellMin;
+		CCVector3 cellMax;
+		m_octree.computeCellLimits(truncatedCode, level, cellMin, cellMax, true);
+
+		//the points may lie slightly outside of their cell (rounding errors)
+		PointCoordinateType margin = m_octree.getCellSize(level) / 1024;
+		cellMin -= CCVector3(margin, margin, margin);
+		cellMax += CCVector3(margin, margin, margin);
+
+		if (!m_transMat)
+		{
+			return ClipBoxRegion{ cellMin, cellMax };
+		}
+
+		//we use the bounding box of the transformed cell (conservative)
+		ClipBoxRegion region;
+		for (unsigned i = 0; i < 8; ++i)
+		{
+			CCVector3 C(	(i & 1) ? cellMax.x : cellMin.x,
+							(i & 2) ? cellMax.y : cellMin.y,
+							(i & 4) ? cellMax.z : cellMin.z);
+			m_transMat->apply(C);
+			if (i == 0)
+			{
+				region.minCorner = region.maxCorner = C;
+			}
+			else
+			{
+				for (unsigned char d = 0; d < 3; ++d)
+				{
+					region.minCorner.u[d] = std::min(region.minCorner.u[d], C.u[d]);
+					region.maxCorner.u[d] = std::max(region.maxCorner.u[d], C.u[d]);
+				}
+			}
+		}
+		return region;
+	}
+
+	//! Classifies a cell (and its children if necessary)
+	void classifyCell(unsigned begin, unsigned end, CCCoreLib::DgmOctree::CellCode truncatedCode, unsigned char level, std::vector<ClipBoxCellRange>& ranges) const
+	{
+		ClipBoxRegion cellRegion = getCellRegion(truncatedCode, level);
+
+		if (m_box.contains(cellRegion))
+		{
+			ranges.push_back(ClipBoxCellRange{ begin, end, ClipBoxCellPosition::INSIDE });
+		}
+		else if (!m_box.intersects(cellRegion))
+		{
+			ranges.push_back(ClipBoxCellRange{ begin, end, ClipBoxCellPosition::OUTSIDE });
+		}
+		else if (level == CCCoreLib::DgmOctree::MAX_OCTREE_LEVEL || end - begin <= s_clipBoxMinCellPopulation)
+		{
+			ranges.push_back(ClipBoxCellRange{ begin, end, ClipBoxCellPosition::STRADDLING });
+		}
+		else
+		{
+			classifyChildren(begin, end, level, ranges);
+		}
+	}
+
+	//! Classifies the (non empty) children of a cell
+	void classifyChildren(unsigned begin, unsigned end, unsigned char level, std::vector<ClipBoxCellRange>& ranges) const
+	{
+		const unsigned char childLevel = level + 1;
+		const unsigned char bitDec = CCCoreLib::DgmOctree::GET_BIT_SHIFT(childLevel);
+
+		unsigned childBegin = begin;
+		while (childBegin < end)
+		{
+			CCCoreLib::DgmOctree::CellCode childCode = (m_codes[childBegin].theCode >> bitDec);
+
+			//the codes are sorted
+			CCCoreLib::DgmOctree::cellsContainer::const_iterator childEndIt = std::upper_bound(
+				m_codes.begin() + childBegin,
+				m_codes.begin() + end,
+				childCode,
+				[bitDec](CCCoreLib::DgmOctree::CellCode code, const CCCoreLib::DgmOctree::IndexAndCode& item) { return code < (item.theCode >> bitDec); });
+			unsigned childEnd = static_cast<unsigned>(childEndIt - m_codes.begin());
+
+			classifyCell(childBegin, childEnd, childCode, childLevel, ranges);
+			childBegin = childEnd;
+		}
+	}
+
+	const CCCoreLib::DgmOctree& m_octree;
+	const CCCoreLib::DgmOctree::cellsContainer& m_codes;
+	const ccGLMatrix* m_transMat;
+	ClipBoxRegion m_box;
+};
+
+//! Classifies the cloud octree cells (if any) relatively to the clipping box
+/** \return the octree if the classification succeeded
+**/
+static ccOctree::Shared ClassifyOctreeCells(ccGenericPointCloud* cloud,
+											const ccBBox& box,
+											const ccGLMatrix* transMat,
+											std::vector<ClipBoxCellRange>& ranges)
+{
+	ccOctree::Shared octree = cloud->getOctree();
+	if (!octree || octree->getNumberOfProjectedPoints() != cloud->size())
+	{
+		return ccOctree::Shared(nullptr);
+	}
+
+	try
+	{
+		ClipBoxCellClassifier classifier(*octree, box, transMat);
+		classifier.classify(ranges);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory: we'll test all the points
+		ranges.clear();
+		return ccOctree::Shared(nullptr);
+	}
+
+	return octree;
+}
+
 void ccClipBox::flagPointsInside(	ccGenericPointCloud* cloud,
 									ccGenericPointCloud::VisibilityTableType* visTable,
 									bool shrink/*=false*/) const
@@ -561,12 +748,63 @@ void ccClipBox::flagPointsInside(	ccGenericPointCloud* cloud,
 		return;
 	}
 
+	ccGLMatrix transMat;
+	if (m_glTransEnabled)
+	{
+		transMat = m_glTrans.inverse();
+	}
+
+	//if the cloud has an octree, we can classify its cells first
+	std::vector<ClipBoxCellRange> ranges;
+	ccOctree::Shared octree = ClassifyOctreeCells(cloud, m_box, m_glTransEnabled ? &transMat : nullptr, ranges);
+	if (octree)
+	{
+		const CCCoreLib::DgmOctree::cellsContainer& codes = octree->pointsAndTheirCellCodes();
+		int rangeCount = static_cast<int>(ranges.size());
+
+#if defined(_OPENMP)
+		#pragma omp parallel for num_threads(omp_get_max_threads()) schedule(dynamic)
+#endif
+		for (int r = 0; r < rangeCount; ++r)
+		{
+			const ClipBoxCellRange& range = ranges[r];
+			for (unsigned j = range.begin; j < range.end; ++j)
+			{
+				unsigned i = codes[j].theIndex;
+				if (shrink && visTable->at(i) != CCCoreLib::POINT_VISIBLE)
+				{
+					continue;
+				}
+
+				switch (range.position)
+				{
+				case ClipBoxCellPosition::INSIDE:
+					visTable->at(i) = CCCoreLib::POINT_VISIBLE;
+					break;
+				case ClipBoxCellPosition::OUTSIDE:
+					visTable->at(i) = CCCoreLib::POINT_HIDDEN;
+					break;
+				case ClipBoxCellPosition::STRADDLING:
+				{
+					CCVector3 P = *cloud->getPoint(i);
+					if (m_glTransEnabled)
+					{
+						transMat.apply(P);
+					}
+					visTable->at(i) = (m_box.contains(P) ? CCCoreLib::POINT_VISIBLE : CCCoreLib::POINT_HIDDEN);
+				}
+				break;
+				}
+			}
+		}
+
+		return;
+	}
+
 	int count = static_cast<int>(cloud->size());
 
 	if (m_glTransEnabled)
 	{
-		ccGLMatrix transMat = m_glTrans.inverse();
-
 #if defined(_OPENMP)
 		#pragma omp parallel for num_threads(omp_get_max_threads())
 #endif
@@ -596,6 +834,90 @@ void ccClipBox::flagPointsInside(	ccGenericPointCloud* cloud,
 	}
 }
 
+bool ccClipBox::selectPointsInside(ccGenericPointCloud* cloud, ccVisibilitySelection& selection) const
+{
+	if (!cloud)
+	{
+		//invalid input
+		assert(false);
+		return false;
+	}
+
+	ccGLMatrix transMat;
+	if (m_glTransEnabled)
+	{
+		transMat = m_glTrans.inverse();
+	}
+
+	try
+	{
+		//if the cloud has an octree, we can classify its cells first
+		std::vector<ClipBoxCellRange> ranges;
+		ccOctree::Shared octree = ClassifyOctreeCells(cloud, m_box, m_glTransEnabled ? &transMat : nullptr, ranges);
+		if (octree)
+		{
+			selection.resize(cloud->size());
+
+			const CCCoreLib::DgmOctree::cellsContainer& codes = octree->pointsAndTheirCellCodes();
+			int rangeCount = static_cast<int>(ranges.size());
+
+			//the points of a cell are scattered in the selection words: the bits are set atomically
+#if defined(_OPENMP)
+			#pragma omp parallel for num_threads(omp_get_max_threads()) schedule(dynamic)
+#endif
+			for (int r = 0; r < rangeCount; ++r)
+			{
+				const ClipBoxCellRange& range = ranges[r];
+				switch (range.position)
+				{
+				case ClipBoxCellPosition::INSIDE:
+					for (unsigned j = range.begin; j < range.end; ++j)
+					{
+						selection.selectConcurrently(codes[j].theIndex);
+					}
+					break;
+				case ClipBoxCellPosition::OUTSIDE:
+					break;
+				case ClipBoxCellPosition::STRADDLING:
+					for (unsigned j = range.begin; j < range.end; ++j)
+					{
+						CCVector3 P = *cloud->getPoint(codes[j].theIndex);
+						if (m_glTransEnabled)
+						{
+							transMat.apply(P);
+						}
+						if (m_box.contains(P))
+						{
+							selection.selectConcurrently(codes[j].theIndex);
+						}
+					}
+					break;
+				}
+			}
+		}
+		else
+		{
+			selection.assign(cloud->size(), [&](unsigned i)
+			{
+				CCVector3 P = *cloud->getPoint(i);
+				if (m_glTransEnabled)
+				{
+					transMat.apply(P);
+				}
+				return m_box.contains(P);
+			});
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		selection.clear();
+		return false;
+	}
+
+	return true;
+}
+
 ccBBox ccClipBox::getOwnBB(bool withGLFeatures/*=false*/)
 {
 	ccBBox bbox = m_box;
@@ -31,8 +31,21 @@
 #include "ccScalarField.h"
 #endif
 
+//Qt
+#include <QElapsedTimer>
+
 //system
+#include <algorithm>
 #include <cassert>
+#include <functional>
+#include <limits>
+#include <map>
+#include <queue>
+
+#if defined(_OPENMP)
+//OpenMP
+#include <omp.h>
+#endif
 
 ccFastMarchingForNormsDirection::ccFastMarchingForNormsDirection()
 	: CCCoreLib::FastMarching()
@@ -119,22 +132,28 @@ int ccFastMarchingForNormsDirection::init(	ccGenericPointCloud* cloud,
 	return 0;
 }
 
-float ccFastMarchingForNormsDirection::computePropagationConfidence(DirectionCell* originCell, DirectionCell* destCell) const
+//! Computes relative 'confidence' between two cells (see ccFastMarchingForNormsDirection::computePropagationConfidence)
+static float PropagationConfidence(const CCVector3& originC, const CCVector3& originN, const CCVector3& destC, const CCVector3& destN)
 {
 	//1) it depends on the angle between the current cell's orientation
 	//	and its neighbor's orientation (symmetric)
 	//2) it depends on whether the neighbor's relative position is
 	//	compatible with the current cell orientation (symmetric)
-	CCVector3 AB = destCell->C - originCell->C;
+	CCVector3 AB = destC - originC;
 	AB.normalize();
 
-	float psOri = std::abs(static_cast<float>(AB.dot(originCell->N))); //ideal: 90 degrees
-	float psDest = std::abs(static_cast<float>(AB.dot(destCell->N))); //ideal: 90 degrees
+	float psOri = std::abs(static_cast<float>(AB.dot(originN))); //ideal: 90 degrees
+	float psDest = std::abs(static_cast<float>(AB.dot(destN))); //ideal: 90 degrees
 	float oriConfidence = (psOri + psDest)/2; //between 0 and 1 (ideal: 0)
 	
 	return 1.0f - oriConfidence;
 }
 
+float ccFastMarchingForNormsDirection::computePropagationConfidence(DirectionCell* originCell, DirectionCell* destCell) const
+{
+	return PropagationConfidence(originCell->C, originCell->N, destCell->C, destCell->N);
+}
+
 void ccFastMarchingForNormsDirection::resolveCellOrientation(unsigned index)
 {
 	DirectionCell* theCell = static_cast<DirectionCell*>(m_theGrid[index]);
@@ -538,3 +557,588 @@ int ccFastMarchingForNormsDirection::OrientNormals(ccPointCloud* cloud,
 
 	return (success ? 1 : 0);
 }
+
+//! Cell data (concurrent version)
+struct RegionCell
+{
+	//! The local cell normal
+	CCVector3 N;
+	//! The local cell center
+	CCVector3 C;
+	//! Patch (i.e. independent front) index
+	unsigned patch = 0;
+};
+
+//! Parameters shared by the cell functions (concurrent version)
+struct ConcurrentFMData
+{
+	ccGenericPointCloud* cloud = nullptr;
+	ccOctree* octree = nullptr;
+	NormsIndexesTableType* norms = nullptr;
+	//! Truncated cell codes (sorted)
+	CCCoreLib::DgmOctree::cellCodesContainer codes;
+	//! Cells data (same order as the codes)
+	std::vector<RegionCell> cells;
+	//! Whether the normals of each patch should be inverted
+	std::vector<unsigned char> patchFlips;
+};
+
+//! Returns the index of a cell (or codes.size() if the cell doesn't exist)
+static size_t FindCell(const CCCoreLib::DgmOctree::cellCodesContainer& codes, CCCoreLib::DgmOctree::CellCode code, size_t first, size_t last)
+{
+	CCCoreLib::DgmOctree::cellCodesContainer::const_iterator it = std::lower_bound(codes.begin() + first, codes.begin() + last, code);
+	return (it != codes.begin() + last && *it == code ? static_cast<size_t>(it - codes.begin()) : codes.size());
+}
+
+static bool ComputeRegionCellData(	const CCCoreLib::DgmOctree::octreeCell& cell,
+									void** additionalParameters,
+									CCCoreLib::NormalizedProgress* nProgress/*=nullptr*/)
+{
+	ConcurrentFMData* data = static_cast<ConcurrentFMData*>(additionalParameters[0]);
+
+	size_t index = FindCell(data->codes, cell.truncatedCode, 0, data->codes.size());
+	if (index == data->codes.size())
+	{
+		assert(false);
+		return true;
+	}
+
+	RegionCell& regionCell = data->cells[index];
+	regionCell.N = ComputeRobustAverageNorm(cell.points, data->cloud);
+	regionCell.C = *CCCoreLib::Neighbourhood(cell.points).getGravityCenter();
+
+	if (nProgress && !nProgress->steps(cell.points->size()))
+		return false;
+
+	return true;
+}
+
+static bool ApplyRegionCellOrientation(	const CCCoreLib::DgmOctree::octreeCell& cell,
+										void** additionalParameters,
+										CCCoreLib::NormalizedProgress* nProgress/*=nullptr*/)
+{
+	ConcurrentFMData* data = static_cast<ConcurrentFMData*>(additionalParameters[0]);
+
+	size_t index = FindCell(data->codes, cell.truncatedCode, 0, data->codes.size());
+	if (index == data->codes.size())
+	{
+		assert(false);
+		return true;
+	}
+
+	const RegionCell& regionCell = data->cells[index];
+	CCVector3 cellN = (data->patchFlips[regionCell.patch] ? -regionCell.N : regionCell.N);
+
+	//each point belongs to a single cell (no need to synchronize the threads)
+	unsigned pointCount = cell.points->size();
+	for (unsigned k = 0; k < pointCount; ++k)
+	{
+		unsigned pointIndex = cell.points->getPointGlobalIndex(k);
+		const CCVector3& N = ccNormalVectors::GetNormal(data->norms->getValue(pointIndex));
+
+		//inverse point normal if necessary
+		if (N.dot(cellN) < 0)
+		{
+			data->norms->setValue(pointIndex, ccNormalVectors::GetNormIndex(-N));
+		}
+	}
+
+	if (nProgress && !nProgress->steps(pointCount))
+		return false;
+
+	return true;
+}
+
+//! Front propagation inside a region (concurrent version)
+/** Mimics ccFastMarchingForNormsDirection::propagate, with a new seed each time the
+	front stops (i.e. one patch per connected set of cells of the region).
+	\return the number of patches (or -1 if not enough memory)
+**/
+static int PropagateInRegion(	ConcurrentFMData& data,
+								unsigned char level,
+								unsigned char regionLevel,
+								size_t firstCell,
+								size_t lastCell,
+								std::vector<std::pair<unsigned, unsigned>>& borderPairs)
+{
+	static const int NeighborShifts[6][3] = { {-1,0,0}, {1,0,0}, {0,-1,0}, {0,1,0}, {0,0,-1}, {0,0,1} };
+	static const unsigned NoNeighbor = std::numeric_limits<unsigned>::max();
+	enum CellState : unsigned char { FAR_CELL, TRIAL_CELL, ACTIVE_CELL };
+
+	const int cellCountPerDim = (1 << level);
+	const unsigned char regionBitShift = 3 * (level - regionLevel);
+	const CCCoreLib::DgmOctree::CellCode regionCode = (data.codes[firstCell] >> regionBitShift);
+	const size_t cellCount = lastCell - firstCell;
+
+	try
+	{
+		//local neighborhood
+		std::vector<unsigned> neighbors(6 * cellCount, NoNeighbor);
+		for (size_t i = 0; i < cellCount; ++i)
+		{
+			size_t index = firstCell + i;
+			Tuple3i cellPos;
+			data.octree->getCellPos(data.codes[index], level, cellPos, true);
+
+			for (unsigned n = 0; n < 6; ++n)
+			{
+				Tuple3i nPos(cellPos.x + NeighborShifts[n][0], cellPos.y + NeighborShifts[n][1], cellPos.z + NeighborShifts[n][2]);
+				if (	nPos.x < 0 || nPos.x >= cellCountPerDim
+					||	nPos.y < 0 || nPos.y >= cellCountPerDim
+					||	nPos.z < 0 || nPos.z >= cellCountPerDim)
+				{
+					continue;
+				}
+
+				CCCoreLib::DgmOctree::CellCode nCode = CCCoreLib::DgmOctree::GenerateTruncatedCellCode(nPos, level);
+				if ((nCode >> regionBitShift) == regionCode)
+				{
+					size_t nIndex = FindCell(data.codes, nCode, firstCell, lastCell);
+					if (nIndex != data.codes.size())
+					{
+						neighbors[6 * i + n] = static_cast<unsigned>(nIndex - firstCell);
+					}
+				}
+				else if (nCode > data.codes[index])
+				{
+					//the regions will be reconciled afterwards (each pair of cells is only stored once)
+					size_t nIndex = FindCell(data.codes, nCode, 0, data.codes.size());
+					if (nIndex != data.codes.size())
+					{
+						borderPairs.emplace_back(static_cast<unsigned>(index), static_cast<unsigned>(nIndex));
+					}
+				}
+			}
+		}
+
+		std::vector<CellState> states(cellCount, FAR_CELL);
+		std::vector<float> T(cellCount, std::numeric_limits<float>::max());
+		std::vector<float> signConfidences(cellCount, 1.0f);
+
+		using TrialCell = std::pair<float, unsigned>;
+		std::priority_queue<TrialCell, std::vector<TrialCell>, std::greater<TrialCell>> trialCells;
+
+		//arrival time of a cell (from its 'ACTIVE' neighbors)
+		auto computeT = [&](unsigned i) -> float
+		{
+			float t = std::numeric_limits<float>::max();
+			const RegionCell& dCell = data.cells[firstCell + i];
+			for (unsigned n = 0; n < 6; ++n)
+			{
+				unsigned j = neighbors[6 * i + n];
+				if (j != NoNeighbor && states[j] == ACTIVE_CELL)
+				{
+					const RegionCell& oCell = data.cells[firstCell + j];
+					float orientationConfidence = PropagationConfidence(oCell.C, oCell.N, dCell.C, dCell.N);
+					t = std::min(t, T[j] + (1.0f - orientationConfidence) * signConfidences[j]);
+				}
+			}
+			return t;
+		};
+
+		int patchCount = 0;
+		for (unsigned seed = 0; seed < cellCount; ++seed)
+		{
+			if (states[seed] != FAR_CELL)
+			{
+				continue;
+			}
+
+			//new front
+			unsigned patch = static_cast<unsigned>(patchCount++);
+			states[seed] = TRIAL_CELL;
+			T[seed] = 0;
+			trialCells.emplace(0.0f, seed);
+
+			while (!trialCells.empty())
+			{
+				TrialCell trialCell = trialCells.top();
+				trialCells.pop();
+				unsigned i = trialCell.second;
+				if (states[i] == ACTIVE_CELL || trialCell.first > T[i])
+				{
+					//already processed (or outdated)
+					continue;
+				}
+
+				RegionCell& theCell = data.cells[firstCell + i];
+				theCell.patch = patch;
+
+				//resolve the cell orientation by looking at the (already processed) neighbors
+				if (i != seed)
+				{
+					unsigned nPos = 0;
+					float confPos = 0;
+					unsigned nNeg = 0;
+					float confNeg = 0;
+					for (unsigned n = 0; n < 6; ++n)
+					{
+						unsigned j = neighbors[6 * i + n];
+						if (j != NoNeighbor && states[j] == ACTIVE_CELL)
+						{
+							const RegionCell& nCell = data.cells[firstCell + j];
+							float confidence = PropagationConfidence(nCell.C, nCell.N, theCell.C, theCell.N);
+							if (nCell.N.dot(theCell.N) < 0)
+							{
+								++nNeg;
+								confNeg += confidence;
+							}
+							else
+							{
+								++nPos;
+								confPos += confidence;
+							}
+						}
+					}
+
+					bool inverseNormal = (nNeg == nPos ? confNeg > confPos : nNeg > nPos);
+					if (inverseNormal)
+					{
+						theCell.N *= -1;
+					}
+					signConfidences[i] = (inverseNormal ? confNeg : confPos);
+				}
+				states[i] = ACTIVE_CELL;
+
+				//add its neighbors to the TRIAL set (or update their arrival time)
+				for (unsigned n = 0; n < 6; ++n)
+				{
+					unsigned j = neighbors[6 * i + n];
+					if (j == NoNeighbor || states[j] == ACTIVE_CELL)
+					{
+						continue;
+					}
+
+					float t = computeT(j);
+					if (states[j] == FAR_CELL || t < T[j])
+					{
+						states[j] = TRIAL_CELL;
+						T[j] = t;
+						trialCells.emplace(t, j);
+					}
+				}
+			}
+		}
+
+		return patchCount;
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return -1;
+	}
+}
+
+//! Union-find structure with relative orientations (to reconcile the patches)
+class PatchOrientations
+{
+public:
+
+	explicit PatchOrientations(size_t count)
+		: m_parents(count)
+		, m_flips(count, 0)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			m_parents[i] = static_cast<unsigned>(i);
+		}
+	}
+
+	//! Returns the root of a patch and whether the patch is inverted relatively to it
+	unsigned find(unsigned patch, unsigned char& flip)
+	{
+		//find the root
+		unsigned root = patch;
+		flip = 0;
+		while (m_parents[root] != root)
+		{
+			flip ^= m_flips[root];
+			root = m_parents[root];
+		}
+
+		//path compression
+		unsigned char remainingFlip = flip;
+		while (m_parents[patch] != root && patch != root)
+		{
+			unsigned parent = m_parents[patch];
+			unsigned char parentFlip = remainingFlip ^ m_flips[patch];
+			m_parents[patch] = root;
+			m_flips[patch] = remainingFlip;
+			patch = parent;
+			remainingFlip = parentFlip;
+		}
+
+		return root;
+	}
+
+	//! Merges two patches (if they are not already merged)
+	/** \param inverted whether the second patch should be inverted relatively to the first one
+	**/
+	bool merge(unsigned patch1, unsigned patch2, bool inverted)
+	{
+		unsigned char flip1 = 0;
+		unsigned char flip2 = 0;
+		unsigned root1 = find(patch1, flip1);
+		unsigned root2 = find(patch2, flip2);
+		if (root1 == root2)
+		{
+			return false;
+		}
+
+		m_parents[root2] = root1;
+		m_flips[root2] = flip1 ^ flip2 ^ (inverted ? 1 : 0);
+		return true;
+	}
+
+protected:
+
+	std::vector<unsigned> m_parents;
+	std::vector<unsigned char> m_flips;
+};
+
+int ccFastMarchingForNormsDirection::OrientNormalsConcurrently(	ccPointCloud* cloud,
+																unsigned char octreeLevel,
+																ccProgressDialog* progressCb/*=nullptr*/)
+{
+	if (!cloud || !cloud->normals())
+	{
+		const QString	name((cloud == nullptr) ? QStringLiteral("[unnamed]") : cloud->getName());
+
+		ccLog::Warning(QString("[orientNormalsWithFM] Cloud '%1' is invalid (or cloud has no normals)").arg(name));
+		assert(false);
+		return 0;
+	}
+
+	unsigned numberOfPoints = cloud->size();
+	if (numberOfPoints == 0)
+		return -1;
+
+	//we need the octree
+	if (!cloud->getOctree())
+	{
+		if (!cloud->computeOctree(progressCb))
+		{
+			ccLog::Warning(QString("[orientNormalsWithFM] Could not compute octree on cloud '%1'").arg(cloud->getName()));
+			return 0;
+		}
+	}
+	ccOctree::Shared octree = cloud->getOctree();
+	assert(octree);
+
+	QElapsedTimer timer;
+	timer.start();
+
+	ConcurrentFMData data;
+	data.cloud = cloud;
+	data.octree = octree.data();
+	data.norms = cloud->normals();
+	void* additionalParameters[1] = { reinterpret_cast<void*>(&data) };
+
+	//compute the cells orientation and center (in parallel)
+	try
+	{
+		octree->getCellCodes(octreeLevel, data.codes, true);
+		data.cells.resize(data.codes.size());
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[orientNormalsWithFM] Not enough memory!");
+		return -5;
+	}
+
+	if (octree->executeFunctionForAllCellsAtLevel(	octreeLevel,
+													&ComputeRegionCellData,
+													additionalParameters,
+													true,
+													progressCb,
+													"Norms direction (cells)") == 0)
+	{
+		ccLog::Warning("[orientNormalsWithFM] Failed to compute the cells orientation (or process cancelled)");
+		return -6;
+	}
+
+	//split the cells in regions (cells of a coarser level, i.e. contiguous codes)
+	int maxThreadCount = 1;
+#if defined(_OPENMP)
+	maxThreadCount = omp_get_max_threads();
+#endif
+	unsigned char regionLevel = 0;
+	std::vector<std::pair<size_t, size_t>> regions;
+	try
+	{
+		size_t targetRegionCount = 8 * static_cast<size_t>(maxThreadCount);
+		for (regionLevel = 1; regionLevel < octreeLevel; ++regionLevel)
+		{
+			unsigned char bitShift = 3 * (octreeLevel - regionLevel);
+			size_t regionCount = 1;
+			for (size_t i = 1; i < data.codes.size(); ++i)
+			{
+				if ((data.codes[i] >> bitShift) != (data.codes[i - 1] >> bitShift))
+					++regionCount;
+			}
+			if (regionCount >= targetRegionCount)
+				break;
+		}
+		regionLevel = std::min<unsigned char>(regionLevel, octreeLevel - 1);
+
+		unsigned char bitShift = 3 * (octreeLevel - regionLevel);
+		size_t firstCell = 0;
+		for (size_t i = 1; i <= data.codes.size(); ++i)
+		{
+			if (i == data.codes.size() || (data.codes[i] >> bitShift) != (data.codes[firstCell] >> bitShift))
+			{
+				regions.emplace_back(firstCell, i);
+				firstCell = i;
+			}
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[orientNormalsWithFM] Not enough memory!");
+		return -5;
+	}
+
+	//propagate independent fronts in each region (in parallel)
+	int regionCount = static_cast<int>(regions.size());
+	std::vector<int> regionPatchCounts(regions.size(), 0);
+	std::vector<qint64> regionTimes_ms(regions.size(), 0);
+	std::vector<std::vector<std::pair<unsigned, unsigned>>> borderPairs(regions.size());
+
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			progressCb->setMethodTitle("Norms direction");
+			progressCb->setInfo(qPrintable(QString("Octree level: %1\nPoints: %2\nRegions: %3").arg(octreeLevel).arg(numberOfPoints).arg(regionCount)));
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+	CCCoreLib::NormalizedProgress nProgress(progressCb, static_cast<unsigned>(regionCount));
+
+#if defined(_OPENMP)
+	#pragma omp parallel for num_threads(maxThreadCount) schedule(dynamic)
+#endif
+	for (int r = 0; r < regionCount; ++r)
+	{
+		QElapsedTimer regionTimer;
+		regionTimer.start();
+
+		regionPatchCounts[r] = PropagateInRegion(data, octreeLevel, regionLevel, regions[r].first, regions[r].second, borderPairs[r]);
+
+		regionTimes_ms[r] = regionTimer.elapsed();
+		if (progressCb)
+		{
+			nProgress.oneStep();
+		}
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	//global patch indexes
+	std::vector<unsigned> patchOffsets(regions.size() + 1, 0);
+	for (size_t r = 0; r < regions.size(); ++r)
+	{
+		if (regionPatchCounts[r] < 0)
+		{
+			ccLog::Warning("[orientNormalsWithFM] Not enough memory!");
+			return -5;
+		}
+		patchOffsets[r + 1] = patchOffsets[r] + static_cast<unsigned>(regionPatchCounts[r]);
+
+		for (size_t i = regions[r].first; i < regions[r].second; ++i)
+		{
+			data.cells[i].patch += patchOffsets[r];
+		}
+
+		ccLog::PrintDebug(QString("[orientNormalsWithFM] Region #%1: %2 cells / %3 patch(es) / %4 ms").arg(r + 1).arg(regions[r].second - regions[r].first).arg(regionPatchCounts[r]).arg(regionTimes_ms[r]));
+	}
+	unsigned patchCount = patchOffsets.back();
+
+	//consensus vote along the borders between the patches
+	size_t inversionCount = 0;
+	try
+	{
+		std::map<std::pair<unsigned, unsigned>, float> votes;
+		for (const std::vector<std::pair<unsigned, unsigned>>& pairs : borderPairs)
+		{
+			for (const std::pair<unsigned, unsigned>& cellPair : pairs)
+			{
+				const RegionCell& cell1 = data.cells[cellPair.first];
+				const RegionCell& cell2 = data.cells[cellPair.second];
+				float confidence = PropagationConfidence(cell1.C, cell1.N, cell2.C, cell2.N);
+				float vote = (cell1.N.dot(cell2.N) < 0 ? -confidence : confidence);
+				if (cell1.patch < cell2.patch)
+					votes[std::make_pair(cell1.patch, cell2.patch)] += vote;
+				else
+					votes[std::make_pair(cell2.patch, cell1.patch)] += vote;
+			}
+		}
+		borderPairs.clear();
+
+		//the strongest consensus first
+		std::vector<std::pair<std::pair<unsigned, unsigned>, float>> sortedVotes(votes.begin(), votes.end());
+		votes.clear();
+		std::sort(sortedVotes.begin(), sortedVotes.end(), [](const std::pair<std::pair<unsigned, unsigned>, float>& a, const std::pair<std::pair<unsigned, unsigned>, float>& b) { return std::abs(a.second) > std::abs(b.second); });
+
+		PatchOrientations orientations(patchCount);
+		for (const std::pair<std::pair<unsigned, unsigned>, float>& vote : sortedVotes)
+		{
+			orientations.merge(vote.first.first, vote.first.second, vote.second < 0);
+		}
+
+		data.patchFlips.resize(patchCount, 0);
+		for (unsigned p = 0; p < patchCount; ++p)
+		{
+			orientations.find(p, data.patchFlips[p]);
+			if (data.patchFlips[p])
+			{
+				++inversionCount;
+			}
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[orientNormalsWithFM] Not enough memory!");
+		return -5;
+	}
+
+	//eventually update the points normals (in parallel)
+	if (octree->executeFunctionForAllCellsAtLevel(	octreeLevel,
+													&ApplyRegionCellOrientation,
+													additionalParameters,
+													true,
+													progressCb,
+													"Norms direction (points)") == 0)
+	{
+		ccLog::Warning("[orientNormalsWithFM] Failed to update the normals (or process cancelled)");
+		return 0;
+	}
+	cloud->normalsHaveChanged();
+	cloud->showNormals(true);
+
+	//timings
+	if (regionCount != 0)
+	{
+		qint64 minTime_ms = *std::min_element(regionTimes_ms.begin(), regionTimes_ms.end());
+		qint64 maxTime_ms = *std::max_element(regionTimes_ms.begin(), regionTimes_ms.end());
+		qint64 totalTime_ms = 0;
+		for (qint64 t : regionTimes_ms)
+			totalTime_ms += t;
+
+		ccLog::Print(QString("[orientNormalsWithFM] %1 regions (level %2) / %3 patches (%4 inverted) / regions: %5 ms min. - %6 ms avg. - %7 ms max. / total: %8 s")
+						.arg(regionCount)
+						.arg(regionLevel)
+						.arg(patchCount)
+						.arg(inversionCount)
+						.arg(minTime_ms)
+						.arg(static_cast<double>(totalTime_ms) / regionCount, 0, 'f', 1)
+						.arg(maxTime_ms)
+						.arg(timer.elapsed() / 1000.0, 0, 'f', 2));
+	}
+
+	return 1;
+}
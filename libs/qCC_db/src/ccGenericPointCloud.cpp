@@ -34,6 +34,7 @@
 #include "ccProgressDialog.h"
 #include "ccScalarField.h"
 #include "ccSensor.h"
+#include "ccVisibilitySelection.h"
 
 #if defined(_OPENMP)
 //OpenMP
@@ -216,7 +217,7 @@ bool ccGenericPointCloud::toFile_MeOnly(QFile& out, short dataVersion) const
 		return WriteError();
 	if (hasVisibilityArray)
 	{
-		if (!ccSerializationHelper::GenericArrayToFile<unsigned char, 1, unsigned char>(m_pointsVisibility, out))
+		if (!ccSerializationHelper::GenericArrayToFile<unsigned char, 1, unsigned char>(m_pointsVisibility, out, dataVersion))
 			return false;
 	}
 
@@ -543,3 +544,91 @@ CCCoreLib::ReferenceCloud* ccGenericPointCloud::getTheVisiblePoints(const Visibi
 
 	return rc;
 }
+
+CCCoreLib::ReferenceCloud* ccGenericPointCloud::getTheSelectedPoints(	const ccVisibilitySelection& pointSelection,
+																		bool silent/*=false*/,
+																		CCCoreLib::ReferenceCloud* selection/*=nullptr*/) const
+{
+	if (pointSelection.size() != size())
+	{
+		assert(false);
+		ccLog::Warning("[ccGenericPointCloud::getTheSelectedPoints] Invalid selection!");
+		return nullptr;
+	}
+
+	unsigned pointCount = pointSelection.count();
+
+	CCCoreLib::ReferenceCloud* rc = nullptr;
+	if (selection)
+	{
+		assert(selection->getAssociatedCloud() == this && selection->size() == 0);
+		rc = selection;
+		rc->clear();
+	}
+	else
+	{
+		rc = new CCCoreLib::ReferenceCloud(const_cast<ccGenericPointCloud*>(this));
+	}
+
+	if (pointCount)
+	{
+		if (rc->resize(pointCount))
+		{
+			//the rank of each selected point gives its position in the reference cloud
+			pointSelection.forEachSelectedInParallel([rc](unsigned rank, unsigned index)
+			{
+				rc->setPointIndex(rank, index);
+			});
+		}
+		else
+		{
+			ccLog::Warning("[ccGenericPointCloud::getTheSelectedPoints] Not enough memory!");
+			if (rc != selection)
+			{
+				delete rc;
+			}
+			rc = nullptr;
+		}
+	}
+	else if (!silent)
+	{
+		ccLog::Warning("[ccGenericPointCloud::getTheSelectedPoints] No point in selection");
+	}
+
+	return rc;
+}
+
+ccGenericPointCloud* ccGenericPointCloud::createNewCloudFromSelection(	const ccVisibilitySelection& pointSelection,
+																		bool removeSelectedPoints/*=false*/,
+																		std::vector<int>* newIndexesOfRemainingPoints/*=nullptr*/,
+																		bool silent/*=false*/)
+{
+	VisibilityTableType visTable;
+	try
+	{
+		pointSelection.toVisibilityTable(visTable);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccGenericPointCloud::createNewCloudFromSelection] Not enough memory!");
+		return nullptr;
+	}
+
+	return createNewCloudFromVisibilitySelection(removeSelectedPoints, &visTable, newIndexesOfRemainingPoints, silent);
+}
+
+bool ccGenericPointCloud::removeSelectedPoints(const ccVisibilitySelection& pointSelection, std::vector<int>* newIndexes/*=nullptr*/)
+{
+	VisibilityTableType visTable;
+	try
+	{
+		pointSelection.toVisibilityTable(visTable);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccGenericPointCloud::removeSelectedPoints] Not enough memory!");
+		return false;
+	}
+
+	return removeVisiblePoints(&visTable, newIndexes);
+}
@@ -377,7 +377,7 @@ protected:
 
 };
 
-bool ccKdTree::getNeighborLeaves(ccKdTree::BaseNode* cell, ccKdTree::LeafSet& neighbors, const int* userDataFilter/*=nullptr*/)
+bool ccKdTree::getNeighborLeaves(ccKdTree::BaseNode* cell, ccKdTree::LeafSet& neighbors, const int* userDataFilter/*=nullptr*/, ccKdTree::BaseNode* subTreeRoot/*=nullptr*/)
 {
 	if (!m_root)
 		return false;
@@ -389,10 +389,10 @@ bool ccKdTree::getNeighborLeaves(ccKdTree::BaseNode* cell, ccKdTree::LeafSet& ne
 
 	try
 	{
-		GetNeighborLeavesVisitor visitor(cell, neighbors, cellBox, getOwnBB(false));
+		GetNeighborLeavesVisitor visitor(cell, neighbors, cellBox, subTreeRoot ? getCellBBox(subTreeRoot) : getOwnBB(false));
 		if (userDataFilter)
 			visitor.setUserDataFilter(*userDataFilter);
-		visitor.visit(m_root);
+		visitor.visit(subTreeRoot ? subTreeRoot : m_root);
 	}
 	catch (const std::bad_alloc&)
 	{
@@ -34,6 +34,7 @@
 #include "ccProgressDialog.h"
 #include "ccChunk.h"
 #include "ccHObjectCaster.h"
+#include "ccVoxelGrid.h"
 
 //CCCoreLib
 #include <ManualSegmentationTools.h>
@@ -3004,7 +3005,7 @@ bool ccMesh::toFile_MeOnly(QFile& out, short dataVersion) const
 	//triangles indexes (dataVersion>=20)
 	if (!m_triVertIndexes)
 		return ccLog::Warning("Internal error: mesh has no triangles array! (not enough memory?)");
-	if (!ccSerializationHelper::GenericArrayToFile<CCCoreLib::VerticesIndexes, 3, unsigned>(*m_triVertIndexes, out))
+	if (!ccSerializationHelper::GenericArrayToFile<CCCoreLib::VerticesIndexes, 3, unsigned>(*m_triVertIndexes, out, dataVersion))
 		return false;
 
 	//per-triangle materials (dataVersion>=20))
@@ -3014,7 +3015,7 @@ bool ccMesh::toFile_MeOnly(QFile& out, short dataVersion) const
 	if (hasTriMtlIndexes)
 	{
 		assert(m_triMtlIndexes);
-		if (!ccSerializationHelper::GenericArrayToFile<int, 1, int>(*m_triMtlIndexes, out))
+		if (!ccSerializationHelper::GenericArrayToFile<int, 1, int>(*m_triMtlIndexes, out, dataVersion))
 			return false;
 	}
 
@@ -3025,7 +3026,7 @@ bool ccMesh::toFile_MeOnly(QFile& out, short dataVersion) const
 	if (hasTexCoordIndexes)
 	{
 		assert(m_texCoordIndexes);
-		if (!ccSerializationHelper::GenericArrayToFile<Tuple3i, 3, int>(*m_texCoordIndexes, out))
+		if (!ccSerializationHelper::GenericArrayToFile<Tuple3i, 3, int>(*m_texCoordIndexes, out, dataVersion))
 			return false;
 	}
 
@@ -3036,7 +3037,7 @@ bool ccMesh::toFile_MeOnly(QFile& out, short dataVersion) const
 	if (hasTriNormalIndexes)
 	{
 		assert(m_triNormalIndexes);
-		if (!ccSerializationHelper::GenericArrayToFile<Tuple3i, 3, int>(*m_triNormalIndexes, out))
+		if (!ccSerializationHelper::GenericArrayToFile<Tuple3i, 3, int>(*m_triNormalIndexes, out, dataVersion))
 			return false;
 	}
 
@@ -3978,82 +3979,7 @@ bool ccMesh::convertMaterialsToVertexColors()
 	return true;
 }
 
-static bool TagDuplicatedVertices(	const CCCoreLib::DgmOctree::octreeCell& cell,
-									void** additionalParameters,
-									CCCoreLib::NormalizedProgress* nProgress/*=nullptr*/)
-{
-	std::vector<int>* equivalentIndexes = static_cast<std::vector<int>*>(additionalParameters[0]);
-
-	//we look for points very close to the others (only if not yet tagged!)
-
-	//structure for nearest neighbors search
-	CCCoreLib::DgmOctree::NearestNeighboursSearchStruct nNSS;
-	nNSS.level = cell.level;
-	static const PointCoordinateType c_defaultSearchRadius = static_cast<PointCoordinateType>(sqrt(CCCoreLib::ZERO_TOLERANCE_F));
-	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
-	cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
-
-	unsigned n = cell.points->size(); //number of points in the current cell
-
-	//we already know some of the neighbours: the points in the current cell!
-	try
-	{
-		nNSS.pointsInNeighbourhood.resize(n);
-	}
-	catch (.../*const std::bad_alloc&*/) //out of memory
-	{
-		return false;
-	}
-
-	//init structure with cell points
-	{
-		CCCoreLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
-		for (unsigned i = 0; i < n; ++i, ++it)
-		{
-			it->point = cell.points->getPointPersistentPtr(i);
-			it->pointIndex = cell.points->getPointGlobalIndex(i);
-		}
-		nNSS.alreadyVisitedNeighbourhoodSize = 1;
-	}
-
-	//for each point in the cell
-	for (unsigned i = 0; i < n; ++i)
-	{
-		int thisIndex = static_cast<int>(cell.points->getPointGlobalIndex(i));
-		if (equivalentIndexes->at(thisIndex) < 0) //has no equivalent yet 
-		{
-			cell.points->getPoint(i, nNSS.queryPoint);
-
-			//look for neighbors in a (very small) sphere
-			//warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors (k)!
-			unsigned k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS, c_defaultSearchRadius, false);
-
-			//if there are some very close points
-			if (k > 1)
-			{
-				for (unsigned j = 0; j < k; ++j)
-				{
-					//all the other points are equivalent to the query point
-					const unsigned& otherIndex = nNSS.pointsInNeighbourhood[j].pointIndex;
-					if (static_cast<int>(otherIndex) != thisIndex)
-						equivalentIndexes->at(otherIndex) = thisIndex;
-				}
-			}
-
-			//and the query point is always root
-			equivalentIndexes->at(thisIndex) = thisIndex;
-		}
-
-		if (nProgress && !nProgress->oneStep())
-		{
-			return false;
-		}
-	}
-
-	return true;
-}
-
-bool ccMesh::mergeDuplicatedVertices(unsigned char octreeLevel/*=10*/, QWidget* parentWidget/*=nullptr*/)
+bool ccMesh::mergeDuplicatedVertices(QWidget* parentWidget/*=nullptr*/)
 {
 	if (!m_associatedCloud)
 	{
@@ -4083,26 +4009,17 @@ bool ccMesh::mergeDuplicatedVertices(unsigned char octreeLevel/*=10*/, QWidget*
 				pDlg.reset(new ccProgressDialog(true, parentWidget));
 			}
 
-			// try to build the octree
-			ccOctree::Shared octree = ccOctree::Shared(new ccOctree(m_associatedCloud));
-			if (!octree->build(pDlg.data()))
+			static const double c_defaultSearchRadius = sqrt(CCCoreLib::ZERO_TOLERANCE_F);
+			std::vector<unsigned> rootIndexes;
+			if (!ccVoxelGrid::FindDuplicates(*m_associatedCloud, c_defaultSearchRadius, rootIndexes, pDlg.data()))
 			{
-				ccLog::Warning("[MergeDuplicatedVertices] Not enough memory");
+				ccLog::Warning("[MergeDuplicatedVertices] Duplicated vertices removal algorithm failed?!");
 				return false;
 			}
 
-			void* additionalParameters[] = { static_cast<void*>(&equivalentIndexes) };
-			unsigned result = octree->executeFunctionForAllCellsAtLevel(10,
-				TagDuplicatedVertices,
-				additionalParameters,
-				false,
-				pDlg.data(),
-				"Tag duplicated vertices");
-
-			if (result == 0)
+			for (unsigned i = 0; i < vertCount; ++i)
 			{
-				ccLog::Warning("[MergeDuplicatedVertices] Duplicated vertices removal algorithm failed?!");
-				return false;
+				equivalentIndexes[i] = static_cast<int>(rootIndexes[i]);
 			}
 		}
 
@@ -22,374 +22,426 @@
 
 //local
 #include "ccLog.h"
+#include "ccNormalVectors.h"
 #include "ccOctree.h"
 #include "ccPointCloud.h"
 #include "ccProgressDialog.h"
-#include "ccScalarField.h"
 
 //system
-#include <map>
-#include <queue>
-#include <set>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <vector>
 
-namespace 
+#if defined(_OPENMP)
+//OpenMP
+#include <omp.h>
+#endif
+
+//! Empty slot in the kNN graph
+static const unsigned s_noNeighbor = std::numeric_limits<unsigned>::max();
+//! Undefined edge (Boruvka)
+static const uint64_t s_noEdge = std::numeric_limits<uint64_t>::max();
+
+//! Returns the weight of the edge between two points (the lower, the more parallel their normals)
+static inline float EdgeWeight(const CCVector3& N1, const CCVector3& N2)
+{
+	return std::max(0.0f, 1.0f - static_cast<float>(std::abs(N1.dot(N2))));
+}
+
+//! Returns the bits of a (positive) weight, that can be compared as integers
+static inline unsigned WeightBits(float weight)
+{
+	unsigned bits = 0;
+	memcpy(&bits, &weight, sizeof(float));
+	return bits;
+}
+
+//! Atomically replaces a value by another one if it's smaller
+template <typename T> static inline void AtomicMin(std::atomic<T>& current, T value)
+{
+	T currentValue = current.load(std::memory_order_relaxed);
+	while (value < currentValue && !current.compare_exchange_weak(currentValue, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+//! Returns the representative of a vertex (with path halving)
+/** Representatives are always the smallest index of their set (see MergeComponents).
+**/
+static inline unsigned FindComponent(std::vector<unsigned>& parents, unsigned v)
 {
-	//! Weighted graph edge
-	class Edge
+	while (parents[v] != v)
 	{
-	public:
-		
-		//! Unique edge key type
-		using Key = std::pair<unsigned, unsigned>;
-		
-		//! Returns the unique key of an edge (no vertex order)
-		inline static Key ConstructKey(unsigned v1, unsigned v2)
+		parents[v] = parents[parents[v]];
+		v = parents[v];
+	}
+	return v;
+}
+
+//! kNN graph (flat list of 'slotCount' neighbors per point)
+struct KNNGraph
+{
+	std::vector<unsigned> neighbors;
+	unsigned slotCount = 0;
+};
+
+static bool ComputeKNNGraphAtLevel(	const CCCoreLib::DgmOctree::octreeCell& cell,
+									void** additionalParameters,
+									CCCoreLib::NormalizedProgress* nProgress/*=nullptr*/)
+{
+	//parameters
+	KNNGraph* graph = static_cast<KNNGraph*>(additionalParameters[0]);
+
+	//structure for the nearest neighbor search
+	CCCoreLib::DgmOctree::NearestNeighboursSearchStruct nNSS;
+	nNSS.level				  = cell.level;
+	nNSS.minNumberOfNeighbors = graph->slotCount; //kNN + 1 because we'll get the query point itself!
+	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
+	cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
+
+	unsigned n = cell.points->size(); //number of points in the current cell
+
+	//we already know some of the neighbours: the points in the current cell!
+	{
+		try
 		{
-			return v1 > v2 ? std::make_pair(v2, v1) : std::make_pair(v1, v2);
+			nNSS.pointsInNeighbourhood.resize(n);
 		}
-		
-		//! Default constructor
-		Edge(unsigned v1, unsigned v2, float weight)
-			: m_key(ConstructKey(v1, v2))
-			, m_weight(weight)
+		catch (.../*const std::bad_alloc&*/) //out of memory
 		{
-			assert(m_weight >= 0);
+			return false;
 		}
-		
-		//! Strict weak ordering operator (required by std::priority_queue)
-		inline bool operator < (const Edge& other) const
+
+		CCCoreLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
+		for (unsigned i = 0; i < n; ++i, ++it)
 		{
-			return m_weight > other.m_weight;
+			it->point = cell.points->getPointPersistentPtr(i);
+			it->pointIndex = cell.points->getPointGlobalIndex(i);
 		}
-		
-		//! Returns first vertex (index)
-		const unsigned& v1() const { return m_key.first; }
-		//! Returns second vertex (index)
-		const unsigned& v2() const { return m_key.second; }
-		
-	protected:
-		
-		//! Unique key
-		Key m_key;
-		
-		//! Associated weight
-		float m_weight;
-	};
-	
-	//! Generic graph structure
-	class Graph
+	}
+	nNSS.alreadyVisitedNeighbourhoodSize = 1;
+
+	//for each point in the cell
+	for (unsigned i = 0; i < n; ++i)
 	{
-	public:
-		
-		//! Default constructor
-		Graph() = default;
-		
-		//! Set of indexes
-		using IndexSet = std::set<unsigned int>;
-		
-		//! Reserves memory for graph
-		/** Must be called before using the structure!
-		Clears the structure as well.
-	**/
-		bool reserve(unsigned vertexCount)
+		cell.points->getPoint(i, nNSS.queryPoint);
+
+		//look for neighbors in a sphere
+		unsigned neighborCount = cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS, false);
+		neighborCount = std::min(neighborCount, graph->slotCount);
+
+		//each point only writes its own slots (no need to synchronize the threads)
+		unsigned index = cell.points->getPointGlobalIndex(i);
+		unsigned* slots = graph->neighbors.data() + static_cast<size_t>(index) * graph->slotCount;
+		unsigned j = 0;
+		for (; j < neighborCount; ++j)
 		{
-			m_edges.clear();
-			
-			try
+			unsigned neighborIndex = nNSS.pointsInNeighbourhood[j].pointIndex;
+			slots[j] = (neighborIndex != index ? neighborIndex : s_noNeighbor);
+		}
+		for (; j < graph->slotCount; ++j)
+		{
+			slots[j] = s_noNeighbor;
+		}
+
+		if (nProgress && !nProgress->oneStep())
+			return false;
+	}
+
+	return true;
+}
+
+//! Computes the minimum spanning forest of the kNN graph (Boruvka)
+/** Each round, every component selects its lightest outgoing edge (ties are broken
+	by edge index) in parallel, then the selected edges are merged. The lowest index
+	of each component ends up being its representative.
+	\return the number of rounds (or -1 if canceled)
+**/
+static int ComputeMinimumSpanningForest(const ccPointCloud* cloud,
+										const KNNGraph& graph,
+										std::vector<unsigned>& components,
+										std::vector<std::pair<unsigned, unsigned>>& treeEdges,
+										ccProgressDialog* progressCb)
+{
+	unsigned vertexCount = cloud->size();
+	int _vertexCount = static_cast<int>(vertexCount);
+	unsigned slotCount = graph.slotCount;
+
+	components.resize(vertexCount);
+	for (unsigned i = 0; i < vertexCount; ++i)
+	{
+		components[i] = i;
+	}
+	treeEdges.reserve(vertexCount);
+
+	//lightest outgoing edge of each component
+	std::vector<std::atomic<unsigned>> minWeights(vertexCount);
+	std::vector<std::atomic<uint64_t>> bestEdges(vertexCount);
+
+	int roundCount = 0;
+	while (true)
+	{
+		++roundCount;
+		if (progressCb)
+		{
+			if (progressCb->isCancelRequested())
 			{
-				m_vertexNeighbors.resize(vertexCount, IndexSet());
+				return -1;
 			}
-			catch (const std::bad_alloc&)
+			progressCb->setInfo(QObject::tr("Compute Minimum spanning tree\nPoints: %1\nRound: %2\nTree edges: %3").arg(vertexCount).arg(roundCount).arg(treeEdges.size()));
+			progressCb->update(100.0f * treeEdges.size() / vertexCount);
+		}
+
+#if defined(_OPENMP)
+		#pragma omp parallel for num_threads(omp_get_max_threads())
+#endif
+		for (int i = 0; i < _vertexCount; ++i)
+		{
+			minWeights[i].store(std::numeric_limits<unsigned>::max(), std::memory_order_relaxed);
+			bestEdges[i].store(s_noEdge, std::memory_order_relaxed);
+		}
+
+		//first pass: lightest weight
+#if defined(_OPENMP)
+		#pragma omp parallel for num_threads(omp_get_max_threads())
+#endif
+		for (int i = 0; i < _vertexCount; ++i)
+		{
+			unsigned ci = components[i];
+			const CCVector3& N1 = cloud->getPointNormal(i);
+			const unsigned* slots = graph.neighbors.data() + static_cast<size_t>(i) * slotCount;
+			for (unsigned j = 0; j < slotCount; ++j)
 			{
-				//not enough memory
-				return false;
+				unsigned neighborIndex = slots[j];
+				if (neighborIndex == s_noNeighbor || components[neighborIndex] == ci)
+				{
+					continue;
+				}
+
+				unsigned weight = WeightBits(EdgeWeight(N1, cloud->getPointNormal(neighborIndex)));
+				AtomicMin(minWeights[ci], weight);
+				AtomicMin(minWeights[components[neighborIndex]], weight);
+			}
+		}
+
+		//second pass: lightest edge index (so that the selection is deterministic)
+#if defined(_OPENMP)
+		#pragma omp parallel for num_threads(omp_get_max_threads())
+#endif
+		for (int i = 0; i < _vertexCount; ++i)
+		{
+			unsigned ci = components[i];
+			const CCVector3& N1 = cloud->getPointNormal(i);
+			const unsigned* slots = graph.neighbors.data() + static_cast<size_t>(i) * slotCount;
+			for (unsigned j = 0; j < slotCount; ++j)
+			{
+				unsigned neighborIndex = slots[j];
+				if (neighborIndex == s_noNeighbor || components[neighborIndex] == ci)
+				{
+					continue;
+				}
+
+				unsigned weight = WeightBits(EdgeWeight(N1, cloud->getPointNormal(neighborIndex)));
+				uint64_t edgeIndex = static_cast<uint64_t>(i) * slotCount + j;
+				if (weight == minWeights[ci].load(std::memory_order_relaxed))
+				{
+					AtomicMin(bestEdges[ci], edgeIndex);
+				}
+				unsigned cn = components[neighborIndex];
+				if (weight == minWeights[cn].load(std::memory_order_relaxed))
+				{
+					AtomicMin(bestEdges[cn], edgeIndex);
+				}
 			}
-			
-			return true;
 		}
-		
-		//! Returns the number of vertices
-		unsigned vertexCount() const { return static_cast<unsigned>(m_vertexNeighbors.size()); } //the m_vertexNeighbors vector size shouldn't be bigger than a 32 bits integer (see 'reserve')
-		
-		//! Returns the number of edges
-		size_t edgeCount() const { return m_edges.size(); }
-		
-		//! Returns the weight associated to an edge (if it exists - returns -1 otherwise)
-		float weight(unsigned v1, unsigned v2) const
+
+		//merge the components along the selected edges
+		size_t previousEdgeCount = treeEdges.size();
+		for (unsigned i = 0; i < vertexCount; ++i)
 		{
-			assert(v1 < m_vertexNeighbors.size() && v2 < m_vertexNeighbors.size());
-			
-			// try to find the corresponding edge (otherwise return -1)
-			std::map<Edge::Key, float>::const_iterator it = m_edges.find(Edge::ConstructKey(v1, v2));
-			
-			return (it == m_edges.end() ? -1 : it->second);
+			uint64_t edgeIndex = bestEdges[i].load(std::memory_order_relaxed);
+			if (edgeIndex == s_noEdge)
+			{
+				continue;
+			}
+
+			unsigned v1 = static_cast<unsigned>(edgeIndex / slotCount);
+			unsigned v2 = graph.neighbors[edgeIndex];
+			unsigned c1 = FindComponent(components, v1);
+			unsigned c2 = FindComponent(components, v2);
+			if (c1 == c2)
+			{
+				//the two components have selected the same edge (or an equivalent one)
+				continue;
+			}
+
+			//the smallest index remains the representative
+			if (c1 < c2)
+				components[c2] = c1;
+			else
+				components[c1] = c2;
+			treeEdges.emplace_back(v1, v2);
 		}
-		
-		//! Adds or updates the edge (v1,v2)
-		void addEdge(unsigned v1, unsigned v2, float weight = 0.0f)
+
+		//representatives have a lower index than the other vertices of their component
+		for (unsigned i = 0; i < vertexCount; ++i)
 		{
-			assert(v1 < m_vertexNeighbors.size() && v2 < m_vertexNeighbors.size());
-			
-			m_edges.insert(std::make_pair(Edge::ConstructKey(v1, v2), weight));
-			m_vertexNeighbors[v1].insert(v2);
-			m_vertexNeighbors[v2].insert(v1);
+			components[i] = components[components[i]];
 		}
-		
-		//! Returns the set of edges connected to a given vertex
-		inline const IndexSet& getVertexNeighbors(unsigned index) const
+
+		if (treeEdges.size() == previousEdgeCount)
 		{
-			return m_vertexNeighbors[index];
+			//no more outgoing edge
+			break;
 		}
-		
-	protected:
-		
-		//! Graph edges
-		std::map<Edge::Key, float> m_edges;
-		
-		//! Set of neighbors for each vertex
-		std::vector<IndexSet> m_vertexNeighbors;
-	};
+	}
+
+	return roundCount;
 }
 
 static bool ResolveNormalsWithMST(	ccPointCloud* cloud,
-#ifdef WITH_GRAPH
-									const Graph& graph,
-#else
-									ccOctree::Shared& octree,
-									unsigned char level,
-									unsigned kNN,
-#endif
+									const KNNGraph& graph,
 									ccProgressDialog* progressCb = nullptr)
 {
 	assert(cloud && cloud->hasNormals());
 
-//#define COLOR_PATCHES
-#ifdef COLOR_PATCHES
-	//Test: color patches
-	cloud->setColor(ccColor::white);
-	cloud->showColors(true);
-
-	//Test: arrival time
-	int sfIdx = cloud->getScalarFieldIndexByName("MST arrival time");
-	if (sfIdx < 0)
-		sfIdx = cloud->addScalarField("MST arrival time");
-	ccScalarField* sf = static_cast<ccScalarField*>(cloud->getScalarField(sfIdx));
-	sf->fill(NAN_VALUE);
-	cloud->setCurrentDisplayedScalarField(sfIdx);
-#endif
-
-	//reset
-	std::priority_queue<Edge> priorityQueue;
-	std::vector<bool> visited;
-	unsigned visitedCount = 0;
-#ifdef WITH_GRAPH
-	unsigned vertexCount = graph.vertexCount();
-#else
 	unsigned vertexCount = cloud->size();
-#endif
 
-	//instantiate the 'visited' table
 	try
 	{
-		visited.resize(vertexCount, false);
-
-		//progress notification
-		CCCoreLib::NormalizedProgress nProgress(progressCb, vertexCount);
 		if (progressCb)
 		{
 			progressCb->update(0);
 			progressCb->setMethodTitle(QObject::tr("Orient normals (MST)"));
-#ifdef WITH_GRAPH
-			progressCb->setInfo(QObject::tr("Compute Minimum spanning tree\nPoints: %1\nEdges: %2").arg(vertexCount).arg(graph.edgeCount()));
-#else
 			progressCb->setInfo(QObject::tr("Compute Minimum spanning tree\nPoints: %1").arg(vertexCount));
-#endif
 			progressCb->start();
 		}
 
-#ifndef WITH_GRAPH
-		CCCoreLib::DgmOctree::NearestNeighboursSearchStruct nNSS;
-		nNSS.level = level;
-		nNSS.minNumberOfNeighbors = kNN + 1; //+1 because we'll get the query point itself!
-#endif
+		std::vector<unsigned> components;
+		std::vector<std::pair<unsigned, unsigned>> treeEdges;
+		if (ComputeMinimumSpanningForest(cloud, graph, components, treeEdges, progressCb) < 0)
+		{
+			//canceled by the user
+			return false;
+		}
 
-		//while unvisited vertices remain...
-		unsigned firstUnvisitedIndex = 0;
-		size_t patchCount = 0;
-		size_t inversionCount = 0;
-		while (visitedCount < vertexCount)
+		//tree adjacency
+		std::vector<unsigned> treeOffsets(static_cast<size_t>(vertexCount) + 1, 0);
+		std::vector<unsigned> treeNeighbors(2 * treeEdges.size());
 		{
-			//find the first not-yet-visited vertex
-			while (visited[firstUnvisitedIndex])
+			for (const std::pair<unsigned, unsigned>& edge : treeEdges)
 			{
-				++firstUnvisitedIndex;
+				++treeOffsets[edge.first + 1];
+				++treeOffsets[edge.second + 1];
 			}
-
-			//set it as "visited"
+			for (unsigned i = 0; i < vertexCount; ++i)
 			{
-				visited[firstUnvisitedIndex] = true;
-				++visitedCount;
-				//add its neighbors to the priority queue
-#ifdef WITH_GRAPH
-				const Graph::IndexSet& neighbors = graph.getVertexNeighbors(firstUnvisitedIndex);
-				for (Graph::IndexSet::const_iterator it = neighbors.begin(); it != neighbors.end(); ++it)
-				{
-					priorityQueue.push(Edge(firstUnvisitedIndex, *it, graph.weight(firstUnvisitedIndex, *it)));
-				}
-#else
-				const CCVector3* P = cloud->getPoint(firstUnvisitedIndex);
-				nNSS.queryPoint = *P;
-				octree->getTheCellPosWhichIncludesThePoint(P, nNSS.cellPos, level);
-				octree->computeCellCenter(nNSS.cellPos, level, nNSS.cellCenter);
-				nNSS.pointsInNeighbourhood.clear();
-				nNSS.alreadyVisitedNeighbourhoodSize = 0;
-
-				//look for neighbors in a sphere
-				unsigned neighborCount = octree->findNearestNeighborsStartingFromCell(nNSS, false);
-				neighborCount = std::min(neighborCount, kNN + 1);
-
-				//current point index
-				const CCVector3& N1 = cloud->getPointNormal(firstUnvisitedIndex);
-				for (unsigned j = 0; j < neighborCount; ++j)
-				{
-					//current neighbor index
-					unsigned neighborIndex = nNSS.pointsInNeighbourhood[j].pointIndex;
-					if (	firstUnvisitedIndex != neighborIndex
-						&&	!visited[neighborIndex])
-					{
-						const CCVector3& N2 = cloud->getPointNormal(neighborIndex);
-						//dot product
-						float weight = std::max(0.0f, 1.0f - static_cast<float>(std::abs(N1.dot(N2))));
-
-						//distance
-						//float weight = sqrt(nNSS.pointsInNeighbourhood[j].squareDistd);
-
-						//mutual dot product
-						//const CCVector3* P2 = cloud->getPoint(static_cast<unsigned>(neighborIndex));
-						//CCVector3 uAB = *P2 - *P1;
-						//uAB.normalize();
-						//float weight = (std::abs(CCVector3::vdot(uAB.u, N1) + std::abs(CCVector3::vdot(uAB.u, N2)))) / 2;
-
-						priorityQueue.emplace( firstUnvisitedIndex, neighborIndex, weight );
-					}
-				}
-#endif
+				treeOffsets[i + 1] += treeOffsets[i];
+			}
+			std::vector<unsigned> fillPos(treeOffsets.begin(), treeOffsets.end() - 1);
+			for (const std::pair<unsigned, unsigned>& edge : treeEdges)
+			{
+				treeNeighbors[fillPos[edge.first]++] = edge.second;
+				treeNeighbors[fillPos[edge.second]++] = edge.first;
+			}
+		}
+		treeEdges.clear();
+		treeEdges.shrink_to_fit();
 
-				if (progressCb && !nProgress.oneStep())
-				{
-					break;
-				}
+		//propagate the orientation from the lowest index of each component, level by level
+		//(the same root as the serial approach, so that the same normals are inverted)
+		std::vector<unsigned> bfsOrder(vertexCount);
+		std::vector<unsigned char> visited(vertexCount, 0);
+		size_t patchCount = 0;
+		for (unsigned i = 0; i < vertexCount; ++i)
+		{
+			if (components[i] == i)
+			{
+				bfsOrder[patchCount++] = i;
+				visited[i] = 1;
 			}
+		}
+		components.clear();
+		components.shrink_to_fit();
 
-	#ifdef COLOR_PATCHES
-			ccColor::Rgb patchCol = ccColor::Generator::Random();
-			cloud->setPointColor(static_cast<unsigned>(firstUnvisitedIndex), patchCol.rgb);
-			sf->setValue(static_cast<unsigned>(firstUnvisitedIndex),static_cast<ScalarType>(visitedCount));
-	#endif
+		if (progressCb)
+		{
+			progressCb->setInfo(QObject::tr("Orient normals\nPoints: %1\nPatches: %2").arg(vertexCount).arg(patchCount));
+		}
+		CCCoreLib::NormalizedProgress nProgress(progressCb, vertexCount);
 
-			while (!priorityQueue.empty() && (visitedCount < vertexCount))
+		//the normals are directly updated by the threads (see ccPointCloud::normalsHaveChanged below)
+		NormsIndexesTableType* normals = cloud->normals();
+		long long inversionCount = 0;
+		size_t levelStart = 0;
+		std::atomic<size_t> levelEnd(patchCount);
+		while (levelStart < levelEnd)
+		{
+			size_t levelSize = levelEnd - levelStart;
+			const unsigned* level = bfsOrder.data() + levelStart;
+			levelStart = levelEnd;
+
+			//each vertex of the next level has only one parent in the current level (tree)
+			int _levelSize = static_cast<int>(levelSize);
+#if defined(_OPENMP)
+			#pragma omp parallel for num_threads(omp_get_max_threads()) reduction(+:inversionCount)
+#endif
+			for (int k = 0; k < _levelSize; ++k)
 			{
-				//process next edge (with the lowest 'weight')
-				Edge element = priorityQueue.top();
-				priorityQueue.pop();
-
-				//shall the normal be inverted?
-				const CCVector3& N1 = cloud->getPointNormal(static_cast<unsigned>(element.v1()));
-				const CCVector3& N2 = cloud->getPointNormal(static_cast<unsigned>(element.v2()));
-				bool inverNormal = (N1.dot(N2) < 0);
-				unsigned v = 0;
-				//we should change the vertex that has not been visited yet
-				if (!visited[element.v1()])
-				{
-					v = element.v1();
-					if (inverNormal)
-					{
-						cloud->setPointNormal(static_cast<unsigned>(v), -N1);
-						++inversionCount;
-					}
-				}
-				else if (!visited[element.v2()])
+				unsigned v = level[k];
+				unsigned firstNeighbor = treeOffsets[v];
+				unsigned lastNeighbor = treeOffsets[v + 1];
+
+				//all the neighbors are children, except the parent (if any)
+				unsigned childCount = lastNeighbor - firstNeighbor;
+				for (unsigned n = firstNeighbor; n < lastNeighbor; ++n)
 				{
-					v = element.v2();
-					if (inverNormal)
+					if (visited[treeNeighbors[n]])
 					{
-						cloud->setPointNormal(static_cast<unsigned>(v), -N2);
-						++inversionCount;
+						--childCount;
+						break;
 					}
 				}
-				else
+				if (childCount == 0)
 				{
 					continue;
 				}
 
-				//set it as "visited"
+				size_t childPos = levelEnd.fetch_add(childCount);
+				const CCVector3& N1 = cloud->getPointNormal(v);
+				for (unsigned n = firstNeighbor; n < lastNeighbor; ++n)
 				{
-					visited[v] = true;
-					++visitedCount;
-					//add its neighbors to the priority queue
-#ifdef WITH_GRAPH
-					const Graph::IndexSet& neighbors = graph.getVertexNeighbors(v);
-					for (Graph::IndexSet::const_iterator it = neighbors.begin(); it != neighbors.end(); ++it)
-						priorityQueue.push(Edge(v, *it, graph.weight(v,*it)));
-#else
-					const CCVector3* P = cloud->getPoint(v);
-					nNSS.queryPoint = *P;
-					octree->getTheCellPosWhichIncludesThePoint(P, nNSS.cellPos, level);
-					octree->computeCellCenter(nNSS.cellPos, level, nNSS.cellCenter);
-					nNSS.pointsInNeighbourhood.clear();
-					nNSS.alreadyVisitedNeighbourhoodSize = 0;
-
-					//look for neighbors in a sphere
-					unsigned neighborCount = octree->findNearestNeighborsStartingFromCell(nNSS, false);
-					neighborCount = std::min(neighborCount, kNN + 1);
-					//current point index
-					const CCVector3& N1 = cloud->getPointNormal(v);
-					for (unsigned j = 0; j < neighborCount; ++j)
+					unsigned child = treeNeighbors[n];
+					if (visited[child])
 					{
-						//current neighbor index
-						unsigned neighborIndex = nNSS.pointsInNeighbourhood[j].pointIndex;
-						if (	v != neighborIndex
-							&&	!visited[neighborIndex])
-						{
-							const CCVector3& N2 = cloud->getPointNormal(neighborIndex);
-							//dot product
-							float weight = std::max(0.0f, 1.0f - static_cast<float>(std::abs(N1.dot(N2))));
-
-							//distance
-							//float weight = sqrt(nNSS.pointsInNeighbourhood[j].squareDistd);
-
-							//mutual dot product
-							//const CCVector3* P2 = cloud->getPoint(static_cast<unsigned>(neighborIndex));
-							//CCVector3 uAB = *P2 - *P1;
-							//uAB.normalize();
-							//float weight = (std::abs(CCVector3::vdot(uAB.u, N1) + std::abs(CCVector3::vdot(uAB.u, N2)))) / 2;
-
-							priorityQueue.emplace( v, neighborIndex, weight );
-						}
+						continue;
 					}
-#endif
-				}
+					visited[child] = 1;
+					bfsOrder[childPos++] = child;
 
-	#ifdef COLOR_PATCHES
-				cloud->setPointColor(static_cast<unsigned>(v), patchCol);
-				sf->setValue(static_cast<unsigned>(v),static_cast<ScalarType>(visitedCount));
-	#endif
-				if (progressCb && !nProgress.oneStep())
-				{
-					visitedCount = static_cast<unsigned>(vertexCount); //early stop
-					break;
+					//shall the normal be inverted?
+					const CCVector3& N2 = cloud->getPointNormal(child);
+					if (N1.dot(N2) < 0)
+					{
+						normals->setValue(child, ccNormalVectors::GetNormIndex(-N2));
+						++inversionCount;
+					}
 				}
 			}
 
-			//new patch
-			++patchCount;
+			if (progressCb && !nProgress.steps(static_cast<unsigned>(levelSize)))
+			{
+				//canceled by the user
+				return false;
+			}
 		}
 
-	#ifdef COLOR_PATCHES
-		sf->computeMinAndMax();
-		cloud->showSF(true);
-	#endif
+		if (inversionCount != 0)
+		{
+			cloud->normalsHaveChanged();
+		}
 
 		if (progressCb)
 		{
@@ -407,90 +459,6 @@ static bool ResolveNormalsWithMST(	ccPointCloud* cloud,
 	return true;
 }
 
-#ifdef WITH_GRAPH
-static bool ComputeMSTGraphAtLevel(	const CCCoreLib::DgmOctree::octreeCell& cell,
-									void** additionalParameters,
-									CCCoreLib::NormalizedProgress* nProgress/*=nullptr*/)
-{
-	//parameters
-	Graph* graph = static_cast<Graph*>(additionalParameters[0]);
-	ccPointCloud* cloud = static_cast<ccPointCloud*>(additionalParameters[1]);
-
-	//structure for the nearest neighbor search
-	unsigned kNN = *static_cast<unsigned*>(additionalParameters[2]);
-
-	CCCoreLib::DgmOctree::NearestNeighboursSearchStruct nNSS;
-	nNSS.level				  = cell.level;
-	nNSS.minNumberOfNeighbors = kNN + 1; //+1 because we'll get the query point itself!
-	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
-	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
-
-	unsigned n = cell.points->size(); //number of points in the current cell
-
-	//we already know some of the neighbours: the points in the current cell!
-	{
-		try
-		{
-			nNSS.pointsInNeighbourhood.resize(n);
-		}
-		catch (.../*const std::bad_alloc&*/) //out of memory
-		{
-			return false;
-		}
-
-		CCCoreLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
-		for (unsigned i = 0; i < n; ++i, ++it)
-		{
-			it->point = cell.points->getPointPersistentPtr(i);
-			it->pointIndex = cell.points->getPointGlobalIndex(i);
-		}
-	}
-	nNSS.alreadyVisitedNeighbourhoodSize = 1;
-
-	//for each point in the cell
-	for (unsigned i = 0; i < n; ++i)
-	{
-		cell.points->getPoint(i, nNSS.queryPoint);
-
-		//look for neighbors in a sphere
-		unsigned neighborCount = cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS, false);
-		neighborCount = std::min(neighborCount, kNN + 1);
-
-		//current point index
-		unsigned index = cell.points->getPointGlobalIndex(i);
-		const CCVector3& N1 = cloud->getPointNormal(index);
-		//const CCVector3* P1 = cloud->getPoint(static_cast<unsigned>(index));
-		for (unsigned j = 0; j < neighborCount; ++j)
-		{
-			//current neighbor index
-			unsigned neighborIndex = nNSS.pointsInNeighbourhood[j].pointIndex;
-			if (index != neighborIndex)
-			{
-				const CCVector3& N2 = cloud->getPointNormal(neighborIndex);
-				//dot product
-				float weight = std::max(0.0f, 1.0f - static_cast<float>(std::abs(N1.dot(N2))));
-
-				//distance
-				//float weight = sqrt(nNSS.pointsInNeighbourhood[j].squareDistd);
-
-				//mutual dot product
-				//const CCVector3* P2 = cloud->getPoint(static_cast<unsigned>(neighborIndex));
-				//CCVector3 uAB = *P2 - *P1;
-				//uAB.normalize();
-				//float weight = (std::abs(CCVector3::vdot(uAB.u, N1) + std::abs(CCVector3::vdot(uAB.u, N2)))) / 2;
-
-				graph->addEdge(index, neighborIndex, weight);
-			}
-		}
-
-		if (nProgress && !nProgress->oneStep())
-			return false;
-	}
-
-	return true;
-}
-#endif
-
 bool ccMinimumSpanningTreeForNormsDirection::OrientNormals(	ccPointCloud* cloud,
 															unsigned kNN/*=6*/,
 															ccProgressDialog* progressDlg/*=nullptr*/)
@@ -519,48 +487,35 @@ bool ccMinimumSpanningTreeForNormsDirection::OrientNormals(	ccPointCloud* cloud,
 	bool result = true;
 	try
 	{
-#ifdef WITH_GRAPH
-		Graph graph;
-		if (!graph.reserve(cloud->size()))
-		{
-			//not enough memory!
-			result = false;
-		}
+		KNNGraph graph;
+		graph.slotCount = kNN + 1; //+1 because we'll get the query point itself!
+		graph.neighbors.resize(static_cast<size_t>(cloud->size()) * graph.slotCount, s_noNeighbor);
 
 		//parameters
-		void* additionalParameters[3] = {	reinterpret_cast<void*>(&graph),
-											reinterpret_cast<void*>(cloud),
-											reinterpret_cast<void*>(&kNN)
-										};
+		void* additionalParameters[1] = { reinterpret_cast<void*>(&graph) };
 
 		if (octree->executeFunctionForAllCellsAtLevel(	level,
-														&ComputeMSTGraphAtLevel,
+														&ComputeKNNGraphAtLevel,
 														additionalParameters,
-														false, //not compatible with parallel strategies!
+														true,
 														progressDlg,
-														"Build Spanning Tree") == 0)
+														"Build kNN graph") == 0)
 		{
 			//something went wrong
-			ccLog::Warning(QString("Failed to compute Spanning Tree on cloud '%1'").arg(cloud->getName()));
+			ccLog::Warning(QString("Failed to compute the kNN graph on cloud '%1'").arg(cloud->getName()));
 			result = false;
 		}
-		else
-		{
-			if (!ResolveNormalsWithMST(cloud, graph, progressDlg))
-			{
-				//something went wrong
-				ccLog::Warning(QString("Failed to compute Minimum Spanning Tree on cloud '%1'").arg(cloud->getName()));
-				result = false;
-			}
-		}
-#else
-		if (!ResolveNormalsWithMST(cloud, octree, level, kNN, progressDlg))
+		else if (!ResolveNormalsWithMST(cloud, graph, progressDlg))
 		{
 			//something went wrong
 			ccLog::Warning(QString("Failed to resolve normals orientation with Minimum Spanning Tree on cloud '%1'").arg(cloud->getName()));
 			result = false;
 		}
-#endif
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning(QString("Not enough memory to orient the normals of cloud '%1'").arg(cloud->getName()));
+		result = false;
 	}
 	catch (...)
 	{
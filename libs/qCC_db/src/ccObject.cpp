@@ -65,8 +65,11 @@
 	v5.2 - 11/30/2020 - New ccCoordinateSystem added
 	v5.3 - 10/02/2022 - ccViewportParameters new members (near and far clipping planes)
 	v5.4 - 01/29/2023 - ccColorScale custom labels can be overridden by a string
+	v5.5 - 10/19/2026 - Arrays can be compressed (see ccArrayCodec)
+	v5.6 - 10/19/2026 - 64-bit array sizes (for arrays with more than 2^32-1 elements)
+	v5.7 - 10/19/2026 - Packed (block-compressed) FWF data (see ccWaveformBlockStorage)
 **/
-const unsigned c_currentDBVersion = 54; //5.4
+const unsigned c_currentDBVersion = 57; //5.7
 
 //! Default unique ID generator (using the system persistent settings as we did previously proved to be not reliable)
 static ccUniqueIDGenerator::Shared s_uniqueIDGenerator(new ccUniqueIDGenerator);
@@ -26,6 +26,7 @@
 #include <ReferenceCloud.h>
 
 //local
+#include "ccArrayCodec.h"
 #include "ccChunk.h"
 #include "ccColorRampShader.h"
 #include "ccColorScalesManager.h"
@@ -46,6 +47,9 @@
 #include "ccProgressDialog.h"
 #include "ccScalarField.h"
 #include "ccHObjectCaster.h"
+#include "ccVisibilitySelection.h"
+#include "ccVoxelGrid.h"
+#include "ccVoxelGridFilter.h"
 
 //Qt
 #include <QCoreApplication>
@@ -53,7 +57,9 @@
 #include <QSettings>
 
 //system
+#include <algorithm>
 #include <cassert>
+#include <limits>
 #include <queue>
 
 static const char s_deviationSFName[] = "Deviation";
@@ -150,6 +156,7 @@ ccPointCloud::ccPointCloud(QString name/*=QString()*/, unsigned uniqueID/*=ccUni
 	, m_visibilityCheckEnabled(false)
 	, m_lod(nullptr)
 	, m_fwfData(nullptr)
+	, m_fwfBlocks(nullptr)
 	, m_normalsDrawnAsLines(false)
 {
 	setName(name); //sadly we cannot use the ccGenericPointCloud constructor argument
@@ -365,7 +372,14 @@ ccPointCloud* ccPointCloud::partialClone(const CCCoreLib::ReferenceCloud* select
 						result->waveforms().push_back(w);
 					}
 					//we will use the same FWF data container
-					result->fwfData() = fwfData();
+					if (isFWFDataPacked())
+					{
+						result->m_fwfBlocks = m_fwfBlocks;
+					}
+					else
+					{
+						result->fwfData() = fwfData();
+					}
 				}
 				catch (const std::bad_alloc&)
 				{
@@ -611,6 +625,13 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 
 	unsigned addedPoints = addedCloud->size();
 
+	//the point indexes are 32-bit values
+	if (static_cast<uint64_t>(pointCountBefore) + addedPoints > std::numeric_limits<unsigned>::max())
+	{
+		ccLog::Error("[ccPointCloud::append] Resulting cloud would have too many points!");
+		return *this;
+	}
+
 	if (!reserve(pointCountBefore + addedPoints))
 	{
 		ccLog::Error("[ccPointCloud::append] Not enough memory!");
@@ -1294,6 +1315,17 @@ bool ccPointCloud::resizeTheNormsTable()
 
 bool ccPointCloud::compressFWFData()
 {
+	if (isFWFDataPacked())
+	{
+		//the data is unpacked, compressed, then packed again
+		if (!unpackFWFData())
+		{
+			return false;
+		}
+		bool success = compressFWFData();
+		return packFWFData() && success;
+	}
+
 	if (!m_fwfData || m_fwfData->empty())
 	{
 		return false;
@@ -1302,63 +1334,81 @@ bool ccPointCloud::compressFWFData()
 	try
 	{
 		size_t initialCount = m_fwfData->size();
-		std::vector<size_t> usedIndexes;
-		usedIndexes.resize(initialCount, 0);
 
-		for (const ccWaveform& w : m_fwfWaveforms)
+		//sort the waveforms by data offset (so that the used bytes can be gathered as ranges)
+		std::vector<unsigned> order;
+		order.reserve(m_fwfWaveforms.size());
+		for (unsigned i = 0; i < static_cast<unsigned>(m_fwfWaveforms.size()); ++i)
 		{
-			if (w.byteCount() == 0)
+			if (m_fwfWaveforms[i].byteCount() == 0)
 			{
 				assert(false);
 				continue;
 			}
-
-			size_t start = w.dataOffset();
-			size_t end = w.dataOffset() + w.byteCount();
-			for (size_t i = start; i < end; ++i)
-			{
-				usedIndexes[i] = 1;
-			}
+			order.push_back(i);
 		}
+		std::sort(order.begin(), order.end(), [this](unsigned a, unsigned b) { return m_fwfWaveforms[a].dataOffset() < m_fwfWaveforms[b].dataOffset(); });
 
-		size_t newIndex = 0;
-		for (size_t& index : usedIndexes)
+		//merge the overlapping (or contiguous) waveforms
+		struct UsedRange
 		{
-			if (index != 0)
+			uint64_t start;
+			uint64_t end;
+			uint64_t newStart;
+		};
+		std::vector<UsedRange> ranges;
+		uint64_t newCount = 0;
+		for (unsigned index : order)
+		{
+			const ccWaveform& w = m_fwfWaveforms[index];
+			uint64_t start = w.dataOffset();
+			uint64_t end = start + w.byteCount();
+			if (!ranges.empty() && start <= ranges.back().end)
+			{
+				if (end > ranges.back().end)
+				{
+					newCount += end - ranges.back().end;
+					ranges.back().end = end;
+				}
+			}
+			else
 			{
-				index = ++newIndex; //we need to start at 1 (as 0 means 'not used')
+				ranges.push_back({ start, end, newCount });
+				newCount += end - start;
 			}
 		}
 
-		if (newIndex >= initialCount)
+		if (newCount >= initialCount)
 		{
 			//nothing to do
 			ccLog::Print(QString("[ccPointCloud::compressFWFData] Cloud '%1': no need to compress FWF data").arg(getName()));
 			return true;
 		}
 
-		//now create the new container
-		FWFDataContainer* newContainer = new FWFDataContainer;
-		newContainer->reserve(newIndex);
+		//now create the new container (range by range)
+		FWFDataContainer* newContainer = new FWFDataContainer(newCount);
 
-		for (size_t i = 0; i < initialCount; ++i)
+		for (const UsedRange& range : ranges)
 		{
-			if (usedIndexes[i])
-			{
-				newContainer->push_back(m_fwfData->at(i));
-			}
+			assert(range.end <= initialCount);
+			memcpy(newContainer->data() + range.newStart, m_fwfData->data() + range.start, range.end - range.start);
 		}
 
 		//and don't forget to update the waveform descriptors!
-		for (ccWaveform& w : m_fwfWaveforms)
+		size_t rangeIndex = 0;
+		for (unsigned index : order)
 		{
-			uint64_t offset = w.dataOffset();
-			assert(usedIndexes[offset] != 0);
-			w.setDataOffset(usedIndexes[offset] - 1);
+			ccWaveform& w = m_fwfWaveforms[index];
+			while (w.dataOffset() >= ranges[rangeIndex].end)
+			{
+				++rangeIndex;
+			}
+			assert(rangeIndex < ranges.size() && w.dataOffset() >= ranges[rangeIndex].start);
+			w.setDataOffset(ranges[rangeIndex].newStart + (w.dataOffset() - ranges[rangeIndex].start));
 		}
 		m_fwfData = SharedFWFDataContainer(newContainer);
 
-		ccLog::Print(QString("[ccPointCloud::compressFWFData] Cloud '%1': FWF data compressed --> %2 / %3 (%4%)").arg(getName()).arg(newIndex).arg(initialCount).arg(100.0 - (newIndex * 100.0) / initialCount, 0, 'f', 1));
+		ccLog::Print(QString("[ccPointCloud::compressFWFData] Cloud '%1': FWF data compressed --> %2 / %3 (%4%)").arg(getName()).arg(newCount).arg(initialCount).arg(100.0 - (newCount * 100.0) / initialCount, 0, 'f', 1));
 	}
 	catch (const std::bad_alloc&)
 	{
@@ -1369,6 +1419,56 @@ bool ccPointCloud::compressFWFData()
 	return true;
 }
 
+bool ccPointCloud::packFWFData(int compressionLevel/*=-1*/)
+{
+	if (isFWFDataPacked())
+	{
+		//nothing to do
+		return true;
+	}
+	if (!m_fwfData || m_fwfData->empty())
+	{
+		return false;
+	}
+
+	ccWaveformBlockStorage* blocks = new ccWaveformBlockStorage;
+	if (!blocks->compress(*this, ccWaveformBlockStorage::DefaultBlockSize, compressionLevel))
+	{
+		delete blocks;
+		return false;
+	}
+
+	//the raw data is released (unless it is shared with another cloud)
+	m_fwfData.clear();
+	m_fwfBlocks = SharedFWFBlockStorage(blocks);
+	m_fwfBlockCache = ccWaveformBlockStorage::Cache();
+
+	return true;
+}
+
+bool ccPointCloud::unpackFWFData()
+{
+	if (!isFWFDataPacked())
+	{
+		//nothing to do
+		return true;
+	}
+
+	FWFDataContainer* container = new FWFDataContainer;
+	if (!m_fwfBlocks->decompress(*container))
+	{
+		ccLog::Warning(QString("[ccPointCloud::unpackFWFData] Cloud '%1': failed to unpack the FWF data").arg(getName()));
+		delete container;
+		return false;
+	}
+
+	m_fwfData = SharedFWFDataContainer(container);
+	m_fwfBlocks.clear();
+	m_fwfBlockCache = ccWaveformBlockStorage::Cache();
+
+	return true;
+}
+
 bool ccPointCloud::reserveTheFWFTable()
 {
 	if (m_points.capacity() == 0)
@@ -1392,16 +1492,31 @@ bool ccPointCloud::reserveTheFWFTable()
 
 bool ccPointCloud::hasFWF() const
 {
-	return		m_fwfData
-			&&	!m_fwfData->empty()
+	return		(	(m_fwfData && !m_fwfData->empty())
+				||	(m_fwfBlocks && m_fwfBlocks->size() != 0))
 			&&	!m_fwfWaveforms.empty();
 }
 
+ccWaveformProxy ccPointCloud::waveformProxy(unsigned index, ccWaveformBlockStorage::Cache& cache) const
+{
+	if (m_fwfBlocks)
+	{
+		return m_fwfBlocks->waveformProxy(*this, index, cache);
+	}
+
+	return waveformProxy(index);
+}
+
 ccWaveformProxy ccPointCloud::waveformProxy(unsigned index) const
 {
 	static const ccWaveform invalidW;
 	static const WaveformDescriptor invalidD;
 
+	if (m_fwfBlocks)
+	{
+		return m_fwfBlocks->waveformProxy(*this, index, m_fwfBlockCache);
+	}
+
 	if (index < m_fwfWaveforms.size())
 	{
 		const ccWaveform& w = m_fwfWaveforms[index];
@@ -2118,6 +2233,20 @@ bool ccPointCloud::applyFilterToRGB(PointCoordinateType sigma,
 		return false;
 	}
 
+	//the voxel grid engine is multi-threaded (but approximate for the mean, Gaussian and bilateral filters)
+	if (filterParams.useVoxelGrid)
+	{
+		if (ccVoxelGridFilter::Apply(*this, sigma, sigmaSF, filterParams, true, filterParams.applyToSFduringRGB, progressCb))
+		{
+			return true;
+		}
+		if (progressCb && progressCb->isCancelRequested())
+		{
+			return false;
+		}
+		ccLog::Warning("[ccPointCloud::applyFilterToRGB] Voxel grid filter failed, falling back to the octree");
+	}
+
 	ccOctree* theOctree = getOctree().data();
 	if (!theOctree)
 	{
@@ -3750,6 +3879,17 @@ void ccPointCloud::hidePointsByScalarValue(ScalarType minVal, ScalarType maxVal)
 	}
 }
 
+//! Returns the name of a cloud segmented from another one
+static QString GetSegmentedCloudName(const QString& originalName)
+{
+	static constexpr const char* DefaultSuffix = ".segmented";
+	QString newName = originalName;
+	if (!newName.endsWith(DefaultSuffix)) // avoid adding a multitude of suffixes
+		newName += DefaultSuffix;
+
+	return newName;
+}
+
 ccGenericPointCloud* ccPointCloud::createNewCloudFromVisibilitySelection(	bool removeSelectedPoints/*=false*/,
 																			VisibilityTableType* visTable/*=nullptr*/,
 																			std::vector<int>* newIndexesOfRemainingPoints/*=nullptr*/,
@@ -3820,12 +3960,7 @@ ccGenericPointCloud* ccPointCloud::createNewCloudFromVisibilitySelection(	bool r
 		return nullptr;
 	}
 
-	static constexpr const char* DefaultSuffix = ".segmented";
-	QString newName = getName();
-	if (!newName.endsWith(DefaultSuffix)) // avoid adding a multitude of suffixes
-		newName += DefaultSuffix;
-
-	result->setName(newName);
+	result->setName(GetSegmentedCloudName(getName()));
 
 	//shall the visible points be erased from this cloud?
 	if (removeSelectedPoints)
@@ -3867,6 +4002,84 @@ bool ccPointCloud::removeVisiblePoints(VisibilityTableType* visTable/*=nullptr*/
 		}
 	}
 
+	return removePoints([visTable](unsigned i) { return visTable->at(i) == CCCoreLib::POINT_VISIBLE; }, newIndexes);
+}
+
+ccGenericPointCloud* ccPointCloud::createNewCloudFromSelection(	const ccVisibilitySelection& pointSelection,
+																bool removeSelectedPoints/*=false*/,
+																std::vector<int>* newIndexesOfRemainingPoints/*=nullptr*/,
+																bool silent/*=false*/)
+{
+	if (pointSelection.size() != size())
+	{
+		ccLog::Error(QString("[Cloud %1] Invalid input selection").arg(getName()));
+		return nullptr;
+	}
+
+	if (pointSelection.count() == size())
+	{
+		// all points are selected: nothing to do
+		return this;
+	}
+
+	//we create a new cloud with the selected points
+	ccPointCloud* result = nullptr;
+	{
+		CCCoreLib::ReferenceCloud* rc = getTheSelectedPoints(pointSelection, silent);
+		if (!rc)
+		{
+			//a warning message has already been issued by getTheSelectedPoints!
+			return nullptr;
+		}
+
+		//convert selection to cloud
+		result = partialClone(rc);
+
+		delete rc;
+		rc = nullptr;
+	}
+
+	if (!result)
+	{
+		ccLog::Warning("[ccPointCloud::createNewCloudFromSelection] Failed to generate a subset cloud");
+		return nullptr;
+	}
+
+	result->setName(GetSegmentedCloudName(getName()));
+
+	//shall the selected points be erased from this cloud?
+	if (removeSelectedPoints)
+	{
+		if (isLocked())
+		{
+			ccLog::Warning("[ccPointCloud::createNewCloudFromSelection] Can't remove selected points as cloud is locked");
+			if (newIndexesOfRemainingPoints)
+			{
+				newIndexesOfRemainingPoints->clear();
+			}
+		}
+		else
+		{
+			this->removeSelectedPoints(pointSelection, newIndexesOfRemainingPoints);
+		}
+	}
+
+	return result;
+}
+
+bool ccPointCloud::removeSelectedPoints(const ccVisibilitySelection& pointSelection, std::vector<int>* newIndexes/*=nullptr*/)
+{
+	if (pointSelection.size() != size())
+	{
+		ccLog::Error("[removeSelectedPoints] Invalid input selection");
+		return false;
+	}
+
+	return removePoints([&pointSelection](unsigned i) { return pointSelection.isSelected(i); }, newIndexes);
+}
+
+bool ccPointCloud::removePoints(const std::function<bool(unsigned)>& toRemove, std::vector<int>* newIndexes)
+{
 	std::vector<int> localNewIndexes;
 	std::vector<int>* _newIndexes = nullptr;
 	try
@@ -3879,7 +4092,7 @@ bool ccPointCloud::removeVisiblePoints(VisibilityTableType* visTable/*=nullptr*/
 			}
 			else if (newIndexes->size() != size())
 			{
-				ccLog::Error("[removeVisiblePoints] Input 'new indexes' has a wrong size");
+				ccLog::Error("[removePoints] Input 'new indexes' has a wrong size");
 				return false;
 			}
 			_newIndexes = newIndexes;
@@ -3893,7 +4106,7 @@ bool ccPointCloud::removeVisiblePoints(VisibilityTableType* visTable/*=nullptr*/
 	}
 	catch (const std::bad_alloc&)
 	{
-		ccLog::Error("[removeVisiblePoints] Not enough memory");
+		ccLog::Error("[removePoints] Not enough memory");
 		return false;
 	}
 
@@ -3906,7 +4119,7 @@ bool ccPointCloud::removeVisiblePoints(VisibilityTableType* visTable/*=nullptr*/
 	unsigned previousCount = size();
 	for (unsigned i = 0; i < previousCount; ++i)
 	{
-		if (visTable->at(i) != CCCoreLib::POINT_VISIBLE)
+		if (!toRemove(i))
 		{
 			if (_newIndexes)
 			{
@@ -4703,7 +4916,7 @@ bool ccPointCloud::toFile_MeOnly(QFile& out, short dataVersion) const
 	}
 
 	//points array (dataVersion>=20)
-	if (!ccSerializationHelper::GenericArrayToFile<CCVector3, 3, PointCoordinateType>(m_points, out))
+	if (!ccSerializationHelper::GenericArrayToFile<CCVector3, 3, PointCoordinateType>(m_points, out, dataVersion))
 		return false;
 
 	//colors array (dataVersion>=20)
@@ -4829,14 +5042,53 @@ bool ccPointCloud::toFile_MeOnly(QFile& out, short dataVersion) const
 			}
 
 			//eventually save the data
-			uint64_t dataSize = static_cast<uint64_t>(m_fwfData ? m_fwfData->size() : 0);
-			if (out.write((const char*)&dataSize, 8) < 0)
+			const ccWaveformBlockStorage* blocks = m_fwfBlocks.data();
+			ccWaveformBlockStorage tempBlocks;
+			FWFDataContainer tempData;
+			const FWFDataContainer* data = m_fwfData.data();
+			if (dataVersion >= ccWaveformBlockStorage::MinFileVersion)
+			{
+				//dataVersion >= 57
+				if (!blocks && data && ccArrayCodec::IsCompressionEnabled() && tempBlocks.compress(*this))
+				{
+					//pack the data on the fly
+					blocks = &tempBlocks;
+				}
+				bool packed = (blocks != nullptr);
+				if (out.write((const char*)&packed, sizeof(bool)) < 0)
+				{
+					return WriteError();
+				}
+			}
+			else if (blocks)
 			{
-				return WriteError();
+				//older versions only support the raw data
+				if (!blocks->decompress(tempData))
+				{
+					return MemoryError();
+				}
+				data = &tempData;
+				blocks = nullptr;
 			}
-			if (m_fwfData && out.write((const char*)m_fwfData->data(), dataSize) < 0)
+
+			if (blocks)
 			{
-				return WriteError();
+				if (!blocks->toFile(out, dataVersion))
+				{
+					return WriteError();
+				}
+			}
+			else
+			{
+				uint64_t dataSize = static_cast<uint64_t>(data ? data->size() : 0);
+				if (out.write((const char*)&dataSize, 8) < 0)
+				{
+					return WriteError();
+				}
+				if (data && out.write((const char*)data->data(), dataSize) < 0)
+				{
+					return WriteError();
+				}
 			}
 		}
 	}
@@ -5088,12 +5340,35 @@ bool ccPointCloud::fromFile_MeOnly(QFile& in, short dataVersion, int flags, Load
 				}
 			}
 
-			//eventually save the data
+			//eventually read the data
+			bool packed = false;
+			if (dataVersion >= ccWaveformBlockStorage::MinFileVersion)
+			{
+				//dataVersion >= 57
+				if (in.read((char*)&packed, sizeof(bool)) < 0)
+				{
+					return ReadError();
+				}
+			}
+
 			uint64_t dataSize = 0;
-			if (in.read((char*)&dataSize, 8) < 0)
+			if (packed)
+			{
+				//the data remains packed in memory
+				ccWaveformBlockStorage* blocks = new ccWaveformBlockStorage;
+				if (!blocks->fromFile(in, dataVersion, flags, oldToNewIDMap))
+				{
+					delete blocks;
+					return false;
+				}
+				m_fwfBlocks = SharedFWFBlockStorage(blocks);
+				m_fwfBlockCache = ccWaveformBlockStorage::Cache();
+			}
+			else if (in.read((char*)&dataSize, 8) < 0)
 			{
 				return ReadError();
 			}
+
 			if (dataSize != 0)
 			{
 				FWFDataContainer* container = new FWFDataContainer;
@@ -5265,7 +5540,7 @@ short ccPointCloud::Grid::minimumFileVersion() const
 short ccPointCloud::minimumFileVersion_MeOnly() const
 {
 	short minVersion = std::max(static_cast<short>(27), ccGenericPointCloud::minimumFileVersion_MeOnly());
-	minVersion = std::max(minVersion, ccSerializationHelper::GenericArrayToFileMinVersion());
+	minVersion = std::max(minVersion, ccSerializationHelper::GenericArrayToFileMinVersion(m_points.size()));
 	if (m_rgbaColors)
 		minVersion = std::max(minVersion, m_rgbaColors->minimumFileVersion());
 	if (m_normals)
@@ -5290,6 +5565,11 @@ short ccPointCloud::minimumFileVersion_MeOnly() const
 		{
 			minVersion = std::max(minVersion, m_fwfWaveforms.front().minimumFileVersion()); // we assume they are all the same
 		}
+		if (isFWFDataPacked() || ccArrayCodec::IsCompressionEnabled())
+		{
+			//packed data
+			minVersion = std::max(minVersion, static_cast<short>(ccWaveformBlockStorage::MinFileVersion));
+		}
 	}
 
 	return minVersion;
@@ -6227,9 +6507,12 @@ bool ccPointCloud::orientNormalsWithMST(unsigned kNN/*=6*/,
 }
 
 bool ccPointCloud::orientNormalsWithFM(	unsigned char level,
-										ccProgressDialog* pDlg/*=nullptr*/)
+										ccProgressDialog* pDlg/*=nullptr*/,
+										bool concurrent/*=false*/)
 {
-	return ccFastMarchingForNormsDirection::OrientNormals(this, level, pDlg);
+	int result = (concurrent ? ccFastMarchingForNormsDirection::OrientNormalsConcurrently(this, level, pDlg)
+							 : ccFastMarchingForNormsDirection::OrientNormals(this, level, pDlg));
+	return (result > 0);
 }
 
 void ccPointCloud::showNormalsAsLines(bool state)
@@ -6825,31 +7108,31 @@ ccPointCloud* ccPointCloud::removeDuplicatePoints(double minDistanceBetweenPoint
 		return nullptr;
 	}
 
-	ccOctree::Shared octree = getOctree();
-
-	CCCoreLib::GeometricalAnalysisTools::ErrorCode result = CCCoreLib::GeometricalAnalysisTools::FlagDuplicatePoints(
-					this,
-					minDistanceBetweenPoints,
-					pDlg,
-					octree.data());
-
-	if (result != CCCoreLib::GeometricalAnalysisTools::NoError)
+	//find the duplicate points (with a spatial hash rather than the octree)
+	std::vector<unsigned> rootIndexes;
+	if (!ccVoxelGrid::FindDuplicates(*this, minDistanceBetweenPoints, rootIndexes, pDlg))
 	{
 		ccLog::Warning(QObject::tr("An error occurred! (Not enough memory?)"));
+		deleteScalarField(sfIdx);
 		return nullptr;
 	}
 
-	//count the number of duplicate points
+	//flag and count the duplicate points
 	CCCoreLib::ScalarField* flagSF = getScalarField(sfIdx);
 	unsigned duplicateCount = 0;
 	if (flagSF)
 	{
 		for (unsigned j = 0; j < flagSF->currentSize(); ++j)
 		{
-			if (flagSF->getValue(j) != 0)
+			if (rootIndexes[j] != j)
 			{
+				flagSF->setValue(j, 1);
 				++duplicateCount;
 			}
+			else
+			{
+				flagSF->setValue(j, 0);
+			}
 		}
 	}
 	else
@@ -21,6 +21,10 @@
 #include <QCoreApplication>
 #include <QPushButton>
 #include <QProgressBar>
+#include <QThread>
+
+//! Progress refresh interval (ms)
+static const int s_refreshInterval_ms = 50;
 
 ccProgressDialog::ccProgressDialog(	bool showCancelButton,
 									QWidget* parent/*=nullptr*/ )
@@ -47,7 +51,10 @@ ccProgressDialog::ccProgressDialog(	bool showCancelButton,
 	}
 	setCancelButton(cancelButton);
 
-	connect(this, &ccProgressDialog::scheduleRefresh, this, &ccProgressDialog::refresh, Qt::QueuedConnection); //can't use DirectConnection here!
+	//the progress is sampled at a fixed rate (instead of being pushed by the process)
+	m_refreshTimer.setInterval(s_refreshInterval_ms);
+	connect(&m_refreshTimer, &QTimer::timeout, this, &ccProgressDialog::refresh);
+	m_eventsTimer.start();
 }
 
 void ccProgressDialog::refresh()
@@ -60,6 +67,18 @@ void ccProgressDialog::refresh()
 	}
 }
 
+void ccProgressDialog::showEvent(QShowEvent* event)
+{
+	QProgressDialog::showEvent(event);
+	m_refreshTimer.start();
+}
+
+void ccProgressDialog::hideEvent(QHideEvent* event)
+{
+	m_refreshTimer.stop();
+	QProgressDialog::hideEvent(event);
+}
+
 void ccProgressDialog::update(float percent)
 {
 	//thread-safe
@@ -67,8 +86,15 @@ void ccProgressDialog::update(float percent)
 	if (value != m_currentValue)
 	{
 		m_currentValue = value;
-		Q_EMIT scheduleRefresh();
-		QCoreApplication::processEvents();
+
+		//if the process runs in the main thread, the refresh timer can't be triggered:
+		//we have to process the events ourselves (but not too often)
+		if (QThread::currentThread() == thread() && m_eventsTimer.elapsed() >= s_refreshInterval_ms)
+		{
+			refresh();
+			QCoreApplication::processEvents();
+			m_eventsTimer.restart();
+		}
 	}
 }
 
@@ -91,6 +117,7 @@ void ccProgressDialog::start()
 {
 	m_lastRefreshValue = -1;
 	show();
+	m_eventsTimer.restart();
 	QCoreApplication::processEvents();
 }
 
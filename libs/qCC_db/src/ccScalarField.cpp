@@ -18,6 +18,7 @@
 #include "ccScalarField.h"
 
 //Local
+#include "ccChunk.h"
 #include "ccColorScalesManager.h"
 
 //CCCoreLib
@@ -26,10 +27,17 @@
 //system
 #include <algorithm>
 
+#if defined(_OPENMP)
+//OpenMP
+#include <omp.h>
+#endif
+
 using namespace CCCoreLib;
 
 //! Default number of classes for associated histogram
 const unsigned MAX_HISTOGRAM_SIZE = 512;
+//! Number of classes of the fine histogram (from which the other histograms are derived)
+static const unsigned FINE_HISTOGRAM_SIZE = (1 << 14);
 
 ccScalarField::ccScalarField(const char* name/*=nullptr*/)
 	: ScalarField(name)
@@ -39,6 +47,7 @@ ccScalarField::ccScalarField(const char* name/*=nullptr*/)
 	, m_alwaysShowZero(false)
 	, m_colorScale(nullptr)
 	, m_colorRampSteps(0)
+	, m_histogramIsValid(false)
 	, m_modified(true)
 	, m_globalShift(0)
 {
@@ -57,7 +66,7 @@ ccScalarField::ccScalarField(const ccScalarField& sf)
 	, m_alwaysShowZero(sf.m_alwaysShowZero)
 	, m_colorScale(sf.m_colorScale)
 	, m_colorRampSteps(sf.m_colorRampSteps)
-	, m_histogram(sf.m_histogram)
+	, m_histogramIsValid(false)
 	, m_modified(sf.m_modified)
 	, m_globalShift(sf.m_globalShift)
 {
@@ -162,64 +171,246 @@ void ccScalarField::setLogScale(bool state)
 
 void ccScalarField::computeMinAndMax()
 {
-	ScalarField::computeMinAndMax();
+	size_t valueCount = size();
+	size_t chunkCount = ccChunk::Count(valueCount);
 
-	m_displayRange.setBounds(getMin(), getMax());
+	//summary of a chunk of values
+	struct ChunkSummary
+	{
+		ScalarType minVal = 0;
+		ScalarType maxVal = 0;
+		unsigned validCount = 0;
+	};
+	std::vector<ChunkSummary> chunkSummaries;
+	try
+	{
+		chunkSummaries.resize(chunkCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory: we scan all the values sequentially
+		ScalarField::computeMinAndMax();
+		onMinAndMaxUpdated();
+		return;
+	}
 
-	//update histogram
+	//scan the chunks in parallel
+	int _chunkCount = static_cast<int>(chunkCount);
+#if defined(_OPENMP)
+	#pragma omp parallel for num_threads(omp_get_max_threads()) schedule(dynamic)
+#endif
+	for (int i = 0; i < _chunkCount; ++i)
 	{
-		if (m_displayRange.maxRange() == 0 || currentSize() == 0)
+		ChunkSummary& summary = chunkSummaries[i];
+
+		const ScalarType* values = data() + ccChunk::StartPos(i);
+		size_t count = ccChunk::Size(i, chunkCount, valueCount);
+
+		summary.validCount = 0;
+		for (size_t j = 0; j < count; ++j)
 		{
-			//can't build histogram of a flat field
-			m_histogram.clear();
+			const ScalarType& val = values[j];
+			if (ValidValue(val))
+			{
+				if (summary.validCount++ != 0)
+				{
+					if (val < summary.minVal)
+						summary.minVal = val;
+					else if (val > summary.maxVal)
+						summary.maxVal = val;
+				}
+				else
+				{
+					summary.minVal = summary.maxVal = val;
+				}
+			}
+		}
+	}
+
+	//merge the summaries
+	bool minMaxInitialized = false;
+	for (const ChunkSummary& summary : chunkSummaries)
+	{
+		if (summary.validCount == 0)
+		{
+			continue;
+		}
+
+		if (minMaxInitialized)
+		{
+			m_minVal = std::min(m_minVal, summary.minVal);
+			m_maxVal = std::max(m_maxVal, summary.maxVal);
 		}
 		else
 		{
-			unsigned count = currentSize();
-			unsigned numberOfClasses = static_cast<unsigned>(ceil(sqrt(static_cast<double>(count))));
-			numberOfClasses = std::max<unsigned>(std::min<unsigned>(numberOfClasses, MAX_HISTOGRAM_SIZE), 4);
+			m_minVal = summary.minVal;
+			m_maxVal = summary.maxVal;
+			minMaxInitialized = true;
+		}
+	}
 
-			m_histogram.maxValue = 0;
+	if (!minMaxInitialized)
+	{
+		//no valid value
+		m_minVal = m_maxVal = 0;
+	}
 
-			//reserve memory
-			try
-			{
-				m_histogram.resize(numberOfClasses);
-			}
-			catch (const std::bad_alloc&)
+	onMinAndMaxUpdated();
+}
+
+void ccScalarField::onMinAndMaxUpdated()
+{
+	m_displayRange.setBounds(getMin(), getMax());
+
+	//the histograms will be updated on demand
+	m_fineHistogram.clear();
+	m_fineHistogram.shrink_to_fit();
+	m_histogramIsValid = false;
+
+	m_modified = true;
+
+	updateSaturationBounds();
+}
+
+bool ccScalarField::scanHistogram(unsigned classCount, std::vector<unsigned>& output) const
+{
+	ScalarType minVal = getMin();
+	ScalarType maxVal = getMax();
+	double step = classCount / static_cast<double>(maxVal - minVal);
+
+	//one histogram per thread
+	int threadCount = 1;
+#if defined(_OPENMP)
+	threadCount = omp_get_max_threads();
+#endif
+	std::vector< std::vector<unsigned> > histograms;
+	try
+	{
+		output.assign(classCount, 0);
+		histograms.resize(threadCount - 1, std::vector<unsigned>(classCount, 0));
+	}
+	catch (const std::bad_alloc&)
+	{
+		output.clear();
+		return false;
+	}
+
+	size_t valueCount = size();
+	size_t chunkCount = ccChunk::Count(valueCount);
+
+	int _chunkCount = static_cast<int>(chunkCount);
+#if defined(_OPENMP)
+	#pragma omp parallel for num_threads(threadCount) schedule(dynamic)
+#endif
+	for (int i = 0; i < _chunkCount; ++i)
+	{
+		int threadIndex = 0;
+#if defined(_OPENMP)
+		threadIndex = omp_get_thread_num();
+#endif
+		std::vector<unsigned>& histogram = (threadIndex == 0 ? output : histograms[threadIndex - 1]);
+
+		const ScalarType* values = data() + ccChunk::StartPos(i);
+		size_t count = ccChunk::Size(i, chunkCount, valueCount);
+		for (size_t j = 0; j < count; ++j)
+		{
+			const ScalarType& val = values[j];
+
+			//we ignore the values outside of [min ; max] (works for NaN values as well)
+			if (val >= minVal && val <= maxVal)
 			{
-				ccLog::Warning("[ccScalarField::computeMinAndMax] Failed to update associated histogram!");
-				m_histogram.clear();
+				size_t bin = static_cast<size_t>((val - minVal) * step);
+				++histogram[std::min<size_t>(bin, classCount - 1)];
 			}
+		}
+	}
 
-			if (!m_histogram.empty())
-			{
-				std::fill(m_histogram.begin(), m_histogram.end(), 0);
+	//merge the histograms
+	for (const std::vector<unsigned>& histogram : histograms)
+	{
+		for (unsigned i = 0; i < classCount; ++i)
+		{
+			output[i] += histogram[i];
+		}
+	}
 
-				//compute histogram
-				{
-					ScalarType step = static_cast<ScalarType>(numberOfClasses) / m_displayRange.maxRange();
-					for (unsigned i = 0; i < count; ++i)
-					{
-						const ScalarType& val = getValue(i);
+	return true;
+}
 
-						if (ValidValue(val))
-						{
-							unsigned bin = static_cast<unsigned>((val - m_displayRange.min())*step);
-							++m_histogram[std::min(bin, numberOfClasses - 1)];
-						}
-					}
-				}
+bool ccScalarField::computeHistogram(unsigned classCount, Histogram& histogram) const
+{
+	histogram.clear();
+	histogram.maxValue = 0;
 
-				//update 'maxValue'
-				m_histogram.maxValue = *std::max_element(m_histogram.begin(), m_histogram.end());
-			}
+	if (classCount == 0)
+	{
+		assert(false);
+		return false;
+	}
+
+	if (getMax() <= getMin() || currentSize() == 0)
+	{
+		//can't build histogram of a flat field
+		return false;
+	}
+
+	if (FINE_HISTOGRAM_SIZE % classCount != 0)
+	{
+		//the classes boundaries don't match the fine ones: we scan the values
+		if (!scanHistogram(classCount, histogram))
+		{
+			ccLog::Warning("[ccScalarField::computeHistogram] Not enough memory!");
+			return false;
 		}
 	}
+	else
+	{
+		if (m_fineHistogram.empty() && !scanHistogram(FINE_HISTOGRAM_SIZE, m_fineHistogram))
+		{
+			ccLog::Warning("[ccScalarField::computeHistogram] Not enough memory!");
+			return false;
+		}
 
-	m_modified = true;
+		try
+		{
+			histogram.resize(classCount, 0);
+		}
+		catch (const std::bad_alloc&)
+		{
+			ccLog::Warning("[ccScalarField::computeHistogram] Not enough memory!");
+			return false;
+		}
 
-	updateSaturationBounds();
+		//each class gathers the same number of consecutive fine classes
+		unsigned fineClassCount = FINE_HISTOGRAM_SIZE / classCount;
+		for (unsigned i = 0; i < FINE_HISTOGRAM_SIZE; ++i)
+		{
+			histogram[i / fineClassCount] += m_fineHistogram[i];
+		}
+	}
+
+	histogram.maxValue = *std::max_element(histogram.begin(), histogram.end());
+
+	return true;
+}
+
+const ccScalarField::Histogram& ccScalarField::getHistogram() const
+{
+	if (!m_histogramIsValid)
+	{
+		m_histogramIsValid = true;
+
+		unsigned count = currentSize();
+		unsigned numberOfClasses = static_cast<unsigned>(ceil(sqrt(static_cast<double>(count))));
+		numberOfClasses = std::max<unsigned>(std::min<unsigned>(numberOfClasses, MAX_HISTOGRAM_SIZE), 4);
+
+		if (!computeHistogram(numberOfClasses, m_histogram))
+		{
+			m_histogram.clear();
+		}
+	}
+
+	return m_histogram;
 }
 
 void ccScalarField::updateSaturationBounds()
@@ -334,7 +525,7 @@ bool ccScalarField::toFile(QFile& out, short dataVersion) const
 		return WriteError();
 
 	//data (dataVersion>=20)
-	if (!ccSerializationHelper::GenericArrayToFile<ScalarType, 1, ScalarType>(*this, out))
+	if (!ccSerializationHelper::GenericArrayToFile<ScalarType, 1, ScalarType>(*this, out, dataVersion))
 		return WriteError();
 
 	//displayed values & saturation boundaries (dataVersion>=20)
@@ -632,7 +823,7 @@ short ccScalarField::minimumFileVersion() const
 	// we need verison 42 to save a non-zero global shift
 	short minVersion = (m_globalShift != 0 ? 42 : 27);
 
-	minVersion = std::max(minVersion, ccSerializationHelper::GenericArrayToFileMinVersion());
+	minVersion = std::max(minVersion, ccSerializationHelper::GenericArrayToFileMinVersion(size()));
 	if (m_colorScale)
 	{
 		minVersion = std::max(minVersion, m_colorScale->minimumFileVersion());
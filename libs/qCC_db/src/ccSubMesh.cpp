@@ -597,7 +597,7 @@ bool ccSubMesh::toFile_MeOnly(QFile& out, short dataVersion) const
 		return WriteError();
 
 	//references (dataVersion>=29)
-	if (!ccSerializationHelper::GenericArrayToFile<unsigned, 1, unsigned>(m_triIndexes, out))
+	if (!ccSerializationHelper::GenericArrayToFile<unsigned, 1, unsigned>(m_triIndexes, out, dataVersion))
 		return WriteError();
 
 	return true;
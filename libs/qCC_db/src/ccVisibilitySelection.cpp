@@ -0,0 +1,296 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccVisibilitySelection.h"
+
+//CCCoreLib
+#include <CCConst.h>
+
+//System
+#include <algorithm>
+
+#if defined(_OPENMP)
+//OpenMP
+#include <omp.h>
+#endif
+
+//! Number of words per block (the number of selected points before each block is stored)
+static const size_t s_wordsPerBlock = 8;
+
+//! Returns the number of bits set in a word
+static inline unsigned Popcount64(uint64_t word)
+{
+	word = word - ((word >> 1) & 0x5555555555555555ULL);
+	word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+	word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return static_cast<unsigned>((word * 0x0101010101010101ULL) >> 56);
+}
+
+void ccVisibilitySelection::resize(unsigned count)
+{
+	m_ranges.clear();
+	m_compacted = false;
+	m_blockRanks.clear();
+	m_ranksValid = false;
+
+	m_words.assign((static_cast<size_t>(count) + 63) >> 6, 0);
+	m_size = count;
+}
+
+void ccVisibilitySelection::clear()
+{
+	m_size = 0;
+	m_words.clear();
+	m_words.shrink_to_fit();
+	m_blockRanks.clear();
+	m_blockRanks.shrink_to_fit();
+	m_ranksValid = false;
+	m_ranges.clear();
+	m_ranges.shrink_to_fit();
+	m_compacted = false;
+}
+
+bool ccVisibilitySelection::isSelected(unsigned index) const
+{
+	assert(index < m_size);
+
+	if (m_compacted)
+	{
+		//first range starting after the index
+		std::vector<Range>::const_iterator it = std::upper_bound(	m_ranges.begin(),
+																	m_ranges.end(),
+																	index,
+																	[](unsigned i, const Range& range) { return i < range.first; });
+		return (it != m_ranges.begin() && index < (it - 1)->last);
+	}
+	else
+	{
+		return ((m_words[index >> 6] >> (index & 63)) & 1) != 0;
+	}
+}
+
+void ccVisibilitySelection::assign(unsigned count, const std::function<bool(unsigned)>& predicate)
+{
+	resize(count);
+
+	//each thread fills its own words
+	int wordCount = static_cast<int>(m_words.size());
+#if defined(_OPENMP)
+	#pragma omp parallel for num_threads(omp_get_max_threads())
+#endif
+	for (int w = 0; w < wordCount; ++w)
+	{
+		unsigned firstIndex = (static_cast<unsigned>(w) << 6);
+		unsigned lastIndex = std::min(firstIndex + 64, m_size);
+
+		uint64_t word = 0;
+		for (unsigned i = firstIndex; i < lastIndex; ++i)
+		{
+			if (predicate(i))
+			{
+				word |= (static_cast<uint64_t>(1) << (i - firstIndex));
+			}
+		}
+		m_words[w] = word;
+	}
+
+	updateRanks();
+}
+
+void ccVisibilitySelection::fromVisibilityTable(const std::vector<unsigned char>& visTable)
+{
+	assign(static_cast<unsigned>(visTable.size()), [&visTable](unsigned i) { return visTable[i] == CCCoreLib::POINT_VISIBLE; });
+}
+
+void ccVisibilitySelection::toVisibilityTable(std::vector<unsigned char>& visTable) const
+{
+	visTable.resize(m_size);
+
+	int size = static_cast<int>(m_size);
+#if defined(_OPENMP)
+	#pragma omp parallel for num_threads(omp_get_max_threads())
+#endif
+	for (int i = 0; i < size; ++i)
+	{
+		visTable[i] = (isSelected(static_cast<unsigned>(i)) ? CCCoreLib::POINT_VISIBLE : CCCoreLib::POINT_HIDDEN);
+	}
+}
+
+void ccVisibilitySelection::updateRanks() const
+{
+	if (m_ranksValid)
+	{
+		return;
+	}
+
+	if (m_compacted)
+	{
+		//number of selected points before each range
+		m_blockRanks.resize(m_ranges.size() + 1);
+		m_blockRanks[0] = 0;
+		for (size_t r = 0; r < m_ranges.size(); ++r)
+		{
+			m_blockRanks[r + 1] = m_blockRanks[r] + (m_ranges[r].last - m_ranges[r].first);
+		}
+	}
+	else
+	{
+		//number of selected points in each block
+		size_t blockCount = (m_words.size() + s_wordsPerBlock - 1) / s_wordsPerBlock;
+		m_blockRanks.resize(blockCount + 1);
+		m_blockRanks[0] = 0;
+
+		int _blockCount = static_cast<int>(blockCount);
+#if defined(_OPENMP)
+		#pragma omp parallel for num_threads(omp_get_max_threads())
+#endif
+		for (int b = 0; b < _blockCount; ++b)
+		{
+			size_t firstWord = b * s_wordsPerBlock;
+			size_t lastWord = std::min(firstWord + s_wordsPerBlock, m_words.size());
+			unsigned population = 0;
+			for (size_t w = firstWord; w < lastWord; ++w)
+			{
+				population += Popcount64(m_words[w]);
+			}
+			m_blockRanks[b + 1] = population;
+		}
+
+		//then accumulate them
+		for (size_t b = 0; b < blockCount; ++b)
+		{
+			m_blockRanks[b + 1] += m_blockRanks[b];
+		}
+	}
+
+	m_ranksValid = true;
+}
+
+unsigned ccVisibilitySelection::count() const
+{
+	updateRanks();
+	return m_blockRanks.empty() ? 0 : m_blockRanks.back();
+}
+
+bool ccVisibilitySelection::compact()
+{
+	if (m_compacted)
+	{
+		return true;
+	}
+
+	//count the ranges first (i.e. the selected bits following an unselected one)
+	size_t rangeCount = 0;
+	{
+		uint64_t previousBit = 0;
+		for (uint64_t word : m_words)
+		{
+			rangeCount += Popcount64(word & ~((word << 1) | previousBit));
+			previousBit = (word >> 63);
+		}
+	}
+
+	if (rangeCount * sizeof(Range) * 2 > m_words.size() * sizeof(uint64_t))
+	{
+		//not coherent enough
+		return false;
+	}
+
+	std::vector<Range> ranges;
+	try
+	{
+		ranges.reserve(rangeCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	forEachSelected([&ranges](unsigned i)
+	{
+		if (!ranges.empty() && ranges.back().last == i)
+		{
+			++ranges.back().last;
+		}
+		else
+		{
+			ranges.push_back(Range{ i, i + 1 });
+		}
+	});
+
+	m_ranges = std::move(ranges);
+	m_compacted = true;
+
+	m_words.clear();
+	m_words.shrink_to_fit();
+	m_ranksValid = false;
+	updateRanks();
+
+	return true;
+}
+
+void ccVisibilitySelection::forEachSelectedInParallel(const std::function<void(unsigned rank, unsigned index)>& func) const
+{
+	updateRanks();
+
+	if (m_compacted)
+	{
+		int rangeCount = static_cast<int>(m_ranges.size());
+#if defined(_OPENMP)
+		#pragma omp parallel for num_threads(omp_get_max_threads()) schedule(dynamic)
+#endif
+		for (int r = 0; r < rangeCount; ++r)
+		{
+			const Range& range = m_ranges[r];
+			unsigned rank = m_blockRanks[r];
+			for (unsigned i = range.first; i < range.last; ++i)
+			{
+				func(rank++, i);
+			}
+		}
+	}
+	else
+	{
+		int blockCount = static_cast<int>(m_blockRanks.size()) - 1;
+#if defined(_OPENMP)
+		#pragma omp parallel for num_threads(omp_get_max_threads())
+#endif
+		for (int b = 0; b < blockCount; ++b)
+		{
+			if (m_blockRanks[b + 1] == m_blockRanks[b])
+			{
+				//empty block
+				continue;
+			}
+
+			unsigned rank = m_blockRanks[b];
+			size_t firstWord = b * s_wordsPerBlock;
+			size_t lastWord = std::min(firstWord + s_wordsPerBlock, m_words.size());
+			for (size_t w = firstWord; w < lastWord; ++w)
+			{
+				uint64_t word = m_words[w];
+				for (unsigned i = static_cast<unsigned>(w << 6); word != 0; ++i, word >>= 1)
+				{
+					if (word & 1)
+					{
+						func(rank++, i);
+					}
+				}
+			}
+		}
+	}
+}
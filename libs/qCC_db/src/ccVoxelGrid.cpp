@@ -0,0 +1,408 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccVoxelGrid.h"
+
+//Local
+#include "ccLog.h"
+
+//CCCoreLib
+#include <GenericIndexedCloudPersist.h>
+#include <GenericProgressCallback.h>
+#include <ParallelSort.h>
+
+//System
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+
+#if defined(_OPENMP)
+//OpenMP
+#include <omp.h>
+#endif
+
+ccVoxelGrid::ccVoxelGrid()
+	: m_voxelSize(0)
+	, m_origin(0, 0, 0)
+	, m_dimensions(0, 0, 0)
+{
+}
+
+void ccVoxelGrid::clear()
+{
+	m_voxels.clear();
+	m_voxels.shrink_to_fit();
+	m_keys.clear();
+	m_keys.shrink_to_fit();
+	m_pointIndexes.clear();
+	m_pointIndexes.shrink_to_fit();
+}
+
+Tuple3i ccVoxelGrid::positionOf(const CCVector3& P) const
+{
+	Tuple3i pos;
+	for (unsigned char d = 0; d < 3; ++d)
+	{
+		int i = static_cast<int>(std::floor((P.u[d] - m_origin.u[d]) / m_voxelSize));
+		pos.u[d] = std::max(0, std::min(i, m_dimensions.u[d] - 1));
+	}
+	return pos;
+}
+
+bool ccVoxelGrid::build(CCCoreLib::GenericIndexedCloudPersist& cloud, PointCoordinateType voxelSize)
+{
+	clear();
+
+	unsigned pointCount = cloud.size();
+	if (pointCount == 0 || voxelSize <= 0)
+	{
+		assert(false);
+		return false;
+	}
+
+	CCVector3 bbMin;
+	CCVector3 bbMax;
+	cloud.getBoundingBox(bbMin, bbMax);
+
+	m_voxelSize = voxelSize;
+	m_origin = bbMin;
+	for (unsigned char d = 0; d < 3; ++d)
+	{
+		double dim = std::floor((bbMax.u[d] - bbMin.u[d]) / voxelSize) + 1;
+		if (dim > MaxDimension)
+		{
+			ccLog::Warning(QString("[ccVoxelGrid] Voxel size too small (%1 voxels along dimension %2, %3 max)").arg(dim).arg(d).arg(MaxDimension));
+			return false;
+		}
+		m_dimensions.u[d] = static_cast<int>(dim);
+	}
+
+	try
+	{
+		//compute the keys (in parallel)
+		std::vector<std::pair<uint64_t, unsigned>> keysAndIndexes(pointCount);
+		int _pointCount = static_cast<int>(pointCount);
+#if defined(_OPENMP)
+		#pragma omp parallel for num_threads(omp_get_max_threads())
+#endif
+		for (int i = 0; i < _pointCount; ++i)
+		{
+			const CCVector3* P = cloud.getPointPersistentPtr(static_cast<unsigned>(i));
+			keysAndIndexes[i] = { Key(positionOf(*P)), static_cast<unsigned>(i) };
+		}
+
+		//sort them (the indexes are unique, so that the order is deterministic)
+		ParallelSort(keysAndIndexes.begin(), keysAndIndexes.end());
+
+		m_pointIndexes.resize(pointCount);
+		size_t voxelCount = 0;
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			m_pointIndexes[i] = keysAndIndexes[i].second;
+			if (i == 0 || keysAndIndexes[i].first != keysAndIndexes[i - 1].first)
+			{
+				++voxelCount;
+			}
+		}
+
+		m_voxels.reserve(voxelCount);
+		m_keys.reserve(voxelCount);
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			if (i == 0 || keysAndIndexes[i].first != keysAndIndexes[i - 1].first)
+			{
+				m_voxels.push_back({ i, 0 });
+				m_keys.push_back(keysAndIndexes[i].first);
+			}
+			++m_voxels.back().count;
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccVoxelGrid] Not enough memory");
+		clear();
+		return false;
+	}
+
+	return true;
+}
+
+int64_t ccVoxelGrid::find(const Tuple3i& pos) const
+{
+	for (unsigned char d = 0; d < 3; ++d)
+	{
+		if (pos.u[d] < 0 || pos.u[d] >= m_dimensions.u[d])
+		{
+			return -1;
+		}
+	}
+
+	uint64_t key = Key(pos);
+	std::vector<uint64_t>::const_iterator it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+	if (it == m_keys.end() || *it != key)
+	{
+		return -1;
+	}
+	return static_cast<int64_t>(it - m_keys.begin());
+}
+
+void ccVoxelGrid::getNeighbors(const Tuple3i& pos, int range, std::vector<size_t>& voxelIndexes) const
+{
+	voxelIndexes.clear();
+
+	int xMin = std::max(0, pos.x - range);
+	int xMax = std::min(m_dimensions.x - 1, pos.x + range);
+	if (xMin > xMax)
+	{
+		return;
+	}
+
+	for (int z = std::max(0, pos.z - range); z <= std::min(m_dimensions.z - 1, pos.z + range); ++z)
+	{
+		for (int y = std::max(0, pos.y - range); y <= std::min(m_dimensions.y - 1, pos.y + range); ++y)
+		{
+			//the voxels of a same row are contiguous (and sorted by X)
+			uint64_t firstKey = Key(Tuple3i(xMin, y, z));
+			uint64_t lastKey = Key(Tuple3i(xMax, y, z));
+			for (std::vector<uint64_t>::const_iterator it = std::lower_bound(m_keys.begin(), m_keys.end(), firstKey); it != m_keys.end() && *it <= lastKey; ++it)
+			{
+				voxelIndexes.push_back(static_cast<size_t>(it - m_keys.begin()));
+			}
+		}
+	}
+}
+
+bool ccVoxelGrid::FindDuplicates(	CCCoreLib::GenericIndexedCloudPersist& cloud,
+									double tolerance,
+									std::vector<unsigned>& rootIndexes,
+									CCCoreLib::GenericProgressCallback* progressCb/*=nullptr*/)
+{
+	unsigned pointCount = cloud.size();
+	if (pointCount == 0 || tolerance < 0)
+	{
+		assert(false);
+		return false;
+	}
+
+	//the voxels can't be smaller than the tolerance (nor too numerous)
+	CCVector3 bbMin;
+	CCVector3 bbMax;
+	cloud.getBoundingBox(bbMin, bbMax);
+	double voxelSize = tolerance;
+	for (unsigned char d = 0; d < 3; ++d)
+	{
+		voxelSize = std::max(voxelSize, static_cast<double>(bbMax.u[d] - bbMin.u[d]) / (MaxDimension - 2));
+	}
+	if (voxelSize <= 0)
+	{
+		//all the points are at the same position
+		voxelSize = 1.0;
+	}
+
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			progressCb->setMethodTitle("Duplicate points");
+			progressCb->setInfo(qPrintable(QString("Points: %1 (tolerance: %2)").arg(pointCount).arg(tolerance)));
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+
+	ccVoxelGrid grid;
+	if (!grid.build(cloud, static_cast<PointCoordinateType>(voxelSize)))
+	{
+		if (progressCb)
+		{
+			progressCb->stop();
+		}
+		return false;
+	}
+	int range = std::max(1, static_cast<int>(std::ceil(tolerance / grid.voxelSize())));
+	double squareTolerance = tolerance * tolerance;
+
+	static const unsigned NoIndex = static_cast<unsigned>(-1);
+
+	std::vector<unsigned> firstClose;
+	std::vector<unsigned> pointVoxel;
+	try
+	{
+		rootIndexes.resize(pointCount);
+		firstClose.resize(pointCount);
+		pointVoxel.resize(pointCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccVoxelGrid] Not enough memory");
+		if (progressCb)
+		{
+			progressCb->stop();
+		}
+		return false;
+	}
+
+	//1st step (in parallel, voxel by voxel): look for the first close point of each point
+	//(i.e. the point with the smallest index among the previous points closer than the tolerance)
+	int _voxelCount = static_cast<int>(grid.voxelCount());
+	CCCoreLib::NormalizedProgress nProgress(progressCb, static_cast<unsigned>(_voxelCount));
+	std::atomic<bool> canceled(false);
+	std::atomic<bool> outOfMemory(false);
+
+#if defined(_OPENMP)
+	#pragma omp parallel num_threads(omp_get_max_threads())
+#endif
+	{
+		std::vector<size_t> neighbors;
+
+#if defined(_OPENMP)
+		#pragma omp for schedule(dynamic, 64)
+#endif
+		for (int v = 0; v < _voxelCount; ++v)
+		{
+			if (canceled || outOfMemory)
+			{
+				continue;
+			}
+
+			try
+			{
+				grid.getNeighbors(grid.voxelPosition(v), range, neighbors);
+			}
+			catch (const std::bad_alloc&)
+			{
+				outOfMemory = true;
+				continue;
+			}
+
+			const Voxel& voxel = grid.voxel(v);
+			for (unsigned k = 0; k < voxel.count; ++k)
+			{
+				unsigned i = grid.pointIndex(voxel, k);
+				const CCVector3* P = cloud.getPointPersistentPtr(i);
+
+				unsigned closeIndex = NoIndex;
+				for (size_t n : neighbors)
+				{
+					//the points of a voxel are sorted by index
+					const Voxel& neighbor = grid.voxel(n);
+					for (unsigned l = 0; l < neighbor.count; ++l)
+					{
+						unsigned j = grid.pointIndex(neighbor, l);
+						if (j >= i || j >= closeIndex)
+						{
+							break;
+						}
+						if ((*cloud.getPointPersistentPtr(j) - *P).norm2d() <= squareTolerance)
+						{
+							//coincident points are found at the first comparison
+							closeIndex = j;
+							break;
+						}
+					}
+				}
+
+				firstClose[i] = closeIndex;
+				pointVoxel[i] = static_cast<unsigned>(v);
+			}
+
+			if (progressCb && !nProgress.oneStep())
+			{
+				canceled = true;
+			}
+		}
+	}
+
+	if (outOfMemory)
+	{
+		ccLog::Warning("[ccVoxelGrid] Not enough memory");
+	}
+	if (outOfMemory || canceled)
+	{
+		if (progressCb)
+		{
+			progressCb->stop();
+		}
+		return false;
+	}
+
+	//2nd step (in index order, so that the result doesn't depend on the number of threads):
+	//a point is merged with the first close point that is not a duplicate itself
+	try
+	{
+		//non duplicate points of each voxel (linked lists)
+		std::vector<unsigned> firstRepresentative(grid.voxelCount(), NoIndex);
+		std::vector<unsigned> nextRepresentative(pointCount, NoIndex);
+		std::vector<size_t> neighbors;
+
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			unsigned rootIndex = i;
+			unsigned closeIndex = firstClose[i];
+			if (closeIndex != NoIndex)
+			{
+				if (rootIndexes[closeIndex] == closeIndex)
+				{
+					//the first close point is not a duplicate: it's also the first close representative
+					rootIndex = closeIndex;
+				}
+				else
+				{
+					//look for the first close representative (rare case: chains of close points)
+					const CCVector3* P = cloud.getPointPersistentPtr(i);
+					grid.getNeighbors(grid.voxelPosition(pointVoxel[i]), range, neighbors);
+					for (size_t n : neighbors)
+					{
+						for (unsigned j = firstRepresentative[n]; j != NoIndex; j = nextRepresentative[j])
+						{
+							//all the representatives have a smaller index than the current point
+							if (j < rootIndex && (*cloud.getPointPersistentPtr(j) - *P).norm2d() <= squareTolerance)
+							{
+								rootIndex = j;
+							}
+						}
+					}
+				}
+			}
+
+			rootIndexes[i] = rootIndex;
+			if (rootIndex == i)
+			{
+				//new representative
+				nextRepresentative[i] = firstRepresentative[pointVoxel[i]];
+				firstRepresentative[pointVoxel[i]] = i;
+			}
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccVoxelGrid] Not enough memory");
+		if (progressCb)
+		{
+			progressCb->stop();
+		}
+		return false;
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	return true;
+}
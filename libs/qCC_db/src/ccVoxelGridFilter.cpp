@@ -0,0 +1,717 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccVoxelGridFilter.h"
+
+//Local
+#include "ccLog.h"
+#include "ccVoxelGrid.h"
+
+//CCCoreLib
+#include <GenericProgressCallback.h>
+#include <ScalarField.h>
+
+//System
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+
+#if defined(_OPENMP)
+//OpenMP
+#include <omp.h>
+#endif
+
+//! Filter context (shared by all the threads)
+struct FilterContext
+{
+	ccPointCloud* cloud = nullptr;
+	ccVoxelGrid grid;
+
+	//! Scalar field read by the filter (current 'output' SF of the cloud)
+	CCCoreLib::ScalarField* sourceSF = nullptr;
+	//! Scalar field written by the filter (current 'input' SF of the cloud)
+	CCCoreLib::ScalarField* targetSF = nullptr;
+	//! Copy of the source scalar values (if they are modified by the filter and read afterwards)
+	std::vector<ScalarType> sfCopy;
+	//! Copy of the colors (if they are modified by the filter and read afterwards)
+	std::vector<ccColor::Rgb> colorsCopy;
+
+	double radius = 0;
+	double sigma2 = 0;
+	double sigmaSF2 = 0;
+	//! Neighborhood range (in voxels)
+	int range = 0;
+
+	bool mean = false;
+	bool median = false;
+	bool bilateral = false;
+	//! Whether the scalar values are used (only the points with a valid scalar value are considered)
+	bool useSF = false;
+	bool filterColors = false;
+	bool filterSF = false;
+
+	ccPointCloud::RgbFilterOptions options;
+	unsigned char burntOutColorThresholdMin = 0;
+	unsigned char burntOutColorThresholdMax = 255;
+
+	inline ScalarType sfValue(unsigned index) const
+	{
+		return sfCopy.empty() ? sourceSF->getValue(index) : sfCopy[index];
+	}
+
+	inline ccColor::Rgb color(unsigned index) const
+	{
+		if (colorsCopy.empty())
+		{
+			const ccColor::Rgba& col = cloud->getPointColor(index);
+			return ccColor::Rgb(col.r, col.g, col.b);
+		}
+		return colorsCopy[index];
+	}
+
+	inline bool isBurntOut(const ccColor::Rgb& col) const
+	{
+		return	(col.r >= burntOutColorThresholdMax && col.g >= burntOutColorThresholdMax && col.b >= burntOutColorThresholdMax)
+			||	(col.r <= burntOutColorThresholdMin && col.g <= burntOutColorThresholdMin && col.b <= burntOutColorThresholdMin);
+	}
+
+	inline bool isGrayscale(const ccColor::Rgb& col) const
+	{
+		double grayscaleMin = (col.r / 3.0) + (col.g / 3.0) + (col.b / 3.0) - options.blendGrayscaleThreshold;
+		double grayscaleMax = grayscaleMin + 2.0 * options.blendGrayscaleThreshold;
+		return	col.r >= grayscaleMin && col.g >= grayscaleMin && col.b >= grayscaleMin
+			&&	col.r <= grayscaleMax && col.g <= grayscaleMax && col.b <= grayscaleMax;
+	}
+
+	//! Returns whether the (boxes of) two voxels are closer than the filter radius
+	inline bool areNeighbors(const Tuple3i& pos1, const Tuple3i& pos2) const
+	{
+		double squareDist = 0;
+		for (unsigned char d = 0; d < 3; ++d)
+		{
+			int delta = std::max(0, std::abs(pos1.u[d] - pos2.u[d]) - 1);
+			squareDist += static_cast<double>(delta) * delta;
+		}
+		double voxelSize = grid.voxelSize();
+		return squareDist * voxelSize * voxelSize <= radius * radius;
+	}
+};
+
+//! Set of points of a voxel (or of a part of a voxel) summarized by their centroid and mean values
+struct Aggregate
+{
+	CCVector3 C;
+	//! Number of points with a valid scalar value (if the scalar values are used)
+	unsigned sfCount = 0;
+	ScalarType sfMean = 0;
+	//! Number of points with a (non burnt out) color
+	unsigned colorCount = 0;
+	float colorMean[3] { 0, 0, 0 };
+	//! Number of points with a grayscale color (if grayscale blending is enabled)
+	unsigned grayscaleCount = 0;
+	float grayscaleMean[3] { 0, 0, 0 };
+};
+
+//! Aggregates a set of points (returns false if no point was retained)
+static bool ComputeAggregate(const FilterContext& context, const unsigned* indexes, size_t count, Aggregate& aggregate)
+{
+	CCVector3d sumP(0, 0, 0);
+	double sumSF = 0;
+	double sumColor[3] { 0, 0, 0 };
+	double sumGrayscale[3] { 0, 0, 0 };
+	unsigned pointCount = 0;
+
+	aggregate = Aggregate();
+	for (size_t i = 0; i < count; ++i)
+	{
+		unsigned index = indexes[i];
+		if (context.useSF)
+		{
+			ScalarType val = context.sfValue(index);
+			if (!CCCoreLib::ScalarField::ValidValue(val))
+			{
+				//the point is ignored
+				continue;
+			}
+			sumSF += val;
+			++aggregate.sfCount;
+		}
+
+		sumP += context.cloud->getPoint(index)->toDouble();
+		++pointCount;
+
+		if (context.filterColors)
+		{
+			ccColor::Rgb col = context.color(index);
+			if (context.isBurntOut(col))
+			{
+				continue;
+			}
+
+			sumColor[0] += col.r;
+			sumColor[1] += col.g;
+			sumColor[2] += col.b;
+			++aggregate.colorCount;
+
+			if (context.options.blendGrayscale && context.isGrayscale(col))
+			{
+				sumGrayscale[0] += col.r;
+				sumGrayscale[1] += col.g;
+				sumGrayscale[2] += col.b;
+				++aggregate.grayscaleCount;
+			}
+		}
+	}
+
+	if (pointCount == 0)
+	{
+		return false;
+	}
+
+	aggregate.C = (sumP / pointCount).toPC();
+	if (aggregate.sfCount)
+	{
+		aggregate.sfMean = static_cast<ScalarType>(sumSF / aggregate.sfCount);
+	}
+	for (unsigned c = 0; c < 3; ++c)
+	{
+		if (aggregate.colorCount)
+			aggregate.colorMean[c] = static_cast<float>(sumColor[c] / aggregate.colorCount);
+		if (aggregate.grayscaleCount)
+			aggregate.grayscaleMean[c] = static_cast<float>(sumGrayscale[c] / aggregate.grayscaleCount);
+	}
+
+	return true;
+}
+
+//! Aggregates the points of a voxel (one aggregate per scalar value bin in bilateral mode)
+static void ComputeVoxelAggregates(	const FilterContext& context,
+									const ccVoxelGrid::Voxel& voxel,
+									double sfBinSize,
+									std::vector<std::pair<int64_t, unsigned>>& binsAndIndexes,
+									std::vector<unsigned>& indexes,
+									std::vector<Aggregate>& aggregates)
+{
+	aggregates.clear();
+	const unsigned* voxelIndexes = context.grid.pointIndexes().data() + voxel.start;
+
+	Aggregate aggregate;
+	if (!context.bilateral)
+	{
+		if (ComputeAggregate(context, voxelIndexes, voxel.count, aggregate))
+		{
+			aggregates.push_back(aggregate);
+		}
+		return;
+	}
+
+	//sort the points by scalar value bin
+	binsAndIndexes.clear();
+	for (unsigned i = 0; i < voxel.count; ++i)
+	{
+		ScalarType val = context.sfValue(voxelIndexes[i]);
+		if (CCCoreLib::ScalarField::ValidValue(val))
+		{
+			binsAndIndexes.emplace_back(static_cast<int64_t>(std::floor(val / sfBinSize)), voxelIndexes[i]);
+		}
+	}
+	std::sort(binsAndIndexes.begin(), binsAndIndexes.end());
+
+	for (size_t i = 0; i < binsAndIndexes.size(); )
+	{
+		indexes.clear();
+		size_t j = i;
+		for (; j < binsAndIndexes.size() && binsAndIndexes[j].first == binsAndIndexes[i].first; ++j)
+		{
+			indexes.push_back(binsAndIndexes[j].second);
+		}
+		if (ComputeAggregate(context, indexes.data(), indexes.size(), aggregate))
+		{
+			aggregates.push_back(aggregate);
+		}
+		i = j;
+	}
+}
+
+//! Mean, Gaussian and bilateral filters (based on the voxel aggregates)
+static bool ApplyAggregatedFilter(const FilterContext& context, CCCoreLib::GenericProgressCallback* progressCb)
+{
+	size_t voxelCount = context.grid.voxelCount();
+	int _voxelCount = static_cast<int>(voxelCount);
+
+	int threadCount = 1;
+#if defined(_OPENMP)
+	threadCount = omp_get_max_threads();
+#endif
+
+	//aggregate the points of each voxel
+	std::vector<Aggregate> aggregates;
+	std::vector<size_t> aggregateStart;
+	try
+	{
+		std::vector<std::vector<Aggregate>> voxelAggregates(voxelCount);
+		std::vector<std::vector<std::pair<int64_t, unsigned>>> binsAndIndexes(threadCount);
+		std::vector<std::vector<unsigned>> indexes(threadCount);
+		double sfBinSize = std::sqrt(context.sigmaSF2 / 2);
+
+#if defined(_OPENMP)
+		#pragma omp parallel for num_threads(threadCount) schedule(dynamic, 256)
+#endif
+		for (int v = 0; v < _voxelCount; ++v)
+		{
+			int threadIndex = 0;
+#if defined(_OPENMP)
+			threadIndex = omp_get_thread_num();
+#endif
+			ComputeVoxelAggregates(context, context.grid.voxel(v), sfBinSize, binsAndIndexes[threadIndex], indexes[threadIndex], voxelAggregates[v]);
+		}
+
+		aggregateStart.resize(voxelCount + 1, 0);
+		for (size_t v = 0; v < voxelCount; ++v)
+		{
+			aggregateStart[v + 1] = aggregateStart[v] + voxelAggregates[v].size();
+		}
+		aggregates.reserve(aggregateStart.back());
+		for (std::vector<Aggregate>& voxelAggregate : voxelAggregates)
+		{
+			aggregates.insert(aggregates.end(), voxelAggregate.begin(), voxelAggregate.end());
+			voxelAggregate = std::vector<Aggregate>();
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccVoxelGridFilter] Not enough memory");
+		return false;
+	}
+
+	//filter the points of each voxel with the aggregates of the neighboring voxels
+	CCCoreLib::NormalizedProgress nProgress(progressCb, static_cast<unsigned>(voxelCount));
+	std::atomic<bool> canceled(false);
+	std::atomic<bool> outOfMemory(false);
+	double squareRadius = context.radius * context.radius;
+	ccColor::Rgba* colors = (context.filterColors ? context.cloud->rgbaColors()->data() : nullptr);
+
+#if defined(_OPENMP)
+	#pragma omp parallel num_threads(threadCount)
+#endif
+	{
+		std::vector<size_t> neighbors;
+		std::vector<const Aggregate*> neighborAggregates;
+
+#if defined(_OPENMP)
+		#pragma omp for schedule(dynamic, 64)
+#endif
+		for (int v = 0; v < _voxelCount; ++v)
+		{
+			if (canceled || outOfMemory)
+			{
+				continue;
+			}
+
+			try
+			{
+				Tuple3i pos = context.grid.voxelPosition(v);
+				context.grid.getNeighbors(pos, context.range, neighbors);
+				neighborAggregates.clear();
+				for (size_t n : neighbors)
+				{
+					if (context.areNeighbors(pos, context.grid.voxelPosition(n)))
+					{
+						for (size_t a = aggregateStart[n]; a < aggregateStart[n + 1]; ++a)
+						{
+							neighborAggregates.push_back(&aggregates[a]);
+						}
+					}
+				}
+			}
+			catch (const std::bad_alloc&)
+			{
+				outOfMemory = true;
+				continue;
+			}
+
+			const ccVoxelGrid::Voxel& voxel = context.grid.voxel(v);
+			for (unsigned i = 0; i < voxel.count; ++i)
+			{
+				unsigned index = context.grid.pointIndex(voxel, i);
+
+				ScalarType queryValue = 0;
+				if (context.bilateral)
+				{
+					queryValue = context.sfValue(index);
+					if (!CCCoreLib::ScalarField::ValidValue(queryValue))
+					{
+						//leave original values
+						continue;
+					}
+				}
+
+				const CCVector3* P = context.cloud->getPoint(index);
+
+				double rgbSum[3] { 0, 0, 0 };
+				double wSum = 0;
+				double rgbGrayscaleSum[3] { 0, 0, 0 };
+				double wGrayscaleSum = 0;
+				double grayscaleCount = 0;
+				double usedCount = 0;
+				double sfSum = 0;
+				double sfWSum = 0;
+
+				for (const Aggregate* aggregate : neighborAggregates)
+				{
+					double squareDist = (aggregate->C - *P).norm2d();
+					if (squareDist > squareRadius)
+					{
+						continue;
+					}
+
+					double weight = context.mean ? 1.0 : exp(-squareDist / context.sigma2);
+					if (context.bilateral)
+					{
+						double dSF = queryValue - aggregate->sfMean;
+						weight *= exp(-(dSF * dSF) / context.sigmaSF2);
+					}
+
+					if (aggregate->sfCount)
+					{
+						sfSum += weight * aggregate->sfCount * aggregate->sfMean;
+						sfWSum += weight * aggregate->sfCount;
+					}
+
+					if (aggregate->colorCount)
+					{
+						double w = weight * aggregate->colorCount;
+						for (unsigned c = 0; c < 3; ++c)
+							rgbSum[c] += w * aggregate->colorMean[c];
+						wSum += w;
+						usedCount += aggregate->colorCount;
+
+						if (aggregate->grayscaleCount)
+						{
+							w = weight * aggregate->grayscaleCount;
+							for (unsigned c = 0; c < 3; ++c)
+								rgbGrayscaleSum[c] += w * aggregate->grayscaleMean[c];
+							wGrayscaleSum += w;
+							grayscaleCount += aggregate->grayscaleCount;
+						}
+					}
+				}
+
+				if (colors && wSum != 0.0)
+				{
+					double avgCol[3];
+					for (unsigned c = 0; c < 3; ++c)
+						avgCol[c] = rgbSum[c] / wSum;
+
+					//blend grayscale modifications (see ccPointCloud::applyFilterToRGB)
+					if (context.options.blendGrayscale)
+					{
+						if (grayscaleCount > context.options.blendGrayscalePercent * usedCount && wGrayscaleSum != 0.0)
+						{
+							for (unsigned c = 0; c < 3; ++c)
+								avgCol[c] = rgbGrayscaleSum[c] / wGrayscaleSum;
+						}
+						else if (wSum - wGrayscaleSum != 0.0)
+						{
+							for (unsigned c = 0; c < 3; ++c)
+								avgCol[c] = (rgbSum[c] - rgbGrayscaleSum[c]) / (wSum - wGrayscaleSum);
+						}
+					}
+
+					colors[index] = ccColor::Rgba(	static_cast<ColorCompType>(std::max(std::min(255.0, avgCol[0]), 0.0)),
+													static_cast<ColorCompType>(std::max(std::min(255.0, avgCol[1]), 0.0)),
+													static_cast<ColorCompType>(std::max(std::min(255.0, avgCol[2]), 0.0)),
+													ccColor::MAX);
+				}
+
+				if (context.filterSF && sfWSum != 0.0)
+				{
+					context.targetSF->setValue(index, static_cast<ScalarType>(sfSum / sfWSum));
+				}
+			}
+
+			if (progressCb && !nProgress.oneStep())
+			{
+				canceled = true;
+			}
+		}
+	}
+
+	if (outOfMemory)
+	{
+		ccLog::Warning("[ccVoxelGridFilter] Not enough memory");
+		return false;
+	}
+
+	return !canceled;
+}
+
+//! Median filter (exact, the candidate neighbors being gathered once per voxel)
+static bool ApplyMedianFilter(const FilterContext& context, CCCoreLib::GenericProgressCallback* progressCb)
+{
+	size_t voxelCount = context.grid.voxelCount();
+	int _voxelCount = static_cast<int>(voxelCount);
+
+	int threadCount = 1;
+#if defined(_OPENMP)
+	threadCount = omp_get_max_threads();
+#endif
+
+	CCCoreLib::NormalizedProgress nProgress(progressCb, static_cast<unsigned>(voxelCount));
+	std::atomic<bool> canceled(false);
+	std::atomic<bool> outOfMemory(false);
+	double squareRadius = context.radius * context.radius;
+	ccColor::Rgba* colors = (context.filterColors ? context.cloud->rgbaColors()->data() : nullptr);
+
+#if defined(_OPENMP)
+	#pragma omp parallel num_threads(threadCount)
+#endif
+	{
+		std::vector<size_t> neighbors;
+		std::vector<unsigned> candidates;
+		std::vector<unsigned char> rValues;
+		std::vector<unsigned char> gValues;
+		std::vector<unsigned char> bValues;
+		std::vector<ScalarType> sfValues;
+
+#if defined(_OPENMP)
+		#pragma omp for schedule(dynamic, 16)
+#endif
+		for (int v = 0; v < _voxelCount; ++v)
+		{
+			if (canceled || outOfMemory)
+			{
+				continue;
+			}
+
+			const ccVoxelGrid::Voxel& voxel = context.grid.voxel(v);
+			try
+			{
+				//gather the candidate neighbors of all the points of the voxel
+				Tuple3i pos = context.grid.voxelPosition(v);
+				context.grid.getNeighbors(pos, context.range, neighbors);
+				candidates.clear();
+				for (size_t n : neighbors)
+				{
+					if (context.areNeighbors(pos, context.grid.voxelPosition(n)))
+					{
+						const ccVoxelGrid::Voxel& neighbor = context.grid.voxel(n);
+						const unsigned* neighborIndexes = context.grid.pointIndexes().data() + neighbor.start;
+						candidates.insert(candidates.end(), neighborIndexes, neighborIndexes + neighbor.count);
+					}
+				}
+
+				for (unsigned i = 0; i < voxel.count; ++i)
+				{
+					unsigned index = context.grid.pointIndex(voxel, i);
+					const CCVector3* P = context.cloud->getPoint(index);
+
+					rValues.clear();
+					gValues.clear();
+					bValues.clear();
+					sfValues.clear();
+					for (unsigned candidate : candidates)
+					{
+						if ((*context.cloud->getPoint(candidate) - *P).norm2d() > squareRadius)
+						{
+							continue;
+						}
+
+						if (context.filterColors)
+						{
+							ccColor::Rgb col = context.color(candidate);
+							if (context.isBurntOut(col))
+							{
+								continue;
+							}
+							rValues.push_back(col.r);
+							gValues.push_back(col.g);
+							bValues.push_back(col.b);
+						}
+
+						if (context.filterSF)
+						{
+							ScalarType val = context.sfValue(candidate);
+							if (CCCoreLib::ScalarField::ValidValue(val))
+							{
+								sfValues.push_back(val);
+							}
+						}
+					}
+
+					if (colors && !rValues.empty())
+					{
+						std::vector<unsigned char>::iterator medR = rValues.begin() + rValues.size() / 2;
+						std::nth_element(rValues.begin(), medR, rValues.end());
+						std::vector<unsigned char>::iterator medG = gValues.begin() + gValues.size() / 2;
+						std::nth_element(gValues.begin(), medG, gValues.end());
+						std::vector<unsigned char>::iterator medB = bValues.begin() + bValues.size() / 2;
+						std::nth_element(bValues.begin(), medB, bValues.end());
+
+						colors[index] = ccColor::Rgba(*medR, *medG, *medB, ccColor::MAX);
+					}
+
+					if (!sfValues.empty())
+					{
+						std::vector<ScalarType>::iterator medSF = sfValues.begin() + sfValues.size() / 2;
+						std::nth_element(sfValues.begin(), medSF, sfValues.end());
+						context.targetSF->setValue(index, *medSF);
+					}
+				}
+			}
+			catch (const std::bad_alloc&)
+			{
+				outOfMemory = true;
+				continue;
+			}
+
+			if (progressCb && !nProgress.oneStep())
+			{
+				canceled = true;
+			}
+		}
+	}
+
+	if (outOfMemory)
+	{
+		ccLog::Warning("[ccVoxelGridFilter] Not enough memory");
+		return false;
+	}
+
+	return !canceled;
+}
+
+bool ccVoxelGridFilter::Apply(	ccPointCloud& cloud,
+								PointCoordinateType sigma,
+								PointCoordinateType sigmaSF,
+								const ccPointCloud::RgbFilterOptions& options,
+								bool filterColors,
+								bool filterSF,
+								CCCoreLib::GenericProgressCallback* progressCb/*=nullptr*/)
+{
+	if (cloud.size() == 0 || sigma <= 0 || (!filterColors && !filterSF))
+	{
+		assert(false);
+		return false;
+	}
+
+	FilterContext context;
+	context.cloud = &cloud;
+	context.options = options;
+	context.filterColors = filterColors;
+	context.filterSF = filterSF;
+	context.mean = (options.filterType == ccPointCloud::RGB_FILTER_TYPES::MEAN);
+	context.median = (options.filterType == ccPointCloud::RGB_FILTER_TYPES::MEDIAN);
+	context.bilateral = (sigmaSF > 0) && !context.mean && !context.median;
+	context.useSF = (context.bilateral || filterSF) && !context.median;
+	context.burntOutColorThresholdMin = (filterColors ? options.burntOutColorThreshold : 0);
+	context.burntOutColorThresholdMax = 255 - context.burntOutColorThresholdMin;
+	context.radius = 3.0 * sigma; //3 * sigma > 99.7%
+	context.sigma2 = (2.0 * sigma) * sigma;
+	context.sigmaSF2 = (2.0 * sigmaSF) * sigmaSF;
+
+	if (filterColors && !cloud.hasColors())
+	{
+		ccLog::Warning("[ccVoxelGridFilter] Cloud has no RGB color");
+		return false;
+	}
+
+	if (context.bilateral || filterSF)
+	{
+		context.sourceSF = cloud.getCurrentOutScalarField();
+		context.targetSF = cloud.getCurrentInScalarField();
+		if (!context.sourceSF || (filterSF && !context.targetSF))
+		{
+			ccLog::Warning("[ccVoxelGridFilter] No active scalar field");
+			return false;
+		}
+	}
+
+	//the voxels are smaller for the aggregated filters, so as to limit the approximation
+	PointCoordinateType voxelSize = static_cast<PointCoordinateType>(context.median ? context.radius / 2 : sigma);
+	context.range = static_cast<int>(std::ceil(context.radius / voxelSize));
+
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			progressCb->setMethodTitle(filterColors ? "RGB filter" : "SF filter");
+			progressCb->setInfo("Voxel grid computation");
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+
+	bool success = context.grid.build(cloud, voxelSize);
+
+	//the median filter reads the neighbors values while the filtered values are written
+	if (success && context.median)
+	{
+		try
+		{
+			if (filterColors)
+			{
+				context.colorsCopy.resize(cloud.size());
+				for (unsigned i = 0; i < cloud.size(); ++i)
+				{
+					const ccColor::Rgba& col = cloud.getPointColor(i);
+					context.colorsCopy[i] = ccColor::Rgb(col.r, col.g, col.b);
+				}
+			}
+			if (filterSF && context.sourceSF == context.targetSF)
+			{
+				context.sfCopy.resize(cloud.size());
+				for (unsigned i = 0; i < cloud.size(); ++i)
+				{
+					context.sfCopy[i] = context.sourceSF->getValue(i);
+				}
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			ccLog::Warning("[ccVoxelGridFilter] Not enough memory");
+			success = false;
+		}
+	}
+
+	if (success)
+	{
+		if (progressCb && progressCb->textCanBeEdited())
+		{
+			progressCb->setInfo(qPrintable(QString("Voxels: %1 (size: %2)").arg(context.grid.voxelCount()).arg(voxelSize)));
+		}
+
+		if (context.median)
+			success = ApplyMedianFilter(context, progressCb);
+		else
+			success = ApplyAggregatedFilter(context, progressCb);
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	if (filterColors)
+	{
+		//We must update the VBOs
+		cloud.colorsHaveChanged();
+	}
+
+	return success;
+}
@@ -0,0 +1,440 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccWaveformBlockStorage.h"
+
+//Local
+#include "ccLog.h"
+#include "ccPointCloud.h"
+
+//Qt
+#include <QFile>
+
+//System
+#include <algorithm>
+#include <cassert>
+
+#if defined(_OPENMP)
+//OpenMP
+#include <omp.h>
+#endif
+
+//! Returns the delta encoding stride for a given descriptor (i.e. the size of a sample in bytes)
+static uint8_t GetStride(const WaveformDescriptor& descriptor)
+{
+	switch (descriptor.bitsPerSample)
+	{
+	case 16:
+		return 2;
+	case 24:
+		return 3;
+	case 32:
+		return 4;
+	default:
+		return 1;
+	}
+}
+
+bool ccWaveformBlockStorage::compress(const ccPointCloud& cloud, uint32_t blockSize/*=DefaultBlockSize*/, int compressionLevel/*=-1*/)
+{
+	clear();
+
+	const ccPointCloud::SharedFWFDataContainer& fwfData = cloud.fwfData();
+	if (!fwfData || fwfData->empty())
+	{
+		ccLog::Warning("[ccWaveformBlockStorage] Cloud has no FWF data");
+		return false;
+	}
+	const std::vector<ccWaveform>& waveforms = cloud.waveforms();
+	const ccPointCloud::FWFDescriptorSet& descriptors = cloud.fwfDescriptors();
+
+	try
+	{
+		//sort the waveforms by data offset
+		std::vector<unsigned> order;
+		order.reserve(waveforms.size());
+		for (unsigned i = 0; i < static_cast<unsigned>(waveforms.size()); ++i)
+		{
+			if (waveforms[i].byteCount() != 0)
+			{
+				order.push_back(i);
+			}
+		}
+		std::sort(order.begin(), order.end(), [&waveforms](unsigned a, unsigned b) { return waveforms[a].dataOffset() < waveforms[b].dataOffset(); });
+
+		//cut the blocks between the waveforms (once they are big enough)
+		static const uint64_t MaxBlockSize = static_cast<uint64_t>(std::numeric_limits<int>::max()); //see qCompress
+		Block currentBlock;
+		uint64_t currentEnd = 0; //end of the waveforms of the current block
+		bool strideSet = false;
+		for (unsigned index : order)
+		{
+			const ccWaveform& w = waveforms[index];
+			uint64_t start = w.dataOffset();
+			uint64_t end = std::min<uint64_t>(start + w.byteCount(), fwfData->size());
+
+			if (start >= currentEnd && currentEnd - currentBlock.firstByte >= blockSize)
+			{
+				if (currentEnd - currentBlock.firstByte > MaxBlockSize)
+				{
+					ccLog::Warning("[ccWaveformBlockStorage] Waveforms overlap too much");
+					clear();
+					return false;
+				}
+				currentBlock.byteCount = static_cast<uint32_t>(currentEnd - currentBlock.firstByte);
+				m_blocks.push_back(currentBlock);
+				currentBlock = Block();
+				currentBlock.firstByte = currentEnd;
+				strideSet = false;
+			}
+
+			if (!strideSet && descriptors.contains(w.descriptorID()))
+			{
+				currentBlock.stride = GetStride(descriptors[w.descriptorID()]);
+				strideSet = true;
+			}
+			currentEnd = std::max(currentEnd, end);
+		}
+
+		//last block
+		if (fwfData->size() - currentBlock.firstByte > MaxBlockSize)
+		{
+			ccLog::Warning("[ccWaveformBlockStorage] Waveforms overlap too much");
+			clear();
+			return false;
+		}
+		currentBlock.byteCount = static_cast<uint32_t>(fwfData->size() - currentBlock.firstByte);
+		m_blocks.push_back(currentBlock);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccWaveformBlockStorage] Not enough memory!");
+		clear();
+		return false;
+	}
+
+	//compress the blocks in parallel
+	int blockCount = static_cast<int>(m_blocks.size());
+	std::vector<uint8_t> failed(m_blocks.size(), 0);
+#if defined(_OPENMP)
+	#pragma omp parallel for num_threads(omp_get_max_threads()) schedule(dynamic)
+#endif
+	for (int i = 0; i < blockCount; ++i)
+	{
+		Block& block = m_blocks[i];
+		try
+		{
+			//delta encoding (waveform samples vary slowly)
+			const uint8_t* input = fwfData->data() + block.firstByte;
+			std::vector<uint8_t> encoded(block.byteCount);
+			for (uint32_t j = 0; j < block.byteCount; ++j)
+			{
+				encoded[j] = static_cast<uint8_t>(j >= block.stride ? input[j] - input[j - block.stride] : input[j]);
+			}
+
+			block.data = qCompress(encoded.data(), static_cast<int>(block.byteCount), compressionLevel);
+			if (block.data.isEmpty() && block.byteCount != 0)
+			{
+				failed[i] = 1;
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			failed[i] = 1;
+		}
+	}
+
+	if (std::find(failed.begin(), failed.end(), 1) != failed.end())
+	{
+		ccLog::Warning("[ccWaveformBlockStorage] Failed to compress the FWF data (not enough memory?)");
+		clear();
+		return false;
+	}
+
+	m_size = fwfData->size();
+
+	ccLog::Print(QString("[ccWaveformBlockStorage] Cloud '%1': FWF data compressed --> %2 / %3 bytes (%4 blocks)").arg(cloud.getName()).arg(compressedSize()).arg(m_size).arg(m_blocks.size()));
+
+	return true;
+}
+
+bool ccWaveformBlockStorage::DecompressBlock(const Block& block, uint8_t* output)
+{
+	QByteArray encoded = qUncompress(block.data);
+	if (static_cast<uint32_t>(encoded.size()) != block.byteCount)
+	{
+		//corrupted block (or not enough memory)
+		return false;
+	}
+
+	const uint8_t* input = reinterpret_cast<const uint8_t*>(encoded.constData());
+	for (uint32_t j = 0; j < block.byteCount; ++j)
+	{
+		output[j] = static_cast<uint8_t>(j >= block.stride ? input[j] + output[j - block.stride] : input[j]);
+	}
+
+	return true;
+}
+
+bool ccWaveformBlockStorage::decompress(std::vector<uint8_t>& data) const
+{
+	try
+	{
+		data.resize(m_size);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccWaveformBlockStorage] Not enough memory!");
+		return false;
+	}
+
+	int blockCount = static_cast<int>(m_blocks.size());
+	std::vector<uint8_t> failed(m_blocks.size(), 0);
+#if defined(_OPENMP)
+	#pragma omp parallel for num_threads(omp_get_max_threads()) schedule(dynamic)
+#endif
+	for (int i = 0; i < blockCount; ++i)
+	{
+		const Block& block = m_blocks[i];
+		if (!DecompressBlock(block, data.data() + block.firstByte))
+		{
+			failed[i] = 1;
+		}
+	}
+
+	if (std::find(failed.begin(), failed.end(), 1) != failed.end())
+	{
+		ccLog::Warning("[ccWaveformBlockStorage] Failed to decompress the FWF data");
+		data.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void ccWaveformBlockStorage::clear()
+{
+	m_blocks.clear();
+	m_blocks.shrink_to_fit();
+	m_size = 0;
+}
+
+uint64_t ccWaveformBlockStorage::compressedSize() const
+{
+	uint64_t size = 0;
+	for (const Block& block : m_blocks)
+	{
+		size += static_cast<uint64_t>(block.data.size());
+	}
+	return size;
+}
+
+size_t ccWaveformBlockStorage::findBlock(uint64_t byte) const
+{
+	//first block starting after this byte
+	std::vector<Block>::const_iterator it = std::upper_bound(	m_blocks.begin(),
+																m_blocks.end(),
+																byte,
+																[](uint64_t b, const Block& block) { return b < block.firstByte; });
+	if (it == m_blocks.begin())
+	{
+		return m_blocks.size();
+	}
+
+	size_t blockIndex = static_cast<size_t>(it - m_blocks.begin()) - 1;
+	const Block& block = m_blocks[blockIndex];
+	return (byte < block.firstByte + block.byteCount ? blockIndex : m_blocks.size());
+}
+
+const uint8_t* ccWaveformBlockStorage::blockData(const ccWaveform& w, Cache& cache, uint64_t& blockOffset) const
+{
+	size_t blockIndex = findBlock(w.dataOffset());
+	if (blockIndex >= m_blocks.size())
+	{
+		return nullptr;
+	}
+
+	const Block& block = m_blocks[blockIndex];
+	if (w.dataOffset() + w.byteCount() > block.firstByte + block.byteCount)
+	{
+		//waveforms are never split over several blocks
+		assert(false);
+		return nullptr;
+	}
+
+	if (cache.blockIndex != blockIndex)
+	{
+		try
+		{
+			cache.data.resize(block.byteCount);
+		}
+		catch (const std::bad_alloc&)
+		{
+			cache.blockIndex = std::numeric_limits<size_t>::max();
+			return nullptr;
+		}
+
+		if (!DecompressBlock(block, cache.data.data()))
+		{
+			cache.blockIndex = std::numeric_limits<size_t>::max();
+			return nullptr;
+		}
+		cache.blockIndex = blockIndex;
+	}
+
+	blockOffset = block.firstByte;
+	return cache.data.data();
+}
+
+ccWaveformProxy ccWaveformBlockStorage::waveformProxy(const ccPointCloud& cloud, unsigned index, Cache& cache) const
+{
+	static const ccWaveform invalidW;
+	static const WaveformDescriptor invalidD;
+
+	const std::vector<ccWaveform>& waveforms = cloud.waveforms();
+	if (index < waveforms.size())
+	{
+		const ccWaveform& w = waveforms[index];
+		ccPointCloud::FWFDescriptorSet::const_iterator it = cloud.fwfDescriptors().constFind(w.descriptorID());
+		if (it != cloud.fwfDescriptors().constEnd())
+		{
+			uint64_t blockOffset = 0;
+			const uint8_t* data = blockData(w, cache, blockOffset);
+			return ccWaveformProxy(w, it.value(), data, blockOffset);
+		}
+		else
+		{
+			return ccWaveformProxy(w, invalidD, nullptr);
+		}
+	}
+
+	//if we are here, then something is wrong
+	assert(false);
+	return ccWaveformProxy(invalidW, invalidD, nullptr);
+}
+
+bool ccWaveformBlockStorage::toFile(QFile& out, short dataVersion) const
+{
+	assert(out.isOpen() && (out.openMode() & QIODevice::WriteOnly));
+	if (dataVersion < MinFileVersion)
+	{
+		assert(false);
+		return false;
+	}
+
+	//uncompressed size
+	if (out.write((const char*)&m_size, 8) < 0)
+	{
+		return WriteError();
+	}
+
+	//blocks
+	uint32_t blockCount = static_cast<uint32_t>(m_blocks.size());
+	if (out.write((const char*)&blockCount, 4) < 0)
+	{
+		return WriteError();
+	}
+	for (const Block& block : m_blocks)
+	{
+		uint32_t compressedSize = static_cast<uint32_t>(block.data.size());
+		if (	out.write((const char*)&block.firstByte, 8) < 0
+			||	out.write((const char*)&block.byteCount, 4) < 0
+			||	out.write((const char*)&block.stride, 1) < 0
+			||	out.write((const char*)&compressedSize, 4) < 0
+			||	out.write(block.data.constData(), compressedSize) < 0)
+		{
+			return WriteError();
+		}
+	}
+
+	return true;
+}
+
+bool ccWaveformBlockStorage::fromFile(QFile& in, short dataVersion, int flags, LoadedIDMap& oldToNewIDMap)
+{
+	if (dataVersion < MinFileVersion)
+	{
+		return CorruptError();
+	}
+
+	clear();
+
+	uint64_t size = 0;
+	uint32_t blockCount = 0;
+	if (	in.read((char*)&size, 8) < 0
+		||	in.read((char*)&blockCount, 4) < 0)
+	{
+		return ReadError();
+	}
+
+	try
+	{
+		m_blocks.resize(blockCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return MemoryError();
+	}
+
+	uint64_t expectedFirstByte = 0;
+	for (Block& block : m_blocks)
+	{
+		uint32_t compressedSize = 0;
+		if (	in.read((char*)&block.firstByte, 8) < 0
+			||	in.read((char*)&block.byteCount, 4) < 0
+			||	in.read((char*)&block.stride, 1) < 0
+			||	in.read((char*)&compressedSize, 4) < 0)
+		{
+			clear();
+			return ReadError();
+		}
+
+		//the blocks must be contiguous (see compress)
+		if (	block.firstByte != expectedFirstByte
+			||	block.stride == 0
+			||	compressedSize > static_cast<uint32_t>(std::numeric_limits<int>::max()))
+		{
+			clear();
+			return CorruptError();
+		}
+		expectedFirstByte += block.byteCount;
+
+		try
+		{
+			block.data.resize(static_cast<int>(compressedSize));
+		}
+		catch (const std::bad_alloc&)
+		{
+			clear();
+			return MemoryError();
+		}
+		if (in.read(block.data.data(), compressedSize) != static_cast<qint64>(compressedSize))
+		{
+			clear();
+			return ReadError();
+		}
+	}
+
+	if (expectedFirstByte != size)
+	{
+		clear();
+		return CorruptError();
+	}
+	m_size = size;
+
+	return true;
+}
@@ -23,6 +23,9 @@
 //local
 #include "ccGlobalShiftManager.h"
 
+//Qt
+#include <QStringList>
+
 class QWidget;
 
 //! Typical I/O filter errors
@@ -69,6 +72,7 @@ public:
 			, autoComputeNormals(false)
 			, parentWidget(nullptr)
 			, sessionStart(true)
+			, maxThreadCount(0)
 		{}
 		
 		//! How to handle big coordinates
@@ -87,6 +91,10 @@ public:
 		QWidget* parentWidget;
 		//! Session start (whether the load action is the first of a session)
 		bool sessionStart;
+		//! Scans to load, for multi-scan formats such as E57 (by index, name or GUID - all scans if empty)
+		QStringList scanSelection;
+		//! Maximum number of threads used to load the file, if the filter supports it (0 = auto)
+		int maxThreadCount;
 	};
 	
 	//! Generic saving parameters
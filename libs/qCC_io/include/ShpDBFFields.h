@@ -58,6 +58,18 @@ public:
 	virtual bool save(DBFHandle handle, int fieldIndex) const { return false; } //1D version
 	virtual bool save(DBFHandle handle, int xFieldIndex, int yFieldIndex, int zFieldIndex) const { return false; } //3D version
 
+	//! Returns the number of values (i.e. records) of this field
+	/** Fields that don't reimplement size() and saveValue() are written
+		column by column, with save().
+	**/
+	virtual size_t size() const { return 0; }
+	//! Writes a single value (i.e. record) of the field
+	/** Writing the DBF file row by row is much faster than column by column.
+	**/
+	virtual bool saveValue(DBFHandle handle, int fieldIndex, int recordIndex) const { return false; } //1D version
+	//! Writes a single value (i.e. record) of the 3D field
+	virtual bool saveValue(DBFHandle handle, int xFieldIndex, int yFieldIndex, int zFieldIndex, int recordIndex) const { return false; } //3D version
+
 protected:
 
 	//! Field name
@@ -77,6 +89,8 @@ public:
 	virtual int width() const { return 6; }
 	virtual int decimal() const { return 0; }
 	virtual bool save(DBFHandle handle, int fieldIndex) const;
+	virtual size_t size() const { return values.size(); }
+	virtual bool saveValue(DBFHandle handle, int fieldIndex, int recordIndex) const;
 
 	//! Field values
 	std::vector<int> values;
@@ -95,6 +109,8 @@ public:
 	virtual int width() const { return 8; }
 	virtual int decimal() const { return 8; }
 	virtual bool save(DBFHandle handle, int fieldIndex) const;
+	virtual size_t size() const { return values.size(); }
+	virtual bool saveValue(DBFHandle handle, int fieldIndex, int recordIndex) const;
 
 	//! Field values
 	std::vector<double> values;
@@ -115,6 +131,8 @@ public:
 	virtual int width() const { return 8; }
 	virtual int decimal() const { return 8; }
 	virtual bool save(DBFHandle handle, int xFieldIndex, int yFieldIndex, int zFieldIndex) const;
+	virtual size_t size() const { return values.size(); }
+	virtual bool saveValue(DBFHandle handle, int xFieldIndex, int yFieldIndex, int zFieldIndex, int recordIndex) const;
 
 	//! Field values
 	std::vector<CCVector3d> values;
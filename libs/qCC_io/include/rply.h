@@ -352,6 +352,21 @@ int ply_write_header(p_ply ply);
  * ---------------------------------------------------------------------- */
 int ply_write(p_ply ply, double value);
 
+/* ----------------------------------------------------------------------
+ * Added for CloudCompare: writes several instances of the element being
+ * written at once, from a buffer of pre-encoded records (binary files
+ * only, the element must only have scalar properties and the records
+ * must already be in the file storage byte order)
+ *
+ * ply: handle returned by ply_create
+ * data: pre-encoded records
+ * size: size of the buffer in bytes
+ * ninstances: number of records in the buffer
+ *
+ * Returns 1 if successful, 0 otherwise
+ * ---------------------------------------------------------------------- */
+int ply_write_raw_instances(p_ply ply, const void *data, size_t size, long ninstances);
+
 /* ----------------------------------------------------------------------
  * Closes a PLY file handle. Releases all memory used by handle
  *
@@ -25,6 +25,7 @@
 
 //qCC_db
 #include <cc2DLabel.h>
+#include <ccArrayCodec.h>
 #include <ccCameraSensor.h>
 #include <ccFacet.h>
 #include <ccFlags.h>
@@ -41,6 +42,7 @@
 #include <ccSubMesh.h>
 
 //system
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <unordered_set>
@@ -340,6 +342,11 @@ CC_FILE_ERROR BinFilter::SaveFileV2(QFile& out, ccHObject* object)
 
 	// Current BIN file version
 	short dataVersion = object->minimumFileVersion();
+	if (ccArrayCodec::IsCompressionEnabled())
+	{
+		//compressed arrays require a more recent version
+		dataVersion = std::max(dataVersion, static_cast<short>(ccArrayCodec::MinFileVersion));
+	}
 	{
 		ccLog::Print(QString("[BIN] Output file version: %1.%2 (automatically deduced from selected entities)").arg(dataVersion / 10).arg(dataVersion % 10));
 		uint32_t binVersion_u32 = dataVersion;
@@ -22,10 +22,13 @@
 #include "PlyOpenDlg.h"
 
 //Qt
+#include <QFile>
 #include <QFileInfo>
 #include <QImage>
 #include <QMessageBox>
 #include <QPushButton>
+#include <QtConcurrentMap>
+#include <QtEndian>
 
 //qCC_db
 #include <ccHObjectCaster.h>
@@ -41,6 +44,7 @@
 #include <cassert>
 #include <cstring>
 #include <array>
+#include <atomic>
 #if defined(CC_WINDOWS)
 #include <windows.h>
 #else
@@ -308,12 +312,12 @@ CC_FILE_ERROR PlyFilter::saveToFile(ccHObject* entity, QString filename, e_ply_s
 	}
 
 	//Normals (nx,ny,nz)
+	const e_ply_type normType = (sizeof(PointCoordinateType) > 4 ? PLY_DOUBLE : PLY_FLOAT);
 	bool hasNormals = vertices->hasNormals();
 	if (hasNormals)
 	{
 		//if (ply_add_element(ply, "normal", vertCount))
 		//{
-			e_ply_type normType = (sizeof(PointCoordinateType) > 4 ? PLY_DOUBLE : PLY_FLOAT);
 			result = ply_add_scalar_property(ply, "nx", normType);
 			result = ply_add_scalar_property(ply, "ny", normType);
 			result = ply_add_scalar_property(ply, "nz", normType);
@@ -322,6 +326,7 @@ CC_FILE_ERROR PlyFilter::saveToFile(ccHObject* entity, QString filename, e_ply_s
 	}
 
 	//Scalar fields
+	const e_ply_type scalarType = (sizeof(ScalarType) > 4 ? PLY_DOUBLE : PLY_FLOAT);
 	std::vector<ccScalarField*> scalarFields;
 	if (vertices->isA(CC_TYPES::POINT_CLOUD))
 	{
@@ -335,8 +340,6 @@ CC_FILE_ERROR PlyFilter::saveToFile(ccHObject* entity, QString filename, e_ply_s
 		unsigned sfCount = ccCloud->getNumberOfScalarFields();
 		if (sfCount)
 		{
-			e_ply_type scalarType = (sizeof(ScalarType) > 4 ? PLY_DOUBLE : PLY_FLOAT);
-
 			scalarFields.resize(sfCount);
 			unsigned unnamedSFCount = 0;
 			for (unsigned i = 0; i < sfCount; ++i)
@@ -440,39 +443,53 @@ CC_FILE_ERROR PlyFilter::saveToFile(ccHObject* entity, QString filename, e_ply_s
 	}
 
 	//save the point cloud (=vertices)
-	for (unsigned i = 0; i < vertCount; ++i)
+	e_ply_storage_mode actualStorageMode = PLY_ASCII;
+	get_plystorage_mode(ply, &actualStorageMode);
+	if (actualStorageMode != PLY_ASCII)
 	{
-		const CCVector3* P = vertices->getPoint(i);
-		CCVector3d Pglobal = vertices->toGlobal3d<PointCoordinateType>(*P);
-		ply_write(ply, Pglobal.x);
-		ply_write(ply, Pglobal.y);
-		ply_write(ply, Pglobal.z);
-
-		if (hasColors)
+		//binary files: the vertex records are encoded in parallel and written by blocks
+		if (!WritePlyBinaryVertices(ply, actualStorageMode, vertices, coordType, hasColors, hasNormals, normType, scalarFields, scalarType))
 		{
-			const ccColor::Rgb& col = vertices->getPointColor(i);
-			ply_write(ply, static_cast<double>(col.r));
-			ply_write(ply, static_cast<double>(col.g));
-			ply_write(ply, static_cast<double>(col.b));
+			ply_close(ply);
+			return CC_FERR_WRITING;
 		}
-		else if (hasUniqueColor)
+	}
+	else
+	{
+		for (unsigned i = 0; i < vertCount; ++i)
 		{
-			ply_write(ply, static_cast<double>(uniqueColor[0]));
-			ply_write(ply, static_cast<double>(uniqueColor[1]));
-			ply_write(ply, static_cast<double>(uniqueColor[2]));
-		}
+			const CCVector3* P = vertices->getPoint(i);
+			CCVector3d Pglobal = vertices->toGlobal3d<PointCoordinateType>(*P);
+			ply_write(ply, Pglobal.x);
+			ply_write(ply, Pglobal.y);
+			ply_write(ply, Pglobal.z);
 
-		if (hasNormals)
-		{
-			const CCVector3& N = vertices->getPointNormal(i);
-			ply_write(ply, static_cast<double>(N.x));
-			ply_write(ply, static_cast<double>(N.y));
-			ply_write(ply, static_cast<double>(N.z));
-		}
+			if (hasColors)
+			{
+				const ccColor::Rgb& col = vertices->getPointColor(i);
+				ply_write(ply, static_cast<double>(col.r));
+				ply_write(ply, static_cast<double>(col.g));
+				ply_write(ply, static_cast<double>(col.b));
+			}
+			else if (hasUniqueColor)
+			{
+				ply_write(ply, static_cast<double>(uniqueColor[0]));
+				ply_write(ply, static_cast<double>(uniqueColor[1]));
+				ply_write(ply, static_cast<double>(uniqueColor[2]));
+			}
 
-		for (std::vector<ccScalarField*>::const_iterator sf = scalarFields.begin(); sf != scalarFields.end(); ++sf)
-		{
-			ply_write(ply, (*sf)->getGlobalShift() + (*sf)->getValue(i));
+			if (hasNormals)
+			{
+				const CCVector3& N = vertices->getPointNormal(i);
+				ply_write(ply, static_cast<double>(N.x));
+				ply_write(ply, static_cast<double>(N.y));
+				ply_write(ply, static_cast<double>(N.z));
+			}
+
+			for (std::vector<ccScalarField*>::const_iterator sf = scalarFields.begin(); sf != scalarFields.end(); ++sf)
+			{
+				ply_write(ply, (*sf)->getGlobalShift() + (*sf)->getValue(i));
+			}
 		}
 	}
 
@@ -920,6 +937,511 @@ static int texIndexes_cb(p_ply_argument argument)
 	return 1;
 }
 
+/*********************************************/
+/***  Binary fast path (fixed-size records) ***/
+/*********************************************/
+
+//! Returns the size of a scalar PLY type (in bytes) or 0 for list types
+static size_t PlyScalarTypeSize(e_ply_type type)
+{
+	switch (type)
+	{
+	case PLY_INT8:
+	case PLY_UINT8:
+	case PLY_CHAR:
+	case PLY_UCHAR:
+		return 1;
+	case PLY_INT16:
+	case PLY_UINT16:
+	case PLY_SHORT:
+	case PLY_USHORT:
+		return 2;
+	case PLY_INT32:
+	case PLY_UIN32:
+	case PLY_INT:
+	case PLY_UINT:
+	case PLY_FLOAT32:
+	case PLY_FLOAT:
+		return 4;
+	case PLY_FLOAT64:
+	case PLY_DOUBLE:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+template <typename T> static inline T LoadBinaryValue(const uchar* ptr, bool swapBytes)
+{
+	T value;
+	memcpy(&value, ptr, sizeof(T));
+	return swapBytes ? qbswap(value) : value;
+}
+
+template <typename T> static inline void StoreBinaryValue(uchar* ptr, T value, bool swapBytes)
+{
+	if (swapBytes)
+	{
+		value = qbswap(value);
+	}
+	memcpy(ptr, &value, sizeof(T));
+}
+
+//! Reads a scalar value from a binary record
+static inline double ReadBinaryValue(const uchar* ptr, e_ply_type type, bool swapBytes)
+{
+	switch (type)
+	{
+	case PLY_INT8:
+	case PLY_CHAR:
+		return static_cast<double>(*reinterpret_cast<const qint8*>(ptr));
+	case PLY_UINT8:
+	case PLY_UCHAR:
+		return static_cast<double>(*ptr);
+	case PLY_INT16:
+	case PLY_SHORT:
+		return static_cast<double>(static_cast<qint16>(LoadBinaryValue<quint16>(ptr, swapBytes)));
+	case PLY_UINT16:
+	case PLY_USHORT:
+		return static_cast<double>(LoadBinaryValue<quint16>(ptr, swapBytes));
+	case PLY_INT32:
+	case PLY_INT:
+		return static_cast<double>(static_cast<qint32>(LoadBinaryValue<quint32>(ptr, swapBytes)));
+	case PLY_UIN32:
+	case PLY_UINT:
+		return static_cast<double>(LoadBinaryValue<quint32>(ptr, swapBytes));
+	case PLY_FLOAT32:
+	case PLY_FLOAT:
+	{
+		quint32 bits = LoadBinaryValue<quint32>(ptr, swapBytes);
+		float value;
+		memcpy(&value, &bits, sizeof(float));
+		return static_cast<double>(value);
+	}
+	case PLY_FLOAT64:
+	case PLY_DOUBLE:
+	{
+		quint64 bits = LoadBinaryValue<quint64>(ptr, swapBytes);
+		double value;
+		memcpy(&value, &bits, sizeof(double));
+		return value;
+	}
+	default:
+		assert(false);
+		return 0.0;
+	}
+}
+
+//! Layout of a binary PLY element with fixed-size records
+struct PlyBinaryLayout
+{
+	//! Offset of the element data in the file
+	qint64 dataOffset = 0;
+	//! Size of a record (in bytes)
+	size_t recordSize = 0;
+	//! Whether the file byte order differs from the host byte order
+	bool swapBytes = false;
+	//! Offset of each property in a record
+	std::vector<size_t> offsets;
+	//! Type of each property
+	std::vector<e_ply_type> types;
+};
+
+//! Column of a binary PLY element (to read or write)
+struct PlyBinaryColumn
+{
+	size_t offset = 0;
+	e_ply_type type = PLY_FLOAT;
+};
+
+//! Returns the file offset right after the header
+static qint64 GetPlyHeaderSize(const QString& filename)
+{
+	QFile file(filename);
+	if (!file.open(QFile::ReadOnly))
+	{
+		return -1;
+	}
+
+	static const int MaxHeaderLineCount = 100000;
+	for (int i = 0; i < MaxHeaderLineCount && !file.atEnd(); ++i)
+	{
+		QByteArray line = file.readLine();
+		if (line.trimmed() == "end_header")
+		{
+			return file.pos();
+		}
+	}
+
+	return -1;
+}
+
+//! Checks whether an element can be read with the binary fast path and returns its layout
+/** The element must be the first one in the file, and must only have scalar properties.
+**/
+static bool GetPlyBinaryLayout(const QString& filename, e_ply_storage_mode storageMode, const plyElement& element, PlyBinaryLayout& layout)
+{
+	if (storageMode != PLY_LITTLE_ENDIAN && storageMode != PLY_BIG_ENDIAN)
+	{
+		return false;
+	}
+	const e_ply_storage_mode hostMode = (QSysInfo::ByteOrder == QSysInfo::LittleEndian ? PLY_LITTLE_ENDIAN : PLY_BIG_ENDIAN);
+	layout.swapBytes = (storageMode != hostMode);
+
+	layout.offsets.clear();
+	layout.types.clear();
+	layout.recordSize = 0;
+	for (const plyProperty& prop : element.properties)
+	{
+		size_t size = PlyScalarTypeSize(prop.type);
+		if (size == 0)
+		{
+			//variable-size record
+			return false;
+		}
+		layout.offsets.push_back(layout.recordSize);
+		layout.types.push_back(prop.type);
+		layout.recordSize += size;
+	}
+
+	layout.dataOffset = GetPlyHeaderSize(filename);
+	return layout.recordSize != 0 && layout.dataOffset > 0;
+}
+
+//! Returns the column corresponding to a given property
+static bool GetPlyBinaryColumn(const plyElement& element, const PlyBinaryLayout& layout, p_ply_property prop, PlyBinaryColumn& column)
+{
+	for (size_t i = 0; i < element.properties.size(); ++i)
+	{
+		if (element.properties[i].prop == prop)
+		{
+			column.offset = layout.offsets[i];
+			column.type = layout.types[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+//! Columns of the (binary) vertex element
+struct PlyVertexColumns
+{
+	std::array<PlyBinaryColumn, 3> point;
+	std::array<bool, 3> hasPoint { false, false, false };
+	std::array<PlyBinaryColumn, 3> normal;
+	std::array<bool, 3> hasNormal { false, false, false };
+	std::array<PlyBinaryColumn, 3> color;
+	std::array<bool, 3> hasColor { false, false, false };
+	std::vector<PlyBinaryColumn> scalar;
+	std::vector<CCCoreLib::ScalarField*> scalarFields;
+};
+
+//! Loads the vertices of a binary PLY file with fixed-size records
+/** The vertex block is memory-mapped and the records are converted in parallel.
+	The cloud (and its features) must have been reserved beforehand.
+**/
+static CC_FILE_ERROR LoadPlyBinaryVertices(	const QString& filename,
+											const PlyBinaryLayout& layout,
+											const PlyVertexColumns& columns,
+											unsigned numberOfPoints,
+											ccPointCloud* cloud)
+{
+	QFile file(filename);
+	if (!file.open(QFile::ReadOnly))
+	{
+		return CC_FERR_READING;
+	}
+
+	const qint64 blockSize = static_cast<qint64>(layout.recordSize) * numberOfPoints;
+	if (file.size() < layout.dataOffset + blockSize)
+	{
+		ccLog::Warning("[PLY] File is truncated!");
+		return CC_FERR_MALFORMED_FILE;
+	}
+
+	const uchar* data = file.map(layout.dataOffset, blockSize);
+	if (!data)
+	{
+		return CC_FERR_READING;
+	}
+
+	bool hasNormals = (columns.hasNormal[0] || columns.hasNormal[1] || columns.hasNormal[2]);
+	bool hasColors = (columns.hasColor[0] || columns.hasColor[1] || columns.hasColor[2]);
+
+	//pre-size the destination arrays
+	if (	!cloud->resize(numberOfPoints)
+		||	(hasNormals && !cloud->resizeTheNormsTable())
+		||	(hasColors && !cloud->resizeTheRGBTable(false)))
+	{
+		file.unmap(const_cast<uchar*>(data));
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+	}
+	for (CCCoreLib::ScalarField* sf : columns.scalarFields)
+	{
+		if (!sf->resizeSafe(numberOfPoints))
+		{
+			file.unmap(const_cast<uchar*>(data));
+			return CC_FERR_NOT_ENOUGH_MEMORY;
+		}
+	}
+
+	auto readPoint = [&](const uchar* record, bool& corrupted) -> CCVector3d
+	{
+		CCVector3d P(0, 0, 0);
+		for (unsigned d = 0; d < 3; ++d)
+		{
+			if (columns.hasPoint[d])
+			{
+				double val = ReadBinaryValue(record + columns.point[d].offset, columns.point[d].type, layout.swapBytes);
+				// This looks like it should always be true, 
+				// but it's false if x is NaN.
+				if (val == val)
+				{
+					P.u[d] = val;
+				}
+				else
+				{
+					corrupted = true;
+				}
+			}
+		}
+		return P;
+	};
+
+	//first point: check for 'big' coordinates
+	{
+		bool corrupted = false;
+		CCVector3d P0 = readPoint(data, corrupted);
+		bool preserveCoordinateShift = true;
+		if (FileIOFilter::HandleGlobalShift(P0, s_Pshift, preserveCoordinateShift, s_loadParameters))
+		{
+			if (preserveCoordinateShift)
+			{
+				cloud->setGlobalShift(s_Pshift);
+			}
+			ccLog::Warning("[PLYFilter::loadFile] Cloud (vertices) has been recentered! Translation: (%.2f ; %.2f ; %.2f)", s_Pshift.x, s_Pshift.y, s_Pshift.z);
+		}
+	}
+
+	//split the records in blocks, converted in parallel
+	static const unsigned BlockRecordCount = (1 << 16);
+	std::vector<unsigned> blockStarts;
+	try
+	{
+		blockStarts.reserve(numberOfPoints / BlockRecordCount + 1);
+		for (unsigned start = 0; start < numberOfPoints; start += BlockRecordCount)
+		{
+			blockStarts.push_back(start);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		file.unmap(const_cast<uchar*>(data));
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+	}
+
+	std::atomic<bool> pointDataCorrupted(false);
+	const CCVector3d Pshift = s_Pshift;
+	NormsIndexesTableType* normals = cloud->normals();
+	RGBAColorsTableType* colors = cloud->rgbaColors();
+
+	auto convertBlock = [&](unsigned start)
+	{
+		unsigned stop = std::min(start + BlockRecordCount, numberOfPoints);
+		bool corrupted = false;
+		ccColor::Rgba col(0, 0, 0, ccColor::MAX);
+
+		for (unsigned i = start; i < stop; ++i)
+		{
+			const uchar* record = data + static_cast<size_t>(i) * layout.recordSize;
+
+			*const_cast<CCVector3*>(cloud->getPoint(i)) = (readPoint(record, corrupted) + Pshift).toPC();
+
+			if (hasNormals)
+			{
+				CCVector3 N(0, 0, 0);
+				for (unsigned d = 0; d < 3; ++d)
+				{
+					if (columns.hasNormal[d])
+					{
+						N.u[d] = static_cast<PointCoordinateType>(ReadBinaryValue(record + columns.normal[d].offset, columns.normal[d].type, layout.swapBytes));
+					}
+				}
+				normals->setValue(i, ccNormalVectors::GetNormIndex(N));
+			}
+
+			if (hasColors)
+			{
+				for (unsigned c = 0; c < 3; ++c)
+				{
+					if (columns.hasColor[c])
+					{
+						double val = ReadBinaryValue(record + columns.color[c].offset, columns.color[c].type, layout.swapBytes);
+						if (IsFloat(columns.color[c].type))
+						{
+							col.rgba[c] = static_cast<ColorCompType>(std::min(std::max(0.0, val), 1.0) * ccColor::MAX);
+						}
+						else
+						{
+							col.rgba[c] = static_cast<ColorCompType>(val);
+						}
+					}
+				}
+				colors->setValue(i, col);
+			}
+
+			for (size_t s = 0; s < columns.scalar.size(); ++s)
+			{
+				double val = ReadBinaryValue(record + columns.scalar[s].offset, columns.scalar[s].type, layout.swapBytes);
+				columns.scalarFields[s]->setValue(i, static_cast<ScalarType>(val));
+			}
+		}
+
+		if (corrupted)
+		{
+			pointDataCorrupted = true;
+		}
+	};
+
+	QtConcurrent::blockingMap(blockStarts, convertBlock);
+
+	file.unmap(const_cast<uchar*>(data));
+
+	cloud->invalidateBoundingBox();
+	s_PointCount = static_cast<int>(numberOfPoints);
+
+	if (pointDataCorrupted)
+	{
+		ccLog::Warning("[PLY] Some vertex coordinates were invalid (NaN) and have been replaced by 0");
+	}
+
+	return CC_FERR_NO_ERROR;
+}
+
+//! Writes the vertices of a cloud as pre-encoded binary records
+/** The records are encoded in parallel, block by block, then written in one go per block.
+	The properties must match the header (x, y, z, [red, green, blue], [nx, ny, nz], [scalars]).
+**/
+static bool WritePlyBinaryVertices(	p_ply ply,
+									e_ply_storage_mode storageMode,
+									ccGenericPointCloud* vertices,
+									e_ply_type coordType,
+									bool hasColors,
+									bool hasNormals,
+									e_ply_type normType,
+									const std::vector<ccScalarField*>& scalarFields,
+									e_ply_type scalarType)
+{
+	const e_ply_storage_mode hostMode = (QSysInfo::ByteOrder == QSysInfo::LittleEndian ? PLY_LITTLE_ENDIAN : PLY_BIG_ENDIAN);
+	const bool swapBytes = (storageMode != hostMode);
+
+	const size_t coordSize = PlyScalarTypeSize(coordType);
+	const size_t normSize = PlyScalarTypeSize(normType);
+	const size_t scalarSize = PlyScalarTypeSize(scalarType);
+	const size_t recordSize = 3 * coordSize
+							+ (hasColors ? 3 : 0)
+							+ (hasNormals ? 3 * normSize : 0)
+							+ scalarFields.size() * scalarSize;
+
+	auto storeReal = [swapBytes](uchar* ptr, double value, e_ply_type type) -> uchar*
+	{
+		if (type == PLY_DOUBLE || type == PLY_FLOAT64)
+		{
+			quint64 bits;
+			memcpy(&bits, &value, sizeof(double));
+			StoreBinaryValue(ptr, bits, swapBytes);
+			return ptr + 8;
+		}
+		else
+		{
+			float fValue = static_cast<float>(value);
+			quint32 bits;
+			memcpy(&bits, &fValue, sizeof(float));
+			StoreBinaryValue(ptr, bits, swapBytes);
+			return ptr + 4;
+		}
+	};
+
+	const unsigned vertCount = vertices->size();
+	static const unsigned BlockRecordCount = (1 << 16);
+	static const unsigned BlocksPerBatch = 16;
+
+	std::vector<QByteArray> buffers;
+	std::vector<unsigned> blockIndexes;
+	try
+	{
+		buffers.resize(BlocksPerBatch);
+		blockIndexes.reserve(BlocksPerBatch);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	for (unsigned batchStart = 0; batchStart < vertCount; batchStart += BlockRecordCount * BlocksPerBatch)
+	{
+		//encode a batch of blocks in parallel
+		blockIndexes.clear();
+		for (unsigned b = 0; b < BlocksPerBatch && batchStart + b * BlockRecordCount < vertCount; ++b)
+		{
+			blockIndexes.push_back(b);
+		}
+
+		auto encodeBlock = [&](unsigned b)
+		{
+			unsigned start = batchStart + b * BlockRecordCount;
+			unsigned stop = std::min(start + BlockRecordCount, vertCount);
+			QByteArray& buffer = buffers[b];
+			buffer.resize(static_cast<int>((stop - start) * recordSize));
+			uchar* ptr = reinterpret_cast<uchar*>(buffer.data());
+
+			for (unsigned i = start; i < stop; ++i)
+			{
+				const CCVector3* P = vertices->getPoint(i);
+				CCVector3d Pglobal = vertices->toGlobal3d<PointCoordinateType>(*P);
+				ptr = storeReal(ptr, Pglobal.x, coordType);
+				ptr = storeReal(ptr, Pglobal.y, coordType);
+				ptr = storeReal(ptr, Pglobal.z, coordType);
+
+				if (hasColors)
+				{
+					const ccColor::Rgb& col = vertices->getPointColor(i);
+					*ptr++ = col.r;
+					*ptr++ = col.g;
+					*ptr++ = col.b;
+				}
+
+				if (hasNormals)
+				{
+					const CCVector3& N = vertices->getPointNormal(i);
+					ptr = storeReal(ptr, N.x, normType);
+					ptr = storeReal(ptr, N.y, normType);
+					ptr = storeReal(ptr, N.z, normType);
+				}
+
+				for (ccScalarField* sf : scalarFields)
+				{
+					ptr = storeReal(ptr, sf->getGlobalShift() + sf->getValue(i), scalarType);
+				}
+			}
+		};
+
+		QtConcurrent::blockingMap(blockIndexes, encodeBlock);
+
+		//then write them sequentially
+		for (unsigned b : blockIndexes)
+		{
+			const QByteArray& buffer = buffers[b];
+			if (!ply_write_raw_instances(ply, buffer.constData(), static_cast<size_t>(buffer.size()), static_cast<long>(buffer.size() / recordSize)))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
 CC_FILE_ERROR PlyFilter::loadFile(const QString& filename, ccHObject& container, LoadParameters& parameters)
 {
 	return loadFile(filename, QString(), container, parameters);
@@ -1629,6 +2151,7 @@ CC_FILE_ERROR PlyFilter::loadFile(const QString& filename, const QString& inputT
 	}
 
 	/* SCALAR FIELDS (SF) */
+	std::vector< std::pair<int, CCCoreLib::ScalarField*> > loadedScalarFields; //property index + scalar field
 	{
 		for (size_t i = 0; i < sfPropIndexes.size(); ++i)
 		{
@@ -1660,6 +2183,7 @@ CC_FILE_ERROR PlyFilter::loadFile(const QString& filename, const QString& inputT
 					if (sf->resizeSafe(numberOfScalars))
 					{
 						ply_set_read_cb(ply, pointElements[pp.elemIndex].elementName, pp.propName, scalar_cb, sf, 1);
+						loadedScalarFields.emplace_back(sfIndex, sf);
 					}
 					else
 					{
@@ -1754,6 +2278,68 @@ CC_FILE_ERROR PlyFilter::loadFile(const QString& filename, const QString& inputT
 		}
 	}
 
+	/* BINARY FAST PATH */
+
+	//binary point clouds with fixed-size vertex records can be read directly (without rply callbacks)
+	bool useBinaryFastPath = false;
+	PlyBinaryLayout binaryLayout;
+	PlyVertexColumns binaryColumns;
+	if (!mesh && !texCoords && !texIndexes && iIndex == 0 && storage_mode != PLY_ASCII)
+	{
+		int vertexElementIndex = stdProperties[std::max(xIndex, std::max(yIndex, zIndex)) - 1].elemIndex;
+		const plyElement& vertexElement = pointElements[vertexElementIndex];
+
+		//all the loaded properties must belong to the vertex element
+		useBinaryFastPath = (vertexElement.elem == ply_get_next_element(ply, nullptr)); //the first element of the file
+		for (int propIndex : { xIndex, yIndex, zIndex, nxIndex, nyIndex, nzIndex, rIndex, gIndex, bIndex })
+		{
+			if (propIndex > 0 && stdProperties[propIndex - 1].elemIndex != vertexElementIndex)
+			{
+				useBinaryFastPath = false;
+			}
+		}
+		for (const auto& loadedSF : loadedScalarFields)
+		{
+			if (stdProperties[loadedSF.first - 1].elemIndex != vertexElementIndex)
+			{
+				useBinaryFastPath = false;
+			}
+		}
+
+		if (useBinaryFastPath && GetPlyBinaryLayout(filename, storage_mode, vertexElement, binaryLayout))
+		{
+			const int pointIndexes[3] { xIndex, yIndex, zIndex };
+			const int normalIndexes[3] { nxIndex, nyIndex, nzIndex };
+			const int colorIndexes[3] { rIndex, gIndex, bIndex };
+			for (unsigned d = 0; d < 3; ++d)
+			{
+				if (pointIndexes[d] > 0)
+					binaryColumns.hasPoint[d] = GetPlyBinaryColumn(vertexElement, binaryLayout, stdProperties[pointIndexes[d] - 1].prop, binaryColumns.point[d]);
+				if (normalIndexes[d] > 0)
+					binaryColumns.hasNormal[d] = GetPlyBinaryColumn(vertexElement, binaryLayout, stdProperties[normalIndexes[d] - 1].prop, binaryColumns.normal[d]);
+				if (colorIndexes[d] > 0)
+					binaryColumns.hasColor[d] = GetPlyBinaryColumn(vertexElement, binaryLayout, stdProperties[colorIndexes[d] - 1].prop, binaryColumns.color[d]);
+			}
+			for (const auto& loadedSF : loadedScalarFields)
+			{
+				PlyBinaryColumn column;
+				if (GetPlyBinaryColumn(vertexElement, binaryLayout, stdProperties[loadedSF.first - 1].prop, column))
+				{
+					binaryColumns.scalar.push_back(column);
+					binaryColumns.scalarFields.push_back(loadedSF.second);
+				}
+				else
+				{
+					useBinaryFastPath = false;
+				}
+			}
+		}
+		else
+		{
+			useBinaryFastPath = false;
+		}
+	}
+
 	QScopedPointer<ccProgressDialog> pDlg(nullptr);
 	if (parameters.parentWidget)
 	{
@@ -1765,18 +2351,33 @@ CC_FILE_ERROR PlyFilter::loadFile(const QString& filename, const QString& inputT
 		QApplication::processEvents();
 	}
 
-	//let 'Rply' do the job;)
 	int success = 0;
-	try
+	if (useBinaryFastPath)
 	{
-		success = ply_read(ply);
+		ply_close(ply);
+
+		CC_FILE_ERROR error = LoadPlyBinaryVertices(filename, binaryLayout, binaryColumns, numberOfPoints, cloud);
+		if (error != CC_FERR_NO_ERROR)
+		{
+			delete cloud;
+			return error;
+		}
+		success = 1;
 	}
-	catch (...)
+	else
 	{
-		success = -1;
-	}
+		//let 'Rply' do the job;)
+		try
+		{
+			success = ply_read(ply);
+		}
+		catch (...)
+		{
+			success = -1;
+		}
 
-	ply_close(ply);
+		ply_close(ply);
+	}
 
 	if (pDlg)
 	{
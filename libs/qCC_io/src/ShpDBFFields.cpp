@@ -36,6 +36,22 @@ bool IntegerDBFField::save(DBFHandle handle, int fieldIndex) const
 	return true;
 }
 
+bool IntegerDBFField::saveValue(DBFHandle handle, int fieldIndex, int recordIndex) const
+{
+	if (!handle || fieldIndex < 0 || recordIndex < 0)
+	{
+		assert(false);
+		return false;
+	}
+
+	if (static_cast<size_t>(recordIndex) >= values.size())
+		return true; //nothing to write
+
+	DBFWriteIntegerAttribute(handle, recordIndex, fieldIndex, values[recordIndex]);
+
+	return true;
+}
+
 bool DoubleDBFField::save(DBFHandle handle, int fieldIndex) const
 {
 	if (!handle || fieldIndex < 0)
@@ -50,6 +66,22 @@ bool DoubleDBFField::save(DBFHandle handle, int fieldIndex) const
 	return true;
 }
 
+bool DoubleDBFField::saveValue(DBFHandle handle, int fieldIndex, int recordIndex) const
+{
+	if (!handle || fieldIndex < 0 || recordIndex < 0)
+	{
+		assert(false);
+		return false;
+	}
+
+	if (static_cast<size_t>(recordIndex) >= values.size())
+		return true; //nothing to write
+
+	DBFWriteDoubleAttribute(handle, recordIndex, fieldIndex, values[recordIndex]);
+
+	return true;
+}
+
 bool DoubleDBFField3D::save(DBFHandle handle, int xFieldIndex, int yFieldIndex, int zFieldIndex) const
 {
 	if (!handle || xFieldIndex < 0 || yFieldIndex < 0 || zFieldIndex < 0)
@@ -68,4 +100,23 @@ bool DoubleDBFField3D::save(DBFHandle handle, int xFieldIndex, int yFieldIndex,
 	return true;
 }
 
+bool DoubleDBFField3D::saveValue(DBFHandle handle, int xFieldIndex, int yFieldIndex, int zFieldIndex, int recordIndex) const
+{
+	if (!handle || xFieldIndex < 0 || yFieldIndex < 0 || zFieldIndex < 0 || recordIndex < 0)
+	{
+		assert(false);
+		return false;
+	}
+
+	if (static_cast<size_t>(recordIndex) >= values.size())
+		return true; //nothing to write
+
+	const CCVector3d& V = values[recordIndex];
+	DBFWriteDoubleAttribute(handle, recordIndex, xFieldIndex, V.x);
+	DBFWriteDoubleAttribute(handle, recordIndex, yFieldIndex, V.y);
+	DBFWriteDoubleAttribute(handle, recordIndex, zFieldIndex, V.z);
+
+	return true;
+}
+
 #endif //CC_SHP_SUPPORT
@@ -36,12 +36,17 @@
 
 //Qt
 #include <QFileInfo>
+#include <QtConcurrentMap>
+#include <QtEndian>
 
 //CCCoreLib
 #include <MeshSamplingTools.h>
 
 //System
+#include <algorithm>
 #include <array>
+#include <cstring>
+#include <limits>
 
 using FieldIndexAndName = QPair<int, QString>;
 
@@ -50,7 +55,6 @@ static const double ESRI_NO_DATA = -1.0e38;
 
 static const int32_t ESRI_SHAPE_FILE_CODE = 9994;
 static const size_t ESRI_HEADER_SIZE = 100;
-static const size_t ESRI_FILE_LENGTH_OFFSET = 24;
 
 //! ESRI Shapefile's shape types
 enum class ESRI_SHAPE_TYPE : int32_t
@@ -356,18 +360,113 @@ static CCVector2d MRangeOfContainer(ccHObject::Container &objects)
 	return range;
 }
 
-static void UpdateFileLength(QDataStream& out, int32_t newFileLentgh)
+//! Lightweight equivalent of QDataStream to encode shape records in memory
+/** Records are encoded concurrently in a pre-allocated buffer (see ShpFilter::saveToFile)
+**/
+class ShpRecordWriter
 {
-	qint64 oldPos = out.device()->pos();
-	QDataStream::ByteOrder oldOrder = out.byteOrder();
+public:
+	//! Default constructor
+	explicit ShpRecordWriter(char* data)
+		: m_data(data)
+	{}
 
-	out.device()->seek(ESRI_FILE_LENGTH_OFFSET);
-	out.setByteOrder(QDataStream::BigEndian);
-	out << newFileLentgh;
+	//! Sets the byte order of the next values
+	void setByteOrder(QDataStream::ByteOrder byteOrder) { m_byteOrder = byteOrder; }
 
-	out.device()->seek(oldPos);
-	out.setByteOrder(oldOrder);
-}
+	//! Returns the current position (relatively to the buffer start)
+	qint64 pos() const { return m_pos; }
+
+	ShpRecordWriter& operator<<(int32_t value) { write(value); return *this; }
+	ShpRecordWriter& operator<<(uint32_t value) { write(value); return *this; }
+	ShpRecordWriter& operator<<(double value)
+	{
+		quint64 bits = 0;
+		memcpy(&bits, &value, sizeof(double));
+		write(bits);
+		return *this;
+	}
+
+private:
+	template <typename T> void write(T value)
+	{
+		if (m_byteOrder == QDataStream::BigEndian)
+			qToBigEndian(value, m_data + m_pos);
+		else
+			qToLittleEndian(value, m_data + m_pos);
+		m_pos += sizeof(T);
+	}
+
+	char* m_data;
+	qint64 m_pos = 0;
+	QDataStream::ByteOrder m_byteOrder = QDataStream::BigEndian;
+};
+
+//! Shape record to be saved
+struct ShpRecordToSave
+{
+	//! Entity to save
+	ccHObject* entity = nullptr;
+	//! Entity bounding box (computed beforehand)
+	ccHObject::GlobalBoundingBox globalBB;
+	//! Record number (starting from 1)
+	int32_t recordNumber = 0;
+	//! Record content length (in 16-bit words)
+	int32_t recordSize16bits = 0;
+	//! Position of the record header in the SHP file (in bytes)
+	qint64 offset = 0;
+	//! Triangle organisation (MultiPatch only)
+	ESRI_PART_TYPE partType = ESRI_PART_TYPE::TRIANGLE_STRIP;
+
+	//! Returns the position of the record end in the SHP file (in bytes)
+	qint64 end() const { return offset + 8 + 2 * static_cast<qint64>(recordSize16bits); }
+};
+
+//! Maximum size of the records encoded at once when saving a SHP file (in bytes)
+static const qint64 s_shpWriteBatchSize = (1 << 26); //64 Mb
+
+//! Position of a shape record in a SHP file
+struct ShpRecordIndex
+{
+	//! Position of the record content in the SHP file (in bytes)
+	qint64 start = 0;
+	//! Record number (as stored in the record header)
+	int32_t recordNumber = 0;
+	//! Record content length (in 16-bit words)
+	int32_t recordSize16bits = 0;
+
+	//! Returns the position of the record end in the SHP file (in bytes)
+	qint64 end() const { return start + 2 * static_cast<qint64>(recordSize16bits); }
+};
+
+//! Shape record decoded from a SHP file
+/** Records are decoded concurrently (see ShpFilter::loadFile). The
+	corresponding entities are created afterwards, sequentially.
+**/
+struct ShpRecordToLoad
+{
+	//! Record position
+	ShpRecordIndex index;
+	//! Shape type code
+	int32_t shapeTypeInt = static_cast<int32_t>(ESRI_SHAPE_TYPE::NULL_SHAPE);
+	//! Decoding error (if any)
+	CC_FILE_ERROR error = CC_FERR_NO_ERROR;
+	//! Whether the record has no measurements (while its type should have some)
+	bool noMeasurements = false;
+	//! Index of the first point of each part
+	std::vector<int32_t> startIndexes;
+	//! Type of each part (MultiPatch only)
+	std::vector<int32_t> partTypes;
+	//! Points (already shifted)
+	std::vector<CCVector3> points;
+	//! Measures (empty if none)
+	std::vector<ScalarType> scalarValues;
+};
+
+//! Maximum size of the records decoded at once when loading a SHP file (in bytes)
+static const qint64 s_shpReadBatchSize = (1 << 26); //64 Mb
+//! Maximum number of records decoded at once when loading a SHP file
+static const size_t s_shpReadBatchCount = (1 << 16);
 
 struct ShapeFileHeader
 {
@@ -645,6 +744,14 @@ static void GetSupportedShapes(ccHObject* baseEntity, ccHObject::Container& shap
 	}
 }
 
+//! Checks that the number of parts and points of a record are consistent with its size
+static bool AreValidRecordCounts(int32_t numParts, int32_t numPoints, int32_t recordSize16bits)
+{
+	return	numParts >= 0
+		&&	numPoints >= 0
+		&&	4 * static_cast<qint64>(numParts) + 16 * static_cast<qint64>(numPoints) <= 2 * static_cast<qint64>(recordSize16bits);
+}
+
 static CC_FILE_ERROR ReadParts(QDataStream& shpStream, int32_t numParts, std::vector<int32_t>& startIndexes)
 {
 	try
@@ -690,7 +797,7 @@ static CC_FILE_ERROR ReadPoints(QDataStream& shpStream, int32_t numPoints, const
 	return CC_FERR_NO_ERROR;
 }
 
-static CC_FILE_ERROR ReadMeasures(QDataStream& shpStream, int32_t numPoints, std::vector<ScalarType>& scalarValues, int32_t recordSize16bits, qint64 recordStart)
+static CC_FILE_ERROR ReadMeasures(QDataStream& shpStream, int32_t numPoints, std::vector<ScalarType>& scalarValues, int32_t recordSize16bits, qint64 recordStart, bool& noMeasurements)
 {
 	// warning: Measures might be optional
 	int64_t currentPos = shpStream.device()->pos();
@@ -731,7 +838,7 @@ static CC_FILE_ERROR ReadMeasures(QDataStream& shpStream, int32_t numPoints, std
 	}
 	else if (readSize <= recordSize16bits * 2)
 	{
-		ccLog::WarningDebug("Entity has no measurements");
+		noMeasurements = true; //we don't log anything here (records are read concurrently)
 		if (readSize < recordSize16bits * 2)
 		{
 			//that would be strange, but the specifications don't say if everything should be ignored,
@@ -897,11 +1004,8 @@ static CC_FILE_ERROR BuildPatches(
 }
 
 
-static CC_FILE_ERROR LoadMultiPatch(QDataStream& shpStream,
-                                    ccHObject& container,
-                                    int32_t recordSize16bits,
-                                    int64_t recordStart,
-                                    CCVector3d Pshift)
+//! Decodes a MultiPatch record (the patches are built afterwards, see BuildPatches)
+static CC_FILE_ERROR DecodeMultiPatch(QDataStream& shpStream, ShpRecordToLoad& record, const CCVector3d& Pshift)
 {
 	// skip record bbox
 	shpStream.skipRawData(4 * 8);
@@ -910,22 +1014,24 @@ static CC_FILE_ERROR LoadMultiPatch(QDataStream& shpStream,
 	int32_t numPoints;
 	shpStream >> numParts >> numPoints;
 
-	std::vector<int32_t> startIndexes;
-	CC_FILE_ERROR error = ReadParts(shpStream, numParts, startIndexes);
+	if (!AreValidRecordCounts(numParts, numPoints, record.index.recordSize16bits))
+	{
+		return CC_FERR_MALFORMED_FILE;
+	}
+
+	CC_FILE_ERROR error = ReadParts(shpStream, numParts, record.startIndexes);
 	if (error != CC_FERR_NO_ERROR)
 	{
 		return error;
 	}
 
-	std::vector<int32_t> partTypes;
-	error = ReadParts(shpStream, numParts, partTypes);
+	error = ReadParts(shpStream, numParts, record.partTypes);
 	if (error != CC_FERR_NO_ERROR)
 	{
 		return error;
 	}
 
-	std::vector<CCVector3> points;
-	error = ReadPoints(shpStream, numPoints, Pshift, points);
+	error = ReadPoints(shpStream, numPoints, Pshift, record.points);
 	if (error != CC_FERR_NO_ERROR)
 	{
 		return error;
@@ -939,28 +1045,21 @@ static CC_FILE_ERROR LoadMultiPatch(QDataStream& shpStream,
 	{
 		double z;
 		shpStream >> z;
-		points[i].z = static_cast<PointCoordinateType>(z + Pshift.z);
-	}
-
-	std::vector<ScalarType> scalarValues;
-	error = ReadMeasures(shpStream, numPoints, scalarValues, recordSize16bits, recordStart);
-	if (error != CC_FERR_NO_ERROR)
-	{
-		return error;
+		record.points[i].z = static_cast<PointCoordinateType>(z + Pshift.z);
 	}
 
-	return BuildPatches(container, startIndexes, partTypes, points, scalarValues);
+	return ReadMeasures(shpStream, numPoints, record.scalarValues, record.index.recordSize16bits, 0, record.noMeasurements);
 }
 
 //! Saves the cloud to the shape file according to the specification
 /**
  *
- * @param stream Output stream of the shapefile
+ * @param stream Output record buffer
  * @param cloud The cloud to save (pointcloud or vertices)
  * @param bbMinGlobal Min point of the cloud (global coordinates)
  * @param bbMaxGlobal Max point of the cloud (global coordinates)
  */
-static void Save3DCloud(QDataStream& stream, const ccGenericPointCloud* cloud, const CCVector3d& bbMinGlobal, const CCVector3d& bbMaxGlobal)
+static void Save3DCloud(ShpRecordWriter& stream, const ccGenericPointCloud* cloud, const CCVector3d& bbMinGlobal, const CCVector3d& bbMaxGlobal)
 {
 	const unsigned numPoints = cloud->size();
 	CCVector3 P;
@@ -1072,9 +1171,15 @@ static CC_FILE_ERROR FindTriangleOrganisation(ccMesh* mesh, ESRI_PART_TYPE &type
 	}
 }
 
-static CC_FILE_ERROR SaveMesh(ccMesh* mesh, QDataStream& stream, int32_t recordNumber, int32_t& recordSize16bits)
+//! Checks that a mesh can be saved and returns the size of its record
+static CC_FILE_ERROR GetMeshRecordSize(ccMesh* mesh, ESRI_PART_TYPE& triangleType, int32_t& recordSize16bits)
 {
-	ESRI_PART_TYPE triangleType;
+	if (!mesh)
+	{
+		assert(false);
+		return CC_FERR_BAD_ENTITY_TYPE;
+	}
+
 	if (FindTriangleOrganisation(mesh, triangleType) == CC_FERR_BAD_ENTITY_TYPE)
 	{
 		ccLog::Warning("[SHP] A mesh has to be organized as a triangle fan or a triangle trip (see MultiPatch geometry specifications)");
@@ -1083,44 +1188,47 @@ static CC_FILE_ERROR SaveMesh(ccMesh* mesh, QDataStream& stream, int32_t recordN
 
 	ccLog::Print(QString("[SHP] Triangle type: %1").arg(ToString(triangleType)));
 
+	int32_t numParts = 1;
+	unsigned numPoints = mesh->getAssociatedCloud()->size();
+	recordSize16bits = SizeofMultipatch16Bits(numPoints, numParts);
+
+	return CC_FERR_NO_ERROR;
+}
+
+//! Saves a mesh record (see GetMeshRecordSize)
+static void SaveMesh(ccMesh* mesh, ShpRecordWriter& stream, const ShpRecordToSave& record)
+{
 	ccGenericPointCloud* vertices = mesh->getAssociatedCloud();
 	int32_t numParts = 1;
 	unsigned numPoints = vertices->size();
-	recordSize16bits = SizeofMultipatch16Bits(numPoints, numParts);
 
 	// Record Header
 	stream.setByteOrder(QDataStream::BigEndian);
-	stream << recordNumber << recordSize16bits;
+	stream << record.recordNumber << record.recordSize16bits;
 
-	qint64 recordStart = stream.device()->pos();
+	qint64 recordStart = stream.pos();
 	stream.setByteOrder(QDataStream::LittleEndian);
 	stream << static_cast<int32_t>(ESRI_SHAPE_TYPE::MULTI_PATCH);
 
-	ccHObject::GlobalBoundingBox globalBB = mesh->getOwnGlobalBB();
+	const ccHObject::GlobalBoundingBox& globalBB = record.globalBB;
 
 	stream << globalBB.minCorner().x << globalBB.minCorner().y << globalBB.maxCorner().x << globalBB.maxCorner().y;
 	stream << numParts << numPoints;
 	stream << static_cast<int32_t>(0); // Parts
-	stream << static_cast<int32_t>(triangleType); // Parts Type
+	stream << static_cast<int32_t>(record.partType); // Parts Type
 
 	Save3DCloud(stream, vertices, globalBB.minCorner(), globalBB.maxCorner());
 
-	qint64 recordEnd = stream.device()->pos();
+	qint64 recordEnd = stream.pos();
 	qint64 bytesWritten = recordEnd - recordStart;
-	assert(bytesWritten == 2 * recordSize16bits);
-	
-	return CC_FERR_NO_ERROR;
+	assert(bytesWritten == 2 * record.recordSize16bits);
 }
 
-static CC_FILE_ERROR LoadPolyline(QDataStream& shpStream,
-                                  ccHObject& container,
-                                  int32_t index,
-                                  ESRI_SHAPE_TYPE shapeType,
-                                  int32_t recordSize16bits,
-                                  int64_t recordStart,
-                                  const CCVector3d& Pshift,
-                                  bool preserveCoordinateShift,
-                                  bool load2DPolyAs3DPoly = true)
+//! Decodes a Polyline or Polygon record (the polylines are built afterwards, see BuildPolylines)
+static CC_FILE_ERROR DecodePolyline(QDataStream& shpStream,
+                                    ShpRecordToLoad& record,
+                                    ESRI_SHAPE_TYPE shapeType,
+                                    const CCVector3d& Pshift)
 {
 	// skip record bbox
 	shpStream.skipRawData(4 * 8);
@@ -1129,8 +1237,12 @@ static CC_FILE_ERROR LoadPolyline(QDataStream& shpStream,
 	int32_t numPoints;
 	shpStream >> numParts >> numPoints;
 
-	std::vector<int32_t> startIndexes;
-	CC_FILE_ERROR error = ReadParts(shpStream, numParts, startIndexes);
+	if (!AreValidRecordCounts(numParts, numPoints, record.index.recordSize16bits))
+	{
+		return CC_FERR_MALFORMED_FILE;
+	}
+
+	CC_FILE_ERROR error = ReadParts(shpStream, numParts, record.startIndexes);
 	if (error != CC_FERR_NO_ERROR)
 	{
 		return error;
@@ -1139,16 +1251,14 @@ static CC_FILE_ERROR LoadPolyline(QDataStream& shpStream,
 	//FIXME: we should use this information and create as many polylines as necessary!
 
 	//Points (An array of length NumPoints)
-	std::vector<CCVector3> points;
-	error = ReadPoints(shpStream, numPoints, Pshift, points);
+	error = ReadPoints(shpStream, numPoints, Pshift, record.points);
 	if (error != CC_FERR_NO_ERROR)
 	{
 		return error;
 	}
 
 	//3D polylines
-	bool is3D = IsESRIShape3D(shapeType);
-	if (is3D)
+	if (IsESRIShape3D(shapeType))
 	{
 		//Z boundaries
 		shpStream.skipRawData(2 * 8);
@@ -1158,27 +1268,55 @@ static CC_FILE_ERROR LoadPolyline(QDataStream& shpStream,
 		{
 			double z;
 			shpStream >> z;
-			points[i].z = static_cast<PointCoordinateType>(z + Pshift.z);
+			record.points[i].z = static_cast<PointCoordinateType>(z + Pshift.z);
 		}
 	}
 
 	//3D polylines or 2D polylines + measurement
-	std::vector<ScalarType> scalarValues;
 	if (HasMeasurements(shapeType))
 	{
-		error = ReadMeasures(shpStream, numPoints, scalarValues, recordSize16bits, recordStart);
+		error = ReadMeasures(shpStream, numPoints, record.scalarValues, record.index.recordSize16bits, 0, record.noMeasurements);
 		if (error != CC_FERR_NO_ERROR)
 		{
 			return error;
 		}
 	}
 
+	return CC_FERR_NO_ERROR;
+}
+
+//! Builds the polyline(s) of a decoded Polyline or Polygon record
+static CC_FILE_ERROR BuildPolylines(ccHObject& container,
+                                    const ShpRecordToLoad& record,
+                                    ESRI_SHAPE_TYPE shapeType,
+                                    const CCVector3d& Pshift,
+                                    bool preserveCoordinateShift,
+                                    bool load2DPolyAs3DPoly = true)
+{
+	const int32_t index = record.index.recordNumber;
+	const std::vector<int32_t>& startIndexes = record.startIndexes;
+	const std::vector<CCVector3>& points = record.points;
+	const std::vector<ScalarType>& scalarValues = record.scalarValues;
+	const int32_t numParts = static_cast<int32_t>(startIndexes.size());
+	const int32_t numPoints = static_cast<int32_t>(points.size());
+	bool is3D = IsESRIShape3D(shapeType);
+
 	//and of course the polyline(s)
 	for (int32_t i = 0; i < numParts; ++i)
 	{
 		const int32_t& firstIndex = startIndexes[i];
 		const int32_t& lastIndex = (i + 1 < numParts ? startIndexes[i + 1] : numPoints) - 1;
 		int32_t vertCount = lastIndex - firstIndex + 1;
+		if (firstIndex < 0 || lastIndex >= numPoints)
+		{
+			ccLog::Warning(QString("[SHP] Polyline #%1.%2: invalid part").arg(index).arg(i + 1));
+			return CC_FERR_MALFORMED_FILE;
+		}
+		if (vertCount <= 0)
+		{
+			//empty part
+			continue;
+		}
 
 		//test if the polyline is closed
 		bool isClosed = false;
@@ -1245,14 +1383,17 @@ static CC_FILE_ERROR LoadPolyline(QDataStream& shpStream,
 					sf->release();
 					sf = nullptr;
 				}
-				for (int32_t j = 0; j < vertCount; ++j)
+				else
 				{
-					sf->addElement(scalarValues[j + firstIndex]);
+					for (int32_t j = 0; j < vertCount; ++j)
+					{
+						sf->addElement(scalarValues[j + firstIndex]);
+					}
+					sf->computeMinAndMax();
+					int sfIdx = vertices->addScalarField(sf);
+					vertices->setCurrentDisplayedScalarField(sfIdx);
+					vertices->showSF(true);
 				}
-				sf->computeMinAndMax();
-				int sfIdx = vertices->addScalarField(sf);
-				vertices->setCurrentDisplayedScalarField(sfIdx);
-				vertices->showSF(true);
 			}
 		}
 		container.addChild(poly);
@@ -1260,25 +1401,17 @@ static CC_FILE_ERROR LoadPolyline(QDataStream& shpStream,
 	return CC_FERR_NO_ERROR;
 }
 
-static CC_FILE_ERROR SavePolyline(ccPolyline* poly,
-                                  QDataStream& out,
-                                  int32_t& recordSize16bits,
-                                  int32_t recordNumber,
-                                  ESRI_SHAPE_TYPE outputShapeType,
-                                  unsigned char vertDim = 2)
+//! Checks that a polyline can be saved and returns the size of its record
+static CC_FILE_ERROR GetPolylineRecordSize(ccPolyline* poly,
+                                           ESRI_SHAPE_TYPE outputShapeType,
+                                           int32_t& recordSize16bits)
 {
-	assert(vertDim < 3);
-
 	if (!poly)
 	{
 		assert(false);
 		return CC_FERR_BAD_ENTITY_TYPE;
 	}
 
-	const unsigned char Z = static_cast<unsigned char>(vertDim);
-	const unsigned char X = Z == 2 ? 0 : Z + 1;
-	const unsigned char Y = X == 2 ? 0 : X + 1;
-
 	CCCoreLib::GenericIndexedCloudPersist* vertices = poly->getAssociatedCloud();
 	if (!vertices)
 	{
@@ -1311,40 +1444,62 @@ static CC_FILE_ERROR SavePolyline(ccPolyline* poly,
 			return CC_FERR_BAD_ENTITY_TYPE;
 	}
 
-	bool isClosed = poly->isClosed();
-
 	if (static_cast<int64_t>(realVertexCount) + 1 > std::numeric_limits<int32_t>::max())
 	{
 		ccLog::Warning(QObject::tr("[SHP] Polyline %1 has too many points to be saved").arg(poly->getName()));
 		return CC_FERR_BAD_ENTITY_TYPE;
 	}
 
-	int32_t iRealVertexCount = static_cast<int32_t>(realVertexCount);
-	int32_t numPoints = iRealVertexCount + (isClosed ? 1 : 0);
+	int32_t numPoints = static_cast<int32_t>(realVertexCount) + (poly->isClosed() ? 1 : 0);
 	const int32_t numParts = 1;
 
 	bool hasSF = vertices->isScalarFieldEnabled();
 
 	recordSize16bits = SizeofPolyLine16Bits(outputShapeType, hasSF, numPoints, numParts);
 
+	return CC_FERR_NO_ERROR;
+}
+
+//! Saves a polyline record (see GetPolylineRecordSize)
+static void SavePolyline(ccPolyline* poly,
+                         ShpRecordWriter& out,
+                         const ShpRecordToSave& record,
+                         ESRI_SHAPE_TYPE outputShapeType,
+                         unsigned char vertDim = 2)
+{
+	assert(vertDim < 3);
+
+	const unsigned char Z = static_cast<unsigned char>(vertDim);
+	const unsigned char X = Z == 2 ? 0 : Z + 1;
+	const unsigned char Y = X == 2 ? 0 : X + 1;
+
+	CCCoreLib::GenericIndexedCloudPersist* vertices = poly->getAssociatedCloud();
+	bool isClosed = poly->isClosed();
+
+	int32_t iRealVertexCount = static_cast<int32_t>(poly->size());
+	int32_t numPoints = iRealVertexCount + (isClosed ? 1 : 0);
+	const int32_t numParts = 1;
+
+	bool hasSF = vertices->isScalarFieldEnabled();
+
 	//write shape record in main SHP file
 	{
 		out.setByteOrder(QDataStream::BigEndian);
 		//Byte 0: Record Number
-		assert(recordNumber > 0); //Record numbers begin at 1
-		out << recordNumber;
+		assert(record.recordNumber > 0); //Record numbers begin at 1
+		out << record.recordNumber;
 		//Byte 4: Content Length
-		out << recordSize16bits;
+		out << record.recordSize16bits;
 	}
 
-	qint64 recordStart = out.device()->pos();
+	qint64 recordStart = out.pos();
 	out.setByteOrder(QDataStream::LittleEndian);
 
 	//Byte 0: Shape Type
 	out << static_cast<int32_t>(outputShapeType);
 
 	//Byte 4: Box
-	ccHObject::GlobalBoundingBox globalBB = poly->getOwnGlobalBB();
+	const ccHObject::GlobalBoundingBox& globalBB = record.globalBB;
 	//The Bounding Box for the PolyLine stored in the order Xmin, Ymin, Xmax, Ymax (24 bytes)
 	out << globalBB.minCorner().u[X] << globalBB.minCorner().u[Y] << globalBB.maxCorner().u[X] << globalBB.maxCorner().u[Y];
 
@@ -1424,19 +1579,15 @@ static CC_FILE_ERROR SavePolyline(ccPolyline* poly,
 		}
 	}
 
-	assert(out.device()->pos() == recordStart + recordSize16bits * 2);
-	return CC_FERR_NO_ERROR;
+	assert(out.pos() == recordStart + record.recordSize16bits * 2);
 }
 
 
-static CC_FILE_ERROR LoadCloud(QDataStream& shpStream,
-                               ccHObject& container,
-                               int32_t index,
-                               ESRI_SHAPE_TYPE shapeType,
-                               int32_t recordSize16bits,
-                               int64_t recordStart,
-                               const CCVector3d& Pshift,
-                               bool preserveCoordinateShift)
+//! Decodes a MultiPoint record (the cloud is built afterwards, see BuildCloud)
+static CC_FILE_ERROR DecodeCloud(QDataStream& shpStream,
+                                 ShpRecordToLoad& record,
+                                 ESRI_SHAPE_TYPE shapeType,
+                                 const CCVector3d& Pshift)
 {
 	// Skip record bbox
 	shpStream.skipRawData(4 * 8);
@@ -1444,27 +1595,16 @@ static CC_FILE_ERROR LoadCloud(QDataStream& shpStream,
 	int32_t numPoints;
 	shpStream >> numPoints;
 
-	ccPointCloud* cloud = new ccPointCloud(QString("Cloud #%1").arg(index));
-	if (!cloud->reserve(numPoints))
-	{
-		delete cloud;
-		return CC_FERR_NOT_ENOUGH_MEMORY;
-	}
-	if (preserveCoordinateShift)
+	if (!AreValidRecordCounts(0, numPoints, record.index.recordSize16bits))
 	{
-		cloud->setGlobalShift(Pshift);
+		return CC_FERR_MALFORMED_FILE;
 	}
 
 	//Points (An array of length NumPoints)
-	for (int32_t i = 0; i < numPoints; ++i)
+	CC_FILE_ERROR error = ReadPoints(shpStream, numPoints, Pshift, record.points);
+	if (error != CC_FERR_NO_ERROR)
 	{
-		double x;
-		double y;
-		shpStream >> x >> y;
-		CCVector3 P(static_cast<PointCoordinateType>(x + Pshift.x),
-					static_cast<PointCoordinateType>(y + Pshift.y),
-					0);
-		cloud->addPoint(P);
+		return error;
 	}
 
 	//3D clouds
@@ -1478,10 +1618,8 @@ static CC_FILE_ERROR LoadCloud(QDataStream& shpStream,
 		{
 			double z;
 			shpStream >> z;
-			const CCVector3* P = cloud->getPoint(i);
-			const_cast<CCVector3*>(P)->z = static_cast<PointCoordinateType>(z + Pshift.z);
+			record.points[i].z = static_cast<PointCoordinateType>(z + Pshift.z);
 		}
-		cloud->invalidateBoundingBox();
 	}
 
 	//3D clouds or 2D clouds + measurement
@@ -1489,48 +1627,36 @@ static CC_FILE_ERROR LoadCloud(QDataStream& shpStream,
 	{
 		// warning: Measures might be optional
 		int64_t currentPos = shpStream.device()->pos();
-		int32_t readSize = static_cast<int32_t>(currentPos - recordStart);
+		int32_t readSize = static_cast<int32_t>(currentPos);
 		int32_t expectedSize = readSize + (2 + numPoints) * sizeof(double); // 2 bounding values + 'numPoints' measurements
+		const int32_t recordSize16bits = record.index.recordSize16bits;
 		if (recordSize16bits * 2 >= expectedSize) //recordSize is expressed as a number of 16-bit words
 		{
 			//M boundaries
-			ccScalarField* sf = nullptr;
 			double mMin;
 			double mMax;
 			shpStream >> mMin >> mMax;
 
 			if (mMin != ESRI_NO_DATA && mMax != ESRI_NO_DATA)
 			{
-				sf = new ccScalarField("Measures");
-				if (!sf->reserveSafe(numPoints))
+				try
 				{
-					ccLog::Warning("[SHP] Not enough memory to load scalar values!");
-					sf->release();
-					sf = nullptr;
+					record.scalarValues.resize(numPoints);
+				}
+				catch (const std::bad_alloc&)
+				{
+					//the scalar values will be ignored (see BuildCloud)
 				}
 			}
 
 			//M values (an array of length NumPoints)
-			if (sf)
+			if (!record.scalarValues.empty())
 			{
 				for (int32_t i = 0; i < numPoints; ++i)
 				{
 					double m;
 					shpStream >> m;
-					ScalarType s = IsESRINoData(m) ? CCCoreLib::NAN_VALUE : static_cast<ScalarType>(m);
-					sf->addElement(s);
-				}
-				bool allNans = std::all_of(sf->begin(), sf->end(), [](ScalarType s) { return std::isnan(s); });
-				if (!allNans)
-				{
-					sf->computeMinAndMax();
-					int sfIdx = cloud->addScalarField(sf);
-					cloud->setCurrentDisplayedScalarField(sfIdx);
-					cloud->showSF(true);
-				}
-				else
-				{
-					sf->release();
+					record.scalarValues[i] = IsESRINoData(m) ? CCCoreLib::NAN_VALUE : static_cast<ScalarType>(m);
 				}
 			}
 			else
@@ -1540,7 +1666,7 @@ static CC_FILE_ERROR LoadCloud(QDataStream& shpStream,
 		}
 		else if (readSize <= recordSize16bits * 2)
 		{
-			ccLog::WarningDebug("Entity has no measurements");
+			record.noMeasurements = true;
 			if (readSize < recordSize16bits * 2)
 			{
 				//that would be strange, but the specifications don't say if everything should be ignored,
@@ -1554,11 +1680,66 @@ static CC_FILE_ERROR LoadCloud(QDataStream& shpStream,
 			assert(false);
 		}
 	}
+
+	return CC_FERR_NO_ERROR;
+}
+
+//! Builds the cloud of a decoded MultiPoint record
+static CC_FILE_ERROR BuildCloud(ccHObject& container,
+                                const ShpRecordToLoad& record,
+                                const CCVector3d& Pshift,
+                                bool preserveCoordinateShift)
+{
+	const std::vector<CCVector3>& points = record.points;
+	unsigned numPoints = static_cast<unsigned>(points.size());
+
+	ccPointCloud* cloud = new ccPointCloud(QString("Cloud #%1").arg(record.index.recordNumber));
+	if (!cloud->reserve(numPoints))
+	{
+		delete cloud;
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+	}
+	if (preserveCoordinateShift)
+	{
+		cloud->setGlobalShift(Pshift);
+	}
+
+	for (const CCVector3& P : points)
+	{
+		cloud->addPoint(P);
+	}
+
+	if (!record.scalarValues.empty())
+	{
+		bool allNans = std::all_of(record.scalarValues.begin(), record.scalarValues.end(), [](ScalarType s) { return std::isnan(s); });
+		if (!allNans)
+		{
+			ccScalarField* sf = new ccScalarField("Measures");
+			if (!sf->reserveSafe(numPoints))
+			{
+				ccLog::Warning("[SHP] Not enough memory to load scalar values!");
+				sf->release();
+			}
+			else
+			{
+				for (ScalarType s : record.scalarValues)
+				{
+					sf->addElement(s);
+				}
+				sf->computeMinAndMax();
+				int sfIdx = cloud->addScalarField(sf);
+				cloud->setCurrentDisplayedScalarField(sfIdx);
+				cloud->showSF(true);
+			}
+		}
+	}
+
 	container.addChild(cloud);
 	return CC_FERR_NO_ERROR;
 }
 
-static CC_FILE_ERROR SaveAsCloud(ccGenericPointCloud* cloud, QDataStream& out, int32_t recordNumber, int32_t& recordSize16bits)
+//! Checks that a cloud can be saved and returns the size of its record
+static CC_FILE_ERROR GetCloudRecordSize(ccGenericPointCloud* cloud, int32_t& recordSize16bits)
 {
 	if (!cloud)
 	{
@@ -1573,12 +1754,18 @@ static CC_FILE_ERROR SaveAsCloud(ccGenericPointCloud* cloud, QDataStream& out, i
 	}
 
 	recordSize16bits = SizeofMultiPointZ16Bits(cloud->size());
+	return CC_FERR_NO_ERROR;
+}
+
+//! Saves a cloud record (see GetCloudRecordSize)
+static void SaveAsCloud(ccGenericPointCloud* cloud, ShpRecordWriter& out, const ShpRecordToSave& record)
+{
 	out.setByteOrder(QDataStream::BigEndian);
-	out << recordNumber << recordSize16bits;
+	out << record.recordNumber << record.recordSize16bits;
 
-	ccHObject::GlobalBoundingBox globalBB = cloud->getOwnGlobalBB();
+	const ccHObject::GlobalBoundingBox& globalBB = record.globalBB;
 
-	int64_t recordStart = out.device()->pos();
+	int64_t recordStart = out.pos();
 	out.setByteOrder(QDataStream::LittleEndian);
 	out << static_cast<int32_t>(ESRI_SHAPE_TYPE::MULTI_POINT_Z);
 
@@ -1586,26 +1773,44 @@ static CC_FILE_ERROR SaveAsCloud(ccGenericPointCloud* cloud, QDataStream& out, i
 	out << static_cast<int32_t >(cloud->size());
 
 	Save3DCloud(out, cloud, globalBB.minCorner(), globalBB.maxCorner());
-	assert(out.device()->pos() - recordStart == recordSize16bits * 2);
-	return CC_FERR_NO_ERROR;
+	assert(out.pos() - recordStart == record.recordSize16bits * 2);
 }
 
-static CC_FILE_ERROR LoadSinglePoint(QDataStream& shpStream,
-                                     ccPointCloud*& singlePoints,
-                                     ESRI_SHAPE_TYPE shapeType,
-                                     int32_t recordSize16bits,
-                                     const CCVector3d& Pshift,
-                                     bool preserveCoordinateShift)
+//! Saves a shape record in a pre-allocated buffer
+static void SaveRecord(const ShpRecordToSave& record, char* data, ESRI_SHAPE_TYPE outputShapeType, unsigned char vertDim)
 {
-	if (!singlePoints)
+	ShpRecordWriter out(data);
+
+	switch (outputShapeType)
 	{
-		singlePoints = new ccPointCloud("Points");
-		if (preserveCoordinateShift)
-		{
-			singlePoints->setGlobalShift(Pshift);
-		}
+		case ESRI_SHAPE_TYPE::POLYLINE:
+		case ESRI_SHAPE_TYPE::POLYLINE_Z:
+		case ESRI_SHAPE_TYPE::POLYLINE_M:
+		case ESRI_SHAPE_TYPE::POLYGON:
+		case ESRI_SHAPE_TYPE::POLYGON_Z:
+		case ESRI_SHAPE_TYPE::POLYGON_M:
+			SavePolyline(static_cast<ccPolyline*>(record.entity), out, record, outputShapeType, vertDim);
+			break;
+		case ESRI_SHAPE_TYPE::MULTI_POINT_Z:
+			SaveAsCloud(ccHObjectCaster::ToGenericPointCloud(record.entity), out, record);
+			break;
+		case ESRI_SHAPE_TYPE::MULTI_PATCH:
+			SaveMesh(ccHObjectCaster::ToMesh(record.entity), out, record);
+			break;
+		default:
+			assert(false);
+			break;
 	}
 
+	assert(out.pos() == record.end() - record.offset);
+}
+
+//! Decodes a Point record (the point is added afterwards, see AddSinglePoint)
+static CC_FILE_ERROR DecodeSinglePoint(QDataStream& shpStream,
+                                       ShpRecordToLoad& record,
+                                       ESRI_SHAPE_TYPE shapeType,
+                                       const CCVector3d& Pshift)
+{
 	double x;
 	double y;
 	shpStream >> x >> y;
@@ -1621,27 +1826,51 @@ static CC_FILE_ERROR LoadSinglePoint(QDataStream& shpStream,
 		P.z = static_cast<PointCoordinateType>(z + Pshift.z);
 		readBytes += 8;
 	}
+	record.points.push_back(P);
 
-	ScalarType s = CCCoreLib::NAN_VALUE;
-	if (HasMeasurements(shapeType) && (readBytes + 4 + 8 <= recordSize16bits * 2)) // +4 = shape type / +8 = measure (double)
+	if (HasMeasurements(shapeType) && (readBytes + 4 + 8 <= record.index.recordSize16bits * 2)) // +4 = shape type / +8 = measure (double)
 	{
 		double m;
 		shpStream >> m;
 		if (!IsESRINoData(m))
 		{
-			s = static_cast<ScalarType>(m);
-			//add a SF to the cloud if not done already
-			if (!singlePoints->hasScalarFields())
+			record.scalarValues.push_back(static_cast<ScalarType>(m));
+		}
+	}
+
+	return CC_FERR_NO_ERROR;
+}
+
+//! Adds the point of a decoded Point record to the 'single points' cloud
+static CC_FILE_ERROR AddSinglePoint(ccPointCloud*& singlePoints,
+                                    const ShpRecordToLoad& record,
+                                    const CCVector3d& Pshift,
+                                    bool preserveCoordinateShift)
+{
+	if (!singlePoints)
+	{
+		singlePoints = new ccPointCloud("Points");
+		if (preserveCoordinateShift)
+		{
+			singlePoints->setGlobalShift(Pshift);
+		}
+	}
+
+	ScalarType s = CCCoreLib::NAN_VALUE;
+	if (!record.scalarValues.empty())
+	{
+		s = record.scalarValues.front();
+		//add a SF to the cloud if not done already
+		if (!singlePoints->hasScalarFields())
+		{
+			int sfIdx = singlePoints->addScalarField("Measures");
+			if (sfIdx >= 0)
 			{
-				int sfIdx = singlePoints->addScalarField("Measures");
-				if (sfIdx >= 0)
+				//set the SF value for the previous points
+				singlePoints->setCurrentScalarField(sfIdx);
+				for (unsigned i = 0; i < singlePoints->size(); ++i)
 				{
-					//set the SF value for the previous points
-					singlePoints->setCurrentScalarField(sfIdx);
-					for (unsigned i = 0; i < singlePoints->size(); ++i)
-					{
-						singlePoints->setPointScalarValue(i, CCCoreLib::NAN_VALUE);
-					}
+					singlePoints->setPointScalarValue(i, CCCoreLib::NAN_VALUE);
 				}
 			}
 		}
@@ -1656,7 +1885,7 @@ static CC_FILE_ERROR LoadSinglePoint(QDataStream& shpStream,
 		return CC_FERR_NOT_ENOUGH_MEMORY;
 	}
 
-	singlePoints->addPoint(P);
+	singlePoints->addPoint(record.points.front());
 
 	if (singlePoints->getCurrentOutScalarField())
 		singlePoints->getCurrentOutScalarField()->addElement(s);
@@ -1664,27 +1893,174 @@ static CC_FILE_ERROR LoadSinglePoint(QDataStream& shpStream,
 	return CC_FERR_NO_ERROR;
 }
 
-
-CC_FILE_ERROR ShpFilter::saveToFile(ccHObject* entity, const QString& filename, const SaveParameters& parameters)
-{
-	std::vector<GenericDBFField*> fields;
-	return saveToFile(entity, fields, filename, parameters);
-}
-
-
-CC_FILE_ERROR ShpFilter::saveToFile(ccHObject* entity, const std::vector<GenericDBFField*>& fields, const QString& filename, const SaveParameters& parameters)
+//! Decodes a shape record (may be called concurrently)
+static void DecodeRecord(ShpRecordToLoad& record, const char* shpData, const CCVector3d& Pshift)
 {
-	if (!entity)
-		return CC_FERR_BAD_ENTITY_TYPE;
+	QByteArray content = QByteArray::fromRawData(shpData + record.index.start, 2 * record.index.recordSize16bits);
+	QDataStream shpStream(content);
+	shpStream.setByteOrder(QDataStream::LittleEndian);
 
-	//this filter only supports point clouds, meshes and polylines!
-	ESRI_SHAPE_TYPE inputShapeType = ESRI_SHAPE_TYPE::NULL_SHAPE;
-	ccHObject::Container toSave;
-	GetSupportedShapes(entity, toSave, inputShapeType);
-
-	if (inputShapeType == ESRI_SHAPE_TYPE::NULL_SHAPE || toSave.empty())
+	shpStream >> record.shapeTypeInt;
+	if (!IsValidESRIShapeCode(record.shapeTypeInt))
 	{
-		return CC_FERR_BAD_ENTITY_TYPE;
+		//will be reported afterwards
+		return;
+	}
+	ESRI_SHAPE_TYPE shapeType = static_cast<ESRI_SHAPE_TYPE>(record.shapeTypeInt);
+
+	switch (shapeType)
+	{
+		case ESRI_SHAPE_TYPE::POLYLINE_Z:
+		case ESRI_SHAPE_TYPE::POLYGON_Z:
+		case ESRI_SHAPE_TYPE::POLYLINE:
+		case ESRI_SHAPE_TYPE::POLYGON:
+		case ESRI_SHAPE_TYPE::POLYLINE_M:
+		case ESRI_SHAPE_TYPE::POLYGON_M:
+			record.error = DecodePolyline(shpStream, record, shapeType, Pshift);
+			break;
+		case ESRI_SHAPE_TYPE::MULTI_POINT_Z:
+		case ESRI_SHAPE_TYPE::MULTI_POINT_M:
+		case ESRI_SHAPE_TYPE::MULTI_POINT:
+			record.error = DecodeCloud(shpStream, record, shapeType, Pshift);
+			break;
+		case ESRI_SHAPE_TYPE::POINT_Z:
+		case ESRI_SHAPE_TYPE::POINT_M:
+		case ESRI_SHAPE_TYPE::POINT:
+			record.error = DecodeSinglePoint(shpStream, record, shapeType, Pshift);
+			break;
+		case ESRI_SHAPE_TYPE::MULTI_PATCH:
+			record.error = DecodeMultiPatch(shpStream, record, Pshift);
+			break;
+		default:
+			//ignored or unhandled entity
+			break;
+	}
+
+	if (record.error == CC_FERR_NO_ERROR && shpStream.status() != QDataStream::Ok)
+	{
+		//the record is shorter than expected
+		record.error = CC_FERR_READING;
+	}
+}
+
+//! Lists the records of a SHP file
+/** The records positions are read from the index (SHX) file if it's valid.
+	Otherwise, the SHP file records headers are scanned.
+**/
+static CC_FILE_ERROR ListRecords(	const char* shpData,
+									qint64 shpSize,
+									qint64 fileLength,
+									const QString& shxFilename,
+									std::vector<ShpRecordIndex>& records)
+{
+	records.clear();
+	const qint64 dataEnd = std::min(shpSize, fileLength);
+
+	QFile shxFile(shxFilename);
+	if (shxFile.exists() && shxFile.open(QIODevice::ReadOnly))
+	{
+		QByteArray shx = shxFile.readAll();
+		shxFile.close();
+
+		bool validIndex = (shx.size() >= static_cast<int>(ESRI_HEADER_SIZE) && (shx.size() - ESRI_HEADER_SIZE) % 8 == 0);
+		if (validIndex)
+		{
+			try
+			{
+				records.reserve((shx.size() - ESRI_HEADER_SIZE) / 8);
+			}
+			catch (const std::bad_alloc&)
+			{
+				return CC_FERR_NOT_ENOUGH_MEMORY;
+			}
+
+			qint64 previousEnd = ESRI_HEADER_SIZE;
+			for (int pos = static_cast<int>(ESRI_HEADER_SIZE); pos < shx.size(); pos += 8)
+			{
+				ShpRecordIndex record;
+				qint64 headerPos = 2 * static_cast<qint64>(qFromBigEndian<qint32>(shx.constData() + pos));
+				record.recordSize16bits = qFromBigEndian<qint32>(shx.constData() + pos + 4);
+				record.start = headerPos + 8;
+
+				//the record must be consistent with the SHP file
+				if (	headerPos < previousEnd
+					||	record.recordSize16bits < 0
+					||	record.end() > dataEnd
+					||	qFromBigEndian<qint32>(shpData + headerPos + 4) != record.recordSize16bits)
+				{
+					validIndex = false;
+					break;
+				}
+				record.recordNumber = qFromBigEndian<qint32>(shpData + headerPos);
+
+				records.push_back(record);
+				previousEnd = record.end();
+			}
+		}
+
+		if (validIndex)
+		{
+			return CC_FERR_NO_ERROR;
+		}
+
+		ccLog::WarningDebug("[SHP] Inconsistent index file, we'll scan the SHP file instead");
+		records.clear();
+	}
+
+	//scan the records headers
+	for (qint64 pos = ESRI_HEADER_SIZE; pos < fileLength; )
+	{
+		if (pos + 8 > shpSize)
+		{
+			ccLog::Warning("[SHP] Something went wrong reading the file");
+			return CC_FERR_READING;
+		}
+
+		ShpRecordIndex record;
+		record.recordNumber = qFromBigEndian<qint32>(shpData + pos);
+		record.recordSize16bits = qFromBigEndian<qint32>(shpData + pos + 4);
+		record.start = pos + 8;
+		if (record.recordSize16bits < 0 || record.end() > shpSize)
+		{
+			ccLog::Warning("[SHP] Something went wrong reading the file");
+			return CC_FERR_READING;
+		}
+
+		try
+		{
+			records.push_back(record);
+		}
+		catch (const std::bad_alloc&)
+		{
+			return CC_FERR_NOT_ENOUGH_MEMORY;
+		}
+		pos = record.end();
+	}
+
+	return CC_FERR_NO_ERROR;
+}
+
+
+CC_FILE_ERROR ShpFilter::saveToFile(ccHObject* entity, const QString& filename, const SaveParameters& parameters)
+{
+	std::vector<GenericDBFField*> fields;
+	return saveToFile(entity, fields, filename, parameters);
+}
+
+
+CC_FILE_ERROR ShpFilter::saveToFile(ccHObject* entity, const std::vector<GenericDBFField*>& fields, const QString& filename, const SaveParameters& parameters)
+{
+	if (!entity)
+		return CC_FERR_BAD_ENTITY_TYPE;
+
+	//this filter only supports point clouds, meshes and polylines!
+	ESRI_SHAPE_TYPE inputShapeType = ESRI_SHAPE_TYPE::NULL_SHAPE;
+	ccHObject::Container toSave;
+	GetSupportedShapes(entity, toSave, inputShapeType);
+
+	if (inputShapeType == ESRI_SHAPE_TYPE::NULL_SHAPE || toSave.empty())
+	{
+		return CC_FERR_BAD_ENTITY_TYPE;
 	}
 
 	ccHObject::GlobalBoundingBox globalBB = BBoxOfHObjectContainer(toSave);
@@ -1756,6 +2132,76 @@ CC_FILE_ERROR ShpFilter::saveToFile(ccHObject* entity, const std::vector<Generic
 
 	ccLog::Print("[SHP] Output type: " + ToString(outputShapeType));
 
+	//compute the size and position of each record first
+	//(so that the records can be encoded concurrently afterwards)
+	std::vector<ShpRecordToSave> records;
+	qint64 shpFileSize = ESRI_HEADER_SIZE;
+	try
+	{
+		records.reserve(toSave.size());
+	}
+	catch (const std::bad_alloc&)
+	{
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+	}
+
+	for (ccHObject* child : toSave)
+	{
+		//check entity eligibility
+		if (child->isA(CC_TYPES::POLY_LINE))
+		{
+			if (static_cast<ccPolyline*>(child)->size() < 2)
+			{
+				ccLog::Warning(QString("Polyline '%1' is too small! It won't be saved...").arg(child->getName()));
+				continue;
+			}
+		}
+
+		ShpRecordToSave record;
+		record.entity = child;
+		record.recordNumber = static_cast<int32_t>(records.size() + 1);
+		record.offset = shpFileSize;
+		record.globalBB = child->getOwnGlobalBB();
+
+		CC_FILE_ERROR error = CC_FERR_NO_ERROR;
+
+		switch (outputShapeType)
+		{
+			case ESRI_SHAPE_TYPE::POLYLINE:
+			case ESRI_SHAPE_TYPE::POLYLINE_Z:
+			case ESRI_SHAPE_TYPE::POLYLINE_M:
+			case ESRI_SHAPE_TYPE::POLYGON:
+			case ESRI_SHAPE_TYPE::POLYGON_Z:
+			case ESRI_SHAPE_TYPE::POLYGON_M:
+				assert(child->isKindOf(CC_TYPES::POLY_LINE));
+				error = GetPolylineRecordSize(static_cast<ccPolyline*>(child), outputShapeType, record.recordSize16bits);
+				break;
+			case ESRI_SHAPE_TYPE::MULTI_POINT_Z:
+				assert(child->isKindOf(CC_TYPES::POINT_CLOUD));
+				error = GetCloudRecordSize(ccHObjectCaster::ToGenericPointCloud(child), record.recordSize16bits);
+				break;
+			case ESRI_SHAPE_TYPE::MULTI_PATCH:
+				error = GetMeshRecordSize(ccHObjectCaster::ToMesh(child), record.partType, record.recordSize16bits);
+				break;
+			default:
+				assert(false);
+				continue;
+		}
+
+		if (error != CC_FERR_NO_ERROR)
+			return error;
+
+		ccLog::PrintDebug("[SHP] Shape #%d (%d bytes)", record.recordNumber, record.recordSize16bits * 2);
+		shpFileSize = record.end();
+		records.push_back(record);
+	}
+
+	if (shpFileSize / 2 > std::numeric_limits<int32_t>::max())
+	{
+		ccLog::Warning("[SHP] Too many shapes to be saved in a single file");
+		return CC_FERR_BAD_ENTITY_TYPE;
+	}
+
 	QFileInfo fi(filename);
 	QString baseFileName = fi.path() + QString("/") + fi.completeBaseName();
 
@@ -1792,67 +2238,61 @@ CC_FILE_ERROR ShpFilter::saveToFile(ccHObject* entity, const std::vector<Generic
 	hdr.shapeTypeInt = static_cast<int32_t>(outputShapeType);
 	hdr.mRange = mRange;
 
+	//file lengths are measured in 16-bit words
+	hdr.fileLength = static_cast<int32_t>(shpFileSize / 2);
 	hdr.writeTo(shpStream);
+	hdr.fileLength = static_cast<int32_t>((ESRI_HEADER_SIZE + 8 * records.size()) / 2);
 	hdr.writeTo(idxStream);
 
-	//save shapes
-	unsigned shapeIndex = 1;
-	for (ccHObject* child : toSave)
+	//write the whole index (SHX) file at once
+	if (!records.empty())
 	{
-		//check entity eligibility
-		if (child->isA(CC_TYPES::POLY_LINE))
+		QByteArray index(static_cast<int>(8 * records.size()), Qt::Uninitialized);
+		ShpRecordWriter idxWriter(index.data());
+		idxWriter.setByteOrder(QDataStream::BigEndian);
+		for (const ShpRecordToSave& record : records)
 		{
-			if (static_cast<ccPolyline*>(child)->size() < 2)
-			{
-				ccLog::Warning(QString("Polyline '%1' is too small! It won't be saved...").arg(child->getName()));
-				continue;
-			}
+			idxWriter << static_cast<int32_t>(record.offset / 2); //the record position must be converted to a number of 16-bit words
+			idxWriter << record.recordSize16bits; //recordSize should already be expressed as a number of 16-bit words
 		}
+		if (indexFile.write(index) != index.size())
+			return CC_FERR_WRITING;
+	}
 
-		int32_t recordSize16bits = 0;
-		qint64 recordStart = shpStream.device()->pos();
-		CC_FILE_ERROR error = CC_FERR_NO_ERROR;
+	//the records are encoded concurrently (by batches) then written at once
+	std::vector<char> buffer;
+	for (size_t batchStart = 0; batchStart < records.size(); )
+	{
+		size_t batchEnd = batchStart + 1;
+		const qint64 batchOffset = records[batchStart].offset;
+		while (batchEnd < records.size() && records[batchEnd].end() - batchOffset <= s_shpWriteBatchSize)
+		{
+			++batchEnd;
+		}
+		const qint64 batchSize = records[batchEnd - 1].end() - batchOffset;
 
-		switch (outputShapeType)
+		try
 		{
-			case ESRI_SHAPE_TYPE::POLYLINE:
-			case ESRI_SHAPE_TYPE::POLYLINE_Z:
-			case ESRI_SHAPE_TYPE::POLYLINE_M:
-			case ESRI_SHAPE_TYPE::POLYGON:
-			case ESRI_SHAPE_TYPE::POLYGON_Z:
-			case ESRI_SHAPE_TYPE::POLYGON_M:
-				assert(child->isKindOf(CC_TYPES::POLY_LINE));
-				error = SavePolyline(static_cast<ccPolyline*>(child), shpStream, recordSize16bits, shapeIndex,
-				                     outputShapeType, s_poly2DVertDim);
-				break;
-			case ESRI_SHAPE_TYPE::MULTI_POINT_Z:
-				assert(child->isKindOf(CC_TYPES::POINT_CLOUD));
-				error = SaveAsCloud(ccHObjectCaster::ToGenericPointCloud(child), shpStream, shapeIndex, recordSize16bits);
-				break;
-			case ESRI_SHAPE_TYPE::MULTI_PATCH:
-				error = SaveMesh(ccHObjectCaster::ToMesh(child), shpStream, shapeIndex, recordSize16bits);
-				break;
-			default:
-				assert(false);
-				break;
+			buffer.resize(static_cast<size_t>(batchSize));
+		}
+		catch (const std::bad_alloc&)
+		{
+			return CC_FERR_NOT_ENOUGH_MEMORY;
 		}
 
-		if (error != CC_FERR_NO_ERROR)
-			return error;
+		char* batchData = buffer.data();
+		unsigned char vertDim = s_poly2DVertDim;
+		QtConcurrent::blockingMap(records.begin() + batchStart, records.begin() + batchEnd, [=](const ShpRecordToSave& record)
+		{
+			SaveRecord(record, batchData + (record.offset - batchOffset), outputShapeType, vertDim);
+		});
 
-		//write corresponding entry in index SHX file
-		idxStream.setByteOrder(QDataStream::BigEndian);
-		idxStream << static_cast<int32_t>(recordStart / 2); //recordStart must be converted to a number of 16-bit words
-		idxStream << recordSize16bits; //recordSize should already be expressed as a number of 16-bit words
+		if (file.write(batchData, batchSize) != batchSize)
+			return CC_FERR_WRITING;
 
-		ccLog::PrintDebug("[SHP] Saved shape #%d (%d bytes)", shapeIndex, recordSize16bits * 2);
-		shapeIndex++;
+		batchStart = batchEnd;
 	}
 
-	//update file lengths
-	UpdateFileLength(shpStream, static_cast<int32_t>(shpStream.device()->pos() / 2));
-	UpdateFileLength(idxStream, static_cast<int32_t>(idxStream.device()->pos() / 2));
-
 	file.close();
 	indexFile.close();
 
@@ -1863,91 +2303,132 @@ CC_FILE_ERROR ShpFilter::saveToFile(ccHObject* entity, const std::vector<Generic
 	DBFHandle dbfHandle = DBFCreate(qPrintable(dbfFilename));
 	if (dbfHandle)
 	{
+		//we declare all the fields first, as adding a field to a
+		//non-empty DBF file would require to rewrite all the records
+		int indexFieldIdx = -1;
+		int heightFieldIdx = -1;
+		std::vector< std::array<int, 3> > userFieldIndexes;
+		size_t recordCount = toSave.size();
+
 		while (true) //trick: we use 'while' to be able to break anytime
 		{
 			//always write an 'index' table
+			indexFieldIdx = DBFAddField(dbfHandle, "local_idx", FTInteger, 6, 0);
+			if (indexFieldIdx < 0)
 			{
-				int fieldIdx = DBFAddField(dbfHandle, "local_idx", FTInteger, 6, 0);
-				if (fieldIdx >= 0)
-				{
-					for (size_t i = 0; i < toSave.size(); ++i)
-						DBFWriteIntegerAttribute(dbfHandle, static_cast<int>(i), fieldIdx, static_cast<int>(i)+1);
-				}
-				else
+				ccLog::Warning(QString("[SHP] Failed to save field 'index' (default)"));
+				result = CC_FERR_WRITING;
+				break;
+			}
+
+			//write the '3D polylines height' field if request
+			if (save3DPolyHeightInDBF)
+			{
+				heightFieldIdx = DBFAddField(dbfHandle, "height", FTDouble, 8, 8);
+				if (heightFieldIdx < 0)
 				{
-					ccLog::Warning(QString("[SHP] Failed to save field 'index' (default)"));
+					ccLog::Warning(QString("[SHP] Failed to save field 'height' (3D polylines height)"));
 					result = CC_FERR_WRITING;
 					break;
 				}
 			}
 
-			//write the '3D polylines height' field if request
-			if (save3DPolyHeightInDBF)
+			//and the other tables (specified by the user)
+			for (GenericDBFField* field : fields)
 			{
-				int fieldIdx = DBFAddField(dbfHandle, "height", FTDouble, 8, 8);
-				if (fieldIdx >= 0)
+				std::array<int, 3> fieldIdx { -1, -1, -1 };
+				if (field->is3D()) //3D case
 				{
-					for (size_t i = 0; i < toSave.size(); ++i)
+					fieldIdx[0] = DBFAddField(dbfHandle, qPrintable(field->name() + QString("_x")), field->type(), field->width(), field->decimal());
+					fieldIdx[1] = DBFAddField(dbfHandle, qPrintable(field->name() + QString("_y")), field->type(), field->width(), field->decimal());
+					fieldIdx[2] = DBFAddField(dbfHandle, qPrintable(field->name() + QString("_z")), field->type(), field->width(), field->decimal());
+					if (fieldIdx[1] < 0 || fieldIdx[2] < 0)
 					{
-						ccPolyline* poly = static_cast<ccPolyline*>(toSave[i]);
-						double height = 0.0;
-						if (poly && poly->size() != 0)
-						{
-							const CCVector3* P0 = poly->getPoint(0);
-							CCVector3d Pg0 = poly->toGlobal3d(*P0);
-							height = Pg0.u[Z];
-						}
-						DBFWriteDoubleAttribute(dbfHandle, static_cast<int>(i), fieldIdx, height);
+						fieldIdx[0] = -1;
 					}
 				}
-				else
+				else //1D case
 				{
-					ccLog::Warning(QString("[SHP] Failed to save field 'height' (3D polylines height)"));
+					fieldIdx[0] = DBFAddField(dbfHandle, qPrintable(field->name()), field->type(), field->width(), field->decimal());
+				}
+
+				if (fieldIdx[0] < 0)
+				{
+					ccLog::Warning(QString("[SHP] Failed to save field '%1'").arg(field->name()));
 					result = CC_FERR_WRITING;
 					break;
 				}
+
+				userFieldIndexes.push_back(fieldIdx);
+				recordCount = std::max(recordCount, field->size());
 			}
 
-			//and write the other tables (specified by the user)
-			for (GenericDBFField* field: fields)
+			break;
+		}
+
+		//then we write the records one after the other (i.e. sequentially)
+		for (size_t i = 0; i < recordCount; ++i)
+		{
+			int recordIndex = static_cast<int>(i);
+
+			if (i < toSave.size())
 			{
-				if (field->is3D()) //3D case
+				if (indexFieldIdx >= 0)
 				{
-					int xFieldIdx = DBFAddField(dbfHandle, qPrintable(field->name() + QString("_x")), field->type(), field->width(), field->decimal());
-					int yFieldIdx = DBFAddField(dbfHandle, qPrintable(field->name() + QString("_y")), field->type(), field->width(), field->decimal());
-					int zFieldIdx = DBFAddField(dbfHandle, qPrintable(field->name() + QString("_z")), field->type(), field->width(), field->decimal());
-					if (xFieldIdx >= 0 && yFieldIdx >= 0 && zFieldIdx >= 0)
-					{
-						if (!field->save(dbfHandle, xFieldIdx, yFieldIdx, zFieldIdx))
-							xFieldIdx = -1;
-					}
+					DBFWriteIntegerAttribute(dbfHandle, recordIndex, indexFieldIdx, recordIndex + 1);
+				}
 
-					if (xFieldIdx < 0)
+				if (heightFieldIdx >= 0)
+				{
+					ccPolyline* poly = static_cast<ccPolyline*>(toSave[i]);
+					double height = 0.0;
+					if (poly && poly->size() != 0)
 					{
-						ccLog::Warning(QString("[SHP] Failed to save field '%1'").arg(field->name()));
-						result = CC_FERR_WRITING;
-						break;
+						const CCVector3* P0 = poly->getPoint(0);
+						CCVector3d Pg0 = poly->toGlobal3d(*P0);
+						height = Pg0.u[Z];
 					}
+					DBFWriteDoubleAttribute(dbfHandle, recordIndex, heightFieldIdx, height);
 				}
-				else //1D case
+			}
+
+			for (size_t j = 0; j < userFieldIndexes.size(); ++j)
+			{
+				const GenericDBFField* field = fields[j];
+				std::array<int, 3>& fieldIdx = userFieldIndexes[j];
+				if (fieldIdx[0] < 0 || i >= field->size())
 				{
-					int fieldIdx = DBFAddField(dbfHandle, qPrintable(field->name()), field->type(), field->width(), field->decimal());
-					if (fieldIdx >= 0)
-					{
-						if (!field->save(dbfHandle, fieldIdx))
-							fieldIdx = -1;
-					}
+					continue;
+				}
 
-					if (fieldIdx < 0)
-					{
-						ccLog::Warning(QString("[SHP] Failed to save field '%1'").arg(field->name()));
-						result = CC_FERR_WRITING;
-						break;
-					}
+				bool success = (field->is3D()	? field->saveValue(dbfHandle, fieldIdx[0], fieldIdx[1], fieldIdx[2], recordIndex)
+												: field->saveValue(dbfHandle, fieldIdx[0], recordIndex));
+				if (!success)
+				{
+					ccLog::Warning(QString("[SHP] Failed to save field '%1'").arg(field->name()));
+					result = CC_FERR_WRITING;
+					fieldIdx[0] = -1;
 				}
 			}
+		}
 
-			break;
+		//the fields that can't be written row by row are written column by column
+		for (size_t j = 0; j < userFieldIndexes.size(); ++j)
+		{
+			const GenericDBFField* field = fields[j];
+			const std::array<int, 3>& fieldIdx = userFieldIndexes[j];
+			if (fieldIdx[0] < 0 || field->size() != 0)
+			{
+				continue;
+			}
+
+			bool success = (field->is3D()	? field->save(dbfHandle, fieldIdx[0], fieldIdx[1], fieldIdx[2])
+											: field->save(dbfHandle, fieldIdx[0]));
+			if (!success)
+			{
+				ccLog::Warning(QString("[SHP] Failed to save field '%1'").arg(field->name()));
+				result = CC_FERR_WRITING;
+			}
 		}
 
 		DBFClose(dbfHandle);
@@ -2001,124 +2482,174 @@ CC_FILE_ERROR ShpFilter::loadFile(const QString& filename, ccHObject& container,
 		QApplication::processEvents();
 	}
 
+	//we access the records directly in memory
+	QByteArray fileContent;
+	const char* shpData = reinterpret_cast<const char*>(file.map(0, fileSize));
+	if (!shpData)
+	{
+		file.seek(0);
+		fileContent = file.readAll();
+		if (fileContent.size() != fileSize)
+		{
+			ccLog::Warning("[SHP] Something went wrong reading the file");
+			return CC_FERR_READING;
+		}
+		shpData = fileContent.constData();
+	}
+
+	QFileInfo fi(filename);
+	QString baseFileName = fi.path() + QString("/") + fi.completeBaseName();
+
+	//list the records (thanks to the index file if possible)
+	std::vector<ShpRecordIndex> recordIndexes;
+	error = ListRecords(shpData, fileSize, hdr.fileLength, baseFileName + QString(".shx"), recordIndexes);
+	if (error != CC_FERR_NO_ERROR)
+		return error;
+
 	//load shapes
-	error = CC_FERR_NO_ERROR;
 	ccPointCloud* singlePoints = nullptr;
 	//we also keep track of the polylines 'record number' (if any)
 	QMap<ccPolyline*, int32_t> polyIDs;
 	int32_t maxPolyID = 0;
 	int32_t maxPointID = 0;
 	bool is3DShape = false;
-	while (hdr.fileLength - shpStream.device()->pos() > 0)
+	std::vector<ShpRecordToLoad> batch;
+	for (size_t batchStart = 0; batchStart < recordIndexes.size() && error == CC_FERR_NO_ERROR; )
 	{
-		if (shpStream.status() != QDataStream::Ok )
+		//the records are decoded concurrently, by batches
+		size_t batchEnd = batchStart;
+		qint64 batchSize = 0;
+		while (batchEnd < recordIndexes.size() && batchEnd - batchStart < s_shpReadBatchCount && (batchEnd == batchStart || batchSize < s_shpReadBatchSize))
 		{
-			ccLog::Warning("[SHP] Something went wrong reading the file");
-			return CC_FERR_READING;
+			batchSize += 2 * static_cast<qint64>(recordIndexes[batchEnd].recordSize16bits);
+			++batchEnd;
 		}
-		shpStream.setByteOrder(QDataStream::BigEndian);
-		int32_t recordNumber;
-		shpStream >> recordNumber;
-		int32_t recordSize16bits;
-		shpStream >> recordSize16bits;
-		
-		shpStream.setByteOrder(QDataStream::LittleEndian);
-		int64_t recordStart = shpStream.device()->pos();
 
-		int32_t shapeTypeInt;
-		shpStream >> shapeTypeInt;
-
-		if (!IsValidESRIShapeCode(shapeTypeInt))
+		batch.clear();
+		try
 		{
-			ccLog::Warning("[SHP] Shape %d has an invalid shape code (%d)", recordNumber, shapeTypeInt);
-			return CC_FERR_READING;
+			batch.resize(batchEnd - batchStart);
+		}
+		catch (const std::bad_alloc&)
+		{
+			error = CC_FERR_NOT_ENOUGH_MEMORY;
+			break;
+		}
+		for (size_t i = 0; i < batch.size(); ++i)
+		{
+			batch[i].index = recordIndexes[batchStart + i];
 		}
-		ESRI_SHAPE_TYPE shapeType = static_cast<ESRI_SHAPE_TYPE>(shapeTypeInt);
 
-		if (recordNumber < 64)
-			ccLog::Print(QString("[SHP] Record #%1 - type: %2 (%3 bytes)").arg(recordNumber).arg(ToString(shapeType)).arg(recordSize16bits * 2)); //recordSize is measured in 16-bit words
-		else if (recordNumber == 64)
-			ccLog::Print("[SHP] Records won't be displayed in the Console anymore to avoid flooding it...");
+		QtConcurrent::blockingMap(batch, [shpData, Pshift](ShpRecordToLoad& record) { DecodeRecord(record, shpData, Pshift); });
 
-		switch (shapeType)
+		//while the entities are created sequentially (and in the same order as the records)
+		for (ShpRecordToLoad& record : batch)
 		{
-			case ESRI_SHAPE_TYPE::POLYLINE_Z:
-			case ESRI_SHAPE_TYPE::POLYGON_Z:
-				is3DShape = true;
-			case ESRI_SHAPE_TYPE::POLYLINE:
-			case ESRI_SHAPE_TYPE::POLYGON:
-			case ESRI_SHAPE_TYPE::POLYLINE_M:
-			case ESRI_SHAPE_TYPE::POLYGON_M:
+			const ShpRecordIndex recordIndex = record.index;
+			const int32_t recordNumber = recordIndex.recordNumber;
+			const int32_t recordSize16bits = recordIndex.recordSize16bits;
+
+			if (record.error == CC_FERR_READING)
+			{
+				ccLog::Warning("[SHP] Something went wrong reading the file");
+				error = CC_FERR_READING;
+				break;
+			}
+
+			if (!IsValidESRIShapeCode(record.shapeTypeInt))
+			{
+				ccLog::Warning("[SHP] Shape %d has an invalid shape code (%d)", recordNumber, record.shapeTypeInt);
+				error = CC_FERR_READING;
+				break;
+			}
+			ESRI_SHAPE_TYPE shapeType = static_cast<ESRI_SHAPE_TYPE>(record.shapeTypeInt);
+
+			if (recordNumber < 64)
+				ccLog::Print(QString("[SHP] Record #%1 - type: %2 (%3 bytes)").arg(recordNumber).arg(ToString(shapeType)).arg(recordSize16bits * 2)); //recordSize is measured in 16-bit words
+			else if (recordNumber == 64)
+				ccLog::Print("[SHP] Records won't be displayed in the Console anymore to avoid flooding it...");
+
+			if (record.noMeasurements)
+				ccLog::WarningDebug("Entity has no measurements");
+
+			error = record.error;
+			if (error == CC_FERR_NO_ERROR)
 			{
-				unsigned childCountBefore = container.getChildrenNumber();
-				error = LoadPolyline(shpStream, container, recordNumber, shapeType, recordSize16bits, recordStart, Pshift, preserveCoordinateShift);
-				if (error == CC_FERR_NO_ERROR && shapeType == ESRI_SHAPE_TYPE::POLYLINE)
+				switch (shapeType)
 				{
-					unsigned childCountAfter = container.getChildrenNumber();
-					//warning: we can load mutliple polylines for a single record!
-					for (unsigned i = childCountBefore; i < childCountAfter; ++i)
+					case ESRI_SHAPE_TYPE::POLYLINE_Z:
+					case ESRI_SHAPE_TYPE::POLYGON_Z:
+						is3DShape = true;
+					case ESRI_SHAPE_TYPE::POLYLINE:
+					case ESRI_SHAPE_TYPE::POLYGON:
+					case ESRI_SHAPE_TYPE::POLYLINE_M:
+					case ESRI_SHAPE_TYPE::POLYGON_M:
 					{
-						ccHObject* child = container.getChild(i);
-						assert(child && child->isA(CC_TYPES::POLY_LINE));
-						polyIDs[static_cast<ccPolyline*>(child)] = recordNumber;
-						if (recordNumber > maxPolyID)
-							maxPolyID = recordNumber;
+						unsigned childCountBefore = container.getChildrenNumber();
+						error = BuildPolylines(container, record, shapeType, Pshift, preserveCoordinateShift);
+						if (error == CC_FERR_NO_ERROR && shapeType == ESRI_SHAPE_TYPE::POLYLINE)
+						{
+							unsigned childCountAfter = container.getChildrenNumber();
+							//warning: we can load mutliple polylines for a single record!
+							for (unsigned i = childCountBefore; i < childCountAfter; ++i)
+							{
+								ccHObject* child = container.getChild(i);
+								assert(child && child->isA(CC_TYPES::POLY_LINE));
+								polyIDs[static_cast<ccPolyline*>(child)] = recordNumber;
+								if (recordNumber > maxPolyID)
+									maxPolyID = recordNumber;
+							}
+						}
 					}
+					break;
+					case ESRI_SHAPE_TYPE::MULTI_POINT_Z:
+					case ESRI_SHAPE_TYPE::MULTI_POINT_M:
+						is3DShape = true;
+					case ESRI_SHAPE_TYPE::MULTI_POINT:
+						error = BuildCloud(container, record, Pshift, preserveCoordinateShift);
+						break;
+					case ESRI_SHAPE_TYPE::POINT_Z:
+					case ESRI_SHAPE_TYPE::POINT_M:
+						is3DShape = true;
+					case ESRI_SHAPE_TYPE::POINT:
+						error = AddSinglePoint(singlePoints, record, Pshift, preserveCoordinateShift);
+						if (error == CC_FERR_NO_ERROR && recordNumber > maxPointID)
+						{
+							maxPointID = recordNumber;
+						}
+						break;
+					case ESRI_SHAPE_TYPE::MULTI_PATCH:
+						error = BuildPatches(container, record.startIndexes, record.partTypes, record.points, record.scalarValues);
+					case ESRI_SHAPE_TYPE::NULL_SHAPE:
+						//ignored
+						break;
+					default:
+						//unhandled entity
+						ccLog::Warning("[SHP] Unhandled type!");
+						break;
 				}
 			}
-			break;
-			case ESRI_SHAPE_TYPE::MULTI_POINT_Z:
-			case ESRI_SHAPE_TYPE::MULTI_POINT_M:
-				is3DShape = true;
-			case ESRI_SHAPE_TYPE::MULTI_POINT:
-				error = LoadCloud(shpStream, container, recordNumber, shapeType, recordSize16bits, recordStart, Pshift, preserveCoordinateShift);
-				break;
-			case ESRI_SHAPE_TYPE::POINT_Z:
-			case ESRI_SHAPE_TYPE::POINT_M:
-				is3DShape = true;
-			case ESRI_SHAPE_TYPE::POINT:
-				error = LoadSinglePoint(shpStream, singlePoints, shapeType, recordSize16bits, Pshift, preserveCoordinateShift);
-				if (error == CC_FERR_NO_ERROR && recordNumber > maxPointID)
-				{
-					maxPointID = recordNumber;
-				}
-				break;
-			case ESRI_SHAPE_TYPE::MULTI_PATCH:
-				error = LoadMultiPatch(shpStream, container, recordSize16bits, recordStart, Pshift);
-			case ESRI_SHAPE_TYPE::NULL_SHAPE:
-				//ignored
-				break;
-			default:
-				//unhandled entity
-				shpStream.skipRawData(recordSize16bits * 2 - sizeof(shapeTypeInt)); //recordSize is measured in 16-bit words
-				ccLog::Warning("[SHP] Unhandled type!");
-				break;
-		}
-
-		if (error != CC_FERR_NO_ERROR)
-		{
-			break;
-		}
-
-		qint64 filePos = shpStream.device()->pos();
-		ccLog::PrintDebug(
-			QString("[SHP] File position = %1 / record start = %2 / record size = %3 (x2) / position shift = %4")
-			.arg(filePos)
-			.arg(recordStart)
-			.arg(recordSize16bits)
-			.arg(filePos - (recordStart + recordSize16bits * 2)));
 
-		assert(shpStream.device()->pos() == recordStart + recordSize16bits * 2); //recordSize is measured in 16-bit words
+			//we don't need the decoded data anymore
+			record = ShpRecordToLoad();
 
-		if (pDlg)
-		{
-			pDlg->setValue(static_cast<int>(shpStream.device()->pos()));
-			if (pDlg->wasCanceled())
+			if (error != CC_FERR_NO_ERROR)
 			{
-				error = CC_FERR_CANCELED_BY_USER;
 				break;
 			}
+
+			if (pDlg)
+			{
+				pDlg->setValue(static_cast<int>(recordIndex.end()));
+				if (pDlg->wasCanceled())
+				{
+					error = CC_FERR_CANCELED_BY_USER;
+					break;
+				}
+			}
 		}
+
+		batchStart = batchEnd;
 	}
 
 	//try to load the DBF to see if there's a 'height' field or something similar for polylines
@@ -2127,8 +2658,6 @@ CC_FILE_ERROR ShpFilter::loadFile(const QString& filename, ccHObject& container,
 	                  maxPointID == static_cast<int32_t>(singlePoints->size()));
 	if (!is3DShape && error == CC_FERR_NO_ERROR && (hasPolylines || hasPoints))
 	{
-		QFileInfo fi(filename);
-		QString baseFileName = fi.path() + QString("/") + fi.completeBaseName();
 		//try to load the DB file (suffix should be ".dbf")
 		QString dbfFilename = baseFileName + QString(".dbf");
 		DBFHandle dbfHandle = DBFOpen(qPrintable(dbfFilename), "rb");
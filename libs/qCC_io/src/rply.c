@@ -705,6 +705,39 @@ int ply_write(p_ply ply, double value) {
     return !breakafter || putc('\n', ply->fp) > 0;
 }
 
+int ply_write_raw_instances(p_ply ply, const void *data, size_t size, long ninstances) {
+    p_ply_element element = NULL;
+    long i;
+    assert(ply && ply->fp && ply->io_mode == PLY_WRITE);
+    if (ply->storage_mode == PLY_ASCII) return 0;
+    if (ply->welement >= ply->nelements) return 0;
+    element = &ply->element[ply->welement];
+    /* we must be at the beginning of an instance */
+    if (ply->wproperty != 0 || ply->wvalue_index != 0) return 0;
+    if (ply->winstance_index + ninstances > element->ninstances) return 0;
+    for (i = 0; i < element->nproperties; i++)
+        if (element->property[i].type == PLY_LIST) return 0;
+    /* flush the pending data, then write the records directly */
+    if (ply->buffer_last > 0) {
+        if (fwrite(ply->buffer, 1, ply->buffer_last, ply->fp) < ply->buffer_last) {
+            ply_ferror(ply, "Error writing buffered data");
+            return 0;
+        }
+        ply->buffer_last = 0;
+    }
+    if (size > 0 && fwrite(data, 1, size, ply->fp) < size) {
+        ply_ferror(ply, "Failed writing %ld instances of %s", 
+                    ninstances, element->name);
+        return 0;
+    }
+    ply->winstance_index += ninstances;
+    if (ply->winstance_index >= element->ninstances) {
+        ply->winstance_index = 0;
+        ply->welement++;
+    }
+    return 1;
+}
+
 int ply_close(p_ply ply) {
     long i;
     assert(ply && ply->fp);
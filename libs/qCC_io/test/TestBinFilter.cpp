@@ -0,0 +1,236 @@
+#include "TestBinFilter.h"
+
+#include "BinFilter.h"
+#include "ccArrayCodec.h"
+#include "ccPointCloud.h"
+#include "ccScalarField.h"
+#include "ccSerializableObject.h"
+#include "ccWaveformBlockStorage.h"
+
+#include <cstdint>
+#include <cstring>
+
+static const unsigned s_pointCount = 1000;
+
+//! Creates a cloud with a scalar field
+static ccPointCloud* CreateCloud()
+{
+	ccPointCloud* cloud = new ccPointCloud("cloud");
+	if (!cloud->reserve(s_pointCount))
+	{
+		delete cloud;
+		return nullptr;
+	}
+
+	ccScalarField* sf = new ccScalarField("values");
+	if (!sf->reserveSafe(s_pointCount))
+	{
+		sf->release();
+		delete cloud;
+		return nullptr;
+	}
+
+	for (unsigned i = 0; i < s_pointCount; ++i)
+	{
+		cloud->addPoint(CCVector3(static_cast<PointCoordinateType>(i), static_cast<PointCoordinateType>(2 * i), static_cast<PointCoordinateType>(3 * i)));
+		sf->addElement(static_cast<ScalarType>(i) / 2);
+	}
+	sf->computeMinAndMax();
+	cloud->addScalarField(sf);
+
+	return cloud;
+}
+
+//! Saves a cloud then reads it back
+static void RoundTrip(const QString& filename, bool& success)
+{
+	success = false;
+
+	QScopedPointer<ccPointCloud> cloud(CreateCloud());
+	QVERIFY(cloud);
+
+	FileIOFilter::SaveParameters saveParams;
+	saveParams.alwaysDisplaySaveDialog = false;
+	BinFilter filter;
+	CC_FILE_ERROR error = filter.saveToFile(cloud.data(), filename, saveParams);
+	QVERIFY(error == CC_FERR_NO_ERROR);
+
+	ccHObject container;
+	FileIOFilter::LoadParameters loadParams;
+	loadParams.alwaysDisplayLoadDialog = false;
+	error = filter.loadFile(filename, container, loadParams);
+	QVERIFY(error == CC_FERR_NO_ERROR);
+
+	QVERIFY(container.getChildrenNumber() == 1);
+	ccHObject* child = container.getChild(0);
+	QVERIFY(child->isA(CC_TYPES::POINT_CLOUD));
+
+	ccPointCloud* loaded = static_cast<ccPointCloud*>(child);
+	QVERIFY(loaded->size() == s_pointCount);
+	QVERIFY(loaded->getNumberOfScalarFields() == 1);
+	CCCoreLib::ScalarField* sf = loaded->getScalarField(0);
+	QVERIFY(sf->size() == s_pointCount);
+
+	for (unsigned i = 0; i < s_pointCount; ++i)
+	{
+		const CCVector3* P = loaded->getPoint(i);
+		QCOMPARE(P->x, static_cast<PointCoordinateType>(i));
+		QCOMPARE(P->y, static_cast<PointCoordinateType>(2 * i));
+		QCOMPARE(P->z, static_cast<PointCoordinateType>(3 * i));
+		QCOMPARE(sf->getValue(i), static_cast<ScalarType>(i) / 2);
+	}
+
+	success = true;
+}
+
+//! Returns whether a file contains the 64-bit header of an array with s_pointCount elements
+static bool ContainsLargeArrayHeader(const QString& filename)
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		return false;
+	}
+
+	char header[12];
+	::uint32_t tag = 0xFFFFFFFF;
+	::uint64_t elementCount = s_pointCount;
+	memcpy(header, &tag, 4);
+	memcpy(header + 4, &elementCount, 8);
+
+	return file.readAll().contains(QByteArray(header, 12));
+}
+
+void TestBinFilter::testSmallArrays() const
+{
+	QTemporaryDir tmpDir;
+	QString filename = tmpDir.filePath("small.bin");
+
+	bool success = false;
+	RoundTrip(filename, success);
+	QVERIFY(success);
+
+	QVERIFY(BinFilter::GetLastSavedFileVersion() < ccSerializationHelper::LargeArrayMinFileVersion);
+	QVERIFY(!ContainsLargeArrayHeader(filename));
+}
+
+void TestBinFilter::testLargeArrayHeader() const
+{
+	//the arrays with more than 100 elements are considered as 'large'
+	ccArrayCodec::SetLargeArrayThreshold(100);
+
+	QTemporaryDir tmpDir;
+	QString filename = tmpDir.filePath("large.bin");
+
+	bool success = false;
+	RoundTrip(filename, success);
+	QVERIFY(success);
+
+	QVERIFY(BinFilter::GetLastSavedFileVersion() == ccSerializationHelper::LargeArrayMinFileVersion);
+	QVERIFY(ContainsLargeArrayHeader(filename));
+}
+
+//! Adds FWF data to a cloud (8 samples per point)
+static bool AddFWF(ccPointCloud& cloud)
+{
+	WaveformDescriptor d;
+	d.numberOfSamples = 8;
+	d.samplingRate_ps = 1000;
+	d.digitizerGain = 1.0;
+	d.digitizerOffset = 0.0;
+	d.bitsPerSample = 8;
+	cloud.fwfDescriptors().insert(1, d);
+
+	if (!cloud.resizeTheFWFTable())
+	{
+		return false;
+	}
+
+	ccPointCloud::FWFDataContainer* data = new ccPointCloud::FWFDataContainer(cloud.size() * d.numberOfSamples);
+	for (unsigned i = 0; i < cloud.size(); ++i)
+	{
+		ccWaveform& w = cloud.waveforms()[i];
+		w.setDescriptorID(1);
+		w.setDataDescription(i * d.numberOfSamples, d.numberOfSamples);
+		for (uint32_t j = 0; j < d.numberOfSamples; ++j)
+		{
+			(*data)[i * d.numberOfSamples + j] = static_cast<uint8_t>(i + j);
+		}
+	}
+	cloud.fwfData() = ccPointCloud::SharedFWFDataContainer(data);
+
+	return true;
+}
+
+//! Checks the FWF data of a cloud (see AddFWF)
+static bool CheckFWF(const ccPointCloud& cloud, const ccWaveformBlockStorage* blocks = nullptr)
+{
+	ccWaveformBlockStorage::Cache cache;
+	for (unsigned i = 0; i < cloud.size(); ++i)
+	{
+		ccWaveformProxy proxy = (blocks ? blocks->waveformProxy(cloud, i, cache) : cloud.waveformProxy(i, cache));
+		if (!proxy.isValid() || proxy.numberOfSamples() != 8)
+		{
+			return false;
+		}
+		for (uint32_t j = 0; j < 8; ++j)
+		{
+			if (proxy.getRawSample(j) != static_cast<uint8_t>(i + j))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void TestBinFilter::testPackedFWF() const
+{
+	QScopedPointer<ccPointCloud> cloud(CreateCloud());
+	QVERIFY(cloud);
+	QVERIFY(AddFWF(*cloud));
+
+	//small blocks (random access over several blocks)
+	ccWaveformBlockStorage blocks;
+	QVERIFY(blocks.compress(*cloud, 1024));
+	QVERIFY(blocks.blockCount() > 1);
+	QVERIFY(CheckFWF(*cloud, &blocks));
+
+	QVERIFY(cloud->packFWFData());
+	QVERIFY(cloud->isFWFDataPacked());
+	QVERIFY(cloud->hasFWF());
+	QVERIFY(CheckFWF(*cloud));
+
+	QTemporaryDir tmpDir;
+	QString filename = tmpDir.filePath("fwf.bin");
+
+	FileIOFilter::SaveParameters saveParams;
+	saveParams.alwaysDisplaySaveDialog = false;
+	BinFilter filter;
+	QVERIFY(filter.saveToFile(cloud.data(), filename, saveParams) == CC_FERR_NO_ERROR);
+	QVERIFY(BinFilter::GetLastSavedFileVersion() == ccWaveformBlockStorage::MinFileVersion);
+
+	ccHObject container;
+	FileIOFilter::LoadParameters loadParams;
+	loadParams.alwaysDisplayLoadDialog = false;
+	QVERIFY(filter.loadFile(filename, container, loadParams) == CC_FERR_NO_ERROR);
+	QVERIFY(container.getChildrenNumber() == 1);
+	QVERIFY(container.getChild(0)->isA(CC_TYPES::POINT_CLOUD));
+
+	ccPointCloud* loaded = static_cast<ccPointCloud*>(container.getChild(0));
+	QVERIFY(loaded->isFWFDataPacked());
+	QVERIFY(CheckFWF(*loaded));
+
+	//unpacking on demand
+	QVERIFY(loaded->fwfData() && loaded->fwfData()->size() == s_pointCount * 8);
+	QVERIFY(!loaded->isFWFDataPacked());
+	QVERIFY(CheckFWF(*loaded));
+}
+
+void TestBinFilter::cleanup() const
+{
+	ccArrayCodec::SetLargeArrayThreshold(ccArrayCodec::DefaultLargeArrayThreshold);
+}
+
+QTEST_MAIN(TestBinFilter)
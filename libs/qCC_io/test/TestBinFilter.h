@@ -0,0 +1,35 @@
+#ifndef CC_TEST_BIN_FILTER_HEADER
+#define CC_TEST_BIN_FILTER_HEADER
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class TestBinFilter : public QObject
+{
+Q_OBJECT
+private slots:
+	/*
+	 * Saves (then reads back) a cloud with the default 32-bit array headers:
+	 * the file version must not require the 64-bit array headers
+	 */
+	void testSmallArrays() const;
+
+	/*
+	 * Saves (then reads back) a cloud with a lowered 'large array' threshold,
+	 * so that its arrays are written with the 64-bit header (0xFFFFFFFF tag
+	 * followed by the 64-bit element count)
+	 */
+	void testLargeArrayHeader() const;
+
+	/*
+	 * Packs the FWF data of a cloud (block compression) and checks that the
+	 * waveforms can still be accessed, then saves (and reads back) the cloud:
+	 * the FWF data must remain packed
+	 */
+	void testPackedFWF() const;
+
+	void cleanup() const;
+};
+
+
+#endif //CC_TEST_BIN_FILTER_HEADER
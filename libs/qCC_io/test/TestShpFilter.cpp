@@ -583,4 +583,61 @@ void TestShpFilter::readSinglePointZFile(const QString &filePath) const
 	}
 }
 
+void TestShpFilter::testWriteManyPolylines() const
+{
+	const unsigned polylineCount = 5000;
+
+	ccHObject container;
+	for (unsigned i = 0; i < polylineCount; ++i)
+	{
+		ccPointCloud* vertices = new ccPointCloud("vertices");
+		QVERIFY(vertices->reserve(3));
+		vertices->addPoint(CCVector3(static_cast<PointCoordinateType>(i), 0, 1));
+		vertices->addPoint(CCVector3(static_cast<PointCoordinateType>(i), 1, 2));
+		vertices->addPoint(CCVector3(static_cast<PointCoordinateType>(i), 2, 3));
+
+		ccPolyline* poly = new ccPolyline(vertices);
+		poly->addChild(vertices);
+		QVERIFY(poly->reserve(3));
+		poly->addPointIndex(0, 3);
+		poly->set2DMode(false);
+		container.addChild(poly);
+	}
+
+	QTemporaryDir tmpDir;
+	QString tmpLines = tmpDir.filePath("lines.shp");
+	FileIOFilter::SaveParameters saveParams;
+	saveParams.alwaysDisplaySaveDialog = false;
+	ShpFilter filter;
+	filter.save3DPolyAs2D(false);
+	filter.save3DPolyHeightInDBF(false);
+
+	CC_FILE_ERROR error = filter.saveToFile(&container, tmpLines, saveParams);
+	QVERIFY(error == CC_FERR_NO_ERROR);
+
+	ccHObject loaded;
+	FileIOFilter::LoadParameters params;
+	error = filter.loadFile(tmpLines, loaded, params);
+	QVERIFY(error == CC_FERR_NO_ERROR);
+
+	//the polylines must be loaded in the same order
+	QVERIFY(loaded.getChildrenNumber() == polylineCount);
+	for (unsigned i = 0; i < polylineCount; ++i)
+	{
+		ccHObject* child = loaded.getChild(i);
+		QVERIFY(child->isA(CC_TYPES::POLY_LINE));
+		QCOMPARE(child->getName(), QString("Polyline #%1").arg(i + 1));
+
+		auto* vertices = static_cast<ccPolyline*>(child)->getAssociatedCloud();
+		QVERIFY(vertices->size() == 3);
+		for (unsigned j = 0; j < 3; ++j)
+		{
+			const CCVector3* P = vertices->getPoint(j);
+			QCOMPARE(P->x, static_cast<PointCoordinateType>(i));
+			QCOMPARE(P->y, static_cast<PointCoordinateType>(j));
+			QCOMPARE(P->z, static_cast<PointCoordinateType>(j + 1));
+		}
+	}
+}
+
 QTEST_MAIN(TestShpFilter)
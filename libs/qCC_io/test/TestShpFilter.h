@@ -59,6 +59,13 @@ private:
 	void testWritePolygonFile() const;
 
 	void testWritePolygonZFile() const;
+
+private slots:
+	/*
+	 * Writes (then reads back) enough polylines for the records
+	 * to be encoded and decoded concurrently
+	 */
+	void testWriteManyPolylines() const;
 };
 
 
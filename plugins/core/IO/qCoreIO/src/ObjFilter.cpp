@@ -24,7 +24,9 @@
 #include <QFileInfo>
 #include <QString>
 #include <QStringList>
+#include <QTextCodec>
 #include <QTextStream>
+#include <QtConcurrentMap>
 
 //qCC_db
 #include <ccChunk.h>
@@ -39,11 +41,17 @@
 #include <ccProgressDialog.h>
 #include <ccSubMesh.h>
 
+//CCPluginAPI
+#include <ccQtHelpers.h>
+
 //CCCoreLib
 #include <Delaunay2dMesh.h>
 
 //System
+#include <algorithm>
+#include <cassert>
 #include <cstring>
+#include <string>
 
 
 ObjFilter::ObjFilter()
@@ -534,6 +542,406 @@ struct facetElement
 	}
 };
 
+//! OBJ record types (output of the parallel parsing pass)
+enum ObjRecordType : unsigned char
+{
+	OBJ_VERTEX = 0,			//!< 'v' record
+	OBJ_TEX_COORD,			//!< 'vt' record
+	OBJ_NORMAL,				//!< 'vn' record
+	OBJ_INVALID_NORMAL,		//!< 'vn' record that had to be normalized
+	OBJ_FACE,				//!< 'f' record
+	OBJ_SHORT_FACE,			//!< 'f' record with less than 3 vertices
+	OBJ_INVALID_FACE,		//!< 'f' record with a missing vertex index
+	OBJ_MALFORMED_LINE,		//!< 'v', 'vt' or 'vn' record with missing values
+	OBJ_OTHER_LINE,			//!< any other record (interpreted during the sequential pass)
+};
+
+//! Chunk of an OBJ file
+/** Chunks are parsed concurrently. The parsed values are stored in per-chunk
+	buffers that are re-used from one batch of chunks to the next. Everything
+	that depends on the previous lines (relative indexes, groups, materials,
+	etc.) is resolved afterwards, when the chunks are merged in file order.
+**/
+struct ObjChunk
+{
+	//! Token (start + length)
+	using Token = std::pair<const char*, int>;
+
+	//! Chunk text (always starts at the beginning of a line)
+	const char* begin = nullptr;
+	//! Chunk text end
+	const char* end = nullptr;
+
+	//! Record types (in file order)
+	std::vector<unsigned char> records;
+	//! Vertices ('v' records)
+	std::vector<CCVector3d> vertices;
+	//! Texture coordinates ('vt' records)
+	std::vector<TexCoords2D> texCoords;
+	//! Compressed normals ('vn' records)
+	std::vector<CompressedNormType> normals;
+	//! Number of elements of each face ('f' records)
+	std::vector<unsigned> faceSizes;
+	//! Face elements ('f' records)
+	std::vector<facetElement> faceElements;
+	//! Other lines (see OBJ_OTHER_LINE)
+	std::vector<QByteArray> otherLines;
+	//! Whether parsing failed because of a lack of memory
+	bool notEnoughMemory = false;
+
+	//! Current line tokens
+	std::vector<Token> tokens;
+	//! Buffer used to convert tokens to numbers
+	QByteArray number;
+	//! Buffer used to concatenate multi-line records
+	std::string joinedLine;
+
+	//! Clears the chunk (but keeps the memory)
+	void clear()
+	{
+		begin = end = nullptr;
+		records.clear();
+		vertices.clear();
+		texCoords.clear();
+		normals.clear();
+		faceSizes.clear();
+		faceElements.clear();
+		otherLines.clear();
+		notEnoughMemory = false;
+	}
+
+	//! Converts a token to a double value (same rules as QString::toDouble)
+	double toDouble(const Token& token)
+	{
+		number.resize(token.second);
+		memcpy(number.data(), token.first, token.second);
+		return number.toDouble();
+	}
+
+	//! Converts a token to a float value (same rules as QString::toFloat)
+	float toFloat(const Token& token)
+	{
+		number.resize(token.second);
+		memcpy(number.data(), token.first, token.second);
+		return number.toFloat();
+	}
+
+	//! Converts a token to an integer value (same rules as QString::toInt)
+	int toInt(const char* start, int length)
+	{
+		number.resize(length);
+		memcpy(number.data(), start, length);
+		return number.toInt();
+	}
+};
+
+//! Position of the merging process in a chunk
+struct ObjChunkCursor
+{
+	size_t vertex = 0;
+	size_t texCoord = 0;
+	size_t normal = 0;
+	size_t face = 0;
+	size_t faceElement = 0;
+	size_t otherLine = 0;
+};
+
+//! Chunk size (in bytes)
+static const size_t s_objChunkSize = (1 << 22); //4 Mb
+
+//! Returns whether a character is a white space (same definition as QChar::isSpace for ASCII characters)
+static inline bool IsObjSpace(char c)
+{
+	return (c == ' ' || (c >= '\t' && c <= '\r'));
+}
+
+//! Tests a token value
+static inline bool TokenEquals(const ObjChunk::Token& token, const char* str)
+{
+	size_t length = strlen(str);
+	return (static_cast<size_t>(token.second) == length && strncmp(token.first, str, length) == 0);
+}
+
+//! Parses a single (logical) OBJ line
+/** \param begin line start
+	\param end line end
+	\param chunk output chunk
+	\param asciiOnly whether lines with non-ASCII characters should be left to the sequential pass (see OBJ_OTHER_LINE)
+**/
+static void ParseObjLine(const char* begin, const char* end, ObjChunk& chunk, bool asciiOnly)
+{
+	//split the line
+	chunk.tokens.clear();
+	for (const char* c = begin; c != end; )
+	{
+		if (IsObjSpace(*c))
+		{
+			++c;
+			continue;
+		}
+
+		const char* tokenStart = c;
+		for (; c != end && !IsObjSpace(*c); ++c)
+		{
+			if (asciiOnly && (*c == 0 || static_cast<unsigned char>(*c) > 127))
+			{
+				//we let QString handle the text decoding (and the unicode white spaces)
+				chunk.records.push_back(OBJ_OTHER_LINE);
+				chunk.otherLines.emplace_back(begin, static_cast<int>(end - begin));
+				return;
+			}
+		}
+		chunk.tokens.emplace_back(tokenStart, static_cast<int>(c - tokenStart));
+	}
+
+	const std::vector<ObjChunk::Token>& tokens = chunk.tokens;
+
+	//skip comments & empty lines
+	if (tokens.empty() || *tokens.front().first == '/' || *tokens.front().first == '#')
+	{
+		return;
+	}
+
+	const ObjChunk::Token& front = tokens.front();
+
+	/*** new vertex ***/
+	if (TokenEquals(front, "v"))
+	{
+		//malformed line?
+		if (tokens.size() < 4)
+		{
+			chunk.records.push_back(OBJ_MALFORMED_LINE);
+			return;
+		}
+
+		chunk.vertices.emplace_back(chunk.toDouble(tokens[1]), chunk.toDouble(tokens[2]), chunk.toDouble(tokens[3]));
+		chunk.records.push_back(OBJ_VERTEX);
+	}
+	/*** new vertex texture coordinates ***/
+	else if (TokenEquals(front, "vt"))
+	{
+		//malformed line?
+		if (tokens.size() < 2)
+		{
+			chunk.records.push_back(OBJ_MALFORMED_LINE);
+			return;
+		}
+
+		TexCoords2D T(chunk.toFloat(tokens[1]), 0);
+
+		if (tokens.size() > 2) //OBJ specification allows for only one value!!!
+		{
+			T.ty = chunk.toFloat(tokens[2]);
+		}
+
+		chunk.texCoords.push_back(T);
+		chunk.records.push_back(OBJ_TEX_COORD);
+	}
+	/*** new vertex normal ***/
+	else if (TokenEquals(front, "vn"))
+	{
+		//malformed line?
+		if (tokens.size() < 4)
+		{
+			chunk.records.push_back(OBJ_MALFORMED_LINE);
+			return;
+		}
+
+		CCVector3 N(static_cast<PointCoordinateType>(chunk.toDouble(tokens[1])),
+					static_cast<PointCoordinateType>(chunk.toDouble(tokens[2])),
+					static_cast<PointCoordinateType>(chunk.toDouble(tokens[3])));
+
+		if (std::abs(N.norm2d() - 1.0) > 0.005)
+		{
+			N.normalize();
+			chunk.records.push_back(OBJ_INVALID_NORMAL);
+		}
+		else
+		{
+			chunk.records.push_back(OBJ_NORMAL);
+		}
+		chunk.normals.push_back(ccNormalVectors::GetNormIndex(N.u));
+	}
+	/*** new face ***/
+	else if (*front.first == 'f')
+	{
+		//malformed line?
+		if (tokens.size() < 4)
+		{
+			chunk.records.push_back(OBJ_SHORT_FACE);
+			return;
+		}
+
+		//read the face elements (singleton, pair or triplet)
+		for (size_t i = 1; i < tokens.size(); ++i)
+		{
+			const char* c = tokens[i].first;
+			const char* tokenEnd = c + tokens[i].second;
+
+			//split the element ('/' separator)
+			const char* parts[3] { nullptr, nullptr, nullptr };
+			int partLengths[3] { 0, 0, 0 };
+			for (int p = 0; p < 3; ++p)
+			{
+				const char* partEnd = static_cast<const char*>(memchr(c, '/', tokenEnd - c));
+				if (!partEnd)
+				{
+					partEnd = tokenEnd;
+				}
+				parts[p] = c;
+				partLengths[p] = static_cast<int>(partEnd - c);
+				if (partEnd == tokenEnd)
+				{
+					break;
+				}
+				c = partEnd + 1;
+			}
+
+			if (partLengths[0] == 0)
+			{
+				//remove the elements already stored for this face
+				chunk.faceElements.resize(chunk.faceElements.size() - (i - 1));
+				chunk.records.push_back(OBJ_INVALID_FACE);
+				return;
+			}
+
+			//new vertex
+			facetElement fe; //(0,0,0) by default
+
+			fe.vIndex = chunk.toInt(parts[0], partLengths[0]);
+			if (partLengths[1] != 0)
+				fe.tcIndex = chunk.toInt(parts[1], partLengths[1]);
+			if (partLengths[2] != 0)
+				fe.nIndex = chunk.toInt(parts[2], partLengths[2]);
+
+			chunk.faceElements.push_back(fe);
+		}
+
+		chunk.faceSizes.push_back(static_cast<unsigned>(tokens.size() - 1));
+		chunk.records.push_back(OBJ_FACE);
+	}
+	/*** groups, polylines and materials ***/
+	else if (	TokenEquals(front, "g")
+			||	TokenEquals(front, "o")
+			||	*front.first == 'l'
+			||	TokenEquals(front, "usemtl")
+			||	TokenEquals(front, "mtllib") )
+	{
+		chunk.records.push_back(OBJ_OTHER_LINE);
+		chunk.otherLines.emplace_back(begin, static_cast<int>(end - begin));
+	}
+}
+
+//! Returns the next physical line of an OBJ file (without the end of line characters)
+static inline const char* NextObjLine(const char* begin, const char* end, const char*& lineEnd)
+{
+	const char* eol = static_cast<const char*>(memchr(begin, '\n', end - begin));
+	if (!eol)
+	{
+		lineEnd = end;
+		return end;
+	}
+
+	//same behavior as QTextStream::readLine ('\r\n' or '\n')
+	lineEnd = (eol != begin && eol[-1] == '\r' ? eol - 1 : eol);
+	return eol + 1;
+}
+
+//! Parses a chunk of an OBJ file
+static void ParseObjChunk(ObjChunk& chunk)
+{
+	try
+	{
+		const char* c = chunk.begin;
+		while (c < chunk.end)
+		{
+			const char* lineEnd = nullptr;
+			const char* next = NextObjLine(c, chunk.end, lineEnd);
+
+			if (lineEnd == c || lineEnd[-1] != '\\')
+			{
+				ParseObjLine(c, lineEnd, chunk, true);
+				c = next;
+				continue;
+			}
+
+			//specific case for weird files
+			std::string& line = chunk.joinedLine;
+			line.assign(c, lineEnd);
+			c = next;
+			while (!line.empty() && line.back() == '\\')
+			{
+				line.pop_back();
+				if (c < chunk.end)
+				{
+					next = NextObjLine(c, chunk.end, lineEnd);
+					line.append(c, lineEnd);
+					c = next;
+				}
+			}
+			ParseObjLine(line.data(), line.data() + line.size(), chunk, true);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		chunk.notEnoughMemory = true;
+	}
+}
+
+//! Returns the end of the chunk starting at 'begin'
+/** The chunk ends after a non-empty line that is not followed by a continuation
+	character, so that it always contains complete (logical) lines.
+**/
+static const char* FindObjChunkEnd(const char* begin, const char* end)
+{
+	if (static_cast<size_t>(end - begin) <= s_objChunkSize)
+	{
+		return end;
+	}
+
+	const char* c = begin + s_objChunkSize;
+	while (c < end)
+	{
+		const char* lineEnd = nullptr;
+		const char* next = NextObjLine(c, end, lineEnd);
+		//if 'c' was pointing at the '\n' of a '\r\n' pair, the '\r' is still there
+		if (lineEnd > begin && lineEnd[-1] == '\r')
+		{
+			--lineEnd;
+		}
+		if (lineEnd > begin && lineEnd[-1] != '\n' && lineEnd[-1] != '\\')
+		{
+			return next;
+		}
+		c = next;
+	}
+
+	return end;
+}
+
+//! Splits the next part of an OBJ file into a batch of chunks
+/** \return whether at least one chunk is not empty
+**/
+static bool PrepareObjBatch(std::vector<ObjChunk>& batch, const char*& pos, const char* end)
+{
+	bool notEmpty = false;
+	for (ObjChunk& chunk : batch)
+	{
+		chunk.clear();
+		chunk.begin = pos;
+		chunk.end = FindObjChunkEnd(pos, end);
+		pos = chunk.end;
+		notEmpty |= (chunk.begin != chunk.end);
+	}
+	return notEmpty;
+}
+
+//! Returns the capacity required to append 'count' elements to a container (geometric growth)
+static inline size_t GetObjCapacity(size_t size, size_t capacity, size_t count)
+{
+	return (size + count <= capacity ? capacity : std::max(size + count, capacity + capacity / 2));
+}
+
 CC_FILE_ERROR ObjFilter::loadFile(const QString& filename, ccHObject& container, LoadParameters& parameters)
 {
 	ccLog::Print(QString("[OBJ] Loading ") + filename);
@@ -544,7 +952,46 @@ CC_FILE_ERROR ObjFilter::loadFile(const QString& filename, ccHObject& container,
 	{
 		return CC_FERR_READING;
 	}
-	QTextStream stream(&file);
+
+	//we map the whole file in memory (or we read it if mapping is not possible)
+	QByteArray fileData;
+	const char* fileBegin = nullptr;
+	qint64 fileSize = file.size();
+	if (fileSize > 0)
+	{
+		fileBegin = reinterpret_cast<const char*>(file.map(0, fileSize));
+		if (!fileBegin)
+		{
+			fileData = file.readAll();
+			if (fileData.size() != fileSize)
+			{
+				return CC_FERR_READING;
+			}
+			fileBegin = fileData.constData();
+		}
+	}
+
+	//text codec (same behavior as QTextStream)
+	QTextCodec* codec = QTextCodec::codecForLocale();
+	if (fileSize >= 3 && memcmp(fileBegin, "\xEF\xBB\xBF", 3) == 0)
+	{
+		//UTF-8 BOM
+		codec = QTextCodec::codecForMib(106);
+		fileBegin += 3;
+		fileSize -= 3;
+	}
+	else if (fileSize != 0)
+	{
+		QTextCodec* utfCodec = QTextCodec::codecForUtfText(QByteArray::fromRawData(fileBegin, static_cast<int>(std::min<qint64>(fileSize, 4))), nullptr);
+		if (utfCodec)
+		{
+			//UTF-16 or UTF-32 file: we convert it to UTF-8 first
+			fileData = utfCodec->toUnicode(fileBegin, static_cast<int>(fileSize)).toUtf8();
+			codec = QTextCodec::codecForMib(106);
+			fileBegin = fileData.constData();
+			fileSize = fileData.size();
+		}
+	}
 
 	//current vertex shift
 	CCVector3d Pshift(0, 0, 0);
@@ -597,7 +1044,7 @@ CC_FILE_ERROR ObjFilter::loadFile(const QString& filename, ccHObject& container,
 		pDlg.reset(new ccProgressDialog(true, parameters.parentWidget));
 		pDlg->setMethodTitle(QObject::tr("OBJ file"));
 		pDlg->setInfo(QObject::tr("Loading in progress..."));
-		pDlg->setRange(0, static_cast<int>(file.size()));
+		pDlg->setRange(0, 100);
 		pDlg->show();
 		QApplication::processEvents();
 	}
@@ -612,110 +1059,64 @@ CC_FILE_ERROR ObjFilter::loadFile(const QString& filename, ccHObject& container,
 	bool objWarnings[5] { false, false, false, false, false };
 	bool error = false;
 
+	//The file is processed in two passes:
+	// - the chunks of a batch are parsed concurrently (see ParseObjChunk)
+	// - they are then merged in file order (while the next batch is parsed)
+	std::vector<ObjChunk> currentBatch(static_cast<size_t>(std::max(ccQtHelpers::GetMaxThreadCount(), 1)) * 2);
+	std::vector<ObjChunk> nextBatch(currentBatch.size());
+	QFuture<void> nextBatchFuture;
+
 	try
 	{
-		unsigned lineCount = 0;
 		unsigned polyCount = 0;
-		QString currentLine = stream.readLine();
-		
-		while (!currentLine.isNull())
-		{
-			++lineCount;
-			if (pDlg && ((lineCount % 2048) == 0))
-			{
-				if (pDlg->wasCanceled())
-				{
-					error = true;
-					objWarnings[CANCELLED_BY_USER] = true;
-					break;
-				}
-				pDlg->setValue(static_cast<int>(file.pos()));
-				QApplication::processEvents();
-			}
+		std::vector<facetElement> currentFace;
 
-			//specific case for weird files
-			while (currentLine.endsWith('\\'))
-			{
-				currentLine.resize(currentLine.length() - 1);
-				currentLine += stream.readLine();
-				++lineCount;
-				if (pDlg && ((lineCount % 2048) == 0))
-				{
-					if (pDlg->wasCanceled())
-					{
-						error = true;
-						objWarnings[CANCELLED_BY_USER] = true;
-						break;
-					}
-					pDlg->setValue(static_cast<int>(file.pos()));
-					QApplication::processEvents();
-				}
-			}
+		//lines that have to be parsed again during the sequential pass (see OBJ_OTHER_LINE)
+		ObjChunk otherLineChunk;
+		ObjChunkCursor otherLineCursor;
 
-			const QStringList tokens = currentLine.simplified().split(QChar(' '), QString::SkipEmptyParts );
+		const char* fileEnd = fileBegin + fileSize;
+		const char* pos = fileBegin;
+		bool hasData = PrepareObjBatch(currentBatch, pos, fileEnd);
+		QtConcurrent::blockingMap(currentBatch, ParseObjChunk);
 
-			//skip comments & empty lines
-			if (tokens.empty() || tokens.front().startsWith('/', Qt::CaseInsensitive) || tokens.front().startsWith('#', Qt::CaseInsensitive))
+		while (hasData && !error)
+		{
+			//start parsing the next batch
+			bool hasNextData = PrepareObjBatch(nextBatch, pos, fileEnd);
+			if (hasNextData)
 			{
-				currentLine = stream.readLine();
-				continue;
+				nextBatchFuture = QtConcurrent::map(nextBatch, ParseObjChunk);
 			}
 
-			/*** new vertex ***/
-			if (tokens.front() == "v")
+			for (ObjChunk& chunk : currentBatch)
 			{
-				//reserve more memory if necessary
-				if (vertices->size() == vertices->capacity())
+				if (chunk.begin == chunk.end)
 				{
-					if (!vertices->reserve(vertices->capacity() + ccChunk::SIZE))
-					{
-						objWarnings[NOT_ENOUGH_MEMORY] = true;
-						error = true;
-						break;
-					}
+					continue;
 				}
 
-				//malformed line?
-				if (tokens.size() < 4)
+				if (chunk.notEnoughMemory)
 				{
-					objWarnings[INVALID_LINE] = true;
+					objWarnings[NOT_ENOUGH_MEMORY] = true;
 					error = true;
 					break;
 				}
 
-				CCVector3d Pd( tokens[1].toDouble(), tokens[2].toDouble(), tokens[3].toDouble() );
-
-				//first point: check for 'big' coordinates
-				if (pointsRead == 0)
+				//reserve the memory for the whole chunk at once
 				{
-					bool preserveCoordinateShift = true;
-					if (HandleGlobalShift(Pd, Pshift, preserveCoordinateShift, parameters))
+					unsigned chunkTriCount = 0;
+					for (unsigned faceSize : chunk.faceSizes)
 					{
-						if (preserveCoordinateShift)
-						{
-							vertices->setGlobalShift(Pshift);
-						}
-						ccLog::Warning("[OBJ] Cloud has been recentered! Translation: (%.2f ; %.2f ; %.2f)", Pshift.x, Pshift.y, Pshift.z);
+						chunkTriCount += faceSize - 2;
 					}
-				}
 
-				//shifted point
-				CCVector3 P = (Pd + Pshift).toPC();
-				vertices->addPoint(P);
-				++pointsRead;
-			}
-			/*** new vertex texture coordinates ***/
-			else if (tokens.front() == "vt")
-			{
-				//create and reserve memory for tex. coords container if necessary
-				if (!texCoords)
-				{
-					texCoords = new TextureCoordsContainer();
-					texCoords->link();
-				}
-				if (texCoords->currentSize() == texCoords->capacity())
-				{
-					if (!texCoords->reserveSafe(texCoords->capacity() + ccChunk::SIZE))
+					size_t vertCapacity = GetObjCapacity(vertices->size(), vertices->capacity(), chunk.vertices.size());
+					size_t triCapacity = GetObjCapacity(baseMesh->size(), baseMesh->capacity(), chunkTriCount);
+					if (	(vertCapacity != vertices->capacity() && !vertices->reserve(static_cast<unsigned>(vertCapacity)))
+						||	(triCapacity != baseMesh->capacity() && !baseMesh->reserve(triCapacity))
+						||	(texCoords && !texCoords->reserveSafe(GetObjCapacity(texCoords->currentSize(), texCoords->capacity(), chunk.texCoords.size())))
+						||	(normals && !normals->reserveSafe(GetObjCapacity(normals->currentSize(), normals->capacity(), chunk.normals.size()))) )
 					{
 						objWarnings[NOT_ENOUGH_MEMORY] = true;
 						error = true;
@@ -723,517 +1124,574 @@ CC_FILE_ERROR ObjFilter::loadFile(const QString& filename, ccHObject& container,
 					}
 				}
 
-				//malformed line?
-				if (tokens.size() < 2)
-				{
-					objWarnings[INVALID_LINE] = true;
-					error = true;
-					break;
-				}
-
-				TexCoords2D T(tokens[1].toFloat(), 0);
-
-				if (tokens.size() > 2) //OBJ specification allows for only one value!!!
+				ObjChunkCursor cursor;
+				for (unsigned char record : chunk.records)
 				{
-					T.ty = tokens[2].toFloat();
-				}
+					ObjChunk* source = &chunk;
+					ObjChunkCursor* sourceCursor = &cursor;
 
-				texCoords->addElement(T);
-				++texCoordsRead;
-			}
-			/*** new vertex normal ***/
-			else if (tokens.front() == "vn") //--> in fact it can also be a facet normal!!!
-			{
-				//create and reserve memory for normals container if necessary
-				if (!normals)
-				{
-					normals = new NormsIndexesTableType;
-					normals->link();
-				}
-				if (normals->currentSize() == normals->capacity())
-				{
-					if (!normals->reserveSafe(normals->capacity() + ccChunk::SIZE))
+					if (record == OBJ_OTHER_LINE)
 					{
-						objWarnings[NOT_ENOUGH_MEMORY] = true;
-						error = true;
-						break;
-					}
-				}
-
-				//malformed line?
-				if (tokens.size() < 4)
-				{
-					objWarnings[INVALID_LINE] = true;
-					error = true;
-					break;
-				}
+						const QByteArray& rawLine = chunk.otherLines[cursor.otherLine++];
+						QTextCodec::ConverterState codecState(QTextCodec::IgnoreHeader);
+						const QString currentLine = codec->toUnicode(rawLine.constData(), rawLine.size(), &codecState);
 
-				CCVector3 N(static_cast<PointCoordinateType>(tokens[1].toDouble()),
-							static_cast<PointCoordinateType>(tokens[2].toDouble()),
-							static_cast<PointCoordinateType>(tokens[3].toDouble()));
+						const QStringList tokens = currentLine.simplified().split(QChar(' '), QString::SkipEmptyParts);
 
-				if (std::abs(N.norm2d() - 1.0) > 0.005)
-				{
-					objWarnings[INVALID_NORMALS] = true;
-					N.normalize();
-				}
-				CompressedNormType nIndex = ccNormalVectors::GetNormIndex(N.u);
+						//skip comments & empty lines
+						if (tokens.empty() || tokens.front().startsWith('/', Qt::CaseInsensitive) || tokens.front().startsWith('#', Qt::CaseInsensitive))
+						{
+							continue;
+						}
 
-				normals->addElement(nIndex); //we don't know yet if it's per-vertex or per-triangle normal...
-				++normsRead;
-			}
-			/*** new group ***/
-			else if (tokens.front() == "g" || tokens.front() == "o")
-			{
-				//update new group index
-				facesRead = 0;
-				//get the group name
-				QString groupName = (tokens.size() > 1 && !tokens[1].isEmpty() ? tokens[1] : "default");
-				for (int i = 2; i < tokens.size(); ++i) //multiple parts?
-					groupName.append(QString(" ") + tokens[i]);
-				//push previous group descriptor (if none was pushed)
-				if (groups.empty() && totalFacesRead > 0)
-					groups.emplace_back(0, "default");
-				//push new group descriptor
-				if (!groups.empty() && groups.back().first == totalFacesRead)
-					groups.back().second = groupName; //simply replace the group name if the previous group was empty!
-				else
-					groups.emplace_back(totalFacesRead, groupName);
-				polyCount = 0; //restart polyline count at 0!
-			}
-			/*** new face ***/
-			else if (tokens.front().startsWith('f'))
-			{
-				//malformed line?
-				if (tokens.size() < 4)
-				{
-					objWarnings[INVALID_LINE] = true;
-					currentLine = stream.readLine();
-					continue;
-					//error = true;
-					//break;
-				}
+						/*** vertex, normal, tex. coords or face with non-ASCII characters ***/
+						if (	tokens.front() == "v"
+							||	tokens.front() == "vt"
+							||	tokens.front() == "vn"
+							||	tokens.front().startsWith('f') )
+						{
+							//we parse the simplified line again
+							QByteArray simplifiedLine = tokens.join(QChar(' ')).toUtf8();
+							otherLineChunk.clear();
+							ParseObjLine(simplifiedLine.constData(), simplifiedLine.constData() + simplifiedLine.size(), otherLineChunk, false);
+							if (otherLineChunk.records.empty())
+							{
+								assert(false);
+								continue;
+							}
 
-				//read the face elements (singleton, pair or triplet)
-				std::vector<facetElement> currentFace;
-				{
-					currentFace.reserve(tokens.size() - 1);
-					for (int i = 1; i < tokens.size(); ++i)
-					{
-						QStringList vertexTokens = tokens[i].split('/');
-						if (vertexTokens.empty() || vertexTokens[0].isEmpty())
+							record = otherLineChunk.records.front();
+							otherLineCursor = ObjChunkCursor();
+							source = &otherLineChunk;
+							sourceCursor = &otherLineCursor;
+						}
+						/*** new group ***/
+						else if (tokens.front() == "g" || tokens.front() == "o")
 						{
-							objWarnings[INVALID_LINE] = true;
-							error = true;
-							break;
+							//update new group index
+							facesRead = 0;
+							//get the group name
+							QString groupName = (tokens.size() > 1 && !tokens[1].isEmpty() ? tokens[1] : "default");
+							for (int i = 2; i < tokens.size(); ++i) //multiple parts?
+								groupName.append(QString(" ") + tokens[i]);
+							//push previous group descriptor (if none was pushed)
+							if (groups.empty() && totalFacesRead > 0)
+								groups.emplace_back(0, "default");
+							//push new group descriptor
+							if (!groups.empty() && groups.back().first == totalFacesRead)
+								groups.back().second = groupName; //simply replace the group name if the previous group was empty!
+							else
+								groups.emplace_back(totalFacesRead, groupName);
+							polyCount = 0; //restart polyline count at 0!
 						}
-						else
+						/*** polyline ***/
+						else if (tokens.front().startsWith('l'))
 						{
-							//new vertex
-							facetElement fe; //(0,0,0) by default
+							//malformed line?
+							if (tokens.size() < 3)
+							{
+								objWarnings[INVALID_LINE] = true;
+								continue;
+							}
 
-							fe.vIndex = vertexTokens[0].toInt();
-							if (vertexTokens.size() > 1 && !vertexTokens[1].isEmpty())
-								fe.tcIndex = vertexTokens[1].toInt();
-							if (vertexTokens.size() > 2 && !vertexTokens[2].isEmpty())
-								fe.nIndex = vertexTokens[2].toInt();
+							//read the face elements (singleton, pair or triplet)
+							ccPolyline* polyline = new ccPolyline(vertices);
+							if (!polyline->reserve(static_cast<unsigned>(tokens.size() - 1)))
+							{
+								//not enough memory
+								objWarnings[NOT_ENOUGH_MEMORY] = true;
+								delete polyline;
+								polyline = nullptr;
+								continue;
+							}
 
-							currentFace.push_back(fe);
-						}
-					}
-				}
+							for (int i = 1; i < tokens.size(); ++i)
+							{
+								//get next polyline's vertex index
+								QStringList vertexTokens = tokens[i].split('/');
+								if (vertexTokens.empty() || vertexTokens[0].isEmpty())
+								{
+									objWarnings[INVALID_LINE] = true;
+									error = true;
+									break;
+								}
+								else
+								{
+									int index = vertexTokens[0].toInt(); //we ignore normal index (if any!)
+									if (!UpdatePointIndex(index, pointsRead))
+									{
+										objWarnings[INVALID_INDEX] = true;
+										error = true;
+										break;
+									}
 
-				if (error)
-					break;
+									polyline->addPointIndex(index);
+								}
+							}
 
-				if (currentFace.size() < 3)
-				{
-					ccLog::Warning("[OBJ] Malformed file: polygon on line %1 has less than 3 vertices!",lineCount);
-					error = true;
-					break;
-				}
+							if (error)
+							{
+								delete polyline;
+								polyline = nullptr;
+								break;
+							}
 
-				//first vertex
-				std::vector<facetElement>::iterator A = currentFace.begin();
+							polyline->setVisible(true);
+							QString name = groups.empty() ? QString("Line") : groups.back().second + QString(".line");
+							polyline->setName(QString("%1 %2").arg(name).arg(++polyCount));
+							vertices->addChild(polyline);
 
-				//the very first vertex of the group tells us about the whole sequence
-				if (facesRead == 0)
-				{
-					//we have a tex. coord index as second vertex element!
-					if (!hasTexCoords && A->tcIndex != 0 && !materialsLoadFailed)
-					{
-						if (!baseMesh->reservePerTriangleTexCoordIndexes())
+						}
+						/*** material ***/
+						else if (tokens.front() == "usemtl") //see 'MTL file' below
 						{
-							objWarnings[NOT_ENOUGH_MEMORY] = true;
-							error = true;
-							break;
+							if (materials) //otherwise we have failed to load MTL file!!!
+							{
+								QString mtlName = currentLine.mid(7).trimmed();
+								//DGM: in case there's space characters in the material name, we must read it again from the original line buffer
+								//QString mtlName = (tokens.size() > 1 && !tokens[1].isEmpty() ? tokens[1] : "");
+								currentMaterial = (!mtlName.isEmpty() ? materials->findMaterialByName(mtlName) : -1);
+								currentMaterialDefined = true;
+							}
 						}
-						for (unsigned int i = 0; i < totalFacesRead; ++i)
-							baseMesh->addTriangleTexCoordIndexes(-1, -1, -1);
+						/*** material file (MTL) ***/
+						else if (tokens.front() == "mtllib")
+						{
+							//malformed line?
+							if (tokens.size() < 2 || tokens[1].isEmpty())
+							{
+								objWarnings[INVALID_LINE] = true;
+							}
+							else
+							{
+								//we build the whole MTL filename + path
+								//DGM: in case there's space characters in the filename, we must read it again from the original line buffer
+								//QString mtlFilename = tokens[1];
+								QString mtlFilename = currentLine.mid(7).trimmed();
+								//remove any quotes around the filename (Photoscan 1.4 bug)
+								if (mtlFilename.startsWith("\""))
+								{
+									mtlFilename = mtlFilename.right(mtlFilename.size() - 1);
+								}
+								if (mtlFilename.endsWith("\""))
+								{
+									mtlFilename = mtlFilename.left(mtlFilename.size() - 1);
+								}
+								ccLog::Print(QString("[OBJ] Material file: ") + mtlFilename);
 
-						hasTexCoords = true;
-					}
+								//we try to load it
+								if (!materials)
+								{
+									materials = new ccMaterialSet("materials");
+									materials->link();
+								}
+								size_t oldSize = materials->size();
 
-					//we have a normal index as third vertex element!
-					if (!normalsPerFacet && A->nIndex != 0)
-					{
-						//so the normals are 'per-facet'
-						if (!baseMesh->reservePerTriangleNormalIndexes())
+								QStringList errors;
+								QString mtlPath = QFileInfo(filename).absolutePath();
+								if (ccMaterialSet::ParseMTL(mtlPath, mtlFilename, *materials, errors))
+								{
+									ccLog::Print("[OBJ] %i materials loaded", materials->size() - oldSize);
+									materialsLoadFailed = false;
+								}
+								else
+								{
+									ccLog::Error(QString("[OBJ] Failed to load material file! (should be in '%1')").arg(mtlPath + '/' + QString(mtlFilename)));
+									materialsLoadFailed = true;
+								}
+
+								if (!errors.empty())
+								{
+									for (int i = 0; i < errors.size(); ++i)
+										ccLog::Warning(QString("[OBJ::Load::MTL parser] ") + errors[i]);
+								}
+								if (materials->empty())
+								{
+									materials->release();
+									materials = nullptr;
+									materialsLoadFailed = true;
+								}
+							}
+						}
+
+						if (record == OBJ_OTHER_LINE)
 						{
-							objWarnings[NOT_ENOUGH_MEMORY] = true;
-							error = true;
-							break;
+							continue;
 						}
-						for (unsigned int i = 0; i < totalFacesRead; ++i)
-							baseMesh->addTriangleNormalIndexes(-1, -1, -1);
-						normalsPerFacet = true;
 					}
-				}
 
-				//we process all vertices accordingly
-				for (facetElement& vertex : currentFace)
-				{
-					//vertex index
+					/*** new vertex ***/
+					if (record == OBJ_VERTEX)
 					{
-						if (!vertex.updatePointIndex(pointsRead))
+						//reserve more memory if necessary
+						if (vertices->size() == vertices->capacity())
 						{
-							objWarnings[INVALID_INDEX] = true;
-							error = true;
-							break;
+							if (!vertices->reserve(vertices->capacity() + ccChunk::SIZE))
+							{
+								objWarnings[NOT_ENOUGH_MEMORY] = true;
+								error = true;
+								break;
+							}
 						}
-						if (vertex.vIndex > maxVertexIndex)
-							maxVertexIndex = vertex.vIndex;
+
+						const CCVector3d& Pd = source->vertices[sourceCursor->vertex++];
+
+						//first point: check for 'big' coordinates
+						if (pointsRead == 0)
+						{
+							bool preserveCoordinateShift = true;
+							if (HandleGlobalShift(Pd, Pshift, preserveCoordinateShift, parameters))
+							{
+								if (preserveCoordinateShift)
+								{
+									vertices->setGlobalShift(Pshift);
+								}
+								ccLog::Warning("[OBJ] Cloud has been recentered! Translation: (%.2f ; %.2f ; %.2f)", Pshift.x, Pshift.y, Pshift.z);
+							}
+						}
+
+						//shifted point
+						CCVector3 P = (Pd + Pshift).toPC();
+						vertices->addPoint(P);
+						++pointsRead;
 					}
-					//should we have a tex. coord index as second vertex element?
-					if (hasTexCoords && currentMaterialDefined)
+					/*** new vertex texture coordinates ***/
+					else if (record == OBJ_TEX_COORD)
 					{
-						if (!vertex.updateTexCoordIndex(texCoordsRead))
+						//create and reserve memory for tex. coords container if necessary
+						if (!texCoords)
 						{
-							objWarnings[INVALID_INDEX] = true;
-							error = true;
-							break;
+							texCoords = new TextureCoordsContainer();
+							texCoords->link();
+						}
+						if (texCoords->currentSize() == texCoords->capacity())
+						{
+							if (!texCoords->reserveSafe(texCoords->capacity() + ccChunk::SIZE))
+							{
+								objWarnings[NOT_ENOUGH_MEMORY] = true;
+								error = true;
+								break;
+							}
 						}
-						if (vertex.tcIndex > maxTexCoordIndex)
-							maxTexCoordIndex = vertex.tcIndex;
-					}
 
-					//should we have a normal index as third vertex element?
-					if (normalsPerFacet)
+						texCoords->addElement(source->texCoords[sourceCursor->texCoord++]);
+						++texCoordsRead;
+					}
+					/*** new vertex normal ***/
+					else if (record == OBJ_NORMAL || record == OBJ_INVALID_NORMAL) //--> in fact it can also be a facet normal!!!
 					{
-						if (!vertex.updateNormalIndex(normsRead))
+						//create and reserve memory for normals container if necessary
+						if (!normals)
 						{
-							objWarnings[INVALID_INDEX] = true;
-							error = true;
-							break;
+							normals = new NormsIndexesTableType;
+							normals->link();
+						}
+						if (normals->currentSize() == normals->capacity())
+						{
+							if (!normals->reserveSafe(normals->capacity() + ccChunk::SIZE))
+							{
+								objWarnings[NOT_ENOUGH_MEMORY] = true;
+								error = true;
+								break;
+							}
 						}
-						if (vertex.nIndex > maxTriNormIndex)
-							maxTriNormIndex = vertex.nIndex;
-					}
-				}
 
-				//don't forget material (common for all vertices)
-				if (currentMaterialDefined && !materialsLoadFailed)
-				{
-					if (!hasMaterial)
-					{
-						if (!baseMesh->reservePerTriangleMtlIndexes())
+						if (record == OBJ_INVALID_NORMAL)
 						{
-							objWarnings[NOT_ENOUGH_MEMORY] = true;
-							error = true;
-							break;
+							objWarnings[INVALID_NORMALS] = true;
 						}
-						for (unsigned int i = 0; i < totalFacesRead; ++i)
-							baseMesh->addTriangleMtlIndex(-1);
 
-						hasMaterial = true;
+						normals->addElement(source->normals[sourceCursor->normal++]); //we don't know yet if it's per-vertex or per-triangle normal...
+						++normsRead;
 					}
-				}
+					/*** malformed vertex, normal or tex. coords ***/
+					else if (record == OBJ_MALFORMED_LINE || record == OBJ_INVALID_FACE)
+					{
+						objWarnings[INVALID_LINE] = true;
+						error = true;
+						break;
+					}
+					/*** malformed face ***/
+					else if (record == OBJ_SHORT_FACE)
+					{
+						objWarnings[INVALID_LINE] = true;
+					}
+					/*** new face ***/
+					else if (record == OBJ_FACE)
+					{
+						//read the face elements (singleton, pair or triplet)
+						{
+							unsigned faceSize = source->faceSizes[sourceCursor->face++];
+							const facetElement* firstElement = source->faceElements.data() + sourceCursor->faceElement;
+							currentFace.assign(firstElement, firstElement + faceSize);
+							sourceCursor->faceElement += faceSize;
+						}
 
-				if (error)
-					break;
+						//first vertex
+						std::vector<facetElement>::iterator A = currentFace.begin();
 
-				//Now, let's tesselate the whole polygon
-				bool shouldTesselate = (currentFace.size() > 4 && vertices);
-				if (shouldTesselate)
-				{
-					for (const facetElement& fe : currentFace)
-					{
-						if (fe.vIndex < 0 || vertices->size() <= static_cast<unsigned>(fe.vIndex))
+						//the very first vertex of the group tells us about the whole sequence
+						if (facesRead == 0)
 						{
-							//we haven't loaded all the vertices?! Too bad, we can't tesselate properly :(
-							ccLog::Warning("[OBJ] Failed to tesselate face");
-							shouldTesselate = false;
-							break;
+							//we have a tex. coord index as second vertex element!
+							if (!hasTexCoords && A->tcIndex != 0 && !materialsLoadFailed)
+							{
+								if (!baseMesh->reservePerTriangleTexCoordIndexes())
+								{
+									objWarnings[NOT_ENOUGH_MEMORY] = true;
+									error = true;
+									break;
+								}
+								for (unsigned int i = 0; i < totalFacesRead; ++i)
+									baseMesh->addTriangleTexCoordIndexes(-1, -1, -1);
+
+								hasTexCoords = true;
+							}
+
+							//we have a normal index as third vertex element!
+							if (!normalsPerFacet && A->nIndex != 0)
+							{
+								//so the normals are 'per-facet'
+								if (!baseMesh->reservePerTriangleNormalIndexes())
+								{
+									objWarnings[NOT_ENOUGH_MEMORY] = true;
+									error = true;
+									break;
+								}
+								for (unsigned int i = 0; i < totalFacesRead; ++i)
+									baseMesh->addTriangleNormalIndexes(-1, -1, -1);
+								normalsPerFacet = true;
+							}
 						}
-					}
-				}
-				if (shouldTesselate)
-				{
-					try
-					{
-						CCCoreLib::PointCloud contour;
-						contour.reserve(static_cast<unsigned>(currentFace.size()));
 
-						for (const facetElement& fe : currentFace)
+						//we process all vertices accordingly
+						for (facetElement& vertex : currentFace)
 						{
-							contour.addPoint(*vertices->getPoint(fe.vIndex));
+							//vertex index
+							{
+								if (!vertex.updatePointIndex(pointsRead))
+								{
+									objWarnings[INVALID_INDEX] = true;
+									error = true;
+									break;
+								}
+								if (vertex.vIndex > maxVertexIndex)
+									maxVertexIndex = vertex.vIndex;
+							}
+							//should we have a tex. coord index as second vertex element?
+							if (hasTexCoords && currentMaterialDefined)
+							{
+								if (!vertex.updateTexCoordIndex(texCoordsRead))
+								{
+									objWarnings[INVALID_INDEX] = true;
+									error = true;
+									break;
+								}
+								if (vertex.tcIndex > maxTexCoordIndex)
+									maxTexCoordIndex = vertex.tcIndex;
+							}
+
+							//should we have a normal index as third vertex element?
+							if (normalsPerFacet)
+							{
+								if (!vertex.updateNormalIndex(normsRead))
+								{
+									objWarnings[INVALID_INDEX] = true;
+									error = true;
+									break;
+								}
+								if (vertex.nIndex > maxTriNormIndex)
+									maxTriNormIndex = vertex.nIndex;
+							}
 						}
-						CCCoreLib::Delaunay2dMesh* dMesh = CCCoreLib::Delaunay2dMesh::TesselateContour(&contour);
-						if (dMesh)
+
+						//don't forget material (common for all vertices)
+						if (currentMaterialDefined && !materialsLoadFailed)
 						{
-							//need more space?
-							unsigned triCount = dMesh->size();
-							if (baseMesh->size() + triCount >= baseMesh->capacity())
+							if (!hasMaterial)
 							{
-								if (!baseMesh->reserve(baseMesh->size() + std::max(triCount, 4096u)))
+								if (!baseMesh->reservePerTriangleMtlIndexes())
 								{
 									objWarnings[NOT_ENOUGH_MEMORY] = true;
 									error = true;
 									break;
 								}
+								for (unsigned int i = 0; i < totalFacesRead; ++i)
+									baseMesh->addTriangleMtlIndex(-1);
+
+								hasMaterial = true;
 							}
+						}
 
-							//push new triangle
-							const int* _triIndexes = dMesh->getTriangleVertIndexesArray();
-							//determine if the triangles must be flipped or not
-							bool flip = false;
+						if (error)
+							break;
+
+						//Now, let's tesselate the whole polygon
+						bool shouldTesselate = (currentFace.size() > 4 && vertices);
+						if (shouldTesselate)
+						{
+							for (const facetElement& fe : currentFace)
+							{
+								if (fe.vIndex < 0 || vertices->size() <= static_cast<unsigned>(fe.vIndex))
+								{
+									//we haven't loaded all the vertices?! Too bad, we can't tesselate properly :(
+									ccLog::Warning("[OBJ] Failed to tesselate face");
+									shouldTesselate = false;
+									break;
+								}
+							}
+						}
+						if (shouldTesselate)
+						{
+							try
 							{
-								for (unsigned i = 0; i < triCount; ++i, _triIndexes += 3)
+								CCCoreLib::PointCloud contour;
+								contour.reserve(static_cast<unsigned>(currentFace.size()));
+
+								for (const facetElement& fe : currentFace)
 								{
-									int i1 = _triIndexes[0];
-									int i2 = _triIndexes[1];
-									int i3 = _triIndexes[2];
-									//by definition the first edge of the original polygon
-									//should be in the same 'direction' of the triangle that uses it
-									if (	(i1 == 0 || i2 == 0 || i3 == 0)
-										&&	(i1 == 1 || i2 == 1 || i3 == 1) )
+									contour.addPoint(*vertices->getPoint(fe.vIndex));
+								}
+								CCCoreLib::Delaunay2dMesh* dMesh = CCCoreLib::Delaunay2dMesh::TesselateContour(&contour);
+								if (dMesh)
+								{
+									//need more space?
+									unsigned triCount = dMesh->size();
+									if (baseMesh->size() + triCount >= baseMesh->capacity())
 									{
-										if (	(i1 == 1 && i2 == 0)
-											||	(i2 == 1 && i3 == 0)
-											||	(i3 == 1 && i1 == 0) )
+										if (!baseMesh->reserve(baseMesh->size() + std::max(triCount, 4096u)))
 										{
-											flip = true;
+											objWarnings[NOT_ENOUGH_MEMORY] = true;
+											error = true;
+											break;
 										}
-										break;
 									}
-								}
-							}
 
-							_triIndexes = dMesh->getTriangleVertIndexesArray();
-							for (unsigned i = 0; i < triCount; ++i, _triIndexes += 3)
-							{
-								const facetElement& f1 = currentFace[_triIndexes[0]];
-								facetElement f2 = currentFace[_triIndexes[1]];
-								facetElement f3 = currentFace[_triIndexes[2]];
+									//push new triangle
+									const int* _triIndexes = dMesh->getTriangleVertIndexesArray();
+									//determine if the triangles must be flipped or not
+									bool flip = false;
+									{
+										for (unsigned i = 0; i < triCount; ++i, _triIndexes += 3)
+										{
+											int i1 = _triIndexes[0];
+											int i2 = _triIndexes[1];
+											int i3 = _triIndexes[2];
+											//by definition the first edge of the original polygon
+											//should be in the same 'direction' of the triangle that uses it
+											if (	(i1 == 0 || i2 == 0 || i3 == 0)
+												&&	(i1 == 1 || i2 == 1 || i3 == 1) )
+											{
+												if (	(i1 == 1 && i2 == 0)
+													||	(i2 == 1 && i3 == 0)
+													||	(i3 == 1 && i1 == 0) )
+												{
+													flip = true;
+												}
+												break;
+											}
+										}
+									}
 
-								if (flip)
-									std::swap(f2, f3);
+									_triIndexes = dMesh->getTriangleVertIndexesArray();
+									for (unsigned i = 0; i < triCount; ++i, _triIndexes += 3)
+									{
+										const facetElement& f1 = currentFace[_triIndexes[0]];
+										facetElement f2 = currentFace[_triIndexes[1]];
+										facetElement f3 = currentFace[_triIndexes[2]];
 
-								baseMesh->addTriangle(f1.vIndex, f2.vIndex, f3.vIndex);
+										if (flip)
+											std::swap(f2, f3);
 
-								if (hasMaterial)
-									baseMesh->addTriangleMtlIndex(currentMaterial);
+										baseMesh->addTriangle(f1.vIndex, f2.vIndex, f3.vIndex);
 
-								if (hasTexCoords)
-									baseMesh->addTriangleTexCoordIndexes(f1.tcIndex, f2.tcIndex, f3.tcIndex);
+										if (hasMaterial)
+											baseMesh->addTriangleMtlIndex(currentMaterial);
 
-								if (normalsPerFacet)
-									baseMesh->addTriangleNormalIndexes(f1.nIndex, f2.nIndex, f3.nIndex);
+										if (hasTexCoords)
+											baseMesh->addTriangleTexCoordIndexes(f1.tcIndex, f2.tcIndex, f3.tcIndex);
 
-								++facesRead;
-								++totalFacesRead;
-							}
+										if (normalsPerFacet)
+											baseMesh->addTriangleNormalIndexes(f1.nIndex, f2.nIndex, f3.nIndex);
 
-							delete dMesh;
-							dMesh = nullptr;
-						}
-						else
-						{
-							ccLog::Warning("[OBJ] Failed to tesselate face");
-							shouldTesselate = false;
-						}
-					}
-					catch (const std::bad_alloc&)
-					{
-						//not enough memory to tesselate!
-						shouldTesselate = false;
-					}
-				}
+										++facesRead;
+										++totalFacesRead;
+									}
 
-				if (!shouldTesselate)
-				{
-					std::vector<facetElement>::const_iterator B = A + 1;
-					std::vector<facetElement>::const_iterator C = B + 1;
-					for (; C != currentFace.end(); ++B, ++C)
-					{
-						//need more space?
-						if (baseMesh->size() == baseMesh->capacity())
-						{
-							if (!baseMesh->reserve(baseMesh->size() + 4096))
+									delete dMesh;
+									dMesh = nullptr;
+								}
+								else
+								{
+									ccLog::Warning("[OBJ] Failed to tesselate face");
+									shouldTesselate = false;
+								}
+							}
+							catch (const std::bad_alloc&)
 							{
-								objWarnings[NOT_ENOUGH_MEMORY] = true;
-								error = true;
-								break;
+								//not enough memory to tesselate!
+								shouldTesselate = false;
 							}
 						}
 
-						//push new triangle
-						baseMesh->addTriangle(A->vIndex, B->vIndex, C->vIndex);
-						++facesRead;
-						++totalFacesRead;
-
-						if (hasMaterial)
-							baseMesh->addTriangleMtlIndex(currentMaterial);
+						if (!shouldTesselate)
+						{
+							std::vector<facetElement>::const_iterator B = A + 1;
+							std::vector<facetElement>::const_iterator C = B + 1;
+							for (; C != currentFace.end(); ++B, ++C)
+							{
+								//need more space?
+								if (baseMesh->size() == baseMesh->capacity())
+								{
+									if (!baseMesh->reserve(baseMesh->size() + 4096))
+									{
+										objWarnings[NOT_ENOUGH_MEMORY] = true;
+										error = true;
+										break;
+									}
+								}
 
-						if (hasTexCoords)
-							baseMesh->addTriangleTexCoordIndexes(A->tcIndex, B->tcIndex, C->tcIndex);
+								//push new triangle
+								baseMesh->addTriangle(A->vIndex, B->vIndex, C->vIndex);
+								++facesRead;
+								++totalFacesRead;
 
-						if (normalsPerFacet)
-							baseMesh->addTriangleNormalIndexes(A->nIndex, B->nIndex, C->nIndex);
-					}
-				}
-			}
-			/*** polyline ***/
-			else if (tokens.front().startsWith('l'))
-			{
-				//malformed line?
-				if (tokens.size() < 3)
-				{
-					objWarnings[INVALID_LINE] = true;
-					currentLine = stream.readLine();
-					continue;
-				}
+								if (hasMaterial)
+									baseMesh->addTriangleMtlIndex(currentMaterial);
 
-				//read the face elements (singleton, pair or triplet)
-				ccPolyline* polyline = new ccPolyline(vertices);
-				if (!polyline->reserve(static_cast<unsigned>(tokens.size() - 1)))
-				{
-					//not enough memory
-					objWarnings[NOT_ENOUGH_MEMORY] = true;
-					delete polyline;
-					polyline = nullptr;
-					currentLine = stream.readLine();
-					continue;
-				}
+								if (hasTexCoords)
+									baseMesh->addTriangleTexCoordIndexes(A->tcIndex, B->tcIndex, C->tcIndex);
 
-				for (int i = 1; i < tokens.size(); ++i)
-				{
-					//get next polyline's vertex index
-					QStringList vertexTokens = tokens[i].split('/');
-					if (vertexTokens.empty() || vertexTokens[0].isEmpty())
-					{
-						objWarnings[INVALID_LINE] = true;
-						error = true;
-						break;
-					}
-					else
-					{
-						int index = vertexTokens[0].toInt(); //we ignore normal index (if any!)
-						if (!UpdatePointIndex(index, pointsRead))
-						{
-							objWarnings[INVALID_INDEX] = true;
-							error = true;
-							break;
+								if (normalsPerFacet)
+									baseMesh->addTriangleNormalIndexes(A->nIndex, B->nIndex, C->nIndex);
+							}
 						}
-
-						polyline->addPointIndex(index);
 					}
+
+					if (error)
+						break;
 				}
 
 				if (error)
-				{
-					delete polyline;
-					polyline = nullptr;
 					break;
-				}
-
-				polyline->setVisible(true);
-				QString name = groups.empty() ? QString("Line") : groups.back().second + QString(".line");
-				polyline->setName(QString("%1 %2").arg(name).arg(++polyCount));
-				vertices->addChild(polyline);
 
-			}
-			/*** material ***/
-			else if (tokens.front() == "usemtl") //see 'MTL file' below
-			{
-				if (materials) //otherwise we have failed to load MTL file!!!
-				{
-					QString mtlName = currentLine.mid(7).trimmed();
-					//DGM: in case there's space characters in the material name, we must read it again from the original line buffer
-					//QString mtlName = (tokens.size() > 1 && !tokens[1].isEmpty() ? tokens[1] : "");
-					currentMaterial = (!mtlName.isEmpty() ? materials->findMaterialByName(mtlName) : -1);
-					currentMaterialDefined = true;
-				}
-			}
-			/*** material file (MTL) ***/
-			else if (tokens.front() == "mtllib")
-			{
-				//malformed line?
-				if (tokens.size() < 2 || tokens[1].isEmpty())
-				{
-					objWarnings[INVALID_LINE] = true;
-				}
-				else
+				if (pDlg)
 				{
-					//we build the whole MTL filename + path
-					//DGM: in case there's space characters in the filename, we must read it again from the original line buffer
-					//QString mtlFilename = tokens[1];
-					QString mtlFilename = currentLine.mid(7).trimmed();
-					//remove any quotes around the filename (Photoscan 1.4 bug)
-					if (mtlFilename.startsWith("\""))
-					{
-						mtlFilename = mtlFilename.right(mtlFilename.size() - 1);
-					}
-					if (mtlFilename.endsWith("\""))
-					{
-						mtlFilename = mtlFilename.left(mtlFilename.size() - 1);
-					}
-					ccLog::Print(QString("[OBJ] Material file: ") + mtlFilename);
-
-					//we try to load it
-					if (!materials)
-					{
-						materials = new ccMaterialSet("materials");
-						materials->link();
-					}
-					size_t oldSize = materials->size();
-
-					QStringList errors;
-					QString mtlPath = QFileInfo(filename).absolutePath();
-					if (ccMaterialSet::ParseMTL(mtlPath, mtlFilename, *materials, errors))
-					{
-						ccLog::Print("[OBJ] %i materials loaded", materials->size() - oldSize);
-						materialsLoadFailed = false;
-					}
-					else
-					{
-						ccLog::Error(QString("[OBJ] Failed to load material file! (should be in '%1')").arg(mtlPath + '/' + QString(mtlFilename)));
-						materialsLoadFailed = true;
-					}
-
-					if (!errors.empty())
-					{
-						for (int i = 0; i < errors.size(); ++i)
-							ccLog::Warning(QString("[OBJ::Load::MTL parser] ") + errors[i]);
-					}
-					if (materials->empty())
+					if (pDlg->wasCanceled())
 					{
-						materials->release();
-						materials = nullptr;
-						materialsLoadFailed = true;
+						error = true;
+						objWarnings[CANCELLED_BY_USER] = true;
+						break;
 					}
+					pDlg->setValue(static_cast<int>((100 * (chunk.end - fileBegin)) / std::max<qint64>(fileSize, 1)));
+					QApplication::processEvents();
 				}
 			}
-			///*** shading group ***/
-			//else if (tokens.front() == "s")
-			//{
-			//	//ignored!
-			//}
 
-			if (error)
-				break;
-
-			currentLine = stream.readLine();
+			//wait for the next batch
+			nextBatchFuture.waitForFinished();
+			std::swap(currentBatch, nextBatch);
+			hasData = hasNextData;
 		}
 	}
 	catch (const std::bad_alloc&)
@@ -1243,6 +1701,10 @@ CC_FILE_ERROR ObjFilter::loadFile(const QString& filename, ccHObject& container,
 		error = true;
 	}
 
+	//make sure the next batch is not being parsed anymore
+	nextBatchFuture.cancel();
+	nextBatchFuture.waitForFinished();
+
 	file.close();
 
 	//1st check
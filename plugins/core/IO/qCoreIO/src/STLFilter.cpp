@@ -359,7 +359,7 @@ CC_FILE_ERROR STLFilter::loadFile(const QString& filename, ccHObject& container,
 	}
 
 	//remove duplicated vertices
-	mesh->mergeDuplicatedVertices(ccMesh::DefaultMergeDuplicateVerticesLevel, parameters.parentWidget);
+	mesh->mergeDuplicatedVertices(parameters.parentWidget);
 	vertices = nullptr; //warning, after this point, 'vertices' is not valid anymore
 
 	ccGenericPointCloud* meshVertices = mesh->getAssociatedCloud();
@@ -26,8 +26,12 @@ class E57Filter : public FileIOFilter
 {
 public:
 	E57Filter();
-	
+
 	//inherited from FileIOFilter
+	/** The scans to load can be restricted with LoadParameters::scanSelection (index in
+		the 'data3D' vector, name or GUID). Other scans are not read at all.
+		The number of scans decoded concurrently can be capped with LoadParameters::maxThreadCount.
+	**/
 	CC_FILE_ERROR loadFile(const QString& filename, ccHObject& container, LoadParameters& parameters) override;
 
 	bool canSave(CC_CLASS_ENUM type, bool& multiple, bool& exclusive) const override;
@@ -34,12 +34,19 @@
 #include <ccProgressDialog.h>
 #include <ccScalarField.h>
 
+//CCPluginAPI
+#include <ccQtHelpers.h>
+
 //Qt
 #include <QApplication>
 #include <QBuffer>
+#include <QThread>
 #include <QUuid>
+#include <QtConcurrentRun>
 
 //system
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <string>
 
@@ -1483,26 +1490,206 @@ struct LoadedScan
 	bool preserveCoordinateShift = false;
 };
 
-static LoadedScan LoadScan(const e57::Node& node, QString& guidStr, ccProgressDialog* progressDlg = nullptr)
+//! Scan decoding job
+/** Prepared on the main thread (header, pose, Global Shift, pre-sized
+	destination arrays) then decoded by a worker thread that owns its own
+	E57 reader, and eventually finalized on the main thread again.
+**/
+struct ScanJob
+{
+	//! Index of the scan in the 'data3D' vector
+	unsigned data3DIndex = 0;
+	//! Scan node element name
+	QString elementName;
+	//! Scan GUID (if any)
+	QString guid;
+
+	//! Number of records in the scan
+	int64_t pointCount = 0;
+	//! Decoded prototype
+	E57ScanHeader header;
+	//! Whether coordinates are stored as spherical coordinates
+	bool sphericalMode = false;
+
+	//output entities (pre-sized)
+	ccPointCloud* cloud = nullptr;
+	ccGBLSensor* sensor = nullptr;
+	ccScalarField* intensitySF = nullptr;
+	ccScalarField* returnIndexSF = nullptr;
+	ccPointCloud::Grid::Shared scanGrid;
+	bool hasNormals = false;
+	bool hasColors = false;
+
+	//color normalization
+	double colorOffset[3] { 0.0, 0.0, 0.0 };
+	double colorRange[3] { 1.0, 1.0, 1.0 };
+
+	//pose and Global Shift
+	ccGLMatrixd poseMat;
+	bool validPoseMat = false;
+	bool poseMatWasShifted = false;
+	CCVector3d poseMatShift;
+	CCVector3d Pshift { 0.0, 0.0, 0.0 };
+	bool globalShiftApplied = false;
+	bool preserveCoordinateShift = true;
+
+	//decoding output
+	int64_t realCount = 0;
+	int64_t invalidCount = 0;
+	int64_t zeroCount = 0;
+	bool hasValidIntensity = false;
+	ScalarType minIntensity = 0;
+	ScalarType maxIntensity = 0;
+	QString error;
+};
+
+//! Adds a destination buffer for a given prototype field
+template <typename T> static void AddDestBuffer(	e57::ImageFile& imf,
+													const e57::StructureNode& prototype,
+													const char* fieldName,
+													std::vector<T>& data,
+													unsigned chunkSize,
+													std::vector<e57::SourceDestBuffer>& dbufs,
+													bool scaled = true)
+{
+	data.resize(chunkSize);
+	dbufs.emplace_back(imf, fieldName, data.data(), chunkSize, true, scaled && (prototype.get(fieldName).type() == e57::E57_SCALED_INTEGER));
+}
+
+//! Sets up the coordinates (and validity) destination buffers
+static void SetupCoordinateBuffers(	const ScanJob& job,
+									e57::ImageFile& imf,
+									const e57::StructureNode& prototype,
+									unsigned chunkSize,
+									TempArrays& arrays,
+									std::vector<e57::SourceDestBuffer>& dbufs)
+{
+	const PointStandardizedFieldsAvailable& fields = job.header.pointFields;
+	if (job.sphericalMode)
+	{
+		//spherical coordinates
+		if (fields.sphericalRangeField)
+			AddDestBuffer(imf, prototype, "sphericalRange", arrays.xData, chunkSize, dbufs);
+		if (fields.sphericalAzimuthField)
+			AddDestBuffer(imf, prototype, "sphericalAzimuth", arrays.yData, chunkSize, dbufs);
+		if (fields.sphericalElevationField)
+			AddDestBuffer(imf, prototype, "sphericalElevation", arrays.zData, chunkSize, dbufs);
+
+		//data validity
+		if (fields.sphericalInvalidStateField)
+			AddDestBuffer(imf, prototype, "sphericalInvalidState", arrays.isInvalidData, chunkSize, dbufs);
+	}
+	else
+	{
+		//cartesian coordinates
+		if (fields.cartesianXField)
+			AddDestBuffer(imf, prototype, "cartesianX", arrays.xData, chunkSize, dbufs);
+		if (fields.cartesianYField)
+			AddDestBuffer(imf, prototype, "cartesianY", arrays.yData, chunkSize, dbufs);
+		if (fields.cartesianZField)
+			AddDestBuffer(imf, prototype, "cartesianZ", arrays.zData, chunkSize, dbufs);
+
+		//data validity
+		if (fields.cartesianInvalidStateField)
+			AddDestBuffer(imf, prototype, "cartesianInvalidState", arrays.isInvalidData, chunkSize, dbufs);
+	}
+}
+
+//! Returns the cartesian coordinates of the i-th point of the current chunk
+static inline CCVector3d GetCartesianCoordinates(const TempArrays& arrays, unsigned i, bool sphericalMode)
+{
+	CCVector3d Pd(0, 0, 0);
+	if (sphericalMode)
+	{
+		double r = (arrays.xData.empty() ? 0 : arrays.xData[i]);
+		double theta = (arrays.yData.empty() ? 0 : arrays.yData[i]);	//Azimuth
+		double phi = (arrays.zData.empty() ? 0 : arrays.zData[i]);		//Elevation
+
+		double cos_phi = cos(phi);
+		Pd.x = r * cos_phi * cos(theta);
+		Pd.y = r * cos_phi * sin(theta);
+		Pd.z = r * sin(phi);
+	}
+	//DGM TODO: not handled yet (-->what are the standard cylindrical field names?)
+	/*else if (cylindricalMode)
+	{
+		//from cylindrical coordinates
+		assert(arrays.xData);
+		double theta = (arrays.yData ? arrays.yData[i] : 0);
+		Pd.x = arrays.xData[i] * cos(theta);
+		Pd.y = arrays.xData[i] * sin(theta);
+		if (arrays.zData)
+			Pd.z = arrays.zData[i];
+	}
+	//*/
+	else //cartesian
+	{
+		if (!arrays.xData.empty())
+			Pd.x = arrays.xData[i];
+		if (!arrays.yData.empty())
+			Pd.y = arrays.yData[i];
+		if (!arrays.zData.empty())
+			Pd.z = arrays.zData[i];
+	}
+
+	return Pd;
+}
+
+//! Reads the first valid point of a scan (to handle the Global Shift before decoding it)
+static bool ReadFirstValidPoint(const ScanJob& job, e57::ImageFile& imf, const e57::CompressedVectorNode& points, CCVector3d& Pd)
+{
+	static const unsigned ProbeChunkSize = 4096;
+
+	e57::StructureNode prototype(points.prototype());
+	TempArrays arrays;
+	std::vector<e57::SourceDestBuffer> dbufs;
+	SetupCoordinateBuffers(job, imf, prototype, std::min<unsigned>(static_cast<unsigned>(job.pointCount), ProbeChunkSize), arrays, dbufs);
+
+	e57::CompressedVectorReader probeReader = points.reader(dbufs);
+	bool found = false;
+	unsigned size = 0;
+	while (!found && (size = probeReader.read()))
+	{
+		for (unsigned i = 0; i < size; ++i)
+		{
+			if (arrays.isInvalidData.empty() || arrays.isInvalidData[i] == 0)
+			{
+				Pd = GetCartesianCoordinates(arrays, i, job.sphericalMode);
+				found = true;
+				break;
+			}
+		}
+	}
+	probeReader.close();
+
+	return found;
+}
+
+//! Prepares a scan before decoding (should be called on the main thread)
+/** Reads the scan metadata, handles the Global Shift (which may require
+	user interaction) and pre-allocates the output cloud, scalar fields and grid.
+**/
+static bool PrepareScan(const e57::Node& node, ScanJob& job)
 {
 	if (node.type() != e57::E57_STRUCTURE)
 	{
 		ccLog::Warning("[E57Filter] Scan nodes should be STRUCTURES!");
-		return {};
+		return false;
 	}
 	e57::StructureNode scanNode(node);
+	job.elementName = QString::fromStdString(scanNode.elementName());
 
 	QString scanName("none");
 	if (scanNode.isDefined("name"))
 		scanName = QString::fromStdString( e57::StringNode(scanNode.get("name")).value() );
 
 	//log
-	ccLog::Print(QString("[E57] Reading new scan node (%1) - %2").arg(scanNode.elementName().c_str()).arg(scanName));
+	ccLog::Print(QString("[E57] Reading new scan node (%1) - %2").arg(job.elementName).arg(scanName));
 
 	if (!scanNode.isDefined("points"))
 	{
-		ccLog::Warning(QString("[E57Filter] No point in scan '%1'!").arg(scanNode.elementName().c_str()));
-		return {};
+		ccLog::Warning(QString("[E57Filter] No point in scan '%1'!").arg(job.elementName));
+		return false;
 	}
 
 	//unique GUID
@@ -1510,41 +1697,46 @@ static LoadedScan LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 	{
 		e57::Node guidNode = scanNode.get("guid");
 		assert(guidNode.type() == e57::E57_STRING);
-		guidStr = QString(static_cast<e57::StringNode>(guidNode).value().c_str());
+		job.guid = QString(static_cast<e57::StringNode>(guidNode).value().c_str());
 	}
 	else
 	{
 		//No GUID!
-		guidStr.clear();
+		job.guid.clear();
 	}
 
 	//points
 	e57::CompressedVectorNode points(scanNode.get("points"));
-	const int64_t pointCount = points.childCount();
+	job.pointCount = points.childCount();
 	
 	//prototype for points
 	e57::StructureNode prototype(points.prototype());
-	E57ScanHeader header;
-	DecodePrototype(scanNode, prototype, header);
+	DecodePrototype(scanNode, prototype, job.header);
 
-	bool sphericalMode = false;
 	//no cartesian fields?
-	if (!header.pointFields.cartesianXField &&
-		!header.pointFields.cartesianYField && 
-		!header.pointFields.cartesianZField)
+	if (!job.header.pointFields.cartesianXField &&
+		!job.header.pointFields.cartesianYField && 
+		!job.header.pointFields.cartesianZField)
 	{
 		//let's look for spherical ones
-		if (!header.pointFields.sphericalRangeField &&
-			!header.pointFields.sphericalAzimuthField &&
-			!header.pointFields.sphericalElevationField)
+		if (!job.header.pointFields.sphericalRangeField &&
+			!job.header.pointFields.sphericalAzimuthField &&
+			!job.header.pointFields.sphericalElevationField)
 		{
-			ccLog::Warning(QString("[E57Filter] No readable point in scan '%1'! (only cartesian and spherical coordinates are supported right now)").arg(scanNode.elementName().c_str()));
-			return {};
+			ccLog::Warning(QString("[E57Filter] No readable point in scan '%1'! (only cartesian and spherical coordinates are supported right now)").arg(job.elementName));
+			return false;
 		}
-		sphericalMode = true;
+		job.sphericalMode = true;
+	}
+
+	if (job.pointCount <= 0)
+	{
+		ccLog::Warning(QString("[E57] No valid point in scan '%1'!").arg(job.elementName));
+		return false;
 	}
 
 	ccPointCloud* cloud = new ccPointCloud();
+	job.cloud = cloud;
 
 	if (scanNode.isDefined("name"))
 	{		
@@ -1585,7 +1777,6 @@ static LoadedScan LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 				e57::StructureNode groupingByLine(pointGroupingSchemes.get("groupingByLine"));
 
 				e57::CompressedVectorNode groups(groupingByLine.get("groups"));
-				int64_t groupCount = groups.childCount(); // total number of groups
 
 				e57::StringNode idElementName(groupingByLine.get("idElementName"));
 				if (idElementName.value().compare("columnIndex") == 0)
@@ -1607,36 +1798,6 @@ static LoadedScan LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 					groupPointCount = gridRowCount;
 				else
 					groupPointCount = gridColumnCount;
-
-#if 0
-				if (groupCount != 0)
-				{
-					int64_t protoCount = lineGroupRecord.childCount();
-					std::vector<e57::SourceDestBuffer> groupSDBuffers;
-
-					std::vector<int64_t> idElementValue, startPointIndex, pointCount;
-					idElementValue.resize(groupCount);
-					startPointIndex.resize(groupCount);
-					pointCount.resize(groupCount);
-
-					for (int64_t protoIndex = 0; protoIndex < protoCount; protoIndex++)
-					{
-						e57::ustring name = lineGroupRecord.get(protoIndex).elementName();
-
-						if ((name.compare("idElementValue") == 0) && lineGroupRecord.isDefined("idElementValue") && (!idElementValue.empty()))
-							groupSDBuffers.push_back(e57::SourceDestBuffer(node.destImageFile(), "idElementValue", idElementValue.data(), static_cast<unsigned>(groupCount), true));
-						else if ((name.compare("startPointIndex") == 0) && lineGroupRecord.isDefined("startPointIndex") && (!startPointIndex.empty()))
-							groupSDBuffers.push_back(e57::SourceDestBuffer(node.destImageFile(), "startPointIndex", startPointIndex.data(), static_cast<unsigned>(groupCount), true));
-						else if ((name.compare("pointCount") == 0) && lineGroupRecord.isDefined("pointCount") && (!pointCount.empty()))
-							groupSDBuffers.push_back(e57::SourceDestBuffer(node.destImageFile(), "pointCount", pointCount.data(), static_cast<unsigned>(groupCount), true));
-					}
-
-					e57::CompressedVectorReader reader = groups.reader(groupSDBuffers);
-					reader.read();
-					reader.close();
-					//optional end
-				}
-#endif
 			}
 		}
 
@@ -1675,498 +1836,473 @@ static LoadedScan LoadScan(const e57::Node& node, QString& guidStr, ccProgressDi
 	//*/
 
 	//scan "pose" relatively to the others
-	ccGLMatrixd poseMat;
-	const bool validPoseMat = GetPoseInformation(scanNode, poseMat);
-	bool preserveCoordinateShift = true;
-	bool globalShiftApplied = false;
-	bool poseMatWasShifted = false;
-	CCVector3d poseMatShift;
-	ccGBLSensor* sensor = nullptr;
+	job.validPoseMat = GetPoseInformation(scanNode, job.poseMat);
 
-	if (validPoseMat)
+	if (job.validPoseMat)
 	{
-		const CCVector3d T = poseMat.getTranslationAsVec3D();
-		if (FileIOFilter::HandleGlobalShift(T, poseMatShift, preserveCoordinateShift, s_loadParameters))
+		const CCVector3d T = job.poseMat.getTranslationAsVec3D();
+		if (FileIOFilter::HandleGlobalShift(T, job.poseMatShift, job.preserveCoordinateShift, s_loadParameters))
 		{
-			poseMat.setTranslation((T + poseMatShift).u);
-			if (preserveCoordinateShift)
+			job.poseMat.setTranslation((T + job.poseMatShift).u);
+			if (job.preserveCoordinateShift)
 			{
-				cloud->setGlobalShift(poseMatShift);
+				cloud->setGlobalShift(job.poseMatShift);
 			}
-			poseMatWasShifted = true;
-			globalShiftApplied = true;
-			ccLog::Warning("[E57Filter::loadFile] Cloud %s has been recentered! Translation: (%.2f ; %.2f ; %.2f)", qPrintable(guidStr), poseMatShift.x, poseMatShift.y, poseMatShift.z);
+			job.poseMatWasShifted = true;
+			job.globalShiftApplied = true;
+			ccLog::Warning("[E57Filter::loadFile] Cloud %s has been recentered! Translation: (%.2f ; %.2f ; %.2f)", qPrintable(job.guid), job.poseMatShift.x, job.poseMatShift.y, job.poseMatShift.z);
 		}
 
 		//cloud->setGLTransformation(poseMat); //TODO-> apply it at the end instead! Otherwise we will loose original coordinates!
 
-		sensor = new ccGBLSensor();
-		sensor->setRigidTransformation(ccGLMatrix(poseMat.data()));
+		job.sensor = new ccGBLSensor();
+		job.sensor->setRigidTransformation(ccGLMatrix(job.poseMat.data()));
+	}
+	else
+	{
+		//the Global Shift is deduced from the first valid point
+		//(we have to read it now, as the user may be asked to confirm the shift)
+		e57::ImageFile imf = node.destImageFile();
+		CCVector3d Pd;
+		if (ReadFirstValidPoint(job, imf, points, Pd))
+		{
+			if (FileIOFilter::HandleGlobalShift(Pd, job.Pshift, job.preserveCoordinateShift, s_loadParameters))
+			{
+				job.globalShiftApplied = true;
+				if (job.preserveCoordinateShift)
+				{
+					cloud->setGlobalShift(job.Pshift);
+				}
+				ccLog::Warning("[E57Filter::loadFile] Cloud %s has been recentered! Translation: (%.2f ; %.2f ; %.2f)", qPrintable(job.guid), job.Pshift.x, job.Pshift.y, job.Pshift.z);
+			}
+		}
 	}
 
-	//prepare temporary structures
-	const unsigned chunkSize = std::min<unsigned>(pointCount, (1 << 20)); //we load the file in several steps to limit the memory consumption
-	TempArrays arrays;
-	std::vector<e57::SourceDestBuffer> dbufs;
-
-	if (!cloud->reserve(static_cast<unsigned>(pointCount)))
+	//pre-size the destination arrays
+	if (!cloud->reserve(static_cast<unsigned>(job.pointCount)))
 	{
 		ccLog::Error("[E57] Not enough memory!");
-		delete cloud;
-		return {};
+		return false;
 	}
 
 	// scan grid
-	ccPointCloud::Grid::Shared scanGrid;
-	if (header.pointFields.rowIndexField && header.pointFields.columnIndexField && gridRowCount != 0 && gridColumnCount != 0)
+	if (job.header.pointFields.rowIndexField && job.header.pointFields.columnIndexField && gridRowCount != 0 && gridColumnCount != 0)
 	{
-		scanGrid.reset(new ccPointCloud::Grid);
-		if (scanGrid->init(static_cast<unsigned>(gridRowCount), static_cast<unsigned>(gridColumnCount)))
-		{
-			arrays.rowIndex.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "rowIndex", arrays.rowIndex.data(), chunkSize, true);
-			arrays.columnIndex.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "columnIndex", arrays.columnIndex.data(), chunkSize, true);
-		}
-		else
+		job.scanGrid.reset(new ccPointCloud::Grid);
+		if (!job.scanGrid->init(static_cast<unsigned>(gridRowCount), static_cast<unsigned>(gridColumnCount)))
 		{
 			ccLog::Warning("[E57] Not enough memory to load the scan grid");
-			scanGrid.clear();
+			job.scanGrid.clear();
 		}
-		
 	}
 
-	if (sphericalMode)
+	//normals
+	job.hasNormals = (		job.header.pointFields.normXField
+						||	job.header.pointFields.normYField
+						||	job.header.pointFields.normZField);
+	if (job.hasNormals)
 	{
-		//spherical coordinates
-		if (header.pointFields.sphericalRangeField)
-		{
-			arrays.xData.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "sphericalRange", arrays.xData.data(), chunkSize, true, (prototype.get("sphericalRange").type() == e57::E57_SCALED_INTEGER));
-		}
-		if (header.pointFields.sphericalAzimuthField)
-		{
-			arrays.yData.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "sphericalAzimuth", arrays.yData.data(), chunkSize, true, (prototype.get("sphericalAzimuth").type() == e57::E57_SCALED_INTEGER));
-		}
-		if (header.pointFields.sphericalElevationField)
+		if (!cloud->reserveTheNormsTable())
 		{
-			arrays.zData.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "sphericalElevation", arrays.zData.data(), chunkSize, true, (prototype.get("sphericalElevation").type() == e57::E57_SCALED_INTEGER));
+			ccLog::Error("[E57] Not enough memory!");
+			return false;
 		}
+		cloud->showNormals(true);
+	}
 
-		//data validity
-		if (header.pointFields.sphericalInvalidStateField)
+	//intensity
+	if (job.header.pointFields.intensityField)
+	{
+		job.intensitySF = new ccScalarField(CC_E57_INTENSITY_FIELD_NAME);
+		if (!job.intensitySF->resizeSafe(static_cast<unsigned>(job.pointCount)))
 		{
-			arrays.isInvalidData.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "sphericalInvalidState", arrays.isInvalidData.data(), chunkSize, true, (prototype.get("sphericalInvalidState").type() == e57::E57_SCALED_INTEGER));
+			ccLog::Error("[E57] Not enough memory!");
+			job.intensitySF->release();
+			job.intensitySF = nullptr;
+			return false;
 		}
+		cloud->addScalarField(job.intensitySF);
 	}
-	else
+
+	//colors
+	job.hasColors = (	job.header.pointFields.colorRedField
+					||	job.header.pointFields.colorGreenField
+					||	job.header.pointFields.colorBlueField);
+	if (job.hasColors)
 	{
-		//cartesian coordinates
-		if (header.pointFields.cartesianXField)
-		{
-			arrays.xData.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "cartesianX", arrays.xData.data(), chunkSize, true, (prototype.get("cartesianX").type() == e57::E57_SCALED_INTEGER));
-		}
-		if (header.pointFields.cartesianYField)
-		{
-			arrays.yData.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "cartesianY", arrays.yData.data(), chunkSize, true, (prototype.get("cartesianY").type() == e57::E57_SCALED_INTEGER));
-		}
-		if (header.pointFields.cartesianZField)
+		if (!cloud->reserveTheRGBTable())
 		{
-			arrays.zData.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "cartesianZ", arrays.zData.data(), chunkSize, true, (prototype.get("cartesianZ").type() == e57::E57_SCALED_INTEGER));
+			ccLog::Error("[E57] Not enough memory!");
+			return false;
 		}
 
-		//data validity
-		if (header.pointFields.cartesianInvalidStateField)
+		const double minimums[3] { job.header.colorLimits.colorRedMinimum, job.header.colorLimits.colorGreenMinimum, job.header.colorLimits.colorBlueMinimum };
+		const double maximums[3] { job.header.colorLimits.colorRedMaximum, job.header.colorLimits.colorGreenMaximum, job.header.colorLimits.colorBlueMaximum };
+		for (unsigned c = 0; c < 3; ++c)
 		{
-			arrays.isInvalidData.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "cartesianInvalidState", arrays.isInvalidData.data(), chunkSize, true, (prototype.get("cartesianInvalidState").type() == e57::E57_SCALED_INTEGER));
+			job.colorOffset[c] = minimums[c];
+			job.colorRange[c] = maximums[c] - minimums[c];
+			if (job.colorRange[c] <= 0.0)
+				job.colorRange[c] = 1.0;
 		}
 	}
 
-	//normals
-	bool hasNormals = (		header.pointFields.normXField
-						||	header.pointFields.normYField
-						||	header.pointFields.normZField);
-	if (hasNormals)
+	//return index (multiple shoots scanners)
+	if (job.header.pointFields.returnIndexField && job.header.pointFields.returnMaximum > 0)
 	{
-		if (!cloud->reserveTheNormsTable())
+		//we store the point return index as a scalar field
+		job.returnIndexSF = new ccScalarField(CC_E57_RETURN_INDEX_FIELD_NAME);
+		if (!job.returnIndexSF->resizeSafe(static_cast<unsigned>(job.pointCount)))
 		{
 			ccLog::Error("[E57] Not enough memory!");
-			delete cloud;
-			return {};
-		}
-		cloud->showNormals(true);
-		if (header.pointFields.normXField)
-		{
-			arrays.xNormData.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "nor:normalX", arrays.xNormData.data(), chunkSize, true, (prototype.get("nor:normalX").type() == e57::E57_SCALED_INTEGER));
-		}
-		if (header.pointFields.normYField)
-		{
-			arrays.yNormData.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "nor:normalY", arrays.yNormData.data(), chunkSize, true, (prototype.get("nor:normalY").type() == e57::E57_SCALED_INTEGER));
-		}
-		if (header.pointFields.normZField)
-		{
-			arrays.zNormData.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "nor:normalZ", arrays.zNormData.data(), chunkSize, true, (prototype.get("nor:normalZ").type() == e57::E57_SCALED_INTEGER));
+			job.returnIndexSF->release();
+			job.returnIndexSF = nullptr;
+			return false;
 		}
+		cloud->addScalarField(job.returnIndexSF);
 	}
 
-	//intensity
-	//double intRange = 0;
-	//double intOffset = 0;
-	//ScalarType invalidSFValue = 0;
+	return true;
+}
 
-	ccScalarField* intensitySF = nullptr;
-	if (header.pointFields.intensityField)
+//! Decodes the points of a prepared scan (thread-safe as long as each thread uses its own ImageFile)
+/** The scan grid is filled while points are decoded.
+	\param imf E57 file (opened by the calling thread)
+	\param job prepared scan job
+	\param decodedRecordCount global counter of decoded records (for progress reporting)
+	\param cancelRequested global cancel flag
+**/
+static void DecodeScan(e57::ImageFile& imf, ScanJob& job, std::atomic<int64_t>& decodedRecordCount, const std::atomic<bool>& cancelRequested)
+{
+	try
 	{
-		intensitySF = new ccScalarField(CC_E57_INTENSITY_FIELD_NAME);
-		if (!intensitySF->resizeSafe(static_cast<unsigned>(pointCount)))
-		{
-			ccLog::Error("[E57] Not enough memory!");
-			intensitySF->release();
-			delete cloud;
-			return {};
-		}
-		cloud->addScalarField(intensitySF);
+		e57::VectorNode data3D(imf.root().get("/data3D"));
+		e57::StructureNode scanNode(data3D.get(job.data3DIndex));
+		e57::CompressedVectorNode points(scanNode.get("points"));
+		e57::StructureNode prototype(points.prototype());
 
-		arrays.intData.resize(chunkSize);
-		dbufs.emplace_back(node.destImageFile(), "intensity", arrays.intData.data(), chunkSize, true, (prototype.get("intensity").type() == e57::E57_SCALED_INTEGER));
-		//intRange = header.intensityLimits.intensityMaximum - header.intensityLimits.intensityMinimum;
-		//intOffset = header.intensityLimits.intensityMinimum;
+		//we load the file in several steps to limit the memory consumption
+		const unsigned chunkSize = std::min<unsigned>(static_cast<unsigned>(job.pointCount), (1 << 20));
+		TempArrays arrays;
+		std::vector<e57::SourceDestBuffer> dbufs;
 
-		if (header.pointFields.isIntensityInvalidField)
+		const PointStandardizedFieldsAvailable& fields = job.header.pointFields;
+		if (job.scanGrid)
 		{
-			arrays.isInvalidIntData.resize(chunkSize);
-			dbufs.emplace_back(node.destImageFile(), "isIntensityInvalid", arrays.isInvalidIntData.data(), chunkSize, true, (prototype.get("isIntensityInvalid").type() == e57::E57_SCALED_INTEGER));
+			AddDestBuffer(imf, prototype, "rowIndex", arrays.rowIndex, chunkSize, dbufs, false);
+			AddDestBuffer(imf, prototype, "columnIndex", arrays.columnIndex, chunkSize, dbufs, false);
 		}
-	}
 
-	//color buffers
-	double colorRedRange = 1;
-	double colorRedOffset = 0;
-	double colorGreenRange = 1;
-	double colorGreenOffset = 0;
-	double colorBlueRange = 1;
-	double colorBlueOffset = 0;
-	bool hasColors = (	header.pointFields.colorRedField
-					||	header.pointFields.colorGreenField
-					||	header.pointFields.colorBlueField);
-	if (hasColors)
-	{
-		if (!cloud->reserveTheRGBTable())
-		{
-			ccLog::Error("[E57] Not enough memory!");
-			delete cloud;
-			return {};
-		}
-		if (header.pointFields.colorRedField)
+		SetupCoordinateBuffers(job, imf, prototype, chunkSize, arrays, dbufs);
+
+		if (job.hasNormals)
 		{
-			arrays.redData.resize(chunkSize);
-			colorRedOffset = header.colorLimits.colorRedMinimum;
-			colorRedRange = header.colorLimits.colorRedMaximum - header.colorLimits.colorRedMinimum;
-			if (colorRedRange <= 0.0)
-				colorRedRange = 1.0;
-			dbufs.emplace_back(node.destImageFile(), "colorRed", arrays.redData.data(), chunkSize, true, (prototype.get("colorRed").type() == e57::E57_SCALED_INTEGER));
+			if (fields.normXField)
+				AddDestBuffer(imf, prototype, "nor:normalX", arrays.xNormData, chunkSize, dbufs);
+			if (fields.normYField)
+				AddDestBuffer(imf, prototype, "nor:normalY", arrays.yNormData, chunkSize, dbufs);
+			if (fields.normZField)
+				AddDestBuffer(imf, prototype, "nor:normalZ", arrays.zNormData, chunkSize, dbufs);
 		}
-		if (header.pointFields.colorGreenField)
+
+		if (job.intensitySF)
 		{
-			arrays.greenData.resize(chunkSize);
-			colorGreenOffset = header.colorLimits.colorGreenMinimum;
-			colorGreenRange = header.colorLimits.colorGreenMaximum - header.colorLimits.colorGreenMinimum;
-			if (colorGreenRange <= 0.0)
-				colorGreenRange = 1.0;
-			dbufs.emplace_back(node.destImageFile(), "colorGreen", arrays.greenData.data(), chunkSize, true, (prototype.get("colorGreen").type() == e57::E57_SCALED_INTEGER));
+			AddDestBuffer(imf, prototype, "intensity", arrays.intData, chunkSize, dbufs);
+			if (fields.isIntensityInvalidField)
+				AddDestBuffer(imf, prototype, "isIntensityInvalid", arrays.isInvalidIntData, chunkSize, dbufs);
 		}
-		if (header.pointFields.colorBlueField)
+
+		if (job.hasColors)
 		{
-			arrays.blueData.resize(chunkSize);
-			colorBlueOffset = header.colorLimits.colorBlueMinimum;
-			colorBlueRange = header.colorLimits.colorBlueMaximum - header.colorLimits.colorBlueMinimum;
-			if (colorBlueRange <= 0.0)
-				colorBlueRange = 1.0;
-			dbufs.emplace_back(node.destImageFile(), "colorBlue", arrays.blueData.data(), chunkSize, true, (prototype.get("colorBlue").type() == e57::E57_SCALED_INTEGER));
+			if (fields.colorRedField)
+				AddDestBuffer(imf, prototype, "colorRed", arrays.redData, chunkSize, dbufs);
+			if (fields.colorGreenField)
+				AddDestBuffer(imf, prototype, "colorGreen", arrays.greenData, chunkSize, dbufs);
+			if (fields.colorBlueField)
+				AddDestBuffer(imf, prototype, "colorBlue", arrays.blueData, chunkSize, dbufs);
 		}
-	}
 
-	//return index (multiple shoots scanners)
-	ccScalarField* returnIndexSF = nullptr;
-	if (header.pointFields.returnIndexField && header.pointFields.returnMaximum > 0)
-	{
-		//we store the point return index as a scalar field
-		returnIndexSF = new ccScalarField(CC_E57_RETURN_INDEX_FIELD_NAME);
-		if (!returnIndexSF->resizeSafe(static_cast<unsigned>(pointCount)))
+		if (job.returnIndexSF)
 		{
-			ccLog::Error("[E57] Not enough memory!");
-			delete cloud;
-			returnIndexSF->release();
-			return {};
+			AddDestBuffer(imf, prototype, "returnIndex", arrays.scanIndexData, chunkSize, dbufs);
 		}
-		cloud->addScalarField(returnIndexSF);
-		arrays.scanIndexData.resize(chunkSize);
-		dbufs.emplace_back(node.destImageFile(), "returnIndex", arrays.scanIndexData.data(), chunkSize, true, (prototype.get("returnIndex").type() == e57::E57_SCALED_INTEGER));
-	}
 
-	//Read the point data
-	e57::CompressedVectorReader dataReader = points.reader(dbufs);
+		//Read the point data
+		e57::CompressedVectorReader dataReader = points.reader(dbufs);
 
-	//local progress bar
-	CCCoreLib::NormalizedProgress nprogress(progressDlg, static_cast<unsigned>(pointCount / chunkSize));
-	if (progressDlg)
-	{
-		progressDlg->setMethodTitle(QObject::tr("Read E57 file"));
-		progressDlg->setInfo(QObject::tr("Scan #%1 - %2 points").arg(s_absoluteScanIndex).arg(pointCount));
-		progressDlg->start();
-		QApplication::processEvents();
-	}
-
-	CCVector3d Pshift(0, 0, 0);
-	unsigned size = 0;
-	int64_t realCount = 0;
-	int64_t invalidCount = 0;
-	int64_t zeroCount = 0;
-	int col = 0, row = 0;
-	while ((size = dataReader.read()))
-	{
-		for (unsigned i = 0; i < size; ++i)
+		ccPointCloud* cloud = job.cloud;
+		unsigned size = 0;
+		int col = 0, row = 0;
+		while ((size = dataReader.read()))
 		{
-			if (scanGrid)
+			for (unsigned i = 0; i < size; ++i)
 			{
-				col = arrays.columnIndex[i];
-				row = arrays.rowIndex[i];
-			}
-
-			//we skip invalid points!
-			if (!arrays.isInvalidData.empty() && arrays.isInvalidData[i] != 0)
-			{
-				++invalidCount;
-				if (scanGrid)
+				if (job.scanGrid)
 				{
-					scanGrid->setIndex(row, col, -1);
+					col = arrays.columnIndex[i];
+					row = arrays.rowIndex[i];
 				}
-				continue;
-			}
 
-			CCVector3d Pd(0, 0, 0);
-			if (sphericalMode)
-			{
-				double r = (arrays.xData.empty() ? 0 : arrays.xData[i]);
-				double theta = (arrays.yData.empty() ? 0 : arrays.yData[i]);	//Azimuth
-				double phi = (arrays.zData.empty() ? 0 : arrays.zData[i]);		//Elevation
-
-				double cos_phi = cos(phi);
-				Pd.x = r * cos_phi * cos(theta);
-				Pd.y = r * cos_phi * sin(theta);
-				Pd.z = r * sin(phi);
-			}
-			//DGM TODO: not handled yet (-->what are the standard cylindrical field names?)
-			/*else if (cylindricalMode)
-			{
-				//from cylindrical coordinates
-				assert(arrays.xData);
-				double theta = (arrays.yData ? arrays.yData[i] : 0);
-				Pd.x = arrays.xData[i] * cos(theta);
-				Pd.y = arrays.xData[i] * sin(theta);
-				if (arrays.zData)
-					Pd.z = arrays.zData[i];
-			}
-			//*/
-			else //cartesian
-			{
-				if (!arrays.xData.empty())
-					Pd.x = arrays.xData[i];
-				if (!arrays.yData.empty())
-					Pd.y = arrays.yData[i];
-				if (!arrays.zData.empty())
-					Pd.z = arrays.zData[i];
-			}
-
-			if (Pd.x == 0 && Pd.y == 0 && Pd.z == 0)
-			{
-				++zeroCount;
-			}
-
-			//first point: check for 'big' coordinates
-			if (realCount == 0 && !poseMatWasShifted)
-			{
-				if (FileIOFilter::HandleGlobalShift(Pd, Pshift, preserveCoordinateShift, s_loadParameters))
+				//we skip invalid points!
+				if (!arrays.isInvalidData.empty() && arrays.isInvalidData[i] != 0)
 				{
-					globalShiftApplied = true;
-					if (preserveCoordinateShift)
+					++job.invalidCount;
+					if (job.scanGrid)
 					{
-						cloud->setGlobalShift(Pshift);
+						job.scanGrid->setIndex(row, col, -1);
 					}
-					ccLog::Warning("[E57Filter::loadFile] Cloud %s has been recentered! Translation: (%.2f ; %.2f ; %.2f)", qPrintable(guidStr), Pshift.x, Pshift.y, Pshift.z);
+					continue;
 				}
-			}
 
-			if (scanGrid)
-			{
-				scanGrid->setIndex(row, col, static_cast<int>(cloud->size()));
-			}
+				const CCVector3d Pd = GetCartesianCoordinates(arrays, i, job.sphericalMode);
+				if (Pd.x == 0 && Pd.y == 0 && Pd.z == 0)
+				{
+					++job.zeroCount;
+				}
 
-			const CCVector3 P = (Pd + Pshift).toPC();
-			cloud->addPoint(P);
+				if (job.scanGrid)
+				{
+					job.scanGrid->setIndex(row, col, static_cast<int>(cloud->size()));
+				}
 
-			if (hasNormals)
-			{
-				CCVector3 N(0, 0, 0);
-				if (!arrays.xNormData.empty())
-					N.x = static_cast<PointCoordinateType>(arrays.xNormData[i]);
-				if (!arrays.yNormData.empty())
-					N.y = static_cast<PointCoordinateType>(arrays.yNormData[i]);
-				if (!arrays.zNormData.empty())
-					N.z = static_cast<PointCoordinateType>(arrays.zNormData[i]);
-				N.normalize();
-				cloud->addNorm(N);
-			}
+				cloud->addPoint((Pd + job.Pshift).toPC());
 
-			if (!arrays.intData.empty())
-			{
-				assert(intensitySF);
-				if (!header.pointFields.isIntensityInvalidField || arrays.isInvalidIntData[i] != INVALID_DATA)
+				if (job.hasNormals)
 				{
-					//ScalarType intensity = (ScalarType)((arrays.intData[i] - intOffset)/intRange); //Normalize intensity to 0 - 1.
-					const ScalarType intensity = static_cast<ScalarType>(arrays.intData[i]);
-					intensitySF->setValue(static_cast<unsigned>(realCount), intensity);
+					CCVector3 N(0, 0, 0);
+					if (!arrays.xNormData.empty())
+						N.x = static_cast<PointCoordinateType>(arrays.xNormData[i]);
+					if (!arrays.yNormData.empty())
+						N.y = static_cast<PointCoordinateType>(arrays.yNormData[i]);
+					if (!arrays.zNormData.empty())
+						N.z = static_cast<PointCoordinateType>(arrays.zNormData[i]);
+					N.normalize();
+					cloud->addNorm(N);
+				}
 
-					//track max intensity (for proper visualization)
-					if (s_absoluteScanIndex != 0 || realCount != 0)
+				if (!arrays.intData.empty())
+				{
+					assert(job.intensitySF);
+					if (!fields.isIntensityInvalidField || arrays.isInvalidIntData[i] != INVALID_DATA)
 					{
-						if (s_maxIntensity < intensity)
-							s_maxIntensity = intensity;
-						else if (s_minIntensity > intensity)
-							s_minIntensity = intensity;
+						const ScalarType intensity = static_cast<ScalarType>(arrays.intData[i]);
+						job.intensitySF->setValue(static_cast<unsigned>(job.realCount), intensity);
+
+						//track min and max intensity (for proper visualization)
+						if (job.hasValidIntensity)
+						{
+							if (job.maxIntensity < intensity)
+								job.maxIntensity = intensity;
+							else if (job.minIntensity > intensity)
+								job.minIntensity = intensity;
+						}
+						else
+						{
+							job.maxIntensity = job.minIntensity = intensity;
+							job.hasValidIntensity = true;
+						}
 					}
 					else
 					{
-						s_maxIntensity = s_minIntensity = intensity;
+						job.intensitySF->flagValueAsInvalid(static_cast<unsigned>(job.realCount));
 					}
 				}
-				else
+
+				if (job.hasColors)
 				{
-					intensitySF->flagValueAsInvalid(static_cast<unsigned>(realCount));
+					//Normalize color to 0 - 255
+					ccColor::Rgb C(0, 0, 0);
+					if (!arrays.redData.empty())
+						C.r = static_cast<ColorCompType>(((arrays.redData[i] - job.colorOffset[0]) * 255) / job.colorRange[0]);
+					if (!arrays.greenData.empty())
+						C.g = static_cast<ColorCompType>(((arrays.greenData[i] - job.colorOffset[1]) * 255) / job.colorRange[1]);
+					if (!arrays.blueData.empty())
+						C.b = static_cast<ColorCompType>(((arrays.blueData[i] - job.colorOffset[2]) * 255) / job.colorRange[2]);
+
+					cloud->addColor(C);
 				}
-			}
 
-			if (hasColors)
-			{
-				//Normalize color to 0 - 255
-				ccColor::Rgb C(0, 0, 0);
-				if (!arrays.redData.empty())
-					C.r = static_cast<ColorCompType>(((arrays.redData[i] - colorRedOffset) * 255) / colorRedRange);
-				if (!arrays.greenData.empty())
-					C.g = static_cast<ColorCompType>(((arrays.greenData[i] - colorGreenOffset) * 255) / colorGreenRange);
-				if (!arrays.blueData.empty())
-					C.b = static_cast<ColorCompType>(((arrays.blueData[i] - colorBlueOffset) * 255) / colorBlueRange);
-
-				cloud->addColor(C);
+				if (!arrays.scanIndexData.empty())
+				{
+					assert(job.returnIndexSF);
+					const ScalarType s = static_cast<ScalarType>(arrays.scanIndexData[i]);
+					job.returnIndexSF->setValue(static_cast<unsigned>(job.realCount), s);
+				}
+
+				++job.realCount;
 			}
 
-			if (!arrays.scanIndexData.empty())
+			decodedRecordCount += size;
+
+			if (cancelRequested)
 			{
-				assert(returnIndexSF);
-				const ScalarType s = static_cast<ScalarType>(arrays.scanIndexData[i]);
-				returnIndexSF->setValue(static_cast<unsigned>(realCount), s);
+				break;
 			}
-
-			realCount++;
 		}
 
-		if (progressDlg && !nprogress.oneStep())
+		dataReader.close();
+	}
+	catch (const e57::E57Exception& e)
+	{
+		job.error = QString::fromStdString(e57::Utilities::errorCodeToString(e.errorCode()));
+		if (!e.context().empty())
 		{
-			QApplication::processEvents();
-			s_cancelRequestedByUser = true;
-			break;
+			job.error += QStringLiteral(" (context: %1)").arg(QString::fromStdString(e.context()));
 		}
 	}
+	catch (const std::bad_alloc&)
+	{
+		job.error = "Not enough memory";
+	}
+	catch (...)
+	{
+		job.error = "Unknown error";
+	}
+}
+
+//! Finalizes a decoded scan (should be called on the main thread)
+/** \warning the job cloud is either returned or deleted
+**/
+static LoadedScan FinalizeScan(ScanJob& job)
+{
+	ccPointCloud* cloud = job.cloud;
+	job.cloud = nullptr;
+	if (!cloud)
+	{
+		assert(false);
+		return {};
+	}
 
-	dataReader.close();
+	if (!job.error.isEmpty())
+	{
+		ccLog::Warning(QString("[E57] Failed to read scan '%1': %2").arg(job.elementName, job.error));
+		delete cloud;
+		return {};
+	}
 
-	if (zeroCount > 1)
+	if (job.zeroCount > 1)
 	{
-		ccLog::Warning(QString("[E57] Number of points clustured at the origin: %1 (consider removing duplicate points)").arg(zeroCount));
+		ccLog::Warning(QString("[E57] Number of points clustured at the origin: %1 (consider removing duplicate points)").arg(job.zeroCount));
 	}
 
-	if (realCount == 0)
+	if (job.realCount == 0)
 	{
-		ccLog::Warning(QString("[E57] No valid point in scan '%1'!").arg(scanNode.elementName().c_str()));
+		ccLog::Warning(QString("[E57] No valid point in scan '%1'!").arg(job.elementName));
 		delete cloud;
 		return {};
 	}
-	else if (realCount < pointCount)
+	else if (job.realCount < job.pointCount)
 	{
-		if ( (realCount + invalidCount) != pointCount )
+		if ( (job.realCount + job.invalidCount) != job.pointCount )
 		{
-			ccLog::Warning(QString("[E57] We read fewer points than expected for scan '%1' (%2/%3)").arg(scanNode.elementName().c_str()).arg(realCount).arg(pointCount));
+			ccLog::Warning(QString("[E57] We read fewer points than expected for scan '%1' (%2/%3)").arg(job.elementName).arg(job.realCount).arg(job.pointCount));
 		}
 		
-		cloud->resize(static_cast<unsigned>(realCount));
+		cloud->resize(static_cast<unsigned>(job.realCount));
 	}
 
 	//Scan grid
-	if (scanGrid)
+	if (job.scanGrid)
 	{
-		scanGrid->validCount = realCount;
-		scanGrid->minValidIndex = 0;
-		scanGrid->maxValidIndex = realCount - 1;
-		cloud->addGrid(scanGrid);
+		job.scanGrid->validCount = job.realCount;
+		job.scanGrid->minValidIndex = 0;
+		job.scanGrid->maxValidIndex = job.realCount - 1;
+		cloud->addGrid(job.scanGrid);
 
-		ccLog::Print(QString("[E57] Scan grid loaded for scan '%1' (%2 x %3)").arg(scanNode.elementName().c_str()).arg(scanGrid->w).arg(scanGrid->h));
+		ccLog::Print(QString("[E57] Scan grid loaded for scan '%1' (%2 x %3)").arg(job.elementName).arg(job.scanGrid->w).arg(job.scanGrid->h));
 	}
 
 	//Scalar fields
-	if (intensitySF)
+	if (job.intensitySF)
 	{
-		intensitySF->computeMinAndMax();
-		if (intensitySF->getMin() >= 0 && intensitySF->getMax() <= 1.0)
-			intensitySF->setColorScale(ccColorScalesManager::GetDefaultScale(ccColorScalesManager::ABS_NORM_GREY));
+		job.intensitySF->computeMinAndMax();
+		if (job.intensitySF->getMin() >= 0 && job.intensitySF->getMax() <= 1.0)
+			job.intensitySF->setColorScale(ccColorScalesManager::GetDefaultScale(ccColorScalesManager::ABS_NORM_GREY));
 		else
-			intensitySF->setColorScale(ccColorScalesManager::GetDefaultScale(ccColorScalesManager::GREY));
-		cloud->setCurrentDisplayedScalarField(cloud->getScalarFieldIndexByName(intensitySF->getName()));
+			job.intensitySF->setColorScale(ccColorScalesManager::GetDefaultScale(ccColorScalesManager::GREY));
+		cloud->setCurrentDisplayedScalarField(cloud->getScalarFieldIndexByName(job.intensitySF->getName()));
 		cloud->showSF(true);
 	}
 
-	if (returnIndexSF)
+	if (job.returnIndexSF)
 	{
-		returnIndexSF->computeMinAndMax();
-		cloud->setCurrentDisplayedScalarField(cloud->getScalarFieldIndexByName(returnIndexSF->getName()));
+		job.returnIndexSF->computeMinAndMax();
+		cloud->setCurrentDisplayedScalarField(cloud->getScalarFieldIndexByName(job.returnIndexSF->getName()));
 		ccLog::Warning("[E57] Cloud has multiple echoes: use 'Edit > Scalar Fields > Filter by value' to extract one component");
 		cloud->showSF(true);
 	}
 
-	cloud->showColors(hasColors);
+	cloud->showColors(job.hasColors);
 	cloud->setVisible(true);
 
 	//we don't deal with virtual transformation (yet)
-	if (validPoseMat)
+	if (job.validPoseMat)
 	{
-		const ccGLMatrix poseMatf(poseMat.data());
+		const ccGLMatrix poseMatf(job.poseMat.data());
 		
 		cloud->applyGLTransformation_recursive(&poseMatf);
 		//this transformation is of no interest for the user
 		cloud->resetGLTransformationHistory_recursive();
 
 		//save the original pose matrix as meta-data
-		cloud->setMetaData(s_e57PoseKey, poseMat.toString(12, ' '));
+		cloud->setMetaData(s_e57PoseKey, job.poseMat.toString(12, ' '));
+	}
+
+	if (job.sensor) //add the sensor at the end, after calling applyGLTransformation_recursive!
+	{
+		job.sensor->setEnabled(false);
+		job.sensor->setVisible(true);
+		job.sensor->setGraphicScale(cloud->getOwnBB().getDiagNorm() / 20);
+		cloud->addChild(job.sensor);
+		job.sensor = nullptr;
+	}
+
+	return { cloud, job.globalShiftApplied, job.poseMatWasShifted ? job.poseMatShift : job.Pshift, job.preserveCoordinateShift };
+}
+
+//! Releases the entities of a job that won't be finalized
+static void DiscardScan(ScanJob& job)
+{
+	delete job.sensor; //not attached to the cloud yet
+	job.sensor = nullptr;
+	delete job.cloud; //will also release the scalar fields
+	job.cloud = nullptr;
+}
+
+//! Returns whether a scan should be loaded
+static bool IsScanSelected(const e57::Node& scanNode, unsigned scanIndex)
+{
+	if (s_loadParameters.scanSelection.isEmpty())
+	{
+		//no filter
+		return true;
 	}
 
-	if (sensor) //add the sensor at the end, after calling applyGLTransformation_recursive!
+	if (s_loadParameters.scanSelection.contains(QString::number(scanIndex)))
 	{
-		sensor->setEnabled(false);
-		sensor->setVisible(true);
-		sensor->setGraphicScale(cloud->getOwnBB().getDiagNorm() / 20);
-		cloud->addChild(sensor);
+		return true;
 	}
 
-	return { cloud, globalShiftApplied, poseMatWasShifted ? poseMatShift : Pshift, preserveCoordinateShift };
+	if (scanNode.type() == e57::E57_STRUCTURE)
+	{
+		e57::StructureNode scanStruct(scanNode);
+		for (const char* key : { "name", "guid" })
+		{
+			if (scanStruct.isDefined(key) && scanStruct.get(key).type() == e57::E57_STRING)
+			{
+				if (s_loadParameters.scanSelection.contains(QString::fromStdString(e57::StringNode(scanStruct.get(key)).value())))
+				{
+					return true;
+				}
+			}
+		}
+		if (s_loadParameters.scanSelection.contains(QString::fromStdString(scanStruct.elementName())))
+		{
+			return true;
+		}
+	}
+
+	return false;
 }
 
 //! Loaded image
@@ -2512,55 +2648,171 @@ CC_FILE_ERROR E57Filter::loadFile(const QString& filename, ccHObject& container,
 				progressDlg->setAutoClose(false);
 			}
 
-			bool showGlobalProgress = (scanCount > 10);
-			if (progressDlg && showGlobalProgress)
-			{
-				//Too many scans, will display a global progress bar
-				progressDlg->setMethodTitle(QObject::tr("Read E57 file"));
-				progressDlg->setInfo(QObject::tr("Scans: %1").arg(scanCount));
-				progressDlg->start();
-				QApplication::processEvents();
-			}
-			CCCoreLib::NormalizedProgress nprogress(progressDlg.data(), showGlobalProgress ? scanCount : 100);
-
 			//static states
 			s_absoluteScanIndex = 0;
 			s_cancelRequestedByUser = false;
 			s_minIntensity = s_maxIntensity = 0;
+
+			//1st pass: read the scans headers and prepare the output entities (on the main thread,
+			//as handling the Global Shift may require some user interaction)
+			std::vector<ScanJob> jobs;
+			jobs.reserve(scanCount);
+			int64_t totalRecordCount = 0;
 			for (unsigned i = 0; i < scanCount; ++i)
 			{
 				const e57::Node scanNode = data3D.get(i);
-				QString scanGUID;
-				
-				LoadedScan scan = LoadScan(scanNode, scanGUID, showGlobalProgress ? nullptr : progressDlg.data());
-				
+				if (!IsScanSelected(scanNode, i))
+				{
+					ccLog::Print(QString("[E57] Scan #%1 (%2) skipped").arg(i).arg(QString::fromStdString(scanNode.elementName())));
+					continue;
+				}
+
+				ScanJob job;
+				job.data3DIndex = i;
+				if (PrepareScan(scanNode, job))
+				{
+					totalRecordCount += job.pointCount;
+					jobs.push_back(job);
+				}
+				else
+				{
+					DiscardScan(job);
+				}
+			}
+
+			//2nd pass: decode the scans concurrently (each worker has its own reader)
+			if (!jobs.empty())
+			{
+				int maxThreadCount = (s_loadParameters.maxThreadCount > 0 ? s_loadParameters.maxThreadCount : ccQtHelpers::GetMaxThreadCount());
+				const size_t workerCount = std::max<size_t>(1, std::min<size_t>(jobs.size(), static_cast<size_t>(maxThreadCount)));
+
+				//biggest scans first (for a better load balancing)
+				std::vector<size_t> jobOrder(jobs.size());
+				for (size_t i = 0; i < jobOrder.size(); ++i)
+				{
+					jobOrder[i] = i;
+				}
+				std::stable_sort(jobOrder.begin(), jobOrder.end(), [&jobs](size_t a, size_t b) { return jobs[a].pointCount > jobs[b].pointCount; });
+
+				//each worker needs its own file handle (libE57Format is not thread-safe)
+				std::vector<e57::ImageFile> workerFiles;
+				workerFiles.reserve(workerCount);
+				workerFiles.push_back(imf);
+				for (size_t i = 1; i < workerCount; ++i)
+				{
+					e57::ImageFile workerFile(filename.toStdString(), "r", e57::CHECKSUM_POLICY_SPARSE);
+					if (!workerFile.extensionsLookupPrefix("nor", _normalsExtension))
+					{
+						workerFile.extensionsAdd("nor", normalsExtension);
+					}
+					workerFiles.push_back(workerFile);
+				}
+
+				if (progressDlg)
+				{
+					progressDlg->setMethodTitle(QObject::tr("Read E57 file"));
+					progressDlg->setInfo(QObject::tr("Scans: %1 - %2 points").arg(jobs.size()).arg(totalRecordCount));
+					progressDlg->start();
+					QApplication::processEvents();
+				}
+
+				std::atomic<int64_t> decodedRecordCount(0);
+				std::atomic<bool> cancelRequested(false);
+				std::atomic<size_t> nextJob(0);
+
+				QList< QFuture<void> > workers;
+				for (size_t w = 0; w < workerCount; ++w)
+				{
+					e57::ImageFile* workerFile = &workerFiles[w];
+					workers.push_back(QtConcurrent::run([&, workerFile]()
+					{
+						size_t j = 0;
+						while (!cancelRequested && (j = nextJob++) < jobOrder.size())
+						{
+							DecodeScan(*workerFile, jobs[jobOrder[j]], decodedRecordCount, cancelRequested);
+						}
+					}));
+				}
+
+				for (QFuture<void>& worker : workers)
+				{
+					while (!worker.isFinished())
+					{
+						QThread::msleep(100);
+						if (progressDlg)
+						{
+							progressDlg->update(totalRecordCount != 0 ? (100.0f * decodedRecordCount) / totalRecordCount : 100.0f);
+							if (progressDlg->wasCanceled())
+							{
+								cancelRequested = true;
+							}
+						}
+						QApplication::processEvents();
+					}
+				}
+				s_cancelRequestedByUser = cancelRequested;
+
+				for (size_t i = 1; i < workerFiles.size(); ++i)
+				{
+					workerFiles[i].close();
+				}
+			}
+
+			//3rd pass: finalize the scans (in the file order)
+			bool hasIntensityRange = false;
+			for (ScanJob& job : jobs)
+			{
+				if (s_cancelRequestedByUser && job.realCount == 0)
+				{
+					//not decoded
+					DiscardScan(job);
+					continue;
+				}
+
+				const bool hasValidIntensity = job.hasValidIntensity && job.error.isEmpty();
+				const ScalarType minIntensity = job.minIntensity;
+				const ScalarType maxIntensity = job.maxIntensity;
+
+				LoadedScan scan = FinalizeScan(job);
+				DiscardScan(job); //in case something is left
+
 				if (scan.entity)
 				{
+					//track the global min and max intensity
+					if (hasValidIntensity)
+					{
+						if (hasIntensityRange)
+						{
+							s_minIntensity = std::min(s_minIntensity, minIntensity);
+							s_maxIntensity = std::max(s_maxIntensity, maxIntensity);
+						}
+						else
+						{
+							s_minIntensity = minIntensity;
+							s_maxIntensity = maxIntensity;
+							hasIntensityRange = true;
+						}
+					}
+
 					if (scan.entity->getName().isEmpty())
 					{
 						QString name("Scan ");
-						e57::ustring nodeName = scanNode.elementName();
 
-						if (!nodeName.empty())
-							name += QString::fromStdString(nodeName);
+						if (!job.elementName.isEmpty())
+							name += job.elementName;
 						else
-							name += QString::number(i);
+							name += QString::number(job.data3DIndex);
 
 						scan.entity->setName(name);
 					}
 					container.addChild(scan.entity);
 
 					//we also add the scan to the GUID/object map
-					if (!scanGUID.isEmpty())
+					if (!job.guid.isEmpty())
 					{
-						scans.insert(scanGUID, scan);
+						scans.insert(job.guid, scan);
 					}
 				}
-				
-				if ((showGlobalProgress && progressDlg && !nprogress.oneStep()) || s_cancelRequestedByUser)
-				{
-					break;
-				}
 				++s_absoluteScanIndex;
 			}
 
@@ -0,0 +1,150 @@
+#pragma once
+
+//##########################################################################
+//#                                                                        #
+//#                   CLOUDCOMPARE PLUGIN: qAnimation                      #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#             COPYRIGHT: Ryan Wicks, 2G Robotics Inc., 2015              #
+//#                                                                        #
+//##########################################################################
+
+//Qt
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+//System
+#include <atomic>
+#include <deque>
+
+class QVideoEncoder;
+
+//! Pipelined export of the rendered frames
+/** The frames are rendered by the main thread (OpenGL) and pushed in a bounded
+	queue. Meanwhile, worker threads downscale them (super resolution mode) and
+	either write them as individual images (in parallel) or feed them, in order,
+	to the video encoder (color conversion + encoding, on a dedicated thread).
+
+	When the queue is full, push() waits for the oldest frame to be processed.
+**/
+class FrameExporter
+{
+public:
+
+	//! Constructor
+	/** \param downscaleFactor the frames are downscaled by this factor before being written/encoded (super resolution mode)
+	**/
+	explicit FrameExporter(int downscaleFactor = 1);
+
+	//! Destructor (waits for the pending frames)
+	~FrameExporter();
+
+	//! Sets the video encoder (the frames will be encoded in order)
+	/** \warning The encoder must not be used by the caller until finish() is called.
+	**/
+	void setEncoder(QVideoEncoder* encoder);
+
+	//! Sets the output directory and image format (the frames will be written as individual images)
+	/** \param outputDir output directory
+		\param format image format ("png" or "jpg")
+		\param quality image quality (-1 = default)
+	**/
+	void setFramesOutput(const QDir& outputDir, const QString& format, int quality = -1);
+
+	//! Pushes a new frame
+	/** May wait for the oldest frame to be processed if the queue is full.
+		\return false if a previous frame failed (see errorMessage)
+	**/
+	bool push(const QImage& image, int frameIndex);
+
+	//! Waits for all the pending frames to be processed
+	/** \return false if any frame failed (see errorMessage)
+	**/
+	bool finish();
+
+	//! Discards the frames that are not processed yet and waits for the running ones
+	void cancel();
+
+	//! Returns the last error message
+	QString errorMessage() const;
+
+	//! Adds the time spent to render a frame (for the timing report)
+	inline void addRenderTime(qint64 ns) { m_renderTime_ns += ns; }
+
+	//! Logs the time spent in each stage of the pipeline
+	void reportTimings() const;
+
+protected:
+
+	//! Downscales a frame and converts it to the encoder format if necessary (worker thread)
+	QImage prepare(const QImage& image);
+
+	//! Writes a frame as an individual image (worker thread)
+	bool write(const QImage& image, int frameIndex);
+
+	//! Encodes a frame (encoder thread)
+	bool encode(const QImage& image, int frameIndex);
+
+	//! Records an error (any thread)
+	void setError(const QString& message);
+
+	//! Downscale factor
+	int m_downscaleFactor;
+	//! Video encoder (if any)
+	QVideoEncoder* m_encoder;
+	//! Output directory (frames mode)
+	QDir m_outputDir;
+	//! Output image format (frames mode)
+	QString m_format;
+	//! Output image quality (frames mode)
+	int m_quality;
+
+	//! Worker threads (downscaling and image writing)
+	QThreadPool m_workerPool;
+	//! Encoder thread (the frames must be encoded one after the other, in order)
+	QThreadPool m_encoderPool;
+
+	//! Frames being processed (oldest first)
+	std::deque<QFuture<void>> m_pendingFrames;
+	//! Maximum number of pending frames (computed from the size of the first frame)
+	size_t m_maxPendingFrames;
+
+	//! Whether the process has failed or has been canceled
+	std::atomic<bool> m_stopped;
+	//! Whether an error occurred
+	std::atomic<bool> m_failed;
+	//! Error mutex
+	mutable QMutex m_errorMutex;
+	//! Last error message
+	QString m_errorMessage;
+
+	//! Processed frames
+	std::atomic<int> m_frameCount;
+	//! Time spent rendering (main thread)
+	qint64 m_renderTime_ns;
+	//! Time spent waiting for the queue (main thread)
+	qint64 m_waitTime_ns;
+	//! Time spent preparing the frames (cumulated over the workers)
+	std::atomic<qint64> m_prepareTime_ns;
+	//! Time spent writing the images (cumulated over the workers)
+	std::atomic<qint64> m_writeTime_ns;
+	//! Time spent encoding (color conversion + encoding)
+	std::atomic<qint64> m_encodeTime_ns;
+	//! Total time (from the first push to the end of finish)
+	qint64 m_totalTime_ns;
+	//! Total time timer
+	QElapsedTimer m_totalTimer;
+};
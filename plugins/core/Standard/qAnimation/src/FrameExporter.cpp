@@ -0,0 +1,274 @@
+//##########################################################################
+//#                                                                        #
+//#                   CLOUDCOMPARE PLUGIN: qAnimation                      #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#             COPYRIGHT: Ryan Wicks, 2G Robotics Inc., 2015              #
+//#                                                                        #
+//##########################################################################
+
+#include "FrameExporter.h"
+
+//qCC_db
+#include <ccLog.h>
+
+//qCC_plugins
+#include <ccQtHelpers.h>
+
+//Qt
+#include <QMutexLocker>
+#include <QtConcurrentRun>
+
+#ifdef QFFMPEG_SUPPORT
+//QTFFmpeg
+#include <QVideoEncoder.h>
+#endif
+
+//System
+#include <algorithm>
+#include <cassert>
+
+//! Maximum amount of memory used by the pending frames (in bytes)
+static const qint64 s_maxPendingBytes = (qint64(1) << 30); //1 Gb
+
+FrameExporter::FrameExporter(int downscaleFactor/*=1*/)
+	: m_downscaleFactor(std::max(1, downscaleFactor))
+	, m_encoder(nullptr)
+	, m_quality(-1)
+	, m_maxPendingFrames(0)
+	, m_stopped(false)
+	, m_failed(false)
+	, m_frameCount(0)
+	, m_renderTime_ns(0)
+	, m_waitTime_ns(0)
+	, m_prepareTime_ns(0)
+	, m_writeTime_ns(0)
+	, m_encodeTime_ns(0)
+	, m_totalTime_ns(0)
+{
+	//the main thread is busy rendering the next frames
+	m_workerPool.setMaxThreadCount(std::max(1, ccQtHelpers::GetMaxThreadCount() - 1));
+	m_encoderPool.setMaxThreadCount(1);
+}
+
+FrameExporter::~FrameExporter()
+{
+	cancel();
+}
+
+void FrameExporter::setEncoder(QVideoEncoder* encoder)
+{
+	assert(m_pendingFrames.empty());
+	m_encoder = encoder;
+}
+
+void FrameExporter::setFramesOutput(const QDir& outputDir, const QString& format, int quality/*=-1*/)
+{
+	assert(m_pendingFrames.empty());
+	m_outputDir = outputDir;
+	m_format = format;
+	m_quality = quality;
+}
+
+bool FrameExporter::push(const QImage& image, int frameIndex)
+{
+	if (m_stopped)
+	{
+		return false;
+	}
+
+	if (m_maxPendingFrames == 0)
+	{
+		m_totalTimer.start();
+
+		//enough frames to keep all the threads busy, but not too many (the super resolution frames can be huge)
+		qint64 frameBytes = std::max<qint64>(1, static_cast<qint64>(image.bytesPerLine()) * image.height());
+		qint64 maxFrames = std::max<qint64>(2, s_maxPendingBytes / frameBytes);
+		m_maxPendingFrames = static_cast<size_t>(std::min<qint64>(2 * (m_workerPool.maxThreadCount() + 1), maxFrames));
+	}
+
+	//remove the frames already processed
+	while (!m_pendingFrames.empty() && m_pendingFrames.front().isFinished())
+	{
+		m_pendingFrames.pop_front();
+	}
+
+	//wait for the oldest frame if the queue is full
+	if (m_pendingFrames.size() >= m_maxPendingFrames)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		m_pendingFrames.front().waitForFinished();
+		m_pendingFrames.pop_front();
+		m_waitTime_ns += timer.nsecsElapsed();
+
+		if (m_stopped)
+		{
+			return false;
+		}
+	}
+
+	if (m_encoder)
+	{
+		//the frames are prepared in parallel...
+		QFuture<QImage> preparedFrame = QtConcurrent::run(&m_workerPool, [this, image]() { return prepare(image); });
+
+		//...and encoded in order (by the single encoder thread)
+		m_pendingFrames.push_back(QtConcurrent::run(&m_encoderPool, [this, preparedFrame, frameIndex]()
+		{
+			QImage frame = preparedFrame.result();
+			if (!m_stopped)
+			{
+				encode(frame, frameIndex);
+			}
+		}));
+	}
+	else
+	{
+		//the frames are prepared and written in parallel
+		m_pendingFrames.push_back(QtConcurrent::run(&m_workerPool, [this, image, frameIndex]()
+		{
+			QImage frame = prepare(image);
+			if (!m_stopped)
+			{
+				write(frame, frameIndex);
+			}
+		}));
+	}
+
+	return true;
+}
+
+bool FrameExporter::finish()
+{
+	for (QFuture<void>& future : m_pendingFrames)
+	{
+		future.waitForFinished();
+	}
+	m_pendingFrames.clear();
+
+	if (m_totalTimer.isValid())
+	{
+		m_totalTime_ns = m_totalTimer.nsecsElapsed();
+	}
+
+	return !m_failed;
+}
+
+void FrameExporter::cancel()
+{
+	m_stopped = true;
+	finish();
+}
+
+QString FrameExporter::errorMessage() const
+{
+	QMutexLocker locker(&m_errorMutex);
+	return m_errorMessage;
+}
+
+void FrameExporter::setError(const QString& message)
+{
+	QMutexLocker locker(&m_errorMutex);
+	m_errorMessage = message;
+	m_failed = true;
+	m_stopped = true;
+}
+
+QImage FrameExporter::prepare(const QImage& image)
+{
+	if (m_stopped)
+	{
+		return QImage();
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	QImage frame = image;
+	if (m_downscaleFactor > 1)
+	{
+		frame = frame.scaled(frame.width() / m_downscaleFactor, frame.height() / m_downscaleFactor, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	}
+
+	//the encoder expects 32 bits frames
+	if (	m_encoder
+		&&	frame.format() != QImage::Format_RGB32
+		&&	frame.format() != QImage::Format_ARGB32
+		&&	frame.format() != QImage::Format_ARGB32_Premultiplied)
+	{
+		frame = frame.convertToFormat(QImage::Format_ARGB32);
+	}
+
+	m_prepareTime_ns += timer.nsecsElapsed();
+
+	return frame;
+}
+
+bool FrameExporter::write(const QImage& image, int frameIndex)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	QString filename = QString("frame_%1.%2").arg(frameIndex, 6, 10, QChar('0')).arg(m_format);
+	if (image.isNull() || !image.save(m_outputDir.filePath(filename), nullptr, m_quality))
+	{
+		setError(QString("Failed to save frame #%1").arg(frameIndex + 1));
+		return false;
+	}
+
+	m_writeTime_ns += timer.nsecsElapsed();
+	++m_frameCount;
+
+	return true;
+}
+
+bool FrameExporter::encode(const QImage& image, int frameIndex)
+{
+#ifdef QFFMPEG_SUPPORT
+	QElapsedTimer timer;
+	timer.start();
+
+	QString errorString;
+	if (image.isNull() || !m_encoder->encodeImage(image, frameIndex, &errorString))
+	{
+		setError(QString("Failed to encode frame #%1: %2").arg(frameIndex + 1).arg(errorString));
+		return false;
+	}
+
+	m_encodeTime_ns += timer.nsecsElapsed();
+	++m_frameCount;
+
+	return true;
+#else
+	Q_UNUSED(image);
+	setError(QString("Failed to encode frame #%1: no FFMPEG support").arg(frameIndex + 1));
+	return false;
+#endif
+}
+
+void FrameExporter::reportTimings() const
+{
+	static const double s_nsToMs = 1.0e-6;
+
+	ccLog::Print(QString("[qAnimation] %1 frame(s) exported in %2 s").arg(m_frameCount.load()).arg(m_totalTime_ns * 1.0e-9, 0, 'f', 2));
+	ccLog::Print(QString("[qAnimation] Rendering: %1 ms (main thread)").arg(m_renderTime_ns * s_nsToMs, 0, 'f', 1));
+	ccLog::Print(QString("[qAnimation] Preparation (downscaling, format conversion): %1 ms (cumulated over %2 worker thread(s))").arg(m_prepareTime_ns.load() * s_nsToMs, 0, 'f', 1).arg(m_workerPool.maxThreadCount()));
+	if (m_encoder)
+	{
+		ccLog::Print(QString("[qAnimation] Color conversion + encoding: %1 ms (encoder thread)").arg(m_encodeTime_ns.load() * s_nsToMs, 0, 'f', 1));
+	}
+	else
+	{
+		ccLog::Print(QString("[qAnimation] Image writing: %1 ms (cumulated over %2 worker thread(s))").arg(m_writeTime_ns.load() * s_nsToMs, 0, 'f', 1).arg(m_workerPool.maxThreadCount()));
+	}
+	ccLog::Print(QString("[qAnimation] Waiting for the queue (max %1 frame(s)): %2 ms (main thread)").arg(m_maxPendingFrames).arg(m_waitTime_ns * s_nsToMs, 0, 'f', 1));
+}
@@ -18,6 +18,7 @@
 #include "qAnimationDlg.h"
 
 //Local
+#include "FrameExporter.h"
 #include "ViewInterpolate.h"
 
 //qCC_db
@@ -97,6 +98,7 @@ qAnimationDlg::qAnimationDlg(ccGLWindowInterface* view3d, QWidget* parent)
 			bool autoStepDuration = settings.value("autoStepDuration", autoStepDurationCheckBox->isChecked()).toBool();
 			bool smoothTrajectory = settings.value("smoothTrajectory", smoothTrajectoryGroupBox->isChecked()).toBool();
 			double smoothRatio = settings.value("smoothRatio", smoothRatioDoubleSpinBox->value()).toDouble();
+			int framesFormat = settings.value("framesFormat", framesFormatComboBox->currentIndex()).toInt();
 			defaultOutputFormat = settings.value("outputFormat").toString();
 
 			previewFromSelectedCheckBox->setChecked(startPreviewFromSelectedStep);
@@ -108,6 +110,7 @@ qAnimationDlg::qAnimationDlg(ccGLWindowInterface* view3d, QWidget* parent)
 			autoStepDurationCheckBox->setChecked(autoStepDuration); //this might be modified when init will be called!
 			smoothTrajectoryGroupBox->setChecked(smoothTrajectory);
 			smoothRatioDoubleSpinBox->setValue(smoothRatio);
+			framesFormatComboBox->setCurrentIndex(framesFormat);
 		}
 		
 		settings.endGroup();
@@ -277,6 +280,7 @@ void qAnimationDlg::onAccept()
 		settings.setValue("smoothTrajectory", smoothTrajectoryGroupBox->isChecked());
 		settings.setValue("smoothRatio", smoothRatioDoubleSpinBox->value());
 		settings.setValue("outputFormat", outputFormatComboBox->currentData().toString());
+		settings.setValue("framesFormat", framesFormatComboBox->currentIndex());
 
 		settings.endGroup();
 	}
@@ -1252,6 +1256,9 @@ void qAnimationDlg::render(bool asSeparateFrames)
 	int renderingMode = renderingModeComboBox->currentIndex();
 	assert(renderingMode == SUPER_RESOLUTION || renderingMode == ZOOM);
 
+	//the rendered frames are downscaled, written or encoded by other threads meanwhile
+	FrameExporter exporter(renderingMode == SUPER_RESOLUTION ? superRes : 1);
+
 	//show progress dialog
 	QProgressDialog progressDialog(tr("Frames: %1").arg(frameCount), "Cancel", 0, frameCount, this);
 	progressDialog.setWindowTitle("Render");
@@ -1304,6 +1311,8 @@ void qAnimationDlg::render(bool asSeparateFrames)
 			setEnabled(true);
 			return;
 		}
+
+		exporter.setEncoder(encoder.data());
 	}
 #else
 	if (!asSeparateFrames)
@@ -1316,7 +1325,18 @@ void qAnimationDlg::render(bool asSeparateFrames)
 	bool lodWasEnabled = m_view3d->isLODEnabled();
 	m_view3d->setLODEnabled(false);
 
-	QDir outputDir(QFileInfo(outputFilename).absolutePath());
+	if (asSeparateFrames)
+	{
+		QDir outputDir(QFileInfo(outputFilename).absolutePath());
+		if (framesFormatComboBox->currentIndex() == 1)
+		{
+			exporter.setFramesOutput(outputDir, "jpg", 95);
+		}
+		else
+		{
+			exporter.setFramesOutput(outputDir, "png");
+		}
+	}
 
 	bool success = true;
 	double currentTime = 0.0;
@@ -1345,7 +1365,10 @@ void qAnimationDlg::render(bool asSeparateFrames)
 			applyViewport(currentViewport);
 
 			//render to image
+			QElapsedTimer renderTimer;
+			renderTimer.start();
 			QImage image = m_view3d->renderToImage(superRes, renderingMode == ZOOM, false, true);
+			exporter.addRenderTime(renderTimer.nsecsElapsed());
 
 			if (image.isNull())
 			{
@@ -1354,35 +1377,12 @@ void qAnimationDlg::render(bool asSeparateFrames)
 				break;
 			}
 
-			if (renderingMode == SUPER_RESOLUTION && superRes > 1)
+			if (!exporter.push(image, frameIndex))
 			{
-				image = image.scaled(image.width() / superRes, image.height() / superRes, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+				//a previous frame failed (the error will be displayed below)
+				break;
 			}
 
-			if (asSeparateFrames)
-			{
-				QString filename = QString("frame_%1.png").arg(frameIndex, 6, 10, QChar('0'));
-				QString fullPath = outputDir.filePath(filename);
-				if (!image.save(fullPath))
-				{
-					QMessageBox::critical(this, "Error", QString("Failed to save frame #%1").arg(frameIndex + 1));
-					success = false;
-					break;
-				}
-			}
-			else
-			{
-#ifdef QFFMPEG_SUPPORT
-				QString errorString;
-				if (!encoder->encodeImage(image, frameIndex, &errorString))
-				{
-					QMessageBox::critical(this, "Error", QString("Failed to encode frame #%1: %2").arg(frameIndex + 1).arg(errorString));
-					success = false;
-					break;
-				}
-#endif
-			}
-			
 			//next frame
 			currentTime += timeStep;
 			++frameIndex;
@@ -1409,6 +1409,27 @@ void qAnimationDlg::render(bool asSeparateFrames)
 		}
 	}
 
+	if (success)
+	{
+		progressDialog.setLabelText(tr("Finishing..."));
+		QApplication::processEvents();
+
+		//wait for the last frames
+		if (exporter.finish())
+		{
+			exporter.reportTimings();
+		}
+		else
+		{
+			QMessageBox::critical(this, "Error", exporter.errorMessage());
+			success = false;
+		}
+	}
+	else
+	{
+		exporter.cancel();
+	}
+
 	m_view3d->setLODEnabled(lodWasEnabled);
 
 #ifdef QFFMPEG_SUPPORT
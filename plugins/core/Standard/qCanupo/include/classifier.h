@@ -63,6 +63,48 @@ public: //methods
 	//! Classification in MSC space
 	float classify(const CorePointDesc& mscdata) const;
 
+	//! Pre-processed boundary (for the classification of many points at once)
+	/** The path segments are stored as flat arrays, with their directions and
+		lengths already computed, as well as their bounding-boxes (so that the
+		segments that can't be crossed or can't be the closest are skipped).
+	**/
+	struct Boundary
+	{
+		std::vector<float> ax, ay;			//!< segment start
+		std::vector<float> bx, by;			//!< segment end
+		std::vector<float> vx, vy;			//!< segment direction (normalized)
+		std::vector<float> abNorm, abNorm2;	//!< segment length (and squared length)
+		std::vector<float> minX, minY;		//!< segment bounding-box (min corner)
+		std::vector<float> maxX, maxY;		//!< segment bounding-box (max corner)
+		float scale = 0;					//!< path extent (for the safety margins)
+	};
+
+	//! Pre-processes the boundary (see Boundary)
+	bool prepareBoundary(Boundary& boundary) const;
+
+	//! Checks numerical condition (with a pre-processed boundary)
+	/** Gives the same result as the other version of this method.
+	**/
+	float classify2D_checkcondnum(const Boundary& boundary, const Point2D& P, const Point2D& R, float& condnumber) const;
+
+	//! Classification in the 2D space (with a pre-processed boundary)
+	float classify2D(const Boundary& boundary, const Point2D& P) const;
+
+	//! Classifies a set of descriptors at once
+	/** Gives the same results as calling 'classify' on each descriptor, but the
+		boundary is pre-processed only once and the descriptors are classified
+		by chunks, in parallel.
+		\param descriptors descriptors
+		\param indexes indexes of the descriptors to classify (all of them if empty)
+		\param distancesToBoundary output (signed) distances to the boundary (one per index)
+		\param maxThreadCount max number of threads (0 = all)
+		\return success
+	**/
+	bool classify(	const CorePointDescSet& descriptors,
+					const std::vector<unsigned>& indexes,
+					std::vector<float>& distancesToBoundary,
+					int maxThreadCount = 0) const;
+
 	//! Classifier's file header info
 	struct FileHeader
 	{
@@ -20,12 +20,19 @@
 
 #include "classifier.h"
 
+//qCC_plugins
+#include <ccQtHelpers.h>
+
 //Qt
 #include <QFile>
+#include <QThreadPool>
+#include <QtConcurrentMap>
 
 //system
+#include <algorithm>
 #include <assert.h>
 #include <limits.h>
+#include <limits>
 
 Classifier::Classifier()
 	: class1(0)
@@ -170,6 +177,320 @@ float Classifier::classify(const CorePointDesc& mscdata) const
 	return classify2D(P);
 }
 
+bool Classifier::prepareBoundary(Boundary& boundary) const
+{
+	if (path.size() < 2)
+	{
+		assert(false);
+		return false;
+	}
+
+	size_t segCount = path.size() - 1;
+	try
+	{
+		for (std::vector<float>* array : {	&boundary.ax, &boundary.ay,
+											&boundary.bx, &boundary.by,
+											&boundary.vx, &boundary.vy,
+											&boundary.abNorm, &boundary.abNorm2,
+											&boundary.minX, &boundary.minY,
+											&boundary.maxX, &boundary.maxY })
+		{
+			array->resize(segCount);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	boundary.scale = std::max(	std::abs(refPointPos.x) + std::abs(refPointPos.y),
+								std::abs(refPointNeg.x) + std::abs(refPointNeg.y) );
+
+	for (size_t i = 0; i < segCount; ++i)
+	{
+		//same computations as in classify2D_checkcondnum
+		const Point2D& A = path[i];
+		const Point2D& B = path[i + 1];
+		Point2D AB = B - A;
+		Point2D v = AB; v.normalize();
+
+		boundary.ax[i] = A.x;
+		boundary.ay[i] = A.y;
+		boundary.bx[i] = B.x;
+		boundary.by[i] = B.y;
+		boundary.vx[i] = v.x;
+		boundary.vy[i] = v.y;
+		boundary.abNorm[i] = AB.norm();
+		boundary.abNorm2[i] = AB.norm2();
+
+		// first and last lines are projected to infinity
+		bool halfLine = (i == 0 || i + 1 == segCount);
+		boundary.minX[i] = halfLine ? -std::numeric_limits<float>::max() : std::min(A.x, B.x);
+		boundary.minY[i] = halfLine ? -std::numeric_limits<float>::max() : std::min(A.y, B.y);
+		boundary.maxX[i] = halfLine ? std::numeric_limits<float>::max() : std::max(A.x, B.x);
+		boundary.maxY[i] = halfLine ? std::numeric_limits<float>::max() : std::max(A.y, B.y);
+
+		boundary.scale = std::max(boundary.scale, std::abs(A.x) + std::abs(A.y));
+	}
+	boundary.scale = std::max(boundary.scale, std::abs(path.back().x) + std::abs(path.back().y));
+
+	return true;
+}
+
+float Classifier::classify2D_checkcondnum(const Boundary& boundary, const Point2D& P, const Point2D& R, float& condnumber) const
+{
+	condnumber = 0;
+	size_t segCount = boundary.ax.size();
+	if (segCount == 0)
+	{
+		assert(false);
+		return 0;
+	}
+
+	Point2D PR = R - P;
+	Point2D u = PR; u.normalize();
+
+	//the numerical condition depends on all the segments (flat loop)
+	const float* vx = boundary.vx.data();
+	const float* vy = boundary.vy.data();
+	for (size_t i = 0; i < segCount; ++i)
+	{
+		condnumber = std::max<float>(condnumber, std::abs(vx[i] * u.x + vy[i] * u.y));
+	}
+
+	//the segments are only skipped when they are (clearly) out of reach
+	//so that the result is the same as with the standard version
+	float margin = 1.0e-3f * (boundary.scale + std::abs(P.x) + std::abs(P.y));
+	float prMinX = std::min(P.x, R.x) - margin;
+	float prMaxX = std::max(P.x, R.x) + margin;
+	float prMinY = std::min(P.y, R.y) - margin;
+	float prMaxY = std::max(P.y, R.y) + margin;
+
+	unsigned numcross = 0;
+	float closestSquareDist = -1.0f;
+
+	for (size_t i = 0; i < segCount; ++i)
+	{
+		//the half-lines are never skipped (their bounding-box is infinite)
+		bool canCross = (	boundary.minX[i] <= prMaxX && boundary.maxX[i] >= prMinX
+						&&	boundary.minY[i] <= prMaxY && boundary.maxY[i] >= prMinY );
+
+		//lower bound of the distance between P and the segment
+		float dx = std::max(0.0f, std::max(boundary.minX[i] - P.x, P.x - boundary.maxX[i]));
+		float dy = std::max(0.0f, std::max(boundary.minY[i] - P.y, P.y - boundary.maxY[i]));
+		bool canBeCloser = (closestSquareDist < 0 || dx*dx + dy*dy <= closestSquareDist * 1.001f + margin*margin);
+
+		if (!canCross && !canBeCloser)
+		{
+			continue;
+		}
+
+		Point2D A(boundary.ax[i], boundary.ay[i]);
+		Point2D AP = P - A;
+		Point2D v(boundary.vx[i], boundary.vy[i]);
+
+		// Compute whether PR[Pt-->Refpt] and that segment cross
+		float denom = (u.x*v.y - v.x*u.y);
+		//(the crossing test is numerically unstable when the lines are nearly parallel)
+		if (denom != 0 && (canCross || std::abs(denom) < 1.0e-3f))
+		{
+			float alpha = (AP.y * v.x - AP.x * v.y) / denom;
+			bool pathIntersects = (alpha >= 0 && alpha*alpha <= PR.norm2());
+			if (pathIntersects)
+			{
+				float beta = (AP.y * u.x - AP.x * u.y) / denom;
+
+				// first and last lines are projected to infinity
+				bool refSegIntersects = ((i == 0 || beta >= 0) && (i + 1 == segCount || beta * beta < boundary.abNorm2[i]));
+
+				if (refSegIntersects)
+					numcross++;
+			}
+		}
+
+		if (canBeCloser)
+		{
+			float squareDistToSeg = 0;
+			float distAH = v.dot(AP);
+			if ((i == 0 || distAH >= 0.0) && (i + 1 == segCount || distAH <= boundary.abNorm[i]))
+			{
+				Point2D PH = (A + v * distAH) - P;
+				squareDistToSeg = PH.norm2();
+			}
+			else
+			{
+				Point2D BP = P - Point2D(boundary.bx[i], boundary.by[i]);
+				squareDistToSeg = std::min(AP.norm2(), BP.norm2());
+			}
+
+			if (closestSquareDist < 0 || squareDistToSeg < closestSquareDist)
+			{
+				closestSquareDist = squareDistToSeg;
+			}
+		}
+	}
+
+	assert(closestSquareDist >= 0);
+	float deltaNorm = sqrt(closestSquareDist);
+
+	return ((numcross & 1) == 0 ? deltaNorm : -deltaNorm);
+}
+
+float Classifier::classify2D(const Boundary& boundary, const Point2D& P) const
+{
+	float condpos = 0.0f;
+	float condneg = 0.0f;
+	float predpos = classify2D_checkcondnum(boundary, P, refPointPos, condpos);
+	float predneg = classify2D_checkcondnum(boundary, P, refPointNeg, condneg);
+
+	// normal nearly aligned = bad conditionning, the lower the dot prod the better
+	return condpos < condneg ? predpos : -predneg;
+}
+
+//! Chunk of descriptors (for the batch classification)
+struct ClassificationChunk
+{
+	size_t first = 0;
+	size_t last = 0; //excluded
+	const Classifier* classifier = nullptr;
+	const Classifier::Boundary* boundary = nullptr;
+	const CorePointDescSet* descriptors = nullptr;
+	const std::vector<unsigned>* indexes = nullptr;
+	std::vector<float>* distances = nullptr;
+};
+
+//! Number of descriptors per chunk
+static const size_t s_classificationChunkSize = 1024;
+//! Number of descriptors projected at once (see ClassifyChunk)
+static const size_t s_projectionBlockSize = 64;
+
+static void ClassifyChunk(ClassificationChunk& chunk)
+{
+	const Classifier& classifier = *chunk.classifier;
+	assert(classifier.weightsAxis1.size() == classifier.weightsAxis2.size());
+	assert(classifier.weightsAxis1.size() > 1);
+	size_t weightCount = classifier.weightsAxis1.size() - 1;
+
+	//block of descriptors, stored parameter by parameter (so that the projection
+	//is a matrix product with contiguous rows, same summation order as Classifier::project)
+	std::vector<float> block;
+	try
+	{
+		block.resize(weightCount * s_projectionBlockSize);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory: one descriptor at a time
+		for (size_t j = chunk.first; j < chunk.last; ++j)
+		{
+			const CorePointDesc& desc = (*chunk.descriptors)[chunk.indexes->empty() ? j : chunk.indexes->at(j)];
+			(*chunk.distances)[j] = classifier.classify2D(*chunk.boundary, classifier.project(desc));
+		}
+		return;
+	}
+
+	float x[s_projectionBlockSize];
+	float y[s_projectionBlockSize];
+
+	for (size_t first = chunk.first; first < chunk.last; first += s_projectionBlockSize)
+	{
+		size_t count = std::min(s_projectionBlockSize, chunk.last - first);
+
+		//gather the (matching) parameters of the descriptors
+		for (size_t r = 0; r < count; ++r)
+		{
+			size_t j = first + r;
+			const CorePointDesc& desc = (*chunk.descriptors)[chunk.indexes->empty() ? j : chunk.indexes->at(j)];
+			//the matching scales are at the end (see Classifier::project)
+			assert(weightCount <= desc.params.size());
+			const float* params = desc.params.data() + (desc.params.size() - weightCount);
+			for (size_t i = 0; i < weightCount; ++i)
+			{
+				block[i * s_projectionBlockSize + r] = params[i];
+			}
+		}
+
+		//project them
+		for (size_t r = 0; r < count; ++r)
+		{
+			x[r] = classifier.weightsAxis1.back();
+			y[r] = classifier.weightsAxis2.back();
+		}
+		for (size_t i = 0; i < weightCount; ++i)
+		{
+			const float* row = block.data() + i * s_projectionBlockSize;
+			float w1 = classifier.weightsAxis1[i];
+			float w2 = classifier.weightsAxis2[i];
+			for (size_t r = 0; r < count; ++r)
+			{
+				x[r] += w1 * row[r];
+				y[r] += w2 * row[r];
+			}
+		}
+
+		for (size_t r = 0; r < count; ++r)
+		{
+			(*chunk.distances)[first + r] = classifier.classify2D(*chunk.boundary, Classifier::Point2D(x[r], y[r]));
+		}
+	}
+}
+
+bool Classifier::classify(	const CorePointDescSet& descriptors,
+							const std::vector<unsigned>& indexes,
+							std::vector<float>& distancesToBoundary,
+							int maxThreadCount/*=0*/) const
+{
+	Boundary boundary;
+	if (!prepareBoundary(boundary))
+	{
+		return false;
+	}
+
+	size_t count = (indexes.empty() ? descriptors.size() : indexes.size());
+	std::vector<ClassificationChunk> chunks;
+	try
+	{
+		distancesToBoundary.resize(count);
+		chunks.resize((count + s_classificationChunkSize - 1) / s_classificationChunkSize);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	for (size_t c = 0; c < chunks.size(); ++c)
+	{
+		ClassificationChunk& chunk = chunks[c];
+		chunk.first = c * s_classificationChunkSize;
+		chunk.last = std::min(count, chunk.first + s_classificationChunkSize);
+		chunk.classifier = this;
+		chunk.boundary = &boundary;
+		chunk.descriptors = &descriptors;
+		chunk.indexes = &indexes;
+		chunk.distances = &distancesToBoundary;
+	}
+
+	if (maxThreadCount == 0)
+	{
+		maxThreadCount = ccQtHelpers::GetMaxThreadCount();
+	}
+
+	if (maxThreadCount == 1 || chunks.size() < 2)
+	{
+		for (ClassificationChunk& chunk : chunks)
+		{
+			ClassifyChunk(chunk);
+		}
+	}
+	else
+	{
+		QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
+		QtConcurrent::blockingMap(chunks, ClassifyChunk);
+	}
+
+	return true;
+}
+
 bool Classifier::Load(QString filename,
 	std::vector<Classifier>& classifiers,
 	std::vector<float>& scales,
@@ -540,16 +540,27 @@ bool qCanupoProcess::Classify(	QString classifierFilename,
 					CCCoreLib::NormalizedProgress nProgress(&pDlg, corePoints->size());
 					pDlg.start();
 
+					//distances to the boundary of each classifier (all the pending points at once)
+					std::vector< std::vector<float> > distancesToBoundary(classifiers.size());
+					for (size_t c = 0; c < classifiers.size(); ++c)
+					{
+						if (!classifiers[c].classify(corePointsDescriptors, pendingPoints, distancesToBoundary[c], params.maxThreadCount))
+						{
+							if (app)
+								app->dispToConsole("Not enough memory to classify the points", ccMainAppInterface::ERR_CONSOLE_MESSAGE);
+							return false;
+						}
+					}
+
 					for (size_t i = 0; i < pendingPoints.size(); ++i)
 					{
 						unsigned coreIndex = pendingPoints[i];
-						CorePointDesc& coreDesc = corePointsDescriptors[coreIndex];
 
 						//most common case
 						if (classifiers.size() == 1)
 						{
 							const Classifier& classifier = classifiers.front();
-							float distToBoundary = classifier.classify(coreDesc);
+							float distToBoundary = distancesToBoundary.front()[i];
 
 							float confidence = 1.0f / (exp(-std::abs(distToBoundary)) + 1.0f); //in [0.5 ; 1]
 							confidence = 2 * (confidence - 0.5f); //map to [0;1]
@@ -612,7 +623,7 @@ bool qCanupoProcess::Classify(	QString classifierFilename,
 								const Classifier& classifier = *classifierIt;
 
 								// uniformize the order, distToBoundary>0 selects the larger class of both
-								float distToBoundary = classifier.classify(coreDesc); //DGM: the descriptors may have more values than the number of scales!
+								float distToBoundary = distancesToBoundary[classifierIt - classifiers.begin()][i]; //DGM: the descriptors may have more values than the number of scales!
 								//if (classifier.class1 > classifier.class2)
 								//	distToBoundary = -distToBoundary;
 
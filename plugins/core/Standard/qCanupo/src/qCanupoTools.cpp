@@ -465,12 +465,19 @@ bool qCanupoTools::EvaluateClassifier(const Classifier& classifier,
 
 	//Evaluate on 1st class
 	{
+		std::vector<float> distances;
+		if (!classifier.classify(descriptors1, std::vector<unsigned>(), distances))
+		{
+			//not enough memory
+			return false;
+		}
+
 		size_t nsamples1 = descriptors1.size();
 		double sumd = 0;
 		double sumd2 = 0;
 		for (size_t i = 0; i < nsamples1; ++i)
 		{
-			float d = classifier.classify(descriptors1[i]);
+			float d = distances[i];
 			if (d > 0)
 				params.false1++;
 			else
@@ -485,12 +492,19 @@ bool qCanupoTools::EvaluateClassifier(const Classifier& classifier,
 
 	//Evaluate on 2nd class
 	{
+		std::vector<float> distances;
+		if (!classifier.classify(descriptors2, std::vector<unsigned>(), distances))
+		{
+			//not enough memory
+			return false;
+		}
+
 		size_t nsamples2 = descriptors2.size();
 		double sumd = 0;
 		double sumd2 = 0;
 		for (size_t i = 0; i < nsamples2; ++i)
 		{
-			float d = classifier.classify(descriptors2[i]);
+			float d = distances[i];
 			if (d < 0)
 				params.false2++;
 			else
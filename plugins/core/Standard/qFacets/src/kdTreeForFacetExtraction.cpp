@@ -20,13 +20,25 @@
 //CCCoreLib
 #include <GenericProgressCallback.h>
 #include <Neighbourhood.h>
-#include <ParallelSort.h>
 
 //qCC_db
 #include <ccPointCloud.h>
 
 //Qt
 #include <QApplication>
+#include <QThread>
+#include <QtConcurrentMap>
+
+//system
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <unordered_map>
+
+//! Min number of leaves per region (see FuseCells)
+static const size_t s_minLeavesPerRegion = 256;
+//! Max depth of the region roots (i.e. at most 2^depth regions)
+static const unsigned s_maxRegionDepth = 6;
 
 //static bool AscendingLeafErrorComparison(const ccKdTree::Leaf* a, const ccKdTree::Leaf* b)
 //{
@@ -38,6 +50,25 @@ static bool DescendingLeafSizeComparison(const ccKdTree::Leaf* a, const ccKdTree
 	return a->points->size() > b->points->size();
 }
 
+//! Pre-computed leaf properties
+struct LeafInfo
+{
+	ccKdTree::Leaf* leaf = nullptr;
+	CCVector3 centroid;
+	PointCoordinateType radius = 0;
+	size_t regionIndex = 0;
+};
+
+static void ComputeLeafInfo(LeafInfo& info)
+{
+	if (info.leaf && info.leaf->points)
+	{
+		CCCoreLib::Neighbourhood N(info.leaf->points);
+		info.centroid = *N.getGravityCenter();
+		info.radius = N.computeLargestRadius();
+	}
+}
+
 struct Candidate
 {
 	ccKdTree::Leaf* leaf;
@@ -46,20 +77,593 @@ struct Candidate
 	CCVector3 centroid;
 
 	Candidate() : leaf(nullptr), dist(CCCoreLib::PC_NAN), radius(0) {}
-	Candidate(ccKdTree::Leaf* l) : leaf(l), dist(CCCoreLib::PC_NAN), radius(0)
+	Candidate(const LeafInfo& info) : leaf(info.leaf), dist(CCCoreLib::PC_NAN), radius(info.radius), centroid(info.centroid) {}
+};
+
+static bool CandidateDistAscendingComparison(const Candidate& a, const Candidate& b)
+{
+	return a.dist < b.dist;
+}
+
+//! Returns the minimum distance between a point and a set of points
+static PointCoordinateType MinDistTo(const CCCoreLib::ReferenceCloud* pointSet, const CCVector3& P)
+{
+	PointCoordinateType minDist2 = 0;
+	for (unsigned j = 0; j < pointSet->size(); ++j)
+	{
+		PointCoordinateType d2 = (*pointSet->getPoint(j) - P).norm2();
+		if (d2 < minDist2 || j == 0)
+			minDist2 = d2;
+	}
+	return sqrt(minDist2);
+}
+
+//! Fusion parameters and shared data
+struct FusionContext
+{
+	ccKdTree* kdTree = nullptr;
+	double maxError = 0;
+	CCCoreLib::DistanceComputationTools::ERROR_MEASURES errorMeasure = CCCoreLib::DistanceComputationTools::RMS;
+	double minCosNormAngle = 1.0;
+	PointCoordinateType overlapCoef = 1;
+	bool closestFirst = true;
+	std::vector<LeafInfo> leafInfos;
+	std::unordered_map<const ccKdTree::Leaf*, size_t> leafIndexes;
+	std::atomic<unsigned> processedCells{ 0 };
+	std::atomic<bool> cancelRequested{ false };
+
+	inline const LeafInfo& info(const ccKdTree::Leaf* leaf) const { return leafInfos[leafIndexes.at(leaf)]; }
+};
+
+//! Region of the kd-tree (sub-tree) in which the cells are fused independently
+struct FusionRegion
+{
+	ccKdTree::BaseNode* root = nullptr;
+	size_t index = 0;
+	FusionContext* context = nullptr;
+	//! Leaves (sorted by decreasing size)
+	std::vector<ccKdTree::Leaf*> leaves;
+	//! Seed leaf of each group (the group local index is its position + 1)
+	std::vector<ccKdTree::Leaf*> seeds;
+	//! Pairs of neighbor leaves that belong to this region and to the next ones
+	std::vector< std::pair<ccKdTree::Leaf*, ccKdTree::Leaf*> > boundaryPairs;
+	bool success = true;
+};
+
+//! Collects the leaves below a given node
+static void GetLeaves(ccKdTree::BaseNode* node, std::vector<ccKdTree::Leaf*>& leaves)
+{
+	if (!node)
+		return;
+
+	if (node->isNode())
+	{
+		ccKdTree::Node* trueNode = static_cast<ccKdTree::Node*>(node);
+		GetLeaves(trueNode->leftChild, leaves);
+		GetLeaves(trueNode->rightChild, leaves);
+	}
+	else
 	{
-		if (leaf && leaf->points)
+		leaves.push_back(static_cast<ccKdTree::Leaf*>(node));
+	}
+}
+
+//! Collects the region roots (the nodes at a given depth, or the leaves above it)
+static void GetRegionRoots(ccKdTree::BaseNode* node, unsigned depth, std::vector<ccKdTree::BaseNode*>& roots)
+{
+	if (!node)
+		return;
+
+	if (depth == 0 || !node->isNode())
+	{
+		roots.push_back(node);
+	}
+	else
+	{
+		ccKdTree::Node* trueNode = static_cast<ccKdTree::Node*>(node);
+		GetRegionRoots(trueNode->leftChild, depth - 1, roots);
+		GetRegionRoots(trueNode->rightChild, depth - 1, roots);
+	}
+}
+
+//! Fuses the cells of a region (greedy fusion, starting from the biggest cells)
+static void FuseRegionCells(FusionRegion& region)
+{
+	FusionContext& context = *region.context;
+	ccKdTree* kdTree = context.kdTree;
+
+	//fuse all cells, starting from the ones with the best error
+	const int unvisitedNeighborValue = -1;
+	for (auto& currentCell : region.leaves)
+	{
+		if (context.cancelRequested)
+			return;
+
+		++context.processedCells;
+
+		if (currentCell->error >= context.maxError)
+			currentCell->userData = 0; //0 = special group for cells already above the user defined threshold!
+
+		//already fused?
+		if (currentCell->userData != -1)
+			continue;
+
+		//we create a new "macro cell" index (local to the region)
+		region.seeds.push_back(currentCell);
+		currentCell->userData = static_cast<int>(region.seeds.size());
+
+		//we init the current set of 'fused' points with the cell's points
+		CCCoreLib::ReferenceCloud* currentPointSet = currentCell->points;
+		//get current fused set centroid and normal
+		CCVector3 currentCentroid = context.info(currentCell).centroid;
+		CCVector3 currentNormal(currentCell->planeEq);
+
+		//visited neighbors
+		ccKdTree::LeafSet visitedNeighbors;
+		//set of candidates
+		std::list<Candidate> candidates;
+
+		//we are going to iteratively look for neighbor cells that could be fused to this one
+		ccKdTree::LeafVector cellsToTest;
+		cellsToTest.push_back(currentCell);
+
+		while (!cellsToTest.empty() || !candidates.empty())
 		{
-			CCCoreLib::Neighbourhood N(leaf->points);
-			centroid = *N.getGravityCenter();
-			radius = N.computeLargestRadius();
+			//get all neighbors around the 'waiting' cell(s)
+			if (!cellsToTest.empty())
+			{
+				ccKdTree::LeafSet neighbors;
+				while (!cellsToTest.empty())
+				{
+					if (!kdTree->getNeighborLeaves(cellsToTest.back(), neighbors, &unvisitedNeighborValue, region.root)) //we only consider unvisited cells (of this region)!
+					{
+						//an error occurred
+						if (currentPointSet != currentCell->points)
+							delete currentPointSet;
+						region.success = false;
+						return;
+					}
+					cellsToTest.pop_back();
+				}
+
+				//add those (new) neighbors to the 'visitedNeighbors' set
+				//and to the candidates set by the way if they are not yet there
+				for (ccKdTree::LeafSet::iterator it = neighbors.begin(); it != neighbors.end(); ++it)
+				{
+					ccKdTree::Leaf* neighbor = *it;
+					std::pair<ccKdTree::LeafSet::iterator,bool> ret = visitedNeighbors.insert(neighbor);
+					//neighbour not already in the set?
+					if (ret.second)
+					{
+						//we create the corresponding candidate
+						try
+						{
+							candidates.push_back(Candidate(context.info(neighbor)));
+						}
+						catch (const std::bad_alloc&)
+						{
+							//not enough memory!
+							if (currentPointSet != currentCell->points)
+								delete currentPointSet;
+							region.success = false;
+							return;
+						}
+					}
+				}
+			}
+
+			//is there remaining candidates?
+			if (!candidates.empty())
+			{
+				//update the set of candidates
+				if (context.closestFirst && candidates.size() > 1)
+				{
+					for (std::list<Candidate>::iterator it = candidates.begin(); it != candidates.end(); ++it)
+						it->dist = (it->centroid - currentCentroid).norm2();
+
+					//sort candidates by their distance
+					candidates.sort(CandidateDistAscendingComparison);
+				}
+
+				//we will keep track of the best fused 'couple' at each pass
+				std::list<Candidate>::iterator bestIt = candidates.end();
+				CCCoreLib::ReferenceCloud* bestFused = nullptr;
+				double bestError = -1.0;
+
+				unsigned skipCount = 0;
+				for (std::list<Candidate>::iterator it = candidates.begin(); it != candidates.end(); /*++it*/)
+				{
+					assert(it->leaf && it->leaf->points);
+					assert(currentPointSet->getAssociatedCloud() == it->leaf->points->getAssociatedCloud());
+
+					//if the leaf orientation is too different
+					if (std::abs(CCVector3(it->leaf->planeEq).dot(currentNormal)) < context.minCosNormAngle)
+					{
+						it = candidates.erase(it);
+						continue;
+					}
+
+					//compute the minimum distance between the candidate centroid and the 'currentPointSet'
+					PointCoordinateType minDistToMainSet = MinDistTo(currentPointSet, it->centroid);
+
+					//if the leaf is too far
+					if (it->radius < minDistToMainSet / context.overlapCoef)
+					{
+						++it;
+						++skipCount;
+						continue;
+					}
+
+					//fuse the main set with the current candidate
+					CCCoreLib::ReferenceCloud* fused = new CCCoreLib::ReferenceCloud(*currentPointSet);
+					if (!fused->add(*(it->leaf->points)))
+					{
+						//not enough memory!
+						delete fused;
+						if (bestFused)
+							delete bestFused;
+						if (currentPointSet != currentCell->points)
+							delete currentPointSet;
+						region.success = false;
+						return;
+					}
+
+					//fit a plane and estimate the resulting error
+					double error = -1.0;
+					const PointCoordinateType* planeEquation = CCCoreLib::Neighbourhood(fused).getLSPlane();
+					if (planeEquation)
+						error = CCCoreLib::DistanceComputationTools::ComputeCloud2PlaneDistance(fused, planeEquation, context.errorMeasure);
+
+					if (error < 0.0 || error > context.maxError)
+					{
+						//candidate is rejected
+						it = candidates.erase(it);
+					}
+					else
+					{
+						//otherwise we keep track of the best one!
+						if (bestError < 0.0 || error < bestError)
+						{
+							bestIt = it;
+							bestError = error;
+							if (bestFused)
+								delete bestFused;
+							bestFused = fused;
+							fused = nullptr;
+
+							if (context.closestFirst)
+								break; //if we have found a good candidate, we stop here (closest first ;)
+						}
+						++it;
+					}
+
+					if (fused)
+					{
+						delete fused;
+						fused = nullptr;
+					}
+				}
+
+				//we have a (best) candidate for this pass?
+				if (bestIt != candidates.end())
+				{
+					assert(bestFused && bestError >= 0.0);
+					if (currentPointSet != currentCell->points)
+						delete currentPointSet;
+					currentPointSet = bestFused;
+					//we don't update the centroid and the normal, otherwise the search would naturally shift along one dimension!
+
+					bestIt->leaf->userData = currentCell->userData;
+
+					//we will test this cell's neighbors as well
+					cellsToTest.push_back(bestIt->leaf);
+
+					if (context.cancelRequested)
+					{
+						//premature end!
+						candidates.clear();
+						cellsToTest.clear();
+						break;
+					}
+
+					//we also remove it from the candidates list
+					candidates.erase(bestIt);
+				}
+
+				if (skipCount == candidates.size() && cellsToTest.empty())
+				{
+					//only far leaves remain...
+					candidates.clear();
+				}
+			}
+
+		} //no more candidates or cells to test
+
+		//end of the fusion process for the current leaf
+		if (currentPointSet != currentCell->points)
+			delete currentPointSet;
+		currentPointSet = nullptr;
+	}
+}
+
+//! Looks for the fused leaves of a region that touch the fused leaves of the next regions
+static void FindRegionBoundaryPairs(FusionRegion& region)
+{
+	FusionContext& context = *region.context;
+
+	for (ccKdTree::Leaf* leaf : region.leaves)
+	{
+		if (context.cancelRequested)
+			return;
+		if (leaf->userData <= 0)
+			continue;
+
+		ccKdTree::LeafSet neighbors;
+		if (!context.kdTree->getNeighborLeaves(leaf, neighbors))
+		{
+			region.success = false;
+			return;
+		}
+
+		for (ccKdTree::Leaf* neighbor : neighbors)
+		{
+			const LeafInfo& neighborInfo = context.info(neighbor);
+			if (neighbor->userData <= 0 || neighborInfo.regionIndex <= region.index)
+				continue;
+
+			//same orientation criterion as for the fusion inside the regions
+			if (std::abs(CCVector3(neighbor->planeEq).dot(CCVector3(leaf->planeEq))) < context.minCosNormAngle)
+				continue;
+
+			//same distance criterion as well
+			if (neighborInfo.radius < MinDistTo(leaf->points, neighborInfo.centroid) / context.overlapCoef)
+				continue;
+
+			try
+			{
+				region.boundaryPairs.emplace_back(leaf, neighbor);
+			}
+			catch (const std::bad_alloc&)
+			{
+				region.success = false;
+				return;
+			}
 		}
 	}
+}
+
+//! Group of fused cells (for the fusion along the region boundaries)
+struct FusedGroup
+{
+	ccKdTree::Leaf* seed = nullptr;
+	std::vector<ccKdTree::Leaf*> leaves;
+	unsigned pointCount = 0;
+	int parent = 0;
+	//! Whether other groups have been merged with this one
+	bool modified = false;
 };
 
-static bool CandidateDistAscendingComparison(const Candidate& a, const Candidate& b)
+//! Fit of the union of two (initial) groups (see FuseRegionBoundaries)
+struct GroupPairFit
 {
-	return a.dist < b.dist;
+	const std::vector<FusedGroup>* groups = nullptr;
+	const FusionContext* context = nullptr;
+	int first = 0;
+	int second = 0;
+	//! Plane fitting error (-1 if the fit failed)
+	double error = -1.0;
+	//! Whether the fit has been computed
+	bool computed = false;
+};
+
+//! Fits a plane on the union of two groups and computes the resulting error
+static bool FitGroups(const FusedGroup& groupA, const FusedGroup& groupB, ccGenericPointCloud* cloud, CCCoreLib::DistanceComputationTools::ERROR_MEASURES errorMeasure, double& error)
+{
+	error = -1.0;
+
+	CCCoreLib::ReferenceCloud fused(cloud);
+	if (!fused.reserve(groupA.pointCount + groupB.pointCount))
+		return false;
+	for (const FusedGroup* group : { &groupA, &groupB })
+	{
+		for (ccKdTree::Leaf* leaf : group->leaves)
+		{
+			if (!fused.add(*leaf->points))
+				return false;
+		}
+	}
+
+	const PointCoordinateType* planeEquation = CCCoreLib::Neighbourhood(&fused).getLSPlane();
+	if (planeEquation)
+		error = CCCoreLib::DistanceComputationTools::ComputeCloud2PlaneDistance(&fused, planeEquation, errorMeasure);
+
+	return true;
+}
+
+static void FitGroupPair(GroupPairFit& fit)
+{
+	const std::vector<FusedGroup>& groups = *fit.groups;
+	const FusionContext& context = *fit.context;
+	if (context.cancelRequested)
+		return;
+
+	//same order as in FuseRegionBoundaries (the biggest group first)
+	int indexA = fit.first;
+	int indexB = fit.second;
+	if (groups[indexB].pointCount > groups[indexA].pointCount)
+		std::swap(indexA, indexB);
+	const FusedGroup& groupA = groups[indexA];
+	const FusedGroup& groupB = groups[indexB];
+
+	//if the orientation is too different
+	if (std::abs(CCVector3(groupB.seed->planeEq).dot(CCVector3(groupA.seed->planeEq))) < context.minCosNormAngle)
+		return;
+
+	//(if it fails, it will be computed again sequentially)
+	fit.computed = FitGroups(groupA, groupB, context.kdTree->associatedGenericCloud(), context.errorMeasure, fit.error);
+}
+
+static int FindRootGroup(std::vector<FusedGroup>& groups, int index)
+{
+	while (groups[index].parent != index)
+	{
+		groups[index].parent = groups[groups[index].parent].parent;
+		index = groups[index].parent;
+	}
+	return index;
+}
+
+//! Fuses the groups of cells along the region boundaries (with the same criteria)
+static bool FuseRegionBoundaries(std::vector<FusionRegion>& regions, FusionContext& context, int groupCount)
+{
+	//groups (index 0 is reserved for the cells above the max error)
+	std::vector<FusedGroup> groups;
+	std::set< std::pair<int, int> > groupPairs;
+	try
+	{
+		groups.resize(static_cast<size_t>(groupCount) + 1);
+		for (size_t i = 0; i < groups.size(); ++i)
+		{
+			groups[i].parent = static_cast<int>(i);
+		}
+		for (const FusionRegion& region : regions)
+		{
+			for (ccKdTree::Leaf* leaf : region.leaves)
+			{
+				if (leaf->userData > 0)
+				{
+					FusedGroup& group = groups[leaf->userData];
+					group.leaves.push_back(leaf);
+					group.pointCount += leaf->points->size();
+				}
+			}
+			for (const auto& leafPair : region.boundaryPairs)
+			{
+				int groupA = std::min(leafPair.first->userData, leafPair.second->userData);
+				int groupB = std::max(leafPair.first->userData, leafPair.second->userData);
+				groupPairs.insert(std::make_pair(groupA, groupB));
+			}
+		}
+		for (FusionRegion& region : regions)
+		{
+			region.boundaryPairs.clear();
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+	for (const FusionRegion& region : regions)
+	{
+		for (size_t i = 0; i < region.seeds.size(); ++i)
+		{
+			groups[region.seeds[i]->userData].seed = region.seeds[i];
+		}
+	}
+
+	//we start with the biggest couples (as for the cells)
+	std::vector< std::pair<int, int> > sortedPairs;
+	try
+	{
+		sortedPairs.reserve(groupPairs.size());
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+	for (const auto& groupPair : groupPairs)
+	{
+		sortedPairs.push_back(groupPair);
+	}
+	std::stable_sort(sortedPairs.begin(), sortedPairs.end(), [&groups](const std::pair<int, int>& a, const std::pair<int, int>& b)
+	{
+		return groups[a.first].pointCount + groups[a.second].pointCount > groups[b.first].pointCount + groups[b.second].pointCount;
+	});
+
+	//fit the planes on the initial pairs of groups in parallel
+	//(they remain valid as long as none of the two groups is merged with another one)
+	std::vector<GroupPairFit> fits;
+	try
+	{
+		fits.resize(sortedPairs.size());
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < sortedPairs.size(); ++i)
+	{
+		fits[i].groups = &groups;
+		fits[i].context = &context;
+		fits[i].first = sortedPairs[i].first;
+		fits[i].second = sortedPairs[i].second;
+	}
+	QtConcurrent::blockingMap(fits, FitGroupPair);
+	if (context.cancelRequested)
+		return true;
+
+	ccGenericPointCloud* cloud = context.kdTree->associatedGenericCloud();
+	for (size_t i = 0; i < sortedPairs.size(); ++i)
+	{
+		const auto& groupPair = sortedPairs[i];
+		int rootA = FindRootGroup(groups, groupPair.first);
+		int rootB = FindRootGroup(groups, groupPair.second);
+		if (rootA == rootB)
+			continue;
+		bool initialPair = (rootA == groupPair.first && rootB == groupPair.second);
+
+		//the biggest group is the reference
+		if (groups[rootB].pointCount > groups[rootA].pointCount)
+			std::swap(rootA, rootB);
+		FusedGroup& groupA = groups[rootA];
+		FusedGroup& groupB = groups[rootB];
+
+		//if the orientation is too different
+		if (std::abs(CCVector3(groupB.seed->planeEq).dot(CCVector3(groupA.seed->planeEq))) < context.minCosNormAngle)
+			continue;
+
+		//fit a plane on both groups and estimate the resulting error
+		double error = -1.0;
+		if (fits[i].computed && initialPair && !groupA.modified && !groupB.modified)
+		{
+			//initial groups: the fit has already been computed
+			error = fits[i].error;
+		}
+		else if (!FitGroups(groupA, groupB, cloud, context.errorMeasure, error))
+		{
+			return false;
+		}
+		if (error < 0.0 || error > context.maxError)
+			continue;
+
+		//merge the groups
+		try
+		{
+			groupA.leaves.insert(groupA.leaves.end(), groupB.leaves.begin(), groupB.leaves.end());
+		}
+		catch (const std::bad_alloc&)
+		{
+			return false;
+		}
+		groupA.pointCount += groupB.pointCount;
+		groupA.modified = true;
+		groupB.leaves.clear();
+		groupB.parent = rootA;
+	}
+
+	//update the leaves
+	for (size_t i = 1; i < groups.size(); ++i)
+	{
+		int root = FindRootGroup(groups, static_cast<int>(i));
+		if (root != static_cast<int>(i))
+			continue;
+		for (ccKdTree::Leaf* leaf : groups[i].leaves)
+		{
+			leaf->userData = root;
+		}
+	}
+
+	return true;
 }
 
 bool ccKdTreeForFacetExtraction::FuseCells(	ccKdTree* kdTree,
@@ -83,7 +687,6 @@ bool ccKdTreeForFacetExtraction::FuseCells(	ccKdTree* kdTree,
 		return false;
 
 	//progress notification
-	CCCoreLib::NormalizedProgress nProgress(progressCb, static_cast<unsigned>(leaves.size()));
 	if (progressCb)
 	{
 		progressCb->update(0);
@@ -97,8 +700,58 @@ bool ccKdTreeForFacetExtraction::FuseCells(	ccKdTree* kdTree,
 
 	ccPointCloud* pc = static_cast<ccPointCloud*>(associatedGenericCloud);
 
-	//sort cells based on their population size (we start by the biggest ones)
-	ParallelSort(leaves.begin(), leaves.end(), DescendingLeafSizeComparison);
+	FusionContext context;
+	context.kdTree = kdTree;
+	context.maxError = maxError;
+	context.errorMeasure = errorMeasure;
+	// cosine of the max angle between fused 'planes'
+	context.minCosNormAngle = cos( CCCoreLib::DegreesToRadians( maxAngle_deg ) );
+	context.overlapCoef = overlapCoef;
+	context.closestFirst = closestFirst;
+
+	//the tree is split in regions (sub-trees) that are processed in parallel
+	//(their number only depends on the tree, so that the result is always the same)
+	std::vector<FusionRegion> regions;
+	try
+	{
+		unsigned regionDepth = 0;
+		while (regionDepth < s_maxRegionDepth && (leaves.size() >> (regionDepth + 1)) >= s_minLeavesPerRegion)
+		{
+			++regionDepth;
+		}
+
+		std::vector<ccKdTree::BaseNode*> regionRoots;
+		GetRegionRoots(kdTree->getRootNode(), regionDepth, regionRoots);
+
+		regions.resize(regionRoots.size());
+		context.leafInfos.reserve(leaves.size());
+		context.leafIndexes.reserve(leaves.size());
+		for (size_t i = 0; i < regions.size(); ++i)
+		{
+			FusionRegion& region = regions[i];
+			region.root = regionRoots[i];
+			region.index = i;
+			region.context = &context;
+			GetLeaves(region.root, region.leaves);
+
+			for (ccKdTree::Leaf* leaf : region.leaves)
+			{
+				LeafInfo info;
+				info.leaf = leaf;
+				info.regionIndex = i;
+				context.leafIndexes[leaf] = context.leafInfos.size();
+				context.leafInfos.push_back(info);
+			}
+
+			//sort cells based on their population size (we start by the biggest ones)
+			std::stable_sort(region.leaves.begin(), region.leaves.end(), DescendingLeafSizeComparison);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[ccKdTreeForFacetExtraction] Not enough memory!");
+		return false;
+	}
 
 	//set all 'userData' to -1 (i.e. unfused cells)
 	{
@@ -110,248 +763,84 @@ bool ccKdTreeForFacetExtraction::FuseCells(	ccKdTree* kdTree,
 		}
 	}
 
-	// cosine of the max angle between fused 'planes'
-	const double c_minCosNormAngle = cos( CCCoreLib::DegreesToRadians( maxAngle_deg ) );
+	//the bounding-boxes must be computed before the parallel sections
+	kdTree->getOwnBB(false);
+	kdTree->getCellBBox(kdTree->getRootNode());
 
-	//fuse all cells, starting from the ones with the best error
-	const int unvisitedNeighborValue = -1;
+	//runs a process in parallel (and updates the progress bar meanwhile)
 	bool cancelled = false;
-	int macroIndex = 1; //starts at 1 (0 is reserved for cells already above the max error)
+	auto runInParallel = [&](QFuture<void> future, bool showProgress)
 	{
-		for (auto& currentCell : leaves)
+		while (!future.isFinished())
 		{
-			if (currentCell->error >= maxError)
-				currentCell->userData = 0; //0 = special group for cells already above the user defined threshold!
-
-			//already fused?
-			if (currentCell->userData != -1)
+			QThread::msleep(50);
+			if (progressCb)
 			{
-				if (progressCb && !nProgress.oneStep()) //process canceled by user
+				if (showProgress)
 				{
-					cancelled = true;
-					break;
+					progressCb->update(100.0f * context.processedCells / leaves.size());
+				}
+				if (progressCb->isCancelRequested())
+				{
+					context.cancelRequested = true;
 				}
-				continue;
 			}
+			QApplication::processEvents();
+		}
+		future.waitForFinished();
+		cancelled = context.cancelRequested;
+	};
 
-			//we create a new "macro cell" index
-			currentCell->userData = macroIndex++;
-
-			//we init the current set of 'fused' points with the cell's points
-			CCCoreLib::ReferenceCloud* currentPointSet = currentCell->points;
-			//get current fused set centroid and normal
-			CCVector3 currentCentroid = *CCCoreLib::Neighbourhood(currentPointSet).getGravityCenter();
-			CCVector3 currentNormal(currentCell->planeEq);
+	//pre-compute the leaves centroid and radius
+	runInParallel(QtConcurrent::map(context.leafInfos, ComputeLeafInfo), false);
 
-			//visited neighbors
-			ccKdTree::LeafSet visitedNeighbors;
-			//set of candidates
-			std::list<Candidate> candidates;
+	//fuse the cells of each region
+	if (!cancelled)
+	{
+		runInParallel(QtConcurrent::map(regions, FuseRegionCells), true);
+	}
 
-			//we are going to iteratively look for neighbor cells that could be fused to this one
-			ccKdTree::LeafVector cellsToTest;
-			cellsToTest.push_back(currentCell);
+	for (const FusionRegion& region : regions)
+	{
+		if (!region.success)
+		{
+			ccLog::Warning("[ccKdTreeForFacetExtraction] Not enough memory!");
+			return false;
+		}
+	}
 
-			if (progressCb && !nProgress.oneStep()) //process canceled by user
+	//convert the local group indexes to global ones
+	int macroIndex = 1; //starts at 1 (0 is reserved for cells already above the max error)
+	for (FusionRegion& region : regions)
+	{
+		for (ccKdTree::Leaf* leaf : region.leaves)
+		{
+			if (leaf->userData > 0)
 			{
-				cancelled = true;
-				break;
+				leaf->userData += macroIndex - 1;
 			}
+		}
+		macroIndex += static_cast<int>(region.seeds.size());
+	}
 
-			while (!cellsToTest.empty() || !candidates.empty())
-			{
-				//get all neighbors around the 'waiting' cell(s)
-				if (!cellsToTest.empty())
-				{
-					ccKdTree::LeafSet neighbors;
-					while (!cellsToTest.empty())
-					{
-						if (!kdTree->getNeighborLeaves(cellsToTest.back(), neighbors, &unvisitedNeighborValue)) //we only consider unvisited cells!
-						{
-							//an error occurred
-							return false;
-						}
-						cellsToTest.pop_back();
-					}
-
-					//add those (new) neighbors to the 'visitedNeighbors' set
-					//and to the candidates set by the way if they are not yet there
-					for (ccKdTree::LeafSet::iterator it = neighbors.begin(); it != neighbors.end(); ++it)
-					{
-						ccKdTree::Leaf* neighbor = *it;
-						std::pair<ccKdTree::LeafSet::iterator,bool> ret = visitedNeighbors.insert(neighbor);
-						//neighbour not already in the set?
-						if (ret.second)
-						{
-							//we create the corresponding candidate
-							try
-							{
-								candidates.push_back(Candidate(neighbor));
-							}
-							catch (const std::bad_alloc&)
-							{
-								//not enough memory!
-								ccLog::Warning("[ccKdTreeForFacetExtraction] Not enough memory!");
-								return false;
-							}
-						}
-					}
-				}
-
-				//is there remaining candidates?
-				if (!candidates.empty())
-				{
-					//update the set of candidates
-					if (closestFirst && candidates.size() > 1)
-					{
-						for (std::list<Candidate>::iterator it = candidates.begin(); it !=candidates.end(); ++it)
-							it->dist = (it->centroid-currentCentroid).norm2();
-
-						//sort candidates by their distance
-						candidates.sort(CandidateDistAscendingComparison);
-					}
-					
-					//we will keep track of the best fused 'couple' at each pass
-					std::list<Candidate>::iterator bestIt = candidates.end();
-					CCCoreLib::ReferenceCloud* bestFused = nullptr;
-					CCVector3 bestNormal(0, 0, 0);
-					double bestError = -1.0;
-
-					unsigned skipCount = 0;
-					for (std::list<Candidate>::iterator it = candidates.begin(); it != candidates.end(); /*++it*/)
-					{
-						assert(it->leaf && it->leaf->points);
-						assert(currentPointSet->getAssociatedCloud() == it->leaf->points->getAssociatedCloud());
-
-						//if the leaf orientation is too different
-						if (std::abs(CCVector3(it->leaf->planeEq).dot(currentNormal)) < c_minCosNormAngle)
-						{
-							it = candidates.erase(it);
-							//++it;
-							//++skipCount;
-							continue;
-						}
-
-						//compute the minimum distance between the candidate centroid and the 'currentPointSet'
-						PointCoordinateType minDistToMainSet = 0.0;
-						{
-							for (unsigned j = 0; j < currentPointSet->size(); ++j)
-							{
-								const CCVector3* P = currentPointSet->getPoint(j);
-								PointCoordinateType d2 = (*P - it->centroid).norm2();
-								if (d2 < minDistToMainSet || j == 0)
-									minDistToMainSet = d2;
-							}
-							minDistToMainSet = sqrt(minDistToMainSet);
-						}
-
-						//if the leaf is too far
-						if (it->radius < minDistToMainSet / overlapCoef)
-						{
-							++it;
-							++skipCount;
-							continue;
-						}
-
-						//fuse the main set with the current candidate
-						CCCoreLib::ReferenceCloud* fused = new CCCoreLib::ReferenceCloud(*currentPointSet);
-						if (!fused->add(*(it->leaf->points)))
-						{
-							//not enough memory!
-							ccLog::Warning("[ccKdTreeForFacetExtraction] Not enough memory!");
-							delete fused;
-							if (currentPointSet != currentCell->points)
-								delete currentPointSet;
-							return false;
-						}
-
-						//fit a plane and estimate the resulting error
-						double error = -1.0;
-						const PointCoordinateType* planeEquation = CCCoreLib::Neighbourhood(fused).getLSPlane();
-						if (planeEquation)
-							error = CCCoreLib::DistanceComputationTools::ComputeCloud2PlaneDistance(fused, planeEquation, errorMeasure);
-
-						if (error < 0.0 || error > maxError)
-						{
-							//candidate is rejected
-							it = candidates.erase(it);
-						}
-						else
-						{
-							//otherwise we keep track of the best one!
-							if (bestError < 0.0 || error < bestError)
-							{
-								bestIt = it;
-								bestError = error;
-								if (bestFused)
-									delete bestFused;
-								bestFused = fused;
-								bestNormal = CCVector3(planeEquation);
-								fused = nullptr;
-
-								if (closestFirst)
-									break; //if we have found a good candidate, we stop here (closest first ;)
-							}
-							++it;
-						}
-
-						if (fused)
-						{
-							delete fused;
-							fused = nullptr;
-						}
-					}
-
-					//we have a (best) candidate for this pass?
-					if (bestIt != candidates.end())
-					{
-						assert(bestFused && bestError >= 0.0);
-						if (currentPointSet != currentCell->points)
-							delete currentPointSet;
-						currentPointSet = bestFused;
-						{
-							//update infos
-							CCCoreLib::Neighbourhood N(currentPointSet);
-							//currentCentroid = *N.getGravityCenter(); //if we update it, the search will naturally shift along one dimension!
-							//currentNormal = bestNormal; //same thing here for normals
-						}
-
-						bestIt->leaf->userData = currentCell->userData;
-
-						//we will test this cell's neighbors as well
-						cellsToTest.push_back(bestIt->leaf);
-
-						if (progressCb && !nProgress.oneStep()) //process canceled by user
-						{
-							//premature end!
-							candidates.clear();
-							cellsToTest.clear();
-							cancelled = true;
-							break;
-						}
-						QApplication::processEvents();
-
-						//we also remove it from the candidates list
-						candidates.erase(bestIt);
-					}
-
-					if (skipCount == candidates.size() && cellsToTest.empty())
-					{
-						//only far leaves remain...
-						candidates.clear();
-					}
-
-				}
-
-			} //no more candidates or cells to test
-
-			//end of the fusion process for the current leaf
-			if (currentPointSet != currentCell->points)
-				delete currentPointSet;
-			currentPointSet = nullptr;
+	//fuse the groups of cells along the region boundaries
+	if (!cancelled && regions.size() > 1)
+	{
+		runInParallel(QtConcurrent::map(regions, FindRegionBoundaryPairs), false);
 
-			if (cancelled)
-				break;
+		bool success = !cancelled;
+		for (const FusionRegion& region : regions)
+		{
+			success &= region.success;
+		}
+		if (success && !FuseRegionBoundaries(regions, context, macroIndex - 1))
+		{
+			success = false;
+		}
+		if (!success && !cancelled)
+		{
+			ccLog::Warning("[ccKdTreeForFacetExtraction] Not enough memory!");
+			return false;
 		}
 	}
 
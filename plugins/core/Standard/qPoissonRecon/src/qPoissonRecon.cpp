@@ -22,11 +22,10 @@
 
 //Qt
 #include <QDialog>
+#include <QFileDialog>
 #include <QInputDialog>
 #include <QMainWindow>
-#include <QProgressDialog>
 #include <QtCore>
-#include <QtConcurrentRun>
 #include <QtGui>
 
 //PoissonRecon
@@ -38,13 +37,14 @@
 #include <ccProgressDialog.h>
 #include <ccScalarField.h>
 
+//CCPluginAPI
+#include <ccJobScheduler.h>
+
 //System
-#if defined(CC_WINDOWS)
-#include "Windows.h"
-#else
-#include <time.h>
-#include <unistd.h>
-#endif
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
 
 template <typename Real>
 class PointCloudWrapper : public PoissonReconLib::ICloud<Real>
@@ -112,6 +112,15 @@ public:
 		, m_error(false)
 	{}
 
+	//! Returns the new capacity of a growing array
+	/** The capacity grows geometrically, so that the (exact) reservations don't
+		copy the whole array over and over again on large reconstructions.
+	**/
+	static size_t GrowCapacity(size_t size, size_t minIncrement)
+	{
+		return size + std::max(minIncrement, size / 2);
+	}
+
 	bool checkMeshCapacity()
 	{
 		if (m_error)
@@ -119,7 +128,7 @@ public:
 			//no need to go further
 			return false;
 		}
-		if (m_mesh.size() == m_mesh.capacity() && !m_mesh.reserve(m_mesh.size() + 1024))
+		if (m_mesh.size() == m_mesh.capacity() && !m_mesh.reserve(GrowCapacity(m_mesh.size(), 1024)))
 		{
 			m_error = true;
 			return false;
@@ -134,10 +143,18 @@ public:
 			//no need to go further
 			return false;
 		}
-		if (m_vertices.size() == m_vertices.capacity() && !m_vertices.reserve(m_vertices.size() + 4096))
+		if (m_vertices.size() == m_vertices.capacity())
 		{
-			m_error = true;
-			return false;
+			size_t newCapacity = GrowCapacity(m_vertices.size(), 4096);
+			if (newCapacity > std::numeric_limits<unsigned>::max())
+			{
+				newCapacity = std::numeric_limits<unsigned>::max();
+			}
+			if (newCapacity == m_vertices.size() || !m_vertices.reserve(static_cast<unsigned>(newCapacity)))
+			{
+				m_error = true;
+				return false;
+			}
 		}
 		return true;
 	}
@@ -192,7 +209,7 @@ public:
 		{
 			return;
 		}
-		if (m_densitySF->size() == m_densitySF->capacity() && !m_densitySF->reserveSafe(m_densitySF->size() + 4096))
+		if (m_densitySF->size() == m_densitySF->capacity() && !m_densitySF->reserveSafe(static_cast<unsigned>(GrowCapacity(m_densitySF->size(), 4096))))
 		{
 			m_error = true;
 			return;
@@ -218,6 +235,307 @@ protected:
 	CCCoreLib::ScalarField* m_densitySF;
 };
 
+//! Buffered temporary file (to stream one property of the output mesh)
+class TemporaryStream
+{
+public:
+
+	//! Creates the temporary file (in the given directory)
+	bool open(const QString& dir)
+	{
+		m_file.setFileTemplate(QDir(dir).filePath("qPoissonRecon_XXXXXX.tmp"));
+		m_buffer.reserve(s_bufferSize);
+		m_count = 0;
+		return m_file.open();
+	}
+
+	//! Appends an element
+	inline bool write(const void* data, int size)
+	{
+		m_buffer.append(static_cast<const char*>(data), size);
+		++m_count;
+		return (m_buffer.size() < s_bufferSize || flush());
+	}
+
+	//! Writes the buffered data
+	bool flush()
+	{
+		bool success = (m_buffer.isEmpty() || m_file.write(m_buffer) == m_buffer.size());
+		m_buffer.resize(0);
+		return success;
+	}
+
+	//! Flushes the buffered data and goes back to the beginning of the file
+	bool rewind() { return flush() && m_file.seek(0); }
+
+	//! Reads the next elements
+	bool read(char* data, qint64 size) { return m_file.read(data, size) == size; }
+
+	//! Returns the number of elements
+	inline size_t count() const { return m_count; }
+
+protected:
+
+	//! Buffer size (bytes)
+	static const int s_bufferSize = (1 << 20);
+
+	//! Temporary file (automatically removed)
+	QTemporaryFile m_file;
+	//! Write buffer
+	QByteArray m_buffer;
+	//! Number of elements
+	size_t m_count = 0;
+};
+
+//! Streams the output mesh to a binary PLY file
+/** The mesh is never entirely loaded in memory: the vertex properties and the
+	triangles are written in temporary files as they come, then interleaved in
+	the final file (as the header requires the number of vertices and triangles).
+**/
+template <typename Real>
+class PlyStreamWrapper : public PoissonReconLib::IMesh<Real>
+{
+public:
+	//! Constructor
+	/** The vertices are written in the global coordinate system of the input cloud
+		(i.e. P / globalScale - globalShift), in double precision if the cloud is shifted.
+	**/
+	explicit PlyStreamWrapper(const QString& filename, const CCVector3d& globalShift = CCVector3d(0, 0, 0), double globalScale = 1.0)
+		: m_filename(filename)
+		, m_globalShift(globalShift)
+		, m_globalScale(globalScale)
+		, m_shifted(globalShift.norm2d() != 0 || globalScale != 1.0)
+		, m_error(false)
+	{
+		QString dir = QFileInfo(filename).absolutePath();
+		for (TemporaryStream* stream : { &m_vertices, &m_normals, &m_colors, &m_densities, &m_triangles })
+		{
+			if (!stream->open(dir))
+			{
+				m_error = true;
+				break;
+			}
+		}
+	}
+
+	virtual void addVertex(const Real* coords) override
+	{
+		if (m_shifted)
+		{
+			//global coordinates (in double precision, as they may be large)
+			double P[3] {	static_cast<double>(coords[0]) / m_globalScale - m_globalShift.x,
+							static_cast<double>(coords[1]) / m_globalScale - m_globalShift.y,
+							static_cast<double>(coords[2]) / m_globalScale - m_globalShift.z };
+			write(m_vertices, P, sizeof(P));
+		}
+		else
+		{
+			float P[3] { static_cast<float>(coords[0]), static_cast<float>(coords[1]), static_cast<float>(coords[2]) };
+			write(m_vertices, P, sizeof(P));
+		}
+	}
+
+	virtual void addNormal(const Real* coords) override
+	{
+		float N[3] { static_cast<float>(coords[0]), static_cast<float>(coords[1]), static_cast<float>(coords[2]) };
+		write(m_normals, N, sizeof(N));
+	}
+
+	virtual void addColor(const Real* rgb) override
+	{
+		uint8_t C[3] {	static_cast<uint8_t>(std::min((Real)255, std::max((Real)0, rgb[0]))),
+						static_cast<uint8_t>(std::min((Real)255, std::max((Real)0, rgb[1]))),
+						static_cast<uint8_t>(std::min((Real)255, std::max((Real)0, rgb[2]))) };
+		write(m_colors, C, sizeof(C));
+	}
+
+	virtual void addDensity(double d) override
+	{
+		float density = static_cast<float>(d);
+		write(m_densities, &density, sizeof(density));
+	}
+
+	void addTriangle(size_t i1, size_t i2, size_t i3) override
+	{
+		if (std::max(i1, std::max(i2, i3)) > static_cast<size_t>(std::numeric_limits<uint32_t>::max()))
+		{
+			//can't be saved as 'uint' indexes
+			m_error = true;
+			return;
+		}
+		uint32_t tri[3] { static_cast<uint32_t>(i1), static_cast<uint32_t>(i2), static_cast<uint32_t>(i3) };
+		write(m_triangles, tri, sizeof(tri));
+	}
+
+	bool isInErrorState() const { return m_error; }
+
+	//! Returns the number of vertices
+	size_t vertexCount() const { return m_vertices.count(); }
+	//! Returns the number of triangles
+	size_t triangleCount() const { return m_triangles.count(); }
+
+	//! Writes the final PLY file
+	bool save(bool withColors, bool withDensity)
+	{
+		if (m_error)
+		{
+			return false;
+		}
+
+		size_t vertexCount = m_vertices.count();
+		bool withNormals = (m_normals.count() == vertexCount);
+		withColors &= (m_colors.count() == vertexCount);
+		withDensity &= (m_densities.count() == vertexCount);
+
+		QFile file(m_filename);
+		if (!file.open(QFile::WriteOnly))
+		{
+			ccLog::Warning(QString("[PoissonRecon] Failed to open file '%1' for writing").arg(m_filename));
+			return false;
+		}
+
+		//header
+		{
+			QTextStream stream(&file);
+			stream << "ply\n";
+			stream << (QSysInfo::ByteOrder == QSysInfo::LittleEndian ? "format binary_little_endian 1.0\n" : "format binary_big_endian 1.0\n");
+			stream << "comment Created by CloudCompare (qPoissonRecon)\n";
+			stream << "element vertex " << vertexCount << "\n";
+			if (m_shifted)
+				stream << "property double x\nproperty double y\nproperty double z\n";
+			else
+				stream << "property float x\nproperty float y\nproperty float z\n";
+			if (withNormals)
+				stream << "property float nx\nproperty float ny\nproperty float nz\n";
+			if (withColors)
+				stream << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+			if (withDensity)
+				stream << "property float density\n";
+			stream << "element face " << m_triangles.count() << "\n";
+			stream << "property list uchar uint vertex_indices\n";
+			stream << "end_header\n";
+		}
+
+		//vertices (the properties are interleaved by blocks)
+		std::vector<std::pair<TemporaryStream*, int>> properties{ { &m_vertices, static_cast<int>(3 * (m_shifted ? sizeof(double) : sizeof(float))) } };
+		if (withNormals)
+			properties.emplace_back(&m_normals, static_cast<int>(3 * sizeof(float)));
+		if (withColors)
+			properties.emplace_back(&m_colors, 3);
+		if (withDensity)
+			properties.emplace_back(&m_densities, static_cast<int>(sizeof(float)));
+
+		if (!writeInterleaved(file, properties, vertexCount, nullptr, 0))
+		{
+			return false;
+		}
+
+		//triangles
+		static const uint8_t s_vertexPerTriangle = 3;
+		properties = { { &m_triangles, static_cast<int>(3 * sizeof(uint32_t)) } };
+		if (!writeInterleaved(file, properties, m_triangles.count(), &s_vertexPerTriangle, 1))
+		{
+			return false;
+		}
+
+		file.close();
+		return (file.error() == QFile::NoError);
+	}
+
+protected:
+
+	//! Writes an element in a stream
+	inline void write(TemporaryStream& stream, const void* data, int size)
+	{
+		if (!m_error && !stream.write(data, size))
+		{
+			m_error = true;
+		}
+	}
+
+	//! Interleaves the elements of several streams in the output file
+	bool writeInterleaved(QFile& file, const std::vector<std::pair<TemporaryStream*, int>>& properties, size_t count, const void* prefix, int prefixSize)
+	{
+		static const size_t s_blockSize = 65536;
+
+		int elementSize = prefixSize;
+		for (const auto& property : properties)
+		{
+			elementSize += property.second;
+			if (!property.first->rewind())
+			{
+				return false;
+			}
+		}
+
+		try
+		{
+			std::vector<std::vector<char>> input(properties.size());
+			for (size_t i = 0; i < properties.size(); ++i)
+			{
+				input[i].resize(s_blockSize * properties[i].second);
+			}
+			std::vector<char> output(s_blockSize * elementSize);
+
+			for (size_t start = 0; start < count; start += s_blockSize)
+			{
+				size_t blockCount = std::min(s_blockSize, count - start);
+				for (size_t i = 0; i < properties.size(); ++i)
+				{
+					if (!properties[i].first->read(input[i].data(), static_cast<qint64>(blockCount * properties[i].second)))
+					{
+						return false;
+					}
+				}
+
+				char* out = output.data();
+				for (size_t j = 0; j < blockCount; ++j)
+				{
+					if (prefixSize)
+					{
+						memcpy(out, prefix, prefixSize);
+						out += prefixSize;
+					}
+					for (size_t i = 0; i < properties.size(); ++i)
+					{
+						int size = properties[i].second;
+						memcpy(out, input[i].data() + j * size, size);
+						out += size;
+					}
+				}
+
+				qint64 byteCount = static_cast<qint64>(blockCount * elementSize);
+				if (file.write(output.data(), byteCount) != byteCount)
+				{
+					ccLog::Warning(QString("[PoissonRecon] Failed to write file '%1' (disk full?)").arg(m_filename));
+					return false;
+				}
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			ccLog::Warning("[PoissonRecon] Not enough memory");
+			return false;
+		}
+
+		return true;
+	}
+
+	QString m_filename;
+	//! Global shift of the input cloud
+	CCVector3d m_globalShift;
+	//! Global scale of the input cloud
+	double m_globalScale;
+	//! Whether the vertices must be converted to global coordinates
+	bool m_shifted;
+	TemporaryStream m_vertices;
+	TemporaryStream m_normals;
+	TemporaryStream m_colors;
+	TemporaryStream m_densities;
+	TemporaryStream m_triangles;
+	bool m_error;
+};
+
 //dialog for qPoissonRecon plugin
 class PoissonReconParamDlg : public QDialog, public Ui::PoissonReconParamDialog
 {
@@ -261,36 +579,103 @@ QList<QAction *> qPoissonRecon::getActions()
 }
 
 static PoissonReconLib::Parameters s_params;
-static ccPointCloud* s_cloud = nullptr;
-static ccMesh* s_mesh = nullptr;
-static ccPointCloud* s_meshVertices = nullptr;
-static CCCoreLib::ScalarField* s_densitySF = nullptr;
 
-bool doReconstruct()
+static bool DoReconstruct(	const PoissonReconLib::Parameters& params,
+							const ccPointCloud& cloud,
+							ccMesh& mesh,
+							ccPointCloud& meshVertices,
+							CCCoreLib::ScalarField* densitySF)
 {
-	//invalid parameters
-	if (!s_cloud || !s_mesh || !s_meshVertices)
+	QElapsedTimer timer;
+	timer.start();
+
+	MeshWrapper<PointCoordinateType> meshWrapper(mesh, meshVertices, densitySF);
+	PointCloudWrapper<PointCoordinateType> cloudWrapper(cloud);
+	
+	if (!PoissonReconLib::Reconstruct(params, cloudWrapper, meshWrapper) || meshWrapper.isInErrorState())
 	{
 		return false;
 	}
 
+	//release the extra memory reserved while the mesh was growing
+	mesh.shrinkToFit();
+	meshVertices.shrinkToFit();
+	if (densitySF)
+	{
+		//the density SF is not associated to the vertices yet
+		if (!densitySF->resizeSafe(meshVertices.size(), true, CCCoreLib::NAN_VALUE))
+		{
+			return false;
+		}
+		densitySF->shrink_to_fit();
+	}
+
+	qint64 elpased_msec = timer.elapsed();
+	ccLog::Print(QString("[PoissonRecon] Duration: %1 s").arg(elpased_msec / 1000.0, 0, 'f', 1));
+
+	return true;
+}
+
+static bool DoReconstructToFile(	const PoissonReconLib::Parameters& params,
+									const ccPointCloud& cloud,
+									const CCVector3d& globalShift,
+									double globalScale,
+									const QString& outputFilename,
+									size_t& vertexCount,
+									size_t& triangleCount)
+{
 	QElapsedTimer timer;
 	timer.start();
 
-	MeshWrapper<PointCoordinateType> meshWrapper(*s_mesh, *s_meshVertices, s_densitySF);
-	PointCloudWrapper<PointCoordinateType> cloudWrapper(*s_cloud);
-	
-	if (!PoissonReconLib::Reconstruct(s_params, cloudWrapper, meshWrapper) || meshWrapper.isInErrorState())
+	PlyStreamWrapper<PointCoordinateType> meshWrapper(outputFilename, globalShift, globalScale);
+	PointCloudWrapper<PointCoordinateType> cloudWrapper(cloud);
+
+	if (	meshWrapper.isInErrorState()
+		||	!PoissonReconLib::Reconstruct(params, cloudWrapper, meshWrapper)
+		||	!meshWrapper.save(params.withColors && cloud.hasColors(), params.density))
 	{
 		return false;
 	}
 
+	vertexCount = meshWrapper.vertexCount();
+	triangleCount = meshWrapper.triangleCount();
+
 	qint64 elpased_msec = timer.elapsed();
 	ccLog::Print(QString("[PoissonRecon] Duration: %1 s").arg(elpased_msec / 1000.0, 0, 'f', 1));
 
 	return true;
 }
 
+//! Copies the data read by the reconstruction (points, normals and colors)
+/** The job works on this private copy, as the input cloud may be edited while the job runs.
+	\return the copy (or nullptr if not enough memory)
+**/
+static ccPointCloud* CopyInput(const ccPointCloud& cloud)
+{
+	ccPointCloud* copy = new ccPointCloud(cloud.getName());
+
+	unsigned pointCount = cloud.size();
+	if (	!copy->reserveThePointsTable(pointCount)
+		||	!copy->reserveTheNormsTable()
+		||	(cloud.hasColors() && !copy->reserveTheRGBTable()))
+	{
+		delete copy;
+		return nullptr;
+	}
+
+	for (unsigned i = 0; i < pointCount; ++i)
+	{
+		copy->addPoint(*cloud.getPoint(i));
+		copy->addNorm(cloud.getPointNormal(i));
+		if (cloud.hasColors())
+		{
+			copy->addColor(cloud.getPointColor(i));
+		}
+	}
+
+	return copy;
+}
+
 void qPoissonRecon::doAction()
 {
 	assert(m_app);
@@ -327,6 +712,8 @@ void qPoissonRecon::doAction()
 	static unsigned s_lastEntityID = 0;
 	static double s_defaultResolution = 0.0;
 	static bool s_depthMode = true;
+	static bool s_streamOutput = false;
+	static QString s_outputFilename;
 	if (s_defaultResolution == 0.0 || s_lastEntityID != pc->getUniqueID())
 	{
 		s_defaultResolution = pc->getOwnBB().getDiagNormd() / 200.0;
@@ -350,6 +737,7 @@ void qPoissonRecon::doAction()
 	prpDlg.weightDoubleSpinBox->setValue(s_params.pointWeight);
 	prpDlg.threadSpinBox->setValue(s_params.threads);
 	prpDlg.linearFitCheckBox->setChecked(s_params.linearFit);
+	prpDlg.streamOutputCheckBox->setChecked(s_streamOutput);
 	switch (s_params.boundary)
 	{
 	case PoissonReconLib::Parameters::FREE:
@@ -369,6 +757,24 @@ void qPoissonRecon::doAction()
 	if (!prpDlg.exec())
 		return;
 
+	//streamed output: the mesh is directly written to a file
+	s_streamOutput = prpDlg.streamOutputCheckBox->isChecked();
+	QString outputFilename;
+	if (s_streamOutput)
+	{
+		if (s_outputFilename.isEmpty())
+		{
+			s_outputFilename = QDir::home().filePath("poisson_mesh.ply");
+		}
+		outputFilename = QFileDialog::getSaveFileName(m_app->getMainWindow(), "Output mesh", s_outputFilename, "PLY mesh (*.ply)");
+		if (outputFilename.isEmpty())
+		{
+			//process cancelled by the user
+			return;
+		}
+		s_outputFilename = outputFilename;
+	}
+
 	//set parameters with dialog settings
 	s_depthMode = prpDlg.depthRadioButton->isChecked();
 	s_defaultResolution = prpDlg.resolutionDoubleSpinBox->value();
@@ -399,121 +805,142 @@ void qPoissonRecon::doAction()
 
 	/*** RECONSTRUCTION PROCESS ***/
 
-	assert(s_cloud == nullptr);
-	assert(s_mesh == nullptr);
-	assert(s_meshVertices == nullptr);
+	PoissonReconLib::Parameters params = s_params;
 
-	ccScalarField* densitySF = nullptr;
-	ccPointCloud* newPC = new ccPointCloud("vertices");
-	ccMesh* newMesh = new ccMesh(newPC);
-	newMesh->addChild(newPC);
+	//the job works on a private copy of the input cloud (deleted by the completion callback)
+	ccPointCloud* input = CopyInput(*pc);
+	if (!input)
+	{
+		m_app->dispToConsole("Not enough memory!", ccMainAppInterface::ERR_CONSOLE_MESSAGE);
+		return;
+	}
 
-	//run in a separate thread
-	bool result = false;
+	if (s_streamOutput)
 	{
-		//start message
-		m_app->dispToConsole(QString("[PoissonRecon] Job started (level %1 - %2 threads)").arg(s_params.depth).arg(s_params.threads), ccMainAppInterface::STD_CONSOLE_MESSAGE);
+		struct StreamedMeshInfo
+		{
+			size_t vertexCount = 0;
+			size_t triangleCount = 0;
+		};
+		std::shared_ptr<StreamedMeshInfo> meshInfo(new StreamedMeshInfo);
+
+		ccJobScheduler::Description description;
+		description.name = QString("PoissonRecon [%1]").arg(pc->getName());
+		description.entities.push_back(pc);
+		description.threadCount = params.threads;
+		//the mesh is saved in the global coordinate system of the input cloud
+		CCVector3d globalShift = pc->getGlobalShift();
+		double globalScale = pc->getGlobalScale();
+		description.process = [params, input, globalShift, globalScale, outputFilename, meshInfo](ccJob& job) mutable
+		{
+			//the scheduler may grant less threads than requested
+			params.threads = job.threadCount();
+			return DoReconstructToFile(params, *input, globalShift, globalScale, outputFilename, meshInfo->vertexCount, meshInfo->triangleCount);
+		};
 
-		//progress dialog (Qtconcurrent::run can't be canceled!)
-		QProgressDialog pDlg(tr("Initialization"), QString(), 0, 0, m_app->getMainWindow());
-		pDlg.setWindowTitle("Poisson Reconstruction");
-		pDlg.setCancelButton(nullptr); // it's not possible to cancel PoissonRecon currently
-		pDlg.show();
-		//QApplication::processEvents();
+		ccMainAppInterface* app = m_app;
+		description.completion = [app, input, outputFilename, meshInfo](ccJob& job, bool success)
+		{
+			delete input;
 
-		QString progressLabel("Reconstruction in progress\n");
-		if (s_depthMode)
-			progressLabel += QString("level: %1").arg(s_params.depth);
-		else
-			progressLabel += QString("resolution: %1").arg(s_params.finestCellWidth);
-		progressLabel += QString(" [%1 thread(s)]").arg(s_params.threads);
+			if (!success)
+			{
+				app->dispToConsole(job.isCanceled() ? "Reconstruction canceled by the user" : "Reconstruction failed!", ccMainAppInterface::ERR_CONSOLE_MESSAGE);
+				return;
+			}
 
-		pDlg.setLabelText(progressLabel);
-		QApplication::processEvents();
+			app->dispToConsole(QString("[PoissonRecon] Job finished (%1 triangles, %2 vertices): mesh saved to '%3'").arg(meshInfo->triangleCount).arg(meshInfo->vertexCount).arg(outputFilename), ccMainAppInterface::STD_CONSOLE_MESSAGE);
+		};
 
-		//run in a separate thread
-		s_cloud = pc;
-		s_mesh = newMesh;
-		s_meshVertices = newPC;
+		m_app->dispToConsole(QString("[PoissonRecon] Job queued (%1 - %2 threads) - output: '%3'").arg(s_depthMode ? QString("level %1").arg(params.depth) : QString("resolution %1").arg(params.finestCellWidth)).arg(params.threads).arg(outputFilename), ccMainAppInterface::STD_CONSOLE_MESSAGE);
 
-		if (s_params.density)
-		{
-			s_densitySF = (densitySF = new ccScalarField("Density"));
-		}
+		ccJobScheduler::Instance()->submit(description);
+		return;
+	}
 
-		QFuture<bool> future = QtConcurrent::run(doReconstruct);
+	ccScalarField* densitySF = (params.density ? new ccScalarField("Density") : nullptr);
+	ccPointCloud* newPC = new ccPointCloud("vertices");
+	ccMesh* newMesh = new ccMesh(newPC);
+	newMesh->addChild(newPC);
 
-		//wait until process is finished!
-		while (!future.isFinished())
-		{
-#if defined(CC_WINDOWS)
-			::Sleep(500);
-#else
-			usleep(500 * 1000);
-#endif
+	//run as a background job (several reconstructions can run concurrently on different clouds)
+	ccJobScheduler::Description description;
+	description.name = QString("PoissonRecon [%1]").arg(pc->getName());
+	description.entities.push_back(pc);
+	description.threadCount = params.threads;
+	description.process = [params, input, newMesh, newPC, densitySF](ccJob& job) mutable
+	{
+		//the scheduler may grant less threads than requested
+		params.threads = job.threadCount();
+		return DoReconstruct(params, *input, *newMesh, *newPC, densitySF);
+	};
+
+	//the input cloud may be deleted meanwhile (despite being locked by the scheduler)
+	QString cloudName = pc->getName();
+	CCVector3d globalShift = pc->getGlobalShift();
+	double globalScale = pc->getGlobalScale();
+	ccMainAppInterface* app = m_app;
+	description.completion = [app, params, pc, cloudName, globalShift, globalScale, input, newMesh, newPC, densitySF, cloudHasColors](ccJob& job, bool success)
+	{
+		delete input;
 
-			pDlg.setValue(pDlg.value() + 1);
-			QApplication::processEvents();
+		if (!success)
+		{
+			if (densitySF)
+			{
+				densitySF->release();
+			}
+			delete newMesh;
+			app->dispToConsole(job.isCanceled() ? "Reconstruction canceled by the user" : "Reconstruction failed!", ccMainAppInterface::ERR_CONSOLE_MESSAGE);
+			return;
 		}
 
-		result = future.result();
-
-		s_cloud = nullptr;
-		s_mesh = nullptr;
-		s_meshVertices = nullptr;
+		//success message
+		app->dispToConsole(QString("[PoissonRecon] Job finished (%1 triangles, %2 vertices)").arg(newMesh->size()).arg(newPC->size()), ccMainAppInterface::STD_CONSOLE_MESSAGE);
 
-		pDlg.hide();
-		QApplication::processEvents();
-	}
+		newMesh->setName(QString("Mesh[%1] (level %2)").arg(cloudName).arg(params.depth));
+		newPC->setEnabled(false);
+		newMesh->setVisible(true);
+		newMesh->computeNormals(true);
+		if (!cloudHasColors)
+		{
+			newPC->unallocateColors();
+			newPC->showColors(false);
+		}
+		newMesh->showColors(newPC->hasColors());
 
-	if (!result)
-	{
 		if (densitySF)
 		{
-			densitySF->release();
-			densitySF = nullptr;
+			densitySF->computeMinAndMax();
+			densitySF->showNaNValuesInGrey(false);
+			int sfIdx = newPC->addScalarField(densitySF);
+			newPC->setCurrentDisplayedScalarField(sfIdx);
+			newPC->showSF(true);
+			newMesh->showColors(newPC->colorsShown());
+			newMesh->showSF(true);
 		}
-		delete newMesh;
-		newMesh = nullptr;
-		m_app->dispToConsole("Reconstruction failed!", ccMainAppInterface::ERR_CONSOLE_MESSAGE);
-		return;
-	}
-	
-	//success message
-	m_app->dispToConsole(QString("[PoissonRecon] Job finished (%1 triangles, %2 vertices)").arg(newMesh->size()).arg(newPC->size()), ccMainAppInterface::STD_CONSOLE_MESSAGE);
 
-	newMesh->setName(QString("Mesh[%1] (level %2)").arg(pc->getName()).arg(s_params.depth));
-	newPC->setEnabled(false);
-	newMesh->setVisible(true);
-	newMesh->computeNormals(true);
-	if (!cloudHasColors)
-	{
-		newPC->unallocateColors();
-		newPC->showColors(false);
-	}
-	newMesh->showColors(newPC->hasColors());
+		//copy Global Shift & Scale information
+		newPC->setGlobalShift(globalShift);
+		newPC->setGlobalScale(globalScale);
 
-	if (densitySF)
-	{
-		densitySF->computeMinAndMax();
-		densitySF->showNaNValuesInGrey(false);
-		int sfIdx = newPC->addScalarField(densitySF);
-		newPC->setCurrentDisplayedScalarField(sfIdx);
-		newPC->showSF(true);
-		newMesh->showColors(newPC->colorsShown());
-		newMesh->showSF(true);
-	}
+		//output mesh
+		app->addToDB(newMesh);
+		if (job.uses(pc)) //i.e. not deleted meanwhile
+		{
+			app->setSelectedInDB(pc, false);
+		}
+		app->setSelectedInDB(newMesh, true);
 
-	//copy Global Shift & Scale information
-	newPC->copyGlobalShiftAndScale(*pc);
+		//currently selected entities parameters may have changed!
+		app->updateUI();
+		//currently selected entities appearance may have changed!
+		app->refreshAll();
+	};
 
-	//output mesh
-	m_app->addToDB(newMesh);
-	m_app->setSelectedInDB(ent, false);
-	m_app->setSelectedInDB(newMesh, true);
+	//start message
+	QString jobDesc = (s_depthMode ? QString("level %1").arg(params.depth) : QString("resolution %1").arg(params.finestCellWidth));
+	m_app->dispToConsole(QString("[PoissonRecon] Job queued (%1 - %2 threads)").arg(jobDesc).arg(params.threads), ccMainAppInterface::STD_CONSOLE_MESSAGE);
 
-	//currently selected entities parameters may have changed!
-	m_app->updateUI();
-	//currently selected entities appearance may have changed!
-	m_app->refreshAll();
+	ccJobScheduler::Instance()->submit(description);
 }
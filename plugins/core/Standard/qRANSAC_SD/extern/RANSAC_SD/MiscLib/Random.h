@@ -13,8 +13,9 @@
 
 namespace MiscLib
 {
-	extern size_t rn_buf[];
-	extern size_t rn_point;
+	// the generator state is local to each thread (so that several detections can run concurrently)
+	extern thread_local size_t rn_buf[];
+	extern thread_local size_t rn_point;
 	void rn_setseed(size_t);
 	size_t rn_refresh(void);
 	inline size_t rn_rand()
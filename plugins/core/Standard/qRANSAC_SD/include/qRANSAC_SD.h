@@ -67,6 +67,7 @@ public:
 		float minTorusMajorRadius;
 		float maxTorusMinorRadius;
 		float maxTorusMajorRadius;
+		unsigned tileLevel; // the shapes are detected independently (and in parallel) in each cell of the octree at this level (0 = no tiling)
 
 		RansacParams() : epsilon(0.005f)
 			, bitmapEpsilon(0.001f)
@@ -89,6 +90,7 @@ public:
 			, minTorusMajorRadius(0)
 			, maxTorusMinorRadius(std::numeric_limits<float>::max())
 			, maxTorusMajorRadius(std::numeric_limits<float>::max())
+			, tileLevel(0)
 		{
 			primEnabled[RPT_PLANE] = true;
 			primEnabled[RPT_SPHERE] = true;
@@ -118,6 +120,7 @@ public:
 			, minTorusMajorRadius(0)
 			, maxTorusMinorRadius(std::numeric_limits<float>::max())
 			, maxTorusMajorRadius(std::numeric_limits<float>::max())
+			, tileLevel(0)
 		{
 			primEnabled[RPT_PLANE] = true;
 			primEnabled[RPT_SPHERE] = true;
@@ -127,6 +130,9 @@ public:
 		};
 
 	};
+	//! Maximum tiling level (see RansacParams::tileLevel)
+	static const unsigned MAX_TILE_LEVEL = 6;
+
 	//! Default constructor
 	explicit qRansacSD(QObject* parent = nullptr);
 
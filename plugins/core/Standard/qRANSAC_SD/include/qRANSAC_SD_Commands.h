@@ -37,6 +37,7 @@ constexpr char SUPPORT_POINTS[] = "SUPPORT_POINTS";
 constexpr char MAX_NORMAL_DEV[] = "MAX_NORMAL_DEV";
 constexpr char PROBABILITY[] = "PROBABILITY";
 constexpr char ENABLE_PRIMITIVE[] = "ENABLE_PRIMITIVE";
+constexpr char TILE_LEVEL[] = "TILE_LEVEL";
 constexpr char OUT_CLOUD_DIR[] = "OUT_CLOUD_DIR";
 constexpr char OUT_MESH_DIR[] = "OUT_MESH_DIR";
 constexpr char OUT_PAIR_DIR[] = "OUT_PAIR_DIR";
@@ -67,7 +68,7 @@ struct CommandRANSAC : public ccCommandLineInterface::Command
 		qRansacSD::RansacParams params;
 		QStringList paramNames = QStringList() << EPSILON_ABSOLUTE << EPSILON_PERCENTAGE_OF_SCALE <<
 			BITMAP_EPSILON_PERCENTAGE_OF_SCALE << BITMAP_EPSILON_ABSOLUTE <<
-			SUPPORT_POINTS << MAX_NORMAL_DEV << PROBABILITY << ENABLE_PRIMITIVE <<
+			SUPPORT_POINTS << MAX_NORMAL_DEV << PROBABILITY << ENABLE_PRIMITIVE << TILE_LEVEL <<
 			OUT_CLOUD_DIR << OUT_MESH_DIR << OUT_GROUP_DIR << OUT_PAIR_DIR << OUT_RANDOM_COLOR << OUTPUT_INDIVIDUAL_PRIMITIVES <<
 			OUTPUT_INDIVIDUAL_SUBCLOUDS << OUTPUT_GROUPED << OUTPUT_INDIVIDUAL_PAIRED_CLOUD_PRIMITIVE;
 		QStringList primitiveNames = QStringList() << PRIM_PLANE << PRIM_SPHERE << PRIM_CYLINDER << PRIM_CONE << PRIM_TORUS;
@@ -205,6 +206,21 @@ struct CommandRANSAC : public ccCommandLineInterface::Command
 					cmd.print(QObject::tr("\tProbability : %1").arg(val));
 					params.probability = val;
 				}
+				else if (param == TILE_LEVEL)
+				{
+					if (cmd.arguments().empty())
+					{
+						return cmd.error(QObject::tr("Missing parameter: number after \"-%1 %2\"").arg(COMMAND_RANSAC, TILE_LEVEL));
+					}
+					bool ok;
+					unsigned level = cmd.arguments().takeFirst().toUInt(&ok);
+					if (!ok || level > qRansacSD::MAX_TILE_LEVEL)
+					{
+						return cmd.error(QObject::tr("Invalid tile level (should be between 0 and %1)").arg(qRansacSD::MAX_TILE_LEVEL));
+					}
+					cmd.print(QObject::tr("\tTile level : %1").arg(level));
+					params.tileLevel = level;
+				}
 				else if (param == OUT_RANDOM_COLOR)
 				{
 					params.randomColor = true;
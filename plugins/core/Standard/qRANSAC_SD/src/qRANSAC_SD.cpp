@@ -37,7 +37,8 @@
 //Qt
 #include <QtGui>
 #include <QApplication>
-#include <QtConcurrentRun>
+#include <QtConcurrentMap>
+#include <QElapsedTimer>
 #include <QApplication>
 #include <QMainWindow>
 
@@ -45,6 +46,7 @@
 #include <ccGenericPointCloud.h>
 #include <ccPointCloud.h>
 #include <ccGenericMesh.h>
+#include <ccNormalVectors.h>
 #include <ccPlane.h>
 #include <ccSphere.h>
 #include <ccCylinder.h>
@@ -58,6 +60,8 @@
 
 //System
 #include <algorithm>
+#include <cmath>
+#include <numeric>
 #if defined(CC_WINDOWS)
 #include "windows.h"
 #else
@@ -105,16 +109,412 @@ void qRansacSD::registerCommands(ccCommandLineInterface* cmd)
 	cmd->registerCommand(ccCommandLineInterface::Command::Shared(new CommandRANSAC));
 }
 
-static MiscLib::Vector< std::pair< MiscLib::RefCountPtr< PrimitiveShape >, size_t > >* s_shapes; // stores the detected shapes
-static size_t s_remainingPoints = 0;
-static RansacShapeDetector* s_detector = 0;
-static PointCloud* s_cloud = 0;
-void doDetection()
+#ifndef POINTSWITHINDEX
+#error "qRANSAC_SD requires the POINTSWITHINDEX definition (see extern/RANSAC_SD/CMakeLists.txt)"
+#endif
+
+typedef std::pair< MiscLib::RefCountPtr< PrimitiveShape >, size_t > DetectedShape;
+
+//! Shape detected by RANSAC
+struct RansacShape
+{
+	//! Primitive
+	MiscLib::RefCountPtr<PrimitiveShape> shape;
+	//! Indexes of the shape points (in the input cloud)
+	std::vector<unsigned> pointIndexes;
+	//! Position of the tile in which the shape has been detected
+	int tilePos[3] = { 0, 0, 0 };
+	//! Whether the shape is the union of several compatible shapes detected in neighbouring tiles
+	bool merged = false;
+};
+
+//! Parameters shared by all the tiles
+struct RansacContext
+{
+	ccPointCloud* cloud = nullptr;
+	const qRansacSD::RansacParams* params = nullptr;
+	RansacShapeDetector::Options options;
+	//! Normals table to fill (if the input cloud has no normals)
+	NormsIndexesTableType* computedNormals = nullptr;
+	//! Radius used to compute the normals
+	float normalsRadius = 0;
+};
+
+//! Spatial tile (the shapes are detected independently in each tile)
+struct RansacTile
+{
+	//! Position of the tile (in the tiling grid)
+	int pos[3] = { 0, 0, 0 };
+	//! Indexes of the tile points (in the input cloud)
+	std::vector<unsigned> pointIndexes;
+	//! Shared parameters
+	const RansacContext* context = nullptr;
+
+	//! Detected shapes (output)
+	std::vector<RansacShape> shapes;
+	//! Indexes of the points that don't belong to any shape (output)
+	std::vector<unsigned> leftOvers;
+	//! Whether the detection succeeded (output)
+	bool success = true;
+
+	//! Timings (output)
+	qint64 buildTime_ms = 0;
+	qint64 normalsTime_ms = 0;
+	qint64 searchTime_ms = 0;
+};
+
+static inline Vec3f PointPosition(const ccPointCloud* cloud, unsigned index)
+{
+	const CCVector3* P = cloud->getPoint(index);
+	return Vec3f(static_cast<float>(P->x), static_cast<float>(P->y), static_cast<float>(P->z));
+}
+
+static void AddShapeConstructors(RansacShapeDetector& detector, const qRansacSD::RansacParams& params)
 {
-	if (!s_detector || !s_cloud || !s_shapes)
+	if (params.primEnabled[qRansacSD::RPT_PLANE])
+		detector.Add(new PlanePrimitiveShapeConstructor());
+	if (params.primEnabled[qRansacSD::RPT_SPHERE])
+		detector.Add(new SpherePrimitiveShapeConstructor(params.minSphereRadius, params.maxSphereRadius));
+	if (params.primEnabled[qRansacSD::RPT_CYLINDER])
+		detector.Add(new CylinderPrimitiveShapeConstructor(params.minCylinderRadius, params.maxCylinderRadius, params.maxCylinderLength));
+	if (params.primEnabled[qRansacSD::RPT_CONE])
+		detector.Add(new ConePrimitiveShapeConstructor(params.maxConeRadius, CCCoreLib::DegreesToRadians(params.maxConeAngle_deg), params.maxConeLength));
+	if (params.primEnabled[qRansacSD::RPT_TORUS])
+		detector.Add(new TorusPrimitiveShapeConstructor(false, params.minTorusMinorRadius, params.minTorusMajorRadius, params.maxTorusMinorRadius, params.maxTorusMajorRadius)); // Do not allow apple shaped torus
+}
+
+//! Splits the cloud in tiles (= the non-empty cells of the octree at the tiling level)
+/** The points of the cells that are too small to contain a shape are directly added to the leftovers.
+**/
+static bool BuildTiles(	const ccPointCloud* cloud,
+						const qRansacSD::RansacParams& params,
+						std::vector<RansacTile>& tiles,
+						std::vector<unsigned>& leftOvers)
+{
+	unsigned pointCount = cloud->size();
+
+	CCVector3 bbMin, bbMax;
+	cloud->getBoundingBox(bbMin, bbMax);
+	CCVector3 diag = bbMax - bbMin;
+	PointCoordinateType cubeSize = std::max(std::max(diag.x, diag.y), diag.z);
+
+	try
+	{
+		unsigned level = std::min(params.tileLevel, static_cast<unsigned>(qRansacSD::MAX_TILE_LEVEL));
+		if (level == 0 || cubeSize <= 0)
+		{
+			//single tile
+			tiles.resize(1);
+			tiles.front().pointIndexes.resize(pointCount);
+			std::iota(tiles.front().pointIndexes.begin(), tiles.front().pointIndexes.end(), 0u);
+			return true;
+		}
+
+		const int gridSize = (1 << level);
+		const PointCoordinateType cellSize = cubeSize / gridSize;
+
+		std::vector<unsigned> pointCells(pointCount);
+		std::vector<unsigned> cellPopulation(static_cast<size_t>(gridSize) * gridSize * gridSize, 0);
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			const CCVector3* P = cloud->getPoint(i);
+			int cellPos[3];
+			for (unsigned char k = 0; k < 3; ++k)
+			{
+				cellPos[k] = std::min(gridSize - 1, static_cast<int>((P->u[k] - bbMin.u[k]) / cellSize));
+			}
+			unsigned cellIndex = static_cast<unsigned>(cellPos[0] + (cellPos[1] + cellPos[2] * gridSize) * gridSize);
+			pointCells[i] = cellIndex;
+			++cellPopulation[cellIndex];
+		}
+
+		std::vector<int> cellTiles(cellPopulation.size(), -1);
+		for (size_t cellIndex = 0; cellIndex < cellPopulation.size(); ++cellIndex)
+		{
+			unsigned population = cellPopulation[cellIndex];
+			if (population == 0 || population < params.supportPoints)
+			{
+				//no shape can be found in this cell
+				continue;
+			}
+
+			cellTiles[cellIndex] = static_cast<int>(tiles.size());
+			RansacTile tile;
+			tile.pos[0] = static_cast<int>(cellIndex % gridSize);
+			tile.pos[1] = static_cast<int>((cellIndex / gridSize) % gridSize);
+			tile.pos[2] = static_cast<int>(cellIndex / (static_cast<size_t>(gridSize) * gridSize));
+			tile.pointIndexes.reserve(population);
+			tiles.push_back(std::move(tile));
+		}
+
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			int tileIndex = cellTiles[pointCells[i]];
+			if (tileIndex >= 0)
+				tiles[tileIndex].pointIndexes.push_back(i);
+			else
+				leftOvers.push_back(i);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+//! Detects the shapes in a tile (may be called concurrently on different tiles)
+static void DetectShapesInTile(RansacTile& tile)
+{
+	if (tile.pointIndexes.empty() || !tile.context)
+	{
 		return;
+	}
+	const RansacContext& context = *tile.context;
+
+	QElapsedTimer timer;
+	timer.start();
+
+	try
+	{
+		//the temporary cloud only contains the points of this tile (and is released as soon as the detection is done)
+		PointCloud cloud;
+		cloud.resize(tile.pointIndexes.size());
+		{
+			const ccPointCloud* ccPC = context.cloud;
+			bool hasNormals = (context.computedNormals == nullptr);
+
+			float bbMin[3], bbMax[3];
+			for (size_t i = 0; i < tile.pointIndexes.size(); ++i)
+			{
+				unsigned index = tile.pointIndexes[i];
+				Point& Pt = cloud[i];
+				Pt.pos = PointPosition(ccPC, index);
+				if (hasNormals)
+				{
+					const CCVector3& N = ccPC->getPointNormal(index);
+					Pt.normal = Vec3f(static_cast<float>(N.x), static_cast<float>(N.y), static_cast<float>(N.z));
+				}
+				else
+				{
+					Pt.normal = Vec3f(0.0f, 0.0f, 0.0f);
+				}
+				Pt.index = index;
+
+				const float* P = Pt.pos.getValue();
+				for (unsigned k = 0; k < 3; ++k)
+				{
+					bbMin[k] = (i != 0 ? std::min(bbMin[k], P[k]) : P[k]);
+					bbMax[k] = (i != 0 ? std::max(bbMax[k], P[k]) : P[k]);
+				}
+			}
+
+			//manually set bounding box!
+			cloud.setBBox(Vec3f(bbMin), Vec3f(bbMax));
+
+			//we don't need the input indexes anymore
+			tile.pointIndexes.clear();
+			tile.pointIndexes.shrink_to_fit();
+		}
+		tile.buildTime_ms = timer.restart();
+
+		if (context.computedNormals)
+		{
+			cloud.calcNormals(context.normalsRadius);
+
+			//each point belongs to a single tile, so the normals can be set concurrently
+			for (size_t i = 0; i < cloud.size(); ++i)
+			{
+				CCVector3 Ni = CCVector3::fromArray(cloud[i].normal);
+				//normalize the vector in case of
+				Ni.normalize();
+				context.computedNormals->setValue(cloud[i].index, ccNormalVectors::GetNormIndex(Ni));
+			}
+			tile.normalsTime_ms = timer.restart();
+		}
+
+		RansacShapeDetector detector(context.options); // the detector object
+		AddShapeConstructors(detector, *context.params);
+
+		// run detection
+		// returns number of unassigned points
+		// the array shapes is filled with pointers to the detected shapes
+		// the second element per shapes gives the number of points assigned to that primitive (the support)
+		// the points belonging to the first shape (shapes[0]) have been sorted to the end of pc,
+		// i.e. into the range [ pc.size() - shapes[0].second, pc.size() )
+		// the points of shape i are found in the range
+		// [ pc.size() - \sum_{j=0..i} shapes[j].second, pc.size() - \sum_{j=0..i-1} shapes[j].second )
+		MiscLib::Vector< DetectedShape > shapes; // stores the detected shapes
+		size_t remaining = detector.Detect(cloud, 0, cloud.size(), &shapes);
+
+		tile.shapes.resize(shapes.size());
+		size_t shapeEnd = cloud.size();
+		for (size_t i = 0; i < shapes.size(); ++i)
+		{
+			size_t shapePointsCount = shapes[i].second;
+			if (shapePointsCount > shapeEnd)
+			{
+				ccLog::Warning("[qRansacSD] Inconsistent result!");
+				tile.shapes.resize(i);
+				break;
+			}
+
+			RansacShape& shape = tile.shapes[i];
+			shape.shape = shapes[i].first;
+			std::copy(tile.pos, tile.pos + 3, shape.tilePos);
+			shape.pointIndexes.resize(shapePointsCount);
+			for (size_t j = 0; j < shapePointsCount; ++j)
+			{
+				shape.pointIndexes[j] = cloud[shapeEnd - 1 - j].index;
+			}
+			shapeEnd -= shapePointsCount;
+		}
+
+		tile.leftOvers.resize(std::min(remaining, cloud.size()));
+		for (size_t j = 0; j < tile.leftOvers.size(); ++j)
+		{
+			tile.leftOvers[j] = cloud[j].index;
+		}
+
+		tile.searchTime_ms = timer.elapsed();
+	}
+	catch (const std::bad_alloc&)
+	{
+		tile.success = false;
+	}
+}
+
+//! Returns whether two shapes (detected in different tiles) are the parts of a same primitive
+static bool AreCompatibleShapes(const RansacShape& a, const RansacShape& b, const RansacShapeDetector::Options& options)
+{
+	//only the shapes of neighbouring tiles can be merged
+	for (unsigned char k = 0; k < 3; ++k)
+	{
+		if (std::abs(a.tilePos[k] - b.tilePos[k]) > 1)
+			return false;
+	}
+	if (std::equal(a.tilePos, a.tilePos + 3, b.tilePos))
+	{
+		//same tile (already handled by the detector)
+		return false;
+	}
+
+	if (a.shape->Identifier() != b.shape->Identifier())
+		return false;
+
+	switch (a.shape->Identifier())
+	{
+	case qRansacSD::RPT_PLANE:
+	{
+		const Plane& pa = static_cast<const PlanePrimitiveShape&>(*a.shape).Internal();
+		const Plane& pb = static_cast<const PlanePrimitiveShape&>(*b.shape).Internal();
+		return	std::abs(pa.getNormal().dot(pb.getNormal())) >= options.m_normalThresh
+			&&	pa.Distance(pb.getPosition()) <= options.m_epsilon
+			&&	pb.Distance(pa.getPosition()) <= options.m_epsilon;
+	}
+
+	case qRansacSD::RPT_SPHERE:
+	{
+		const Sphere& sa = static_cast<const SpherePrimitiveShape&>(*a.shape).Internal();
+		const Sphere& sb = static_cast<const SpherePrimitiveShape&>(*b.shape).Internal();
+		return	(sa.Center() - sb.Center()).length() <= options.m_epsilon
+			&&	std::abs(sa.Radius() - sb.Radius()) <= options.m_epsilon;
+	}
+
+	case qRansacSD::RPT_CYLINDER:
+	{
+		const Cylinder& ca = static_cast<const CylinderPrimitiveShape&>(*a.shape).Internal();
+		const Cylinder& cb = static_cast<const CylinderPrimitiveShape&>(*b.shape).Internal();
+		if (	std::abs(ca.AxisDirection().dot(cb.AxisDirection())) < options.m_normalThresh
+			||	std::abs(ca.Radius() - cb.Radius()) > options.m_epsilon)
+		{
+			return false;
+		}
+		//distance between the two axes
+		Vec3f AB = cb.AxisPosition() - ca.AxisPosition();
+		AB -= ca.AxisDirection() * AB.dot(ca.AxisDirection());
+		return AB.length() <= options.m_epsilon;
+	}
+
+	default:
+		//cones and tori are not merged
+		return false;
+	}
+}
+
+//! Merges the compatible shapes detected in neighbouring tiles
+static std::vector<RansacShape> MergeShapes(std::vector<RansacShape>& shapes, const RansacShapeDetector::Options& options)
+{
+	//union-find
+	std::vector<size_t> parents(shapes.size());
+	std::iota(parents.begin(), parents.end(), 0);
+	auto root = [&parents](size_t i)
+	{
+		while (parents[i] != i)
+		{
+			parents[i] = parents[parents[i]];
+			i = parents[i];
+		}
+		return i;
+	};
+
+	for (size_t i = 0; i < shapes.size(); ++i)
+	{
+		for (size_t j = i + 1; j < shapes.size(); ++j)
+		{
+			if (AreCompatibleShapes(shapes[i], shapes[j], options))
+			{
+				size_t ri = root(i);
+				size_t rj = root(j);
+				if (ri != rj)
+				{
+					parents[std::max(ri, rj)] = std::min(ri, rj);
+				}
+			}
+		}
+	}
+
+	//the largest part of each group is used as reference
+	std::vector<size_t> references(shapes.size());
+	std::iota(references.begin(), references.end(), 0);
+	for (size_t i = 0; i < shapes.size(); ++i)
+	{
+		size_t& ref = references[root(i)];
+		if (shapes[i].pointIndexes.size() > shapes[ref].pointIndexes.size())
+		{
+			ref = i;
+		}
+	}
+
+	std::vector<RansacShape> mergedShapes;
+	std::vector<int> groupIndexes(shapes.size(), -1);
+	for (size_t i = 0; i < shapes.size(); ++i)
+	{
+		size_t r = root(i);
+		if (groupIndexes[r] < 0)
+		{
+			groupIndexes[r] = static_cast<int>(mergedShapes.size());
+			RansacShape group;
+			group.shape = shapes[references[r]].shape;
+			std::copy(shapes[references[r]].tilePos, shapes[references[r]].tilePos + 3, group.tilePos);
+			mergedShapes.push_back(std::move(group));
+		}
+
+		RansacShape& group = mergedShapes[groupIndexes[r]];
+		if (!group.pointIndexes.empty())
+		{
+			group.merged = true;
+		}
+		group.pointIndexes.insert(group.pointIndexes.end(), shapes[i].pointIndexes.begin(), shapes[i].pointIndexes.end());
+		shapes[i].pointIndexes.clear();
+		shapes[i].pointIndexes.shrink_to_fit();
+	}
 
-	s_remainingPoints = s_detector->Detect(*s_cloud, 0, s_cloud->size(), s_shapes);
+	//sort the shapes by decreasing support (as the detector does)
+	std::stable_sort(mergedShapes.begin(), mergedShapes.end(), [](const RansacShape& a, const RansacShape& b) { return a.pointIndexes.size() > b.pointIndexes.size(); });
+
+	return mergedShapes;
 }
 
 //for parameters persistence
@@ -344,165 +744,97 @@ ccHObject* qRansacSD::executeRANSAC(ccPointCloud* ccPC, const RansacParams& para
 	s_proba = params.probability;
 	s_createCloudFromLeftOverPoints = params.createCloudFromLeftOverPoints;
 	s_allowSimplification = params.allowSimplification;
-	unsigned count = ccPC->size();
 	bool hasNorms = ccPC->hasNormals();
 	CCVector3 bbMin, bbMax;
 	ccPC->getBoundingBox(bbMin, bbMax);
-	const CCVector3d& globalShift = ccPC->getGlobalShift();
-	double globalScale = ccPC->getGlobalScale();
-	PointCloud cloud;
-	{
-		try
-		{
-			cloud.reserve(count);
-		}
-		catch (...)
-		{
-			ccLog::Error("[qRansacSD] Could not create temporary cloud, Not enough memory!");
-			return nullptr;
-		}
+	const float scale = static_cast<float>(std::max(std::max(bbMax.x - bbMin.x, bbMax.y - bbMin.y), bbMax.z - bbMin.z));
 
-		//default point & normal
-		Point Pt;
-		Pt.normal[0] = 0.0;
-		Pt.normal[1] = 0.0;
-		Pt.normal[2] = 0.0;
-		for (unsigned i = 0; i < count; ++i)
-		{
-			const CCVector3* P = ccPC->getPoint(i);
-			Pt.pos[0] = static_cast<float>(P->x);
-			Pt.pos[1] = static_cast<float>(P->y);
-			Pt.pos[2] = static_cast<float>(P->z);
-			if (hasNorms)
-			{
-				const CCVector3& N = ccPC->getPointNormal(i);
-				Pt.normal[0] = static_cast<float>(N.x);
-				Pt.normal[1] = static_cast<float>(N.y);
-				Pt.normal[2] = static_cast<float>(N.z);
-			}
-#ifdef POINTSWITHINDEX
-			Pt.index = i;
-#endif
-			cloud.push_back(Pt);
-		}
+	QElapsedTimer phaseTimer;
+	phaseTimer.start();
 
-		//manually set bounding box!
-		Vec3f cbbMin, cbbMax;
-		cbbMin[0] = static_cast<float>(bbMin.x);
-		cbbMin[1] = static_cast<float>(bbMin.y);
-		cbbMin[2] = static_cast<float>(bbMin.z);
-		cbbMax[0] = static_cast<float>(bbMax.x);
-		cbbMax[1] = static_cast<float>(bbMax.y);
-		cbbMax[2] = static_cast<float>(bbMax.z);
-		cloud.setBBox(cbbMin, cbbMax);
+	//spatial tiling (the points are only copied tile by tile, during the detection)
+	std::vector<RansacTile> tiles;
+	std::vector<unsigned> leftOvers;
+	if (!BuildTiles(ccPC, params, tiles, leftOvers))
+	{
+		ccLog::Error("[qRansacSD] Not enough memory!");
+		return nullptr;
 	}
+	if (tiles.empty())
+	{
+		ccLog::Error("[qRansacSD] Not enough points (in each tile)!");
+		return nullptr;
+	}
+	const size_t tileCount = tiles.size();
 
-	RansacShapeDetector::Options ransacOptions;
+	RansacContext context;
+	context.cloud = ccPC;
+	context.params = &params;
 	{
-		ransacOptions.m_epsilon = params.epsilon;
-		ransacOptions.m_bitmapEpsilon = params.bitmapEpsilon;
-		ransacOptions.m_normalThresh = static_cast<float>(cos( CCCoreLib::DegreesToRadians( params.maxNormalDev_deg ) ));
-		assert(ransacOptions.m_normalThresh >= 0);
-		ransacOptions.m_probability = params.probability;
-		ransacOptions.m_minSupport = params.supportPoints;
-		ransacOptions.m_allowSimplification = params.allowSimplification;
-		ransacOptions.m_fitting = params.allowFitting ? RansacShapeDetector::Options::LS_FITTING : RansacShapeDetector::Options::NO_FITTING;
+		context.options.m_epsilon = params.epsilon;
+		context.options.m_bitmapEpsilon = params.bitmapEpsilon;
+		context.options.m_normalThresh = static_cast<float>(cos( CCCoreLib::DegreesToRadians( params.maxNormalDev_deg ) ));
+		assert(context.options.m_normalThresh >= 0);
+		context.options.m_probability = params.probability;
+		context.options.m_minSupport = params.supportPoints;
+		context.options.m_allowSimplification = params.allowSimplification;
+		context.options.m_fitting = params.allowFitting ? RansacShapeDetector::Options::LS_FITTING : RansacShapeDetector::Options::NO_FITTING;
 	}
-	const float scale = cloud.getScale();
 
 	if (!hasNorms)
 	{
-		ccProgressDialog* pDlg = nullptr;
-		if (!silent)
+		if (!ccPC->resizeTheNormsTable())
 		{
-			pDlg = new ccProgressDialog(false, s_app ? s_app->getMainWindow() : nullptr);
-			pDlg->setWindowTitle("Ransac Shape Detection");
-			pDlg->setMethodTitle(tr("Computing normals (please wait)"));
-			pDlg->setRange(0, 0); // infinite loop
-			pDlg->show();
+			ccLog::Error("[qRansacSD] Not enough memory to compute normals!");
+			return nullptr;
 		}
-		QApplication::processEvents();
 
-		cloud.calcNormals(.01f * scale);
-
-		if (ccPC->reserveTheNormsTable())
+		if (tileCount == 1 && leftOvers.empty())
 		{
-			for (unsigned i = 0; i < count; ++i)
-			{
-				Vec3f& Nvi = cloud[i].normal;
-				CCVector3 Ni = CCVector3::fromArray(Nvi);
-				//normalize the vector in case of
-				Ni.normalize();
-				ccPC->addNorm(Ni);
-			}
-			ccPC->showNormals(true);
-
-			//currently selected entities appearance may have changed!
-			ccPC->prepareDisplayForRefresh_recursive();
+			//the normals will be computed in the (single) tile, before the detection
+			context.computedNormals = ccPC->normals();
+			context.normalsRadius = .01f * scale;
 		}
 		else
 		{
-			ccLog::Error("[qRansacSD] Not enough memory to compute normals!");
-			if (pDlg)
+			//the points of the cells that are too small to be tiles must get a normal as well,
+			//and the normals must not depend on the tiles borders: we compute them beforehand
+			if (!ccNormalVectors::ComputeCloudNormals(ccPC, *ccPC->normals(), CCCoreLib::LS, .01f * scale))
 			{
-				pDlg->hide();
-				delete pDlg;
+				ccLog::Error("[qRansacSD] Failed to compute normals!");
+				ccPC->unallocateNorms();
+				return nullptr;
 			}
-			return nullptr;
-		}
-		if (pDlg)
-		{
-			pDlg->hide();
-			delete pDlg;
 		}
 	}
-
-	RansacShapeDetector detector(ransacOptions); // the detector object
-
-	if (params.primEnabled[RPT_PLANE])
-		detector.Add(new PlanePrimitiveShapeConstructor());
-	if (params.primEnabled[RPT_SPHERE])
-		detector.Add(new SpherePrimitiveShapeConstructor(params.minSphereRadius, params.maxSphereRadius));
-	if (params.primEnabled[RPT_CYLINDER])
-		detector.Add(new CylinderPrimitiveShapeConstructor(params.minCylinderRadius, params.maxCylinderRadius, params.maxCylinderLength));
-	if (params.primEnabled[RPT_CONE])
-		detector.Add(new ConePrimitiveShapeConstructor(params.maxConeRadius, CCCoreLib::DegreesToRadians(params.maxConeAngle_deg), params.maxConeLength));
-	if (params.primEnabled[RPT_TORUS])
-		detector.Add(new TorusPrimitiveShapeConstructor(false, params.minTorusMinorRadius, params.minTorusMajorRadius, params.maxTorusMinorRadius, params.maxTorusMajorRadius)); // Do not allow apple shaped torus
-
-
-	unsigned remaining = count;
-	typedef std::pair< MiscLib::RefCountPtr< PrimitiveShape >, size_t > DetectedShape;
-	MiscLib::Vector< DetectedShape > shapes; // stores the detected shapes
-
-	// run detection
-	// returns number of unassigned points
-	// the array shapes is filled with pointers to the detected shapes
-	// the second element per shapes gives the number of points assigned to that primitive (the support)
-	// the points belonging to the first shape (shapes[0]) have been sorted to the end of pc,
-	// i.e. into the range [ pc.size() - shapes[0].second, pc.size() )
-	// the points of shape i are found in the range
-	// [ pc.size() - \sum_{j=0..i} shapes[j].second, pc.size() - \sum_{j=0..i-1} shapes[j].second )
+	qint64 preparationTime_ms = phaseTimer.restart();
 
 	{
-		//progress dialog (Qtconcurrent::run can't be canceled!)
+		//progress dialog (the detection can't be canceled!)
 		ccProgressDialog* pDlg = nullptr;
 		if (!silent)
 		{
 			pDlg = new ccProgressDialog(false, s_app ? s_app->getMainWindow() : nullptr);
 			pDlg->setWindowTitle("Ransac Shape Detection");
-			pDlg->setMethodTitle(tr("Operation in progress (please wait)"));
-			pDlg->setRange(0, 0); // infinite progress
+			pDlg->setMethodTitle(context.computedNormals ? tr("Computing normals and detecting shapes (please wait)") : tr("Operation in progress (please wait)"));
+			if (tileCount > 1)
+			{
+				pDlg->setInfo(tr("Tiles: %1").arg(tileCount));
+				pDlg->setRange(0, static_cast<int>(tileCount));
+			}
+			else
+			{
+				pDlg->setRange(0, 0); // infinite progress
+			}
 			pDlg->show();
 		}
 
-		//run in a separate thread
-		s_detector = &detector;
-		s_shapes = &shapes;
-		s_cloud = &cloud;
-		QElapsedTimer eTimer;
-		eTimer.start();
-		QFuture<void> future = QtConcurrent::run(doDetection);
+		//run in separate threads (one tile per thread)
+		for (RansacTile& tile : tiles)
+		{
+			tile.context = &context;
+		}
+		QFuture<void> future = QtConcurrent::map(tiles, DetectShapesInTile);
 
 		while (!future.isFinished())
 		{
@@ -513,11 +845,10 @@ ccHObject* qRansacSD::executeRANSAC(ccPointCloud* ccPC, const RansacParams& para
 #endif
 			if (!silent && pDlg)
 			{
-				pDlg->setValue(pDlg->value() + 1);
+				pDlg->setValue(tileCount > 1 ? future.progressValue() : pDlg->value() + 1);
 			}
 			QApplication::processEvents();
 		}
-		remaining = static_cast<unsigned>(s_remainingPoints);
 
 		QApplication::processEvents();
 		if (pDlg)
@@ -525,131 +856,129 @@ ccHObject* qRansacSD::executeRANSAC(ccPointCloud* ccPC, const RansacParams& para
 			pDlg->hide();
 			delete pDlg;
 		}
-		qint64 elapsedTime_ms = eTimer.elapsed();
-
-		ccLog::Print("[qRANSAC] Search Timing: %2.3f s", static_cast<double>(elapsedTime_ms) / 1.0e3);
+	}
+	qint64 detectionTime_ms = phaseTimer.restart();
+
+	//gather the results of all tiles
+	std::vector<RansacShape> shapes;
+	qint64 buildTime_ms = 0;
+	qint64 normalsTime_ms = 0;
+	qint64 searchTime_ms = 0;
+	try
+	{
+		for (RansacTile& tile : tiles)
+		{
+			if (!tile.success)
+			{
+				throw std::bad_alloc();
+			}
+			std::move(tile.shapes.begin(), tile.shapes.end(), std::back_inserter(shapes));
+			leftOvers.insert(leftOvers.end(), tile.leftOvers.begin(), tile.leftOvers.end());
+			buildTime_ms += tile.buildTime_ms;
+			normalsTime_ms += tile.normalsTime_ms;
+			searchTime_ms += tile.searchTime_ms;
+		}
+		tiles.clear();
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Error("[qRansacSD] Not enough memory!");
+		if (!hasNorms)
+		{
+			ccPC->unallocateNorms();
+		}
+		return nullptr;
 	}
 
-#if 0 //def _DEBUG
-	FILE* fp = fopen("RANS_SD_trace.txt", "wt");
-
-	fprintf(fp, "[Options]\n");
-	fprintf(fp, "epsilon=%f\n", ransacOptions.m_epsilon);
-	fprintf(fp, "bitmap epsilon=%f\n", ransacOptions.m_bitmapEpsilon);
-	fprintf(fp, "normal thresh=%f\n", ransacOptions.m_normalThresh);
-	fprintf(fp, "min support=%i\n", ransacOptions.m_minSupport);
-	fprintf(fp, "probability=%f\n", ransacOptions.m_probability);
+	if (!hasNorms)
+	{
+		ccPC->normalsHaveChanged();
+		ccPC->showNormals(true);
 
-	fprintf(fp, "\n[Statistics]\n");
-	fprintf(fp, "input points=%i\n", count);
-	fprintf(fp, "segmented=%i\n", count - remaining);
-	fprintf(fp, "remaining=%i\n", remaining);
+		//currently selected entities appearance may have changed!
+		ccPC->prepareDisplayForRefresh_recursive();
+	}
 
-	if (shapes.size() > 0)
+	size_t detectedShapeCount = shapes.size();
+	if (tileCount > 1 && !shapes.empty())
 	{
-		fprintf(fp, "\n[Shapes]\n");
-		for (unsigned i = 0; i < shapes.size(); ++i)
+		//merge the parts of the shapes that overlap several tiles
+		try
 		{
-			PrimitiveShape* shape = shapes[i].first;
-			size_t shapePointsCount = shapes[i].second;
-
-			std::string desc;
-			shape->Description(&desc);
-			fprintf(fp, "#%i - %s - %i points\n", i + 1, desc.c_str(), shapePointsCount);
+			shapes = MergeShapes(shapes, context.options);
+		}
+		catch (const std::bad_alloc&)
+		{
+			ccLog::Error("[qRansacSD] Not enough memory to merge the shapes of the different tiles!");
+			if (!hasNorms)
+			{
+				ccPC->unallocateNorms();
+			}
+			return nullptr;
 		}
 	}
-	fclose(fp);
-#endif
+	qint64 mergeTime_ms = phaseTimer.restart();
 
+	ccLog::Print(QString("[qRANSAC] %1 shape(s) detected in %2 tile(s) (%3 after merging)").arg(detectedShapeCount).arg(tileCount).arg(shapes.size()));
 
-	if (remaining == count)
+	if (shapes.empty())
 	{
 		ccLog::Error("[qRansacSD] Segmentation failed...");
 		return nullptr;
 	}
 
-	if (shapes.size() > 0)
+	ccHObject* group = nullptr;
 	{
 		unsigned planeCount = 1;
 		unsigned sphereCount = 1;
 		unsigned cylinderCount = 1;
 		unsigned coneCount = 1;
 		unsigned torusCount = 1;
-		ccHObject* group = nullptr;
-		for (MiscLib::Vector<DetectedShape>::const_iterator it = shapes.begin(); it != shapes.end(); ++it)
+		for (std::vector<RansacShape>::const_iterator it = shapes.begin(); it != shapes.end(); ++it)
 		{
-			const PrimitiveShape* shape = it->first;
-			unsigned shapePointsCount = static_cast<unsigned>(it->second);
-
-			//too many points?!
-			if (shapePointsCount > count)
-			{
-				ccLog::Error("[qRansacSD] Inconsistent result!");
-				break;
-			}
+			const PrimitiveShape* shape = &*it->shape;
+			const std::vector<unsigned>& shapeIndexes = it->pointIndexes;
+			unsigned shapePointsCount = static_cast<unsigned>(shapeIndexes.size());
 
 			if (shapePointsCount < params.supportPoints)
 			{
 				ccLog::Warning("[qRansacSD] Skipping shape, did not meet minimum point requirement");
-				count -= shapePointsCount;
 				continue;
 			}
 
 			std::string desc;
 			shape->Description(&desc);
 
-			// points to current shapes last point in cloud
-			const auto shapeCloudIndex = count - 1;
-
 			//new cloud for sub-part
 			ccPointCloud* pcShape = nullptr;
 			bool saveNormals = true;
 			{
-#ifdef POINTSWITHINDEX
 				CCCoreLib::ReferenceCloud refPcShape(ccPC);
 				//we fill cloud with sub-part points
-				if (!refPcShape.reserve(static_cast<unsigned>(shapePointsCount)))
+				if (!refPcShape.reserve(shapePointsCount))
 				{
 					ccLog::Error("[qRansacSD] Not enough memory!");
 					break;
 				}
 
-				for (unsigned j = 0; j < shapePointsCount; ++j)
+				for (unsigned index : shapeIndexes)
 				{
-					refPcShape.addPointIndex(cloud[shapeCloudIndex - j].index);
+					refPcShape.addPointIndex(index);
 				}
 				int warnings = 0;
 				pcShape = ccPC->partialClone(&refPcShape, &warnings);
-				if (warnings != 0)
-				{
-					if ((warnings & ccPointCloud::WRN_OUT_OF_MEM_FOR_NORMALS) == ccPointCloud::WRN_OUT_OF_MEM_FOR_NORMALS)
-					{
-						saveNormals = false;
-					}
-				}
-
-#else
-				pcShape = new ccPointCloud(desc.c_str());
-				if (!pcShape->reserve(static_cast<unsigned>(shapePointsCount)))
+				if (!pcShape)
 				{
 					ccLog::Error("[qRansacSD] Not enough memory!");
-					delete pcShape;
 					break;
 				}
-				saveNormals = pcShape->reserveTheNormsTable();
-
-				for (unsigned j = 0; j < shapePointsCount; ++j)
+				if (warnings != 0)
 				{
-					pcShape->addPoint(CCVector3::fromArray(cloud[shapeCloudIndex - j].pos));
-					if (saveNormals)
+					if ((warnings & ccPointCloud::WRN_OUT_OF_MEM_FOR_NORMALS) == ccPointCloud::WRN_OUT_OF_MEM_FOR_NORMALS)
 					{
-						pcShape->addNorm(CCVector3::fromArray(cloud[shapeCloudIndex - j].normal));
+						saveNormals = false;
 					}
-
 				}
-				pcShape->setGlobalShift(globalShift);
-				pcShape->setGlobalScale(globalScale);
-#endif
 			}
 			//random color
 			ccColor::Rgb col = ccColor::Generator::Random();
@@ -680,7 +1009,7 @@ ccHObject* qRansacSD::executeRANSAC(ccPointCloud* ccPC, const RansacParams& para
 				for (unsigned j = 0; j < shapePointsCount; ++j)
 				{
 					std::pair<float, float> param;
-					plane->Parameters(cloud[shapeCloudIndex - j].pos, &param);
+					plane->Parameters(PointPosition(ccPC, shapeIndexes[j]), &param);
 					if (j != 0)
 					{
 						if (minX < param.first)
@@ -754,6 +1083,26 @@ ccHObject* qRansacSD::executeRANSAC(ccPointCloud* ccPC, const RansacParams& para
 				float r = cyl->Internal().Radius();
 				float hMin = cyl->MinHeight();
 				float hMax = cyl->MaxHeight();
+				if (it->merged)
+				{
+					//the height range must be computed on all the merged parts
+					for (unsigned j = 0; j < shapePointsCount; ++j)
+					{
+						float h = (PointPosition(ccPC, shapeIndexes[j]) - cyl->Internal().AxisPosition()).dot(N);
+						if (j == 0)
+						{
+							hMin = hMax = h;
+						}
+						else if (h < hMin)
+						{
+							hMin = h;
+						}
+						else if (h > hMax)
+						{
+							hMax = h;
+						}
+					}
+				}
 				float h = hMax - hMin;
 				G += N * (hMin + h / 2);
 
@@ -782,20 +1131,21 @@ ccHObject* qRansacSD::executeRANSAC(ccPointCloud* ccPC, const RansacParams& para
 				//compute max height
 				Vec3f minP, maxP;
 				float minHeight, maxHeight;
-				minP = maxP = cloud[shapeCloudIndex].pos;
-				minHeight = maxHeight = cone->Internal().Height(cloud[shapeCloudIndex].pos);
+				minP = maxP = PointPosition(ccPC, shapeIndexes[0]);
+				minHeight = maxHeight = cone->Internal().Height(minP);
 				for (size_t j = 1; j < shapePointsCount; ++j)
 				{
-					float h = cone->Internal().Height(cloud[shapeCloudIndex - j].pos);
+					Vec3f Pj = PointPosition(ccPC, shapeIndexes[j]);
+					float h = cone->Internal().Height(Pj);
 					if (h < minHeight)
 					{
 						minHeight = h;
-						minP = cloud[shapeCloudIndex - j].pos;
+						minP = Pj;
 					}
 					else if (h > maxHeight)
 					{
 						maxHeight = h;
-						maxP = cloud[shapeCloudIndex - j].pos;
+						maxP = Pj;
 					}
 
 				}
@@ -891,59 +1241,58 @@ ccHObject* qRansacSD::executeRANSAC(ccPointCloud* ccPC, const RansacParams& para
 			}
 
 
-			count -= shapePointsCount;
-
 			QApplication::processEvents();
 		}
+	}
 
-		if (group)
-		{
-			assert(group->getChildrenNumber() != 0);
+	if (group)
+	{
+		assert(group->getChildrenNumber() != 0);
 
-			//we hide input cloud
-			ccPC->setEnabled(false);
-			ccLog::Warning("[qRansacSD] Input cloud has been automtically hidden!");
+		//we hide input cloud
+		ccPC->setEnabled(false);
+		ccLog::Warning("[qRansacSD] Input cloud has been automtically hidden!");
 
 
-			group->setVisible(true);
-			group->setDisplay_recursive(ccPC->getDisplay());
-#ifdef POINTSWITHINDEX
-			if (params.createCloudFromLeftOverPoints)
+		group->setVisible(true);
+		group->setDisplay_recursive(ccPC->getDisplay());
+		if (params.createCloudFromLeftOverPoints && !leftOvers.empty())
+		{
+			//new cloud for left overs
+			ccPointCloud* pcLeftOvers = nullptr;
+			CCCoreLib::ReferenceCloud refPcLO(ccPC);
+			//we fill cloud with left over points
+			if (!refPcLO.reserve(static_cast<unsigned>(leftOvers.size())))
 			{
-				//new cloud for left overs
-				ccPointCloud* pcLeftOvers = nullptr;
-				CCCoreLib::ReferenceCloud refPcLO(ccPC);
-				//we fill cloud with left over points
-				if (!refPcLO.reserve(remaining))
-				{
-					ccLog::Error("[qRansacSD] Not enough memory!");
-				}
-
-				for (unsigned j = 0; j < remaining; ++j)
-				{
-					refPcLO.addPointIndex(cloud[j].index);
-				}
-				int warnings = 0;
-				pcLeftOvers = ccPC->partialClone(&refPcLO, &warnings);
-				bool saveNormals = true;
-				if (warnings != 0)
-				{
-					if ((warnings & ccPointCloud::WRN_OUT_OF_MEM_FOR_NORMALS) == ccPointCloud::WRN_OUT_OF_MEM_FOR_NORMALS)
-					{
-						saveNormals = false;
-					}
-				}
-				if (pcLeftOvers)
+				ccLog::Error("[qRansacSD] Not enough memory!");
+			}
+			else
+			{
+				for (unsigned index : leftOvers)
 				{
-					pcLeftOvers->setName("Leftovers");
-					group->addChild(pcLeftOvers);
+					refPcLO.addPointIndex(index);
 				}
+				pcLeftOvers = ccPC->partialClone(&refPcLO);
+			}
+			if (pcLeftOvers)
+			{
+				pcLeftOvers->setName("Leftovers");
+				group->addChild(pcLeftOvers);
 			}
-#endif
-
-			return group;
 		}
 	}
-
-	return nullptr;
+	qint64 exportTime_ms = phaseTimer.elapsed();
+
+	//timings
+	ccLog::Print(QString("[qRANSAC] Timings: preparation %1 s / detection %2 s / merging %3 s / export %4 s")
+		.arg(preparationTime_ms / 1.0e3, 0, 'f', 3)
+		.arg(detectionTime_ms / 1.0e3, 0, 'f', 3)
+		.arg(mergeTime_ms / 1.0e3, 0, 'f', 3)
+		.arg(exportTime_ms / 1.0e3, 0, 'f', 3));
+	ccLog::Print(QString("[qRANSAC] Detection details (cumulated over the tiles): cloud copy %1 s / normals %2 s / search %3 s")
+		.arg(buildTime_ms / 1.0e3, 0, 'f', 3)
+		.arg(normalsTime_ms / 1.0e3, 0, 'f', 3)
+		.arg(searchTime_ms / 1.0e3, 0, 'f', 3));
+
+	return group;
 }
@@ -182,6 +182,9 @@ protected:
 	//! Internal map structure
 	QSharedPointer<DistanceMapGenerationTool::Map> m_map;
 
+	//! Projected cloud (kept as long as the projection parameters don't change)
+	QSharedPointer<DistanceMapGenerationTool::ProjectedCloud> m_projectedCloud;
+
 	//! Current angular units
 	ANGULAR_UNIT m_angularUnits;
 
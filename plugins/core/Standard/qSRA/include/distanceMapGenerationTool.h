@@ -198,10 +198,59 @@ public:
 								FILL_INTERPOLATE		= 2,
 	};
 
+	//! Cylindrical or conical coordinates of the points of a cloud
+	/** They don't depend on the map steps and boundaries, so they can be kept to
+		regenerate the map at another resolution without projecting the cloud again.
+	**/
+	struct ProjectedCloud
+	{
+		//! Longitude of each point (radians, between 0 and 2*pi)
+		std::vector<float> lon_rad;
+		//! Height (cylindrical projection) or latitude (conical projection, radians) of each point
+		std::vector<float> y;
+
+		//projection parameters
+		const ccPointCloud* cloud = nullptr;
+		ccGLMatrix cloudToSurface;
+		unsigned char revolutionAxisDim = 2;
+		bool conical = false;
+		bool counterclockwise = false;
+
+		//! Returns whether the coordinates correspond to a given cloud (of the same size) and projection
+		bool isValidFor(const ccPointCloud* cloud,
+						const ccGLMatrix& cloudToSurface,
+						unsigned char revolutionAxisDim,
+						bool conical,
+						bool counterclockwise) const;
+	};
+
+	//! Computes the cylindrical or conical coordinates of the points of a cloud (see ProjectedCloud)
+	static QSharedPointer<ProjectedCloud> ProjectCloud(	ccPointCloud* cloud,
+														const ccGLMatrix& cloudToSurface, //e.g. translation to the revolution origin
+														unsigned char revolutionAxisDim,
+														bool conical,
+														bool counterclockwise,
+														ccMainAppInterface* app = nullptr);
+
+	//! Generates a 2D map from the projected points of a cloud (see ProjectCloud)
+	/** The points are accumulated in parallel (one partial map per block of points)
+		and the partial maps are then merged.
+	**/
+	static QSharedPointer<Map> CreateMap(	const ProjectedCloud& projectedCloud,
+											ccScalarField* sf,
+											double angStep_rad,
+											double yStep,
+											double yMin,
+											double yMax,
+											FillStrategyType fillStrategy,
+											EmptyCellFillOption emptyCellfillOption,
+											ccMainAppInterface* app = nullptr);
+
 	//! Projects a cloud (scalar field) on a revolution surface to generate a 2D map
 	/** Projection can be either cylindrical or spherical.
 		Warning: for cylindrical projection, the 2D map 'height' will be expressed
 		relatively to the 'revolutionOrigin' and not the cloud's (implicit) origin.
+		See ProjectCloud to avoid projecting the cloud each time the map is generated.
 	**/
 	static QSharedPointer<Map> CreateMap(	ccPointCloud* cloud,
 											ccScalarField* sf,
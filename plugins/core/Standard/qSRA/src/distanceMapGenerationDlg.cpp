@@ -106,6 +106,7 @@ DistanceMapGenerationDlg::DistanceMapGenerationDlg(ccPointCloud* cloud, ccScalar
 	, m_profile(polyline)
 	, m_sf(sf)
 	, m_map(nullptr)
+	, m_projectedCloud(nullptr)
 	, m_angularUnits(ANG_GRAD)
 	, m_window(nullptr)
 	, m_colorScaleSelector(nullptr)
@@ -1187,17 +1188,25 @@ QSharedPointer<DistanceMapGenerationTool::Map> DistanceMapGenerationDlg::updateM
 	double yStep = 0.0;
 	getGridYValues(yMin, yMax, yStep, ANG_RAD);
 
+	//project the cloud (only if the projection has changed)
+	bool conical = (getProjectionMode() == PROJ_CONICAL);
+	unsigned char revolDim = static_cast<unsigned char>(profileDesc.revolDim);
+	if (!m_projectedCloud || !m_projectedCloud->isValidFor(m_cloud, cloudToSurface, revolDim, conical, ccw))
+	{
+		m_projectedCloud = DistanceMapGenerationTool::ProjectCloud(m_cloud, cloudToSurface, revolDim, conical, ccw, m_app);
+		if (!m_projectedCloud)
+		{
+			return QSharedPointer<DistanceMapGenerationTool::Map>(nullptr);
+		}
+	}
+
 	//generate map
-	return DistanceMapGenerationTool::CreateMap(m_cloud,
+	return DistanceMapGenerationTool::CreateMap(*m_projectedCloud,
 		m_sf,
-		cloudToSurface,
-		profileDesc.revolDim,
 		angStep_rad,
 		yStep,
 		yMin,
 		yMax,
-		getProjectionMode() == PROJ_CONICAL,
-		ccw,
 		getFillingStrategy(),
 		getEmptyCellFillingOption(),
 		m_app);
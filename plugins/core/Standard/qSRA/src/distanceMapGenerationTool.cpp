@@ -19,6 +19,7 @@
 
 //qCC
 #include <ccMainAppInterface.h>
+#include <ccQtHelpers.h>
 
 //qCC_db
 #include <ccPointCloud.h>
@@ -32,9 +33,16 @@
 #include <Delaunay2dMesh.h>
 
 //Qt
+#include <QApplication>
 #include <QFile>
 #include <QTextStream>
 #include <QMainWindow>
+#include <QThread>
+#include <QtConcurrentMap>
+
+//system
+#include <algorithm>
+#include <functional>
 
 //Meta-data key for profile (polyline) origin
 const char PROFILE_ORIGIN_KEY[] = "ProfileOrigin";
@@ -62,6 +70,170 @@ static inline double ComputeLatitude_rad(	PointCoordinateType x,
 	return atan(z / sqrt(static_cast<double>(r)));
 }
 
+//! Default number of points per chunk (see ProcessInParallel)
+static const unsigned s_defaultChunkSize = (1 << 16);
+
+//! Chunk of elements (see ProcessInParallel)
+struct ProcessChunk
+{
+	unsigned first = 0;
+	unsigned last = 0; //excluded
+	const std::function<void(unsigned, unsigned)>* process = nullptr;
+};
+
+static void RunProcessChunk(ProcessChunk& chunk)
+{
+	(*chunk.process)(chunk.first, chunk.last);
+}
+
+//! Processes a set of elements by chunks, in parallel
+/** \param count number of elements
+	\param chunkSize number of elements per chunk
+	\param process process (applied on the elements [first ; last[)
+	\param progressCb progress callback (optional, the process can be canceled if set)
+	\return false if the process has been canceled (some chunks may not have been processed)
+**/
+static bool ProcessInParallel(	unsigned count,
+								unsigned chunkSize,
+								const std::function<void(unsigned first, unsigned last)>& process,
+								CCCoreLib::GenericProgressCallback* progressCb = nullptr)
+{
+	assert(chunkSize != 0);
+	std::vector<ProcessChunk> chunks((count + chunkSize - 1) / chunkSize);
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		chunks[i].first = static_cast<unsigned>(i * chunkSize);
+		chunks[i].last = std::min(count, chunks[i].first + chunkSize);
+		chunks[i].process = &process;
+	}
+
+	if (chunks.size() < 2)
+	{
+		for (ProcessChunk& chunk : chunks)
+		{
+			RunProcessChunk(chunk);
+		}
+		return true;
+	}
+
+	QFuture<void> future = QtConcurrent::map(chunks, RunProcessChunk);
+	if (progressCb)
+	{
+		while (!future.isFinished())
+		{
+			QThread::msleep(50);
+			progressCb->update(100.0f * future.progressValue() / chunks.size());
+			if (progressCb->isCancelRequested())
+			{
+				//the remaining chunks won't be processed
+				future.cancel();
+			}
+			QApplication::processEvents();
+		}
+	}
+	future.waitForFinished();
+
+	return !future.isCanceled();
+}
+
+//! Converts a (relative) position to cylindrical or conical coordinates
+static inline void ToMapCoordinates(const CCVector3& relativePos,
+									unsigned char X,
+									unsigned char Y,
+									unsigned char Z,
+									double ccw,
+									bool conical,
+									double& x,
+									double& y)
+{
+	//convert to cylindrical or conical (spherical) coordinates
+	x = ccw * atan2(relativePos.u[X], relativePos.u[Y]); //longitude
+	if (x < 0.0)
+	{
+		x += 2 * M_PI;
+	}
+
+	if (conical)
+	{
+		y = ComputeLatitude_rad(relativePos.u[X], relativePos.u[Y], relativePos.u[Z]); //latitude between 0 and pi/2
+	}
+	else
+	{
+		y = relativePos.u[Z]; //height
+	}
+}
+
+//! Adds a value to a map cell
+static inline void AddValueToCell(	DistanceMapGenerationTool::MapCell& cell,
+									ScalarType val,
+									DistanceMapGenerationTool::FillStrategyType fillStrategy)
+{
+	if (cell.count) //if there's already values projected in this cell
+	{
+		switch (fillStrategy)
+		{
+		case DistanceMapGenerationTool::FILL_STRAT_MIN_DIST:
+			// Set the minimum SF value
+			if (val < cell.value)
+				cell.value = val;
+			break;
+		case DistanceMapGenerationTool::FILL_STRAT_AVG_DIST:
+			// Sum the values
+			cell.value += static_cast<double>(val);
+			break;
+		case DistanceMapGenerationTool::FILL_STRAT_MAX_DIST:
+			// Set the maximum SF value
+			if (val > cell.value)
+				cell.value = val;
+			break;
+		default:
+			assert(false);
+			break;
+		}
+	}
+	else
+	{
+		//for the first point, we simply have to store its associated value (whatever the case)
+		cell.value = val;
+	}
+	++cell.count;
+}
+
+//! Merges two map cells (before the average values computation)
+static inline void MergeCells(	DistanceMapGenerationTool::MapCell& cell,
+								const DistanceMapGenerationTool::MapCell& otherCell,
+								DistanceMapGenerationTool::FillStrategyType fillStrategy)
+{
+	if (otherCell.count == 0)
+	{
+		return;
+	}
+
+	if (cell.count)
+	{
+		switch (fillStrategy)
+		{
+		case DistanceMapGenerationTool::FILL_STRAT_MIN_DIST:
+			cell.value = std::min(cell.value, otherCell.value);
+			break;
+		case DistanceMapGenerationTool::FILL_STRAT_AVG_DIST:
+			cell.value += otherCell.value;
+			break;
+		case DistanceMapGenerationTool::FILL_STRAT_MAX_DIST:
+			cell.value = std::max(cell.value, otherCell.value);
+			break;
+		default:
+			assert(false);
+			break;
+		}
+	}
+	else
+	{
+		cell.value = otherCell.value;
+	}
+	cell.count += otherCell.count;
+}
+
 //helper
 static bool GetPolylineMetaVector(const ccPolyline* polyline, const QString& key, CCVector3& P)
 {
@@ -318,63 +490,61 @@ bool DistanceMapGenerationTool::ComputeRadialDist(	ccPointCloud* cloud,
 		dlg.setMethodTitle(QObject::tr("Cloud to profile radial distance"));
 		dlg.setInfo(QObject::tr("Polyline: %1 vertices\nCloud: %2 points").arg(vertexCount).arg(pointCount));
 		dlg.start();
-		CCCoreLib::NormalizedProgress nProgress(static_cast<CCCoreLib::GenericProgressCallback*>(&dlg), pointCount);
 
-		for (unsigned i = 0; i < pointCount; ++i)
-		{
-			const CCVector3* P = cloud->getPoint(i);
+		//the points that won't be processed (if the process is canceled) will have an invalid distance
+		sf->fill(CCCoreLib::NAN_VALUE);
 
-			//relative point position
-			CCVector3 Prel = cloudToProfile * (*P);
+		std::function<void(unsigned, unsigned)> computeRadialDist = [&](unsigned first, unsigned last)
+		{
+			for (unsigned i = first; i < last; ++i)
+			{
+				const CCVector3* P = cloud->getPoint(i);
 
-			//deduce point height and radius (i.e. in profile 2D coordinate system)
-			double height = Prel.u[profileDesc.revolDim];
-			//TODO FIXME: we assume the surface of revolution is smooth!
-			double radius = sqrt(Prel.u[dim1] * Prel.u[dim1] + Prel.u[dim2] * Prel.u[dim2]);
+				//relative point position
+				CCVector3 Prel = cloudToProfile * (*P);
 
-			if (radiiSf)
-			{
-				ScalarType radiusVal = static_cast<ScalarType>(radius);
-				radiiSf->setValue(i, radiusVal);
-			}
+				//deduce point height and radius (i.e. in profile 2D coordinate system)
+				double height = Prel.u[profileDesc.revolDim];
+				//TODO FIXME: we assume the surface of revolution is smooth!
+				double radius = sqrt(Prel.u[dim1] * Prel.u[dim1] + Prel.u[dim2] * Prel.u[dim2]);
 
-			//search nearest "segment" in polyline
-			ScalarType minDist = CCCoreLib::NAN_VALUE;
-			for (unsigned j = 1; j < vertexCount; ++j)
-			{
-				const CCVector3* A = vertices->getPoint(j - 1);
-				const CCVector3* B = vertices->getPoint(j);
+				if (radiiSf)
+				{
+					ScalarType radiusVal = static_cast<ScalarType>(radius);
+					radiiSf->setValue(i, radiusVal);
+				}
 
-				double alpha = (height - A->y) / (B->y - A->y);
-				if (alpha >= 0.0 && alpha <= 1.0)
+				//search nearest "segment" in polyline
+				ScalarType minDist = CCCoreLib::NAN_VALUE;
+				for (unsigned j = 1; j < vertexCount; ++j)
 				{
-					//we deduce the right radius by linear interpolation
-					double radius_th = A->x + alpha * (B->x - A->x);
-					double dist = radius - radius_th;
+					const CCVector3* A = vertices->getPoint(j - 1);
+					const CCVector3* B = vertices->getPoint(j);
 
-					//we look at the closest segment (if the polyline is concave!)
-					if (	!CCCoreLib::ScalarField::ValidValue(minDist)
-						||	(dist * dist) < (static_cast<double>(minDist) * minDist) )
+					double alpha = (height - A->y) / (B->y - A->y);
+					if (alpha >= 0.0 && alpha <= 1.0)
 					{
-						minDist = static_cast<ScalarType>(dist);
+						//we deduce the right radius by linear interpolation
+						double radius_th = A->x + alpha * (B->x - A->x);
+						double dist = radius - radius_th;
+
+						//we look at the closest segment (if the polyline is concave!)
+						if (	!CCCoreLib::ScalarField::ValidValue(minDist)
+							||	(dist * dist) < (static_cast<double>(minDist) * minDist) )
+						{
+							minDist = static_cast<ScalarType>(dist);
+						}
 					}
 				}
-			}
-
-			sf->setValue(i, minDist);
-
-			if (!nProgress.oneStep())
-			{
-				//cancelled by user
-				for (unsigned j = i; j < pointCount; ++j)
-					sf->setValue(j, CCCoreLib::NAN_VALUE);
 
-				success = false;
-				break;
+				sf->setValue(i, minDist);
 			}
+		};
 
-			//TEST
-			//*const_cast<CCVector3*>(P) = Prel;
+		if (!ProcessInParallel(pointCount, s_defaultChunkSize, computeRadialDist, &dlg))
+		{
+			//cancelled by user
+			success = false;
 		}
 
 		//TEST
@@ -459,6 +629,91 @@ double DistanceMapGenerationTool::ConicalProject(double phi, double phi1, double
 	return cos(phi1) * pow(tan_pl / tan_pl1, n) / n;
 }
 
+bool DistanceMapGenerationTool::ProjectedCloud::isValidFor(	const ccPointCloud* _cloud,
+																const ccGLMatrix& _cloudToSurface,
+																unsigned char _revolutionAxisDim,
+																bool _conical,
+																bool _counterclockwise) const
+{
+	if (	!_cloud
+		||	_cloud != cloud
+		||	_cloud->size() != lon_rad.size()
+		||	_revolutionAxisDim != revolutionAxisDim
+		||	_conical != conical
+		||	_counterclockwise != counterclockwise)
+	{
+		return false;
+	}
+
+	return std::equal(cloudToSurface.data(), cloudToSurface.data() + OPENGL_MATRIX_SIZE, _cloudToSurface.data());
+}
+
+QSharedPointer<DistanceMapGenerationTool::ProjectedCloud> DistanceMapGenerationTool::ProjectCloud(	ccPointCloud* cloud,
+																									const ccGLMatrix& cloudToSurface,
+																									unsigned char revolutionAxisDim,
+																									bool conical,
+																									bool counterclockwise,
+																									ccMainAppInterface* app/*=nullptr*/)
+{
+	assert(cloud);
+	if (!cloud || revolutionAxisDim > 2)
+	{
+		if (app)
+			app->dispToConsole(QString("[DistanceMapGenerationTool] Internal error: invalid input parameters!"), ccMainAppInterface::ERR_CONSOLE_MESSAGE);
+		return QSharedPointer<ProjectedCloud>(nullptr);
+	}
+
+	unsigned count = cloud->size();
+
+	QSharedPointer<ProjectedCloud> projectedCloud(new ProjectedCloud);
+	try
+	{
+		projectedCloud->lon_rad.resize(count);
+		projectedCloud->y.resize(count);
+	}
+	catch (const std::bad_alloc&)
+	{
+		if (app)
+			app->dispToConsole(QString("[DistanceMapGenerationTool] Not enough memory!"), ccMainAppInterface::ERR_CONSOLE_MESSAGE);
+		return QSharedPointer<ProjectedCloud>(nullptr);
+	}
+	projectedCloud->cloud = cloud;
+	projectedCloud->cloudToSurface = cloudToSurface;
+	projectedCloud->revolutionAxisDim = revolutionAxisDim;
+	projectedCloud->conical = conical;
+	projectedCloud->counterclockwise = counterclockwise;
+
+	//revolution axis
+	const unsigned char Z = revolutionAxisDim;
+	//we deduce the 2 other ('horizontal') dimensions from the revolution axis
+	const unsigned char X = (Z < 2 ? Z + 1 : 0);
+	const unsigned char Y = (X < 2 ? X + 1 : 0);
+
+	//motion direction
+	double ccw = (counterclockwise ? -1.0 : 1.0);
+
+	ProjectedCloud* output = projectedCloud.data();
+	std::function<void(unsigned, unsigned)> projectPoints = [&](unsigned first, unsigned last)
+	{
+		for (unsigned n = first; n < last; ++n)
+		{
+			const CCVector3* P = cloud->getPoint(n);
+			CCVector3 relativePos = cloudToSurface * (*P);
+
+			double x = 0.0;
+			double y = 0.0;
+			ToMapCoordinates(relativePos, X, Y, Z, ccw, conical, x, y);
+
+			output->lon_rad[n] = static_cast<float>(x);
+			output->y[n] = static_cast<float>(y);
+		}
+	};
+
+	ProcessInParallel(count, s_defaultChunkSize, projectPoints);
+
+	return projectedCloud;
+}
+
 QSharedPointer<DistanceMapGenerationTool::Map> DistanceMapGenerationTool::CreateMap(ccPointCloud* cloud,
 																					ccScalarField* sf,
 																					const ccGLMatrix& cloudToSurface,
@@ -481,27 +736,54 @@ QSharedPointer<DistanceMapGenerationTool::Map> DistanceMapGenerationTool::Create
 		return QSharedPointer<Map>(nullptr);
 	}
 
+	QSharedPointer<ProjectedCloud> projectedCloud = ProjectCloud(cloud, cloudToSurface, revolutionAxisDim, conical, counterclockwise, app);
+	if (!projectedCloud)
+	{
+		return QSharedPointer<Map>(nullptr);
+	}
+
+	return CreateMap(*projectedCloud, sf, xStep_rad, yStep, yMin, yMax, fillStrategy, emptyCellfillOption, app);
+}
+
+QSharedPointer<DistanceMapGenerationTool::Map> DistanceMapGenerationTool::CreateMap(const ProjectedCloud& projectedCloud,
+																					ccScalarField* sf,
+																					double xStep_rad,
+																					double yStep,
+																					double yMin,
+																					double yMax,
+																					FillStrategyType fillStrategy,
+																					EmptyCellFillOption emptyCellfillOption,
+																					ccMainAppInterface* app/*=nullptr*/)
+{
+	assert(sf);
+	if (!sf)
+	{
+		if (app)
+			app->dispToConsole(QString("[DistanceMapGenerationTool] Internal error: invalid input structures!"), ccMainAppInterface::ERR_CONSOLE_MESSAGE);
+		return QSharedPointer<Map>(nullptr);
+	}
+
 	//invalid parameters?
-	if (xStep_rad <= 0.0 || yStep <= 0.0 || yMax <= yMin || revolutionAxisDim > 2)
+	if (xStep_rad <= 0.0 || yStep <= 0.0 || yMax <= yMin)
 	{
 		if (app)
 			app->dispToConsole(QString("[DistanceMapGenerationTool] Internal error: invalid grid parameters!"), ccMainAppInterface::ERR_CONSOLE_MESSAGE);
 		return QSharedPointer<Map>(nullptr);
 	}
 
-	unsigned count = cloud->size();
+	unsigned count = static_cast<unsigned>(projectedCloud.lon_rad.size());
 	if (count == 0)
 	{
 		if (app)
 			app->dispToConsole(QString("[DistanceMapGenerationTool] Cloud is empty! Nothing to do!"), ccMainAppInterface::ERR_CONSOLE_MESSAGE);
 		return QSharedPointer<Map>(nullptr);
 	}
-
-	//revolution axis
-	const unsigned char Z = revolutionAxisDim;
-	//we deduce the 2 other ('horizontal') dimensions from the revolution axis
-	const unsigned char X = (Z < 2 ? Z + 1 : 0);
-	const unsigned char Y = (X < 2 ? X + 1 : 0);
+	if (sf->size() != count)
+	{
+		if (app)
+			app->dispToConsole(QString("[DistanceMapGenerationTool] Internal error: scalar field and projected cloud sizes mismatch!"), ccMainAppInterface::ERR_CONSOLE_MESSAGE);
+		return QSharedPointer<Map>(nullptr);
+	}
 
 	//grid dimensions
 	unsigned xSteps = 0;
@@ -554,89 +836,85 @@ QSharedPointer<DistanceMapGenerationTool::Map> DistanceMapGenerationTool::Create
 	grid->yMin = yMin;
 	grid->yMax = yMax;
 	grid->yStep = yStep;
-	grid->conical = conical;
+	grid->conical = projectedCloud.conical;
 
 	//motion direction
-	grid->counterclockwise = counterclockwise;
-	double ccw = (counterclockwise ? -1.0 : 1.0);
+	grid->counterclockwise = projectedCloud.counterclockwise;
 
-	for (unsigned n = 0; n < count; ++n)
+	//the points are split in blocks, each block being projected in its own (partial) map
+	std::vector<Map> partialMaps;
+	unsigned blockCount = std::max(1u, std::min(static_cast<unsigned>(ccQtHelpers::GetMaxThreadCount()), count / s_defaultChunkSize));
+	try
 	{
-		//we skip invalid values
-		const ScalarType& val = sf->getValue(n);
-		if (!CCCoreLib::ScalarField::ValidValue(val))
-			continue;
-
-		const CCVector3* P = cloud->getPoint(n);
-		CCVector3 relativePos = cloudToSurface * (*P);
-
-		//convert to cylindrical or conical (spherical) coordinates
-		double x = ccw * atan2(relativePos.u[X], relativePos.u[Y]); //longitude
-		if (x < 0.0)
+		partialMaps.resize(blockCount - 1);
+		for (Map& partialMap : partialMaps)
 		{
-			x += 2 * M_PI;
+			partialMap.resize(cellCount);
 		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory for the partial maps: we'll use only one block
+		partialMaps.clear();
+		blockCount = 1;
+	}
+	unsigned blockSize = (count + blockCount - 1) / blockCount;
 
-		double y = 0.0;
-		if (conical)
-		{
-			y = ComputeLatitude_rad(relativePos.u[X], relativePos.u[Y], relativePos.u[Z]); //latitude between 0 and pi/2
-		}
-		else
+	const Map* theGrid = grid.data();
+	std::function<void(unsigned, unsigned)> projectBlock = [&](unsigned first, unsigned last)
+	{
+		unsigned blockIndex = first / blockSize;
+		Map& map = (blockIndex == 0 ? *grid : partialMaps[blockIndex - 1]);
+
+		for (unsigned n = first; n < last; ++n)
 		{
-			y = relativePos.u[Z]; //height
-		}
+			//we skip invalid values
+			const ScalarType& val = sf->getValue(n);
+			if (!CCCoreLib::ScalarField::ValidValue(val))
+				continue;
 
-		int i = static_cast<int>((x - grid->xMin) / grid->xStep);
-		int j = static_cast<int>((y - grid->yMin) / grid->yStep);
+			double x = projectedCloud.lon_rad[n];
+			double y = projectedCloud.y[n];
 
-		//if we fall exactly on the max corner of the grid box
-		if (i == static_cast<int>(grid->xSteps))
-			--i;
-		if (j == static_cast<int>(grid->ySteps))
-			--j;
+			int i = static_cast<int>((x - theGrid->xMin) / theGrid->xStep);
+			int j = static_cast<int>((y - theGrid->yMin) / theGrid->yStep);
 
-		//we skip points outside the box!
-		if (	i < 0 || i >= static_cast<int>(grid->xSteps)
-			||	j < 0 || j >= static_cast<int>(grid->ySteps) )
-		{
-			continue;
-		}
-		assert(i >= 0 && j >= 0);
+			//if we fall exactly on the max corner of the grid box
+			if (i == static_cast<int>(theGrid->xSteps))
+				--i;
+			if (j == static_cast<int>(theGrid->ySteps))
+				--j;
 
-		MapCell& cell = (*grid)[j*static_cast<int>(grid->xSteps) + i];
-		if (cell.count) //if there's already values projected in this cell
-		{
-			switch (fillStrategy)
+			//we skip points outside the box!
+			if (	i < 0 || i >= static_cast<int>(theGrid->xSteps)
+				||	j < 0 || j >= static_cast<int>(theGrid->ySteps) )
 			{
-			case FILL_STRAT_MIN_DIST:
-				// Set the minimum SF value
-				if (val < cell.value)
-					cell.value = val;
-				break;
-			case FILL_STRAT_AVG_DIST:
-				// Sum the values
-				cell.value += static_cast<double>(val);
-				break;
-			case FILL_STRAT_MAX_DIST:
-				// Set the maximum SF value
-				if (val > cell.value)
-					cell.value = val;
-				break;
-			default:
-				assert(false);
-				break;
+				continue;
 			}
+			assert(i >= 0 && j >= 0);
+
+			AddValueToCell(map[j*static_cast<int>(theGrid->xSteps) + i], val, fillStrategy);
 		}
-		else
+	};
+
+	ProcessInParallel(count, blockSize, projectBlock);
+
+	//merge the partial maps (always in the same order)
+	if (!partialMaps.empty())
+	{
+		std::function<void(unsigned, unsigned)> mergeCells = [&](unsigned first, unsigned last)
 		{
-			//for the first point, we simply have to store its associated value (whatever the case)
-			cell.value = val;
-		}
-		++cell.count;
+			for (const Map& partialMap : partialMaps)
+			{
+				for (unsigned i = first; i < last; ++i)
+				{
+					MergeCells((*grid)[i], partialMap[i], fillStrategy);
+				}
+			}
+		};
 
-		//if (progressCb)
-		//	progressCb->update(30.0 * (float)n / (float)cloud->size());
+		ProcessInParallel(cellCount, s_defaultChunkSize, mergeCells);
+		partialMaps.clear();
 	}
 
 	//we need to finish the average values computation
@@ -1165,24 +1443,29 @@ bool DistanceMapGenerationTool::ConvertCloudToCylindrical(	ccPointCloud* cloud,
 	PointCoordinateType ccw = (counterclockwise ? -CCCoreLib::PC_ONE : CCCoreLib::PC_ONE);
 
 	//get projection height
-	for (unsigned n = 0; n < cloud->size(); ++n)
+	std::function<void(unsigned, unsigned)> convertPoints = [&](unsigned first, unsigned last)
 	{
-		CCVector3* P = const_cast<CCVector3*>(cloud->getPoint(n));
-		CCVector3 relativePos = cloudToSurface * (*P);
-
-		//convert to cylindrical coordinates
-		double lon_rad = ccw * atan2(relativePos.u[X], relativePos.u[Y]); //longitude
-		if (lon_rad < 0.0)
+		for (unsigned n = first; n < last; ++n)
 		{
-			lon_rad += 2 * M_PI;
+			CCVector3* P = const_cast<CCVector3*>(cloud->getPoint(n));
+			CCVector3 relativePos = cloudToSurface * (*P);
+
+			//convert to cylindrical coordinates
+			double lon_rad = ccw * atan2(relativePos.u[X], relativePos.u[Y]); //longitude
+			if (lon_rad < 0.0)
+			{
+				lon_rad += 2 * M_PI;
+			}
+
+			PointCoordinateType height = relativePos.u[Z];
+
+			P->x = static_cast<PointCoordinateType>(lon_rad);
+			P->y = height;
+			P->z = 0;
 		}
-		
-		PointCoordinateType height = relativePos.u[Z];
+	};
 
-		P->x = static_cast<PointCoordinateType>(lon_rad);
-		P->y = height;
-		P->z = 0;
-	}
+	ProcessInParallel(cloud->size(), s_defaultChunkSize, convertPoints);
 
 	cloud->refreshBB();
 	if (cloud->getOctree())
@@ -1218,22 +1501,27 @@ bool DistanceMapGenerationTool::ConvertCloudToConical(	ccPointCloud* cloud,
 	double nProj = ConicalProjectN(latMin_rad, latMax_rad) * conicalSpanRatio;
 
 	//get projection height
-	for (unsigned n = 0; n < cloud->size(); ++n)
+	std::function<void(unsigned, unsigned)> convertPoints = [&](unsigned first, unsigned last)
 	{
-		CCVector3* P = const_cast<CCVector3*>(cloud->getPoint(n));
-		CCVector3 relativePos = cloudToSurface * (*P);
+		for (unsigned n = first; n < last; ++n)
+		{
+			CCVector3* P = const_cast<CCVector3*>(cloud->getPoint(n));
+			CCVector3 relativePos = cloudToSurface * (*P);
 
-		//convert to cylindrical coordinates
-		PointCoordinateType ang_rad = ccw * atan2(relativePos.u[X], relativePos.u[Y]);
-		if (ang_rad < 0.0)
-			ang_rad += static_cast<PointCoordinateType>(2 * M_PI);
+			//convert to cylindrical coordinates
+			PointCoordinateType ang_rad = ccw * atan2(relativePos.u[X], relativePos.u[Y]);
+			if (ang_rad < 0.0)
+				ang_rad += static_cast<PointCoordinateType>(2 * M_PI);
 
-		double lat_rad = ComputeLatitude_rad(	relativePos.u[X],
-												relativePos.u[Y],
-												relativePos.u[Z] ); //between 0 and pi/2
+			double lat_rad = ComputeLatitude_rad(	relativePos.u[X],
+													relativePos.u[Y],
+													relativePos.u[Z] ); //between 0 and pi/2
 
-		*P = ProjectPointOnCone(ang_rad, lat_rad, latMin_rad, nProj, counterclockwise);
-	}
+			*P = ProjectPointOnCone(ang_rad, lat_rad, latMin_rad, nProj, counterclockwise);
+		}
+	};
+
+	ProcessInParallel(cloud->size(), s_defaultChunkSize, convertPoints);
 
 	cloud->refreshBB();
 	if (cloud->getOctree())
@@ -1617,34 +1905,42 @@ QImage DistanceMapGenerationTool::ConvertMapToImage(const QSharedPointer<Map>& m
 		return QImage();
 	}
 
-	//convert map cells to pixels
+	//convert map cells to pixels (the rows are processed in parallel)
 	{
 		bool csIsRelative = colorScale->isRelative();
 
-		const MapCell* cell = &map->at(0);
-		for (unsigned j = 0; j < map->ySteps; ++j)
+		//we write the pixels directly (QImage::setPixel is quite slow!)
+		uchar* bits = image.bits();
+		int bytesPerLine = image.bytesPerLine();
+
+		std::function<void(unsigned, unsigned)> convertRows = [&](unsigned firstRow, unsigned lastRow)
 		{
-			//for each column
-			for (unsigned i = 0; i < map->xSteps; ++i, ++cell)
+			for (unsigned j = firstRow; j < lastRow; ++j)
 			{
-				const ccColor::Rgb* rgb = &ccColor::lightGreyRGB;
+				const MapCell* cell = &map->at(j * map->xSteps);
+				QRgb* pixels = reinterpret_cast<QRgb*>(bits + static_cast<size_t>(j) * bytesPerLine);
 
-				if (cell->count != 0)
+				//for each column
+				for (unsigned i = 0; i < map->xSteps; ++i, ++cell)
 				{
-					double relativePos = csIsRelative ? (cell->value - map->minVal) / (map->maxVal - map->minVal) : colorScale->getRelativePosition(cell->value);
-					if (relativePos < 0.0)
-						relativePos = 0.0;
-					else if (relativePos > 1.0)
-						relativePos = 1.0;
-					rgb = colorScale->getColorByRelativePos(relativePos, colorScaleSteps, &ccColor::lightGreyRGB);
-				}
+					const ccColor::Rgb* rgb = &ccColor::lightGreyRGB;
 
-				//DGM FIXME: QImage::sePixel is quite slow!
-				image.setPixel(	static_cast<int>(i),
-								static_cast<int>(j),
-								qRgb(rgb->r, rgb->g, rgb->b));
+					if (cell->count != 0)
+					{
+						double relativePos = csIsRelative ? (cell->value - map->minVal) / (map->maxVal - map->minVal) : colorScale->getRelativePosition(cell->value);
+						if (relativePos < 0.0)
+							relativePos = 0.0;
+						else if (relativePos > 1.0)
+							relativePos = 1.0;
+						rgb = colorScale->getColorByRelativePos(relativePos, colorScaleSteps, &ccColor::lightGreyRGB);
+					}
+
+					pixels[i] = qRgb(rgb->r, rgb->g, rgb->b);
+				}
 			}
-		}
+		};
+
+		ProcessInParallel(map->ySteps, std::max(1u, s_defaultChunkSize / std::max(1u, map->xSteps)), convertRows);
 	}
 
 	return image;
@@ -31,6 +31,8 @@ ccAskTwoDoubleValuesDlg::ccAskTwoDoubleValuesDlg(	const QString& vName1,
 {
 	setupUi(this);
 
+	checkBox->setVisible(false);
+
 	label1->setText(vName1);
 	label2->setText(vName2);
 	doubleSpinBox1->setDecimals(precision);
@@ -45,3 +47,17 @@ ccAskTwoDoubleValuesDlg::ccAskTwoDoubleValuesDlg(	const QString& vName1,
 		setWindowTitle(windowTitle);
 	}
 }
+
+void ccAskTwoDoubleValuesDlg::showCheckbox(const QString& label, bool state, QString tooltip/*=QString()*/)
+{
+	checkBox->setVisible(true);
+	checkBox->setEnabled(true);
+	checkBox->setChecked(state);
+	checkBox->setText(label);
+	checkBox->setToolTip(tooltip);
+}
+
+bool ccAskTwoDoubleValuesDlg::getCheckboxState() const
+{
+	return checkBox->isChecked();
+}
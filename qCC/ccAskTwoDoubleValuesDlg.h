@@ -36,6 +36,12 @@ public:
 							int precision = 6,
 							QString windowTitle = QString(),
 							QWidget* parent = nullptr);
+
+	//! Enable the checkbox (bottom-left)
+	void showCheckbox(const QString& label, bool state, QString tooltip = QString());
+
+	//! Returns the checkbox state
+	bool getCheckboxState() const;
 };
 
 #endif //CC_ASK_TWO_DOUBLE_VALUES_DIALOG_HEADER
@@ -28,14 +28,22 @@
 
 #include "db_tree/ccDBRoot.h"
 
+//CCPluginAPI
+#include <ccQtHelpers.h>
+
 //qCC_db
 #include <ccClipBox.h>
 #include <ccPointCloud.h>
 #include <ccProgressDialog.h>
 #include <ccRasterGrid.h>
+#include <ccVisibilitySelection.h>
 
 //Qt
 #include <QMessageBox>
+#include <QtConcurrentMap>
+
+//System
+#include <numeric>
 
 namespace
 {
@@ -414,12 +422,8 @@ ccHObject* GetSlice(ccHObject* obj, ccClipBox* clipBox, bool silent)
 	{
 		ccGenericPointCloud* inputCloud = ccHObjectCaster::ToGenericPointCloud(obj);
 
-		ccGenericPointCloud::VisibilityTableType selectionTable;
-		try
-		{
-			selectionTable.resize(inputCloud->size());
-		}
-		catch (const std::bad_alloc&)
+		ccVisibilitySelection selection;
+		if (!clipBox->selectPointsInside(inputCloud, selection))
 		{
 			if (!silent)
 			{
@@ -427,9 +431,8 @@ ccHObject* GetSlice(ccHObject* obj, ccClipBox* clipBox, bool silent)
 			}
 			return nullptr;
 		}
-		clipBox->flagPointsInside(inputCloud, &selectionTable);
-		
-		ccGenericPointCloud* sliceCloud = inputCloud->createNewCloudFromVisibilitySelection(false, &selectionTable, nullptr, true);
+
+		ccGenericPointCloud* sliceCloud = inputCloud->createNewCloudFromSelection(selection, false, nullptr, true);
 
 		// specific case: all points were selected
 		if (sliceCloud == inputCloud)
@@ -554,6 +557,289 @@ static unsigned ComputeGridDimensions(	const ccBBox& localBox,
 	return cellCount;
 }
 
+//! Returns the chunks (point index ranges) used to process a cloud concurrently
+static std::vector<std::pair<unsigned, unsigned>> GetPointChunks(unsigned pointCount, size_t maxChunkCount)
+{
+	static const unsigned s_minChunkSize = 65536;
+
+	size_t chunkCount = std::min(maxChunkCount, static_cast<size_t>(pointCount / s_minChunkSize));
+	chunkCount = std::max<size_t>(chunkCount, 1);
+
+	std::vector<std::pair<unsigned, unsigned>> chunks(chunkCount);
+	for (size_t c = 0; c < chunkCount; ++c)
+	{
+		chunks[c].first = static_cast<unsigned>((static_cast<uint64_t>(pointCount) * c) / chunkCount);
+		chunks[c].second = static_cast<unsigned>((static_cast<uint64_t>(pointCount) * (c + 1)) / chunkCount);
+	}
+
+	return chunks;
+}
+
+//! Adds the points of a cloud (expressed in the local clipping box ref.) to a bounding box
+static void AddToLocalBox(ccGenericPointCloud* cloud, const ccGLMatrix& localTrans, ccBBox& localBox)
+{
+	std::vector<std::pair<unsigned, unsigned>> chunks = GetPointChunks(cloud->size(), static_cast<size_t>(std::max(ccQtHelpers::GetMaxThreadCount(), 1)));
+	std::vector<ccBBox> chunkBoxes(chunks.size());
+	std::vector<size_t> chunkIndexes(chunks.size());
+	std::iota(chunkIndexes.begin(), chunkIndexes.end(), 0);
+
+	QtConcurrent::blockingMap(chunkIndexes, [&](size_t c)
+	{
+		ccBBox& chunkBox = chunkBoxes[c];
+		for (unsigned i = chunks[c].first; i < chunks[c].second; ++i)
+		{
+			CCVector3 P = *cloud->getPoint(i);
+			localTrans.apply(P);
+			chunkBox.add(P);
+		}
+	});
+
+	for (const ccBBox& chunkBox : chunkBoxes)
+	{
+		if (chunkBox.isValid())
+		{
+			localBox += chunkBox;
+		}
+	}
+}
+
+//! Slices grid (in the local clipping box ref.)
+struct SliceGrid
+{
+	CCVector3 origin;
+	CCVector3 cellSize;
+	CCVector3 cellSizePlusGap;
+	PointCoordinateType gap = 0;
+	int indexMins[3]{ 0, 0, 0 };
+	int indexMaxs[3]{ 0, 0, 0 };
+	int gridDim[3]{ 0, 0, 0 };
+	unsigned cellCount = 0;
+
+	//! Returns the index of the cell (slice) a point belongs to, or -1 if it falls in a gap
+	inline int cellIndex(CCVector3 P) const
+	{
+		//relative coordinates (between 0 and 1)
+		P -= origin;
+		P.x /= cellSizePlusGap.x;
+		P.y /= cellSizePlusGap.y;
+		P.z /= cellSizePlusGap.z;
+
+		int xi = static_cast<int>(floor(P.x));
+		xi = std::min(std::max(xi, indexMins[0]), indexMaxs[0]);
+		int yi = static_cast<int>(floor(P.y));
+		yi = std::min(std::max(yi, indexMins[1]), indexMaxs[1]);
+		int zi = static_cast<int>(floor(P.z));
+		zi = std::min(std::max(zi, indexMins[2]), indexMaxs[2]);
+
+		if (gap == 0 ||
+			(	(P.x - static_cast<PointCoordinateType>(xi))*cellSizePlusGap.x <= cellSize.x
+			&&	(P.y - static_cast<PointCoordinateType>(yi))*cellSizePlusGap.y <= cellSize.y
+			&&	(P.z - static_cast<PointCoordinateType>(zi))*cellSizePlusGap.z <= cellSize.z))
+		{
+			return ((zi - indexMins[2]) * gridDim[1] + (yi - indexMins[1])) * gridDim[0] + (xi - indexMins[0]);
+		}
+
+		return -1;
+	}
+};
+
+//! Maximum number of per-chunk cell counters used to bin the points of a cloud
+static const size_t s_maxBinningCounters = (size_t(1) << 24);
+
+//! Assigns all the points of a cloud to their slice in a single (concurrent) pass
+/** The points of each slice are stored in refClouds[cellIndex * cloudCount + cloudIndex],
+	in increasing index order.
+	\warning May throw std::bad_alloc
+	\return false if not enough memory
+**/
+static bool BinPoints(	ccGenericPointCloud* cloud,
+						size_t cloudIndex,
+						size_t cloudCount,
+						const ccGLMatrix& localTrans,
+						const SliceGrid& grid,
+						std::vector<CCCoreLib::ReferenceCloud*>& refClouds,
+						unsigned& subCloudsCount)
+{
+	unsigned pointCount = cloud->size();
+	if (pointCount == 0 || grid.cellCount == 0)
+	{
+		return true;
+	}
+
+	//the number of chunks is limited by the memory required to count the points of each cell per chunk
+	size_t maxChunkCount = static_cast<size_t>(std::max(ccQtHelpers::GetMaxThreadCount(), 1));
+	maxChunkCount = std::min(maxChunkCount, std::max<size_t>(s_maxBinningCounters / grid.cellCount, 1));
+	std::vector<std::pair<unsigned, unsigned>> chunks = GetPointChunks(pointCount, maxChunkCount);
+	std::vector<size_t> chunkIndexes(chunks.size());
+	std::iota(chunkIndexes.begin(), chunkIndexes.end(), 0);
+
+	//cell index of each point, and number of points per cell and per chunk
+	std::vector<int> cellIndexes(pointCount);
+	std::vector<unsigned> chunkCellCounts(chunks.size() * grid.cellCount, 0);
+
+	QtConcurrent::blockingMap(chunkIndexes, [&](size_t c)
+	{
+		unsigned* cellCounts = chunkCellCounts.data() + c * grid.cellCount;
+		for (unsigned i = chunks[c].first; i < chunks[c].second; ++i)
+		{
+			CCVector3 P = *cloud->getPoint(i);
+			localTrans.apply(P);
+
+			int cellIndex = grid.cellIndex(P);
+			cellIndexes[i] = cellIndex;
+			if (cellIndex >= 0)
+			{
+				assert(static_cast<unsigned>(cellIndex) < grid.cellCount);
+				++cellCounts[cellIndex];
+			}
+		}
+	});
+
+	//create the (non empty) slices, and convert the counts to the first position of each chunk in them
+	for (unsigned cellIndex = 0; cellIndex < grid.cellCount; ++cellIndex)
+	{
+		unsigned slicePointCount = 0;
+		for (size_t c = 0; c < chunks.size(); ++c)
+		{
+			unsigned& count = chunkCellCounts[c * grid.cellCount + cellIndex];
+			unsigned chunkPointCount = count;
+			count = slicePointCount;
+			slicePointCount += chunkPointCount;
+		}
+
+		if (slicePointCount != 0)
+		{
+			CCCoreLib::ReferenceCloud*& destCloud = refClouds[cellIndex * cloudCount + cloudIndex];
+			assert(!destCloud);
+			destCloud = new CCCoreLib::ReferenceCloud(cloud);
+			++subCloudsCount;
+
+			if (!destCloud->resize(slicePointCount))
+			{
+				return false;
+			}
+		}
+	}
+
+	//eventually fill the slices
+	QtConcurrent::blockingMap(chunkIndexes, [&](size_t c)
+	{
+		unsigned* positions = chunkCellCounts.data() + c * grid.cellCount;
+		for (unsigned i = chunks[c].first; i < chunks[c].second; ++i)
+		{
+			int cellIndex = cellIndexes[i];
+			if (cellIndex >= 0)
+			{
+				refClouds[cellIndex * cloudCount + cloudIndex]->setPointIndex(positions[cellIndex]++, i);
+			}
+		}
+	});
+
+	return true;
+}
+
+//! Level set (contour lines) extraction parameters
+struct LevelSetParams
+{
+	ccGLMatrix localTrans;
+	ccGLMatrix globalTrans;
+	CCVector3 gridOrigin;
+	unsigned gridWidth = 0;
+	unsigned gridHeight = 0;
+	double gridStep = 0.0;
+	int minVertexCount = 0;
+	int X = 0;
+	int Y = 1;
+	int Z = 2;
+};
+
+//! Extracts the level set of a single slice
+/** Can be called concurrently (no GUI).
+	\return false if not enough memory or if the contour lines generation failed
+**/
+static bool ExtractSliceLevelSet(ccPointCloud* sliceCloud, double sliceZ, const LevelSetParams& levelSet, std::vector<ccPolyline*>& contours)
+{
+	try
+	{
+		ccRasterGrid grid;
+		if (!grid.init(levelSet.gridWidth, levelSet.gridHeight, levelSet.gridStep, CCVector3d(0, 0, 0)))
+		{
+			return false;
+		}
+
+		//project the slice in 2D
+		for (unsigned pi = 0; pi != sliceCloud->size(); ++pi)
+		{
+			CCVector3 relativePos = *sliceCloud->getPoint(pi);
+			levelSet.localTrans.apply(relativePos);
+			relativePos -= levelSet.gridOrigin;
+
+			int i = static_cast<int>(relativePos.u[levelSet.X] / levelSet.gridStep + 0.5);
+			int j = static_cast<int>(relativePos.u[levelSet.Y] / levelSet.gridStep + 0.5);
+
+			//we skip points that fall outside of the grid!
+			if (	i < 0 || i >= static_cast<int>(levelSet.gridWidth)
+				||	j < 0 || j >= static_cast<int>(levelSet.gridHeight))
+			{
+				//there shouldn't be any actually
+				assert(false);
+				continue;
+			}
+
+			ccRasterCell& cell = grid.rows[j][i];
+			cell.h = 1.0;
+			++cell.nbPoints;
+		}
+
+		grid.updateNonEmptyCellCount();
+		grid.updateCellStats();
+		grid.setValid(true);
+
+		//now extract the contour lines
+		ccContourLinesGenerator::Parameters params;
+		params.emptyCellsValue = std::numeric_limits<double>::quiet_NaN();
+		params.minVertexCount = levelSet.minVertexCount;
+		params.showProgress = false;
+		params.startAltitude = 0.0;
+		params.maxAltitude = 1.0;
+		params.step = 1.0;
+
+		if (!ccContourLinesGenerator::GenerateContourLines(&grid, CCVector2d(levelSet.gridOrigin.u[levelSet.X], levelSet.gridOrigin.u[levelSet.Y]), params, contours))
+		{
+			return false;
+		}
+
+		for (ccPolyline* poly : contours)
+		{
+			CCCoreLib::GenericIndexedCloudPersist* vertices = poly->getAssociatedCloud();
+			for (unsigned pi = 0; pi < vertices->size(); ++pi)
+			{
+				//convert the vertices from the local coordinate system to the global one
+				const CCVector3* Pconst = vertices->getPoint(pi);
+				CCVector3 P;
+				P.u[levelSet.X] = Pconst->x;
+				P.u[levelSet.Y] = Pconst->y;
+				P.u[levelSet.Z] = sliceZ;
+				*const_cast<CCVector3*>(Pconst) = levelSet.globalTrans * P;
+			}
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		for (ccPolyline* poly : contours)
+		{
+			delete poly;
+		}
+		contours.clear();
+		return false;
+	}
+
+	return true;
+}
+
+//! Maximum memory used by the level set grids processed concurrently
+static const size_t s_maxLevelSetGridsMemory = (size_t(1) << 31); //2 Gb
+
 bool ccClippingBoxTool::ExtractSlicesAndContours
 (
 	const std::vector<ccGenericPointCloud*>& clouds,
@@ -667,26 +953,25 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 				ccBBox localBox;
 				for (ccGenericPointCloud* cloud : clouds)
 				{
-					for (unsigned i = 0; i < cloud->size(); ++i)
-					{
-						CCVector3 P = *cloud->getPoint(i);
-						localTrans.apply(P);
-						localBox.add(P);
-					}
+					AddToLocalBox(cloud, localTrans, localBox);
 				}
 
-				int indexMins[3]{ 0, 0, 0 };
-				int indexMaxs[3]{ 0, 0, 0 };
-				int gridDim[3]{ 0, 0, 0 };
-				unsigned cellCount = ComputeGridDimensions(localBox, repeatDimensions, indexMins, indexMaxs, gridDim, gridOrigin, cellSizePlusGap);
+				SliceGrid grid;
+				grid.origin = gridOrigin;
+				grid.cellSize = cellSize;
+				grid.cellSizePlusGap = cellSizePlusGap;
+				grid.gap = gap;
+				grid.cellCount = ComputeGridDimensions(localBox, repeatDimensions, grid.indexMins, grid.indexMaxs, grid.gridDim, gridOrigin, cellSizePlusGap);
 
 				//we'll potentially create up to one (ref.) cloud per input loud and per cell
 				std::vector<CCCoreLib::ReferenceCloud*> refClouds;
-				refClouds.resize(cellCount * clouds.size(), nullptr);
+				refClouds.resize(grid.cellCount * clouds.size(), nullptr);
 
 				if (progressDialog)
 				{
 					progressDialog->setWindowTitle(tr("Preparing extraction"));
+					progressDialog->setMaximum(static_cast<int>(clouds.size()));
+					progressDialog->setValue(0);
 					progressDialog->start();
 					progressDialog->show();
 					progressDialog->setAutoClose(false);
@@ -694,7 +979,7 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 
 				unsigned subCloudsCount = 0;
 
-				//project points into grid
+				//assign all the points to their slice (one pass per cloud)
 				for (size_t ci = 0; ci != clouds.size(); ++ci)
 				{
 					ccGenericPointCloud* cloud = clouds[ci];
@@ -708,54 +993,19 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 					}
 					QApplication::processEvents();
 
-					CCCoreLib::NormalizedProgress nProgress(progressDialog, pointCount);
-					for (unsigned i = 0; i < pointCount; ++i)
+					if (!BinPoints(cloud, ci, clouds.size(), localTrans, grid, refClouds, subCloudsCount))
 					{
-						CCVector3 P = *cloud->getPoint(i);
-						localTrans.apply(P);
-
-						//relative coordinates (between 0 and 1)
-						P -= gridOrigin;
-						P.x /= cellSizePlusGap.x;
-						P.y /= cellSizePlusGap.y;
-						P.z /= cellSizePlusGap.z;
-
-						int xi = static_cast<int>(floor(P.x));
-						xi = std::min(std::max(xi, indexMins[0]), indexMaxs[0]);
-						int yi = static_cast<int>(floor(P.y));
-						yi = std::min(std::max(yi, indexMins[1]), indexMaxs[1]);
-						int zi = static_cast<int>(floor(P.z));
-						zi = std::min(std::max(zi, indexMins[2]), indexMaxs[2]);
-
-						if (gap == 0 ||
-							(	(P.x - static_cast<PointCoordinateType>(xi))*cellSizePlusGap.x <= cellSize.x
-							&&	(P.y - static_cast<PointCoordinateType>(yi))*cellSizePlusGap.y <= cellSize.y
-							&&	(P.z - static_cast<PointCoordinateType>(zi))*cellSizePlusGap.z <= cellSize.z))
-						{
-							int cloudIndex = ((zi - indexMins[2]) * static_cast<int>(gridDim[1]) + (yi - indexMins[1])) * static_cast<int>(gridDim[0]) + (xi - indexMins[0]);
-							assert(cloudIndex >= 0 && static_cast<size_t>(cloudIndex)* clouds.size() + ci < refClouds.size());
-
-							CCCoreLib::ReferenceCloud*& destCloud = refClouds[cloudIndex * clouds.size() + ci];
-							if (!destCloud)
-							{
-								destCloud = new CCCoreLib::ReferenceCloud(cloud);
-								++subCloudsCount;
-							}
-
-							if (!destCloud->addPointIndex(i))
-							{
-								ccLog::Error("Not enough memory!");
-								error = true;
-								break;
-							}
-						}
+						ccLog::Error("Not enough memory!");
+						error = true;
+						break;
 					}
 
-					if (!nProgress.oneStep())
+					if (progressDialog)
 					{
 						// sadly, we can't cancel in the middle of this process!
+						progressDialog->setValue(static_cast<int>(ci + 1));
 					}
-				} //project points into grid
+				} //assign all the points to their slice
 
 				if (progressDialog)
 				{
@@ -770,13 +1020,13 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 				subCloudsCount = 0;
 
 				//now create the real clouds
-				for (int i = indexMins[0]; i <= indexMaxs[0]; ++i)
+				for (int i = grid.indexMins[0]; i <= grid.indexMaxs[0]; ++i)
 				{
-					for (int j = indexMins[1]; j <= indexMaxs[1]; ++j)
+					for (int j = grid.indexMins[1]; j <= grid.indexMaxs[1]; ++j)
 					{
-						for (int k = indexMins[2]; k <= indexMaxs[2]; ++k)
+						for (int k = grid.indexMins[2]; k <= grid.indexMaxs[2]; ++k)
 						{
-							int cloudIndex = ((k - indexMins[2]) * static_cast<int>(gridDim[1]) + (j - indexMins[1])) * static_cast<int>(gridDim[0]) + (i - indexMins[0]);
+							int cloudIndex = ((k - grid.indexMins[2]) * static_cast<int>(grid.gridDim[1]) + (j - grid.indexMins[1])) * static_cast<int>(grid.gridDim[0]) + (i - grid.indexMins[0]);
 							assert(cloudIndex >= 0 && static_cast<size_t>(cloudIndex)* clouds.size() < refClouds.size());
 
 							for (size_t ci = 0; ci != clouds.size(); ++ci)
@@ -799,9 +1049,9 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 											{
 												ccLog::Error("Not enough memory!");
 												error = true;
-												i = indexMaxs[0];
-												j = indexMaxs[1];
-												k = indexMaxs[2];
+												i = grid.indexMaxs[0];
+												j = grid.indexMaxs[1];
+												k = grid.indexMaxs[2];
 											}
 											sliceCloud->showColors(true);
 										}
@@ -838,9 +1088,9 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 										error = true;
 										ccLog::Warning(QString("[ExtractSlicesAndContours] Process canceled by user"));
 										//early stop
-										i = indexMaxs[0];
-										j = indexMaxs[1];
-										k = indexMaxs[2];
+										i = grid.indexMaxs[0];
+										j = grid.indexMaxs[1];
+										k = grid.indexMaxs[2];
 										break;
 									}
 								}
@@ -867,13 +1117,7 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 				ccBBox localBox;
 				for (ccGenericMesh* mesh : meshes)
 				{
-					ccGenericPointCloud* cloud = mesh->getAssociatedCloud();
-					for (unsigned i = 0; i < cloud->size(); ++i)
-					{
-						CCVector3 P = *cloud->getPoint(i);
-						localTrans.apply(P);
-						localBox.add(P);
-					}
+					AddToLocalBox(mesh->getAssociatedCloud(), localTrans, localBox);
 				}
 
 				int indexMins[3]{ 0, 0, 0 };
@@ -1006,7 +1250,15 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 
 				CCVector3 gridOrigin = clipBox.getOwnBB().minCorner();
 				CCVector3 gridSize = clipBox.getOwnBB().getDiagVec();
-				ccGLMatrix globalTrans = localTrans.inverse();
+
+				LevelSetParams levelSetParams;
+				levelSetParams.localTrans = localTrans;
+				levelSetParams.globalTrans = localTrans.inverse();
+				levelSetParams.gridStep = levelSetGridStep;
+				levelSetParams.minVertexCount = levelSetMinVertCount;
+				levelSetParams.X = X;
+				levelSetParams.Y = Y;
+				levelSetParams.Z = Z;
 
 				assert(false == CCCoreLib::LessThanEpsilon(levelSetGridStep));
 				unsigned gridWidth = 1 + static_cast<unsigned>(gridSize.u[X] / levelSetGridStep + 0.5);
@@ -1018,118 +1270,83 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 				gridOrigin.u[X] -= levelSetGridStep;
 				gridOrigin.u[Y] -= levelSetGridStep;
 
-				ccRasterGrid grid;
-				if (!grid.init(gridWidth, gridHeight, levelSetGridStep, CCVector3d(0, 0, 0)))
-				{
-					ccLog::Error("Not enough memory!");
-					error = true;
-					break;
-				}
+				levelSetParams.gridOrigin = gridOrigin;
+				levelSetParams.gridWidth = gridWidth;
+				levelSetParams.gridHeight = gridHeight;
+
+				//the slices are processed concurrently (by batches, as each one requires its own grid)
+				size_t gridMemory = static_cast<size_t>(gridWidth) * gridHeight * sizeof(ccRasterCell);
+				size_t batchSize = std::min(static_cast<size_t>(std::max(ccQtHelpers::GetMaxThreadCount(), 1)),
+											1 + s_maxLevelSetGridsMemory / std::max<size_t>(gridMemory, 1));
+
+				std::vector<std::vector<ccPolyline*>> batchContours(batchSize);
+				std::vector<char> batchSuccess(batchSize, 0);
 
 				//process all the slices originating from point clouds
 				assert(cloudSliceCount <= outputSlices.size());
-				for (size_t i = 0; i < cloudSliceCount; ++i)
+				for (size_t firstSlice = 0; firstSlice < cloudSliceCount && !error; firstSlice += batchSize)
 				{
-					ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[i]);
-					assert(sliceCloud);
-
-					double sliceZ = sliceCloud->getMetaData(QString("slice.origin.dim(%1)").arg(Z)).toDouble();
-					sliceZ += gridSize.u[Z] / 2;
+					size_t batchSliceCount = std::min(batchSize, cloudSliceCount - firstSlice);
+					std::vector<size_t> batchIndexes(batchSliceCount);
+					std::iota(batchIndexes.begin(), batchIndexes.end(), 0);
 
-					//grid.reset();
-					for (ccRasterGrid::Row& row : grid.rows)
+					QtConcurrent::blockingMap(batchIndexes, [&](size_t k)
 					{
-						for (ccRasterCell& cell : row)
-						{
-							cell.h = 0.0;
-							cell.nbPoints = 0;
-						}
-					}
+						ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[firstSlice + k]);
+						assert(sliceCloud);
 
-					//project the slice in 2D
-					for (unsigned pi = 0; pi != sliceCloud->size(); ++pi)
-					{
-						CCVector3 relativePos = *sliceCloud->getPoint(pi);
-						localTrans.apply(relativePos);
-						relativePos -= gridOrigin;
-
-						int i = static_cast<int>(relativePos.u[X] / levelSetGridStep + 0.5);
-						int j = static_cast<int>(relativePos.u[Y] / levelSetGridStep + 0.5);
-
-						//we skip points that fall outside of the grid!
-						if (	i < 0 || i >= static_cast<int>(gridWidth)
-							||	j < 0 || j >= static_cast<int>(gridHeight))
-						{
-							//there shouldn't be any actually
-							assert(false);
-							continue;
-						}
+						double sliceZ = sliceCloud->getMetaData(QString("slice.origin.dim(%1)").arg(Z)).toDouble();
+						sliceZ += gridSize.u[Z] / 2;
 
-						ccRasterCell& cell = grid.rows[j][i];
-						cell.h = 1.0;
-						++cell.nbPoints;
-					}
+						batchContours[k].clear();
+						batchSuccess[k] = ExtractSliceLevelSet(sliceCloud, sliceZ, levelSetParams, batchContours[k]) ? 1 : 0;
+					});
 
-					grid.updateNonEmptyCellCount();	
-					grid.updateCellStats();
-					grid.setValid(true);
-
-					//now extract the contour lines
-					ccContourLinesGenerator::Parameters params;
-					params.emptyCellsValue = std::numeric_limits<double>::quiet_NaN();
-					params.minVertexCount = levelSetMinVertCount;
-					params.parentWidget = progressDialog->parentWidget();
-					params.startAltitude = 0.0;
-					params.maxAltitude = 1.0;
-					params.step = 1.0;
-
-					std::vector<ccPolyline*> contours;
-					if (ccContourLinesGenerator::GenerateContourLines(&grid, CCVector2d(gridOrigin.u[X], gridOrigin.u[Y]), params, contours))
+					//the contour lines are added in the slices order
+					for (size_t k = 0; k < batchSliceCount; ++k)
 					{
-						for (size_t k = 0; k < contours.size(); ++k)
+						size_t i = firstSlice + k;
+						ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[i]);
+
+						if (batchSuccess[k])
 						{
-							ccPolyline* poly = contours[k];
-							CCCoreLib::GenericIndexedCloudPersist* vertices = poly->getAssociatedCloud();
-							for (unsigned pi = 0; pi < vertices->size(); ++pi)
+							double sliceZ = sliceCloud->getMetaData(QString("slice.origin.dim(%1)").arg(Z)).toDouble();
+							sliceZ += gridSize.u[Z] / 2;
+
+							const std::vector<ccPolyline*>& contours = batchContours[k];
+							for (size_t c = 0; c < contours.size(); ++c)
 							{
-								//convert the vertices from the local coordinate system to the global one
-								const CCVector3* Pconst = vertices->getPoint(pi);
-								CCVector3 P;
-								P.u[X] = Pconst->x;
-								P.u[Y] = Pconst->y;
-								P.u[Z] = sliceZ;
-								*const_cast<CCVector3*>(Pconst) = globalTrans * P;
-							}
+								ccPolyline* poly = contours[c];
 
-							static char s_dimNames[3] = { 'X', 'Y', 'Z' };
-							poly->setName(QString("Contour line %1=%2 (#%3)").arg(s_dimNames[Z]).arg(sliceZ).arg(k + 1));
-							poly->copyGlobalShiftAndScale(*sliceCloud);
-							poly->setMetaData(ccPolyline::MetaKeyConstAltitude(), QVariant(sliceZ)); //replace the 'altitude' meta-data by the right value
+								static char s_dimNames[3] = { 'X', 'Y', 'Z' };
+								poly->setName(QString("Contour line %1=%2 (#%3)").arg(s_dimNames[Z]).arg(sliceZ).arg(c + 1));
+								poly->copyGlobalShiftAndScale(*sliceCloud);
+								poly->setMetaData(ccPolyline::MetaKeyConstAltitude(), QVariant(sliceZ)); //replace the 'altitude' meta-data by the right value
 
-							//set meta-data
-							poly->setMetaData(s_originEntityUUID, sliceCloud->getMetaData(s_originEntityUUID));
-							poly->setMetaData(s_sliceID, sliceCloud->getMetaData(s_sliceID));
-							poly->setMetaData("slice.origin.dim(0)", sliceCloud->getMetaData("slice.origin.dim(0)"));
-							poly->setMetaData("slice.origin.dim(1)", sliceCloud->getMetaData("slice.origin.dim(1)"));
-							poly->setMetaData("slice.origin.dim(2)", sliceCloud->getMetaData("slice.origin.dim(2)"));
+								//set meta-data
+								poly->setMetaData(s_originEntityUUID, sliceCloud->getMetaData(s_originEntityUUID));
+								poly->setMetaData(s_sliceID, sliceCloud->getMetaData(s_sliceID));
+								poly->setMetaData("slice.origin.dim(0)", sliceCloud->getMetaData("slice.origin.dim(0)"));
+								poly->setMetaData("slice.origin.dim(1)", sliceCloud->getMetaData("slice.origin.dim(1)"));
+								poly->setMetaData("slice.origin.dim(2)", sliceCloud->getMetaData("slice.origin.dim(2)"));
 
-							levelSet.push_back(poly);
+								levelSet.push_back(poly);
+							}
+						}
+						else
+						{
+							ccLog::Warning(tr("Failed to generate contour lines for cloud #%1").arg(i + 1));
 						}
-					}
-					else
-					{
-						ccLog::Warning(tr("Failed to generate contour lines for cloud #%1").arg(i + 1));
-					}
 
-					if (progressDialog)
-					{
-						if (progressDialog->wasCanceled())
+						if (progressDialog && !error)
 						{
-							error = true;
-							ccLog::Warning(tr("[ExtractSlicesAndContours] Process canceled by user"));
-							break;
+							if (progressDialog->wasCanceled())
+							{
+								error = true;
+								ccLog::Warning(tr("[ExtractSlicesAndContours] Process canceled by user"));
+							}
+							progressDialog->setValue(static_cast<int>(i) + 1);
 						}
-						progressDialog->setValue(static_cast<int>(i) + 1);
 					}
 				}
 			}
@@ -1153,13 +1370,13 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 			//preferred dimension?
 			PointCoordinateType* preferredNormDir = nullptr;
 			PointCoordinateType* preferredUpDir = nullptr;
+			ccGLMatrix invLocalTrans = localTrans.inverse(); //must outlive the extraction (the directions point to its columns)
 			if (repeatDimensionsSum == 1)
 			{
 				for (int i = 0; i < 3; ++i)
 				{
 					if (repeatDimensions[i])
 					{
-						ccGLMatrix invLocalTrans = localTrans.inverse();
 						if (!projectOnBestFitPlane) //otherwise the normal will be automatically computed
 							preferredNormDir = invLocalTrans.getColumn(i);
 						preferredUpDir = invLocalTrans.getColumn(i < 2 ? 2 : 0);
@@ -1170,72 +1387,105 @@ bool ccClippingBoxTool::ExtractSlicesAndContours
 
 			assert(cloudSliceCount <= outputSlices.size());
 
-			//process all the slices originating from point clouds
-			for (size_t i = 0; i < cloudSliceCount; ++i)
+			//the slices are processed concurrently (except in visual debug mode)
+			size_t batchSize = (visualDebugMode ? 1 : static_cast<size_t>(std::max(ccQtHelpers::GetMaxThreadCount(), 1)));
+			std::vector<std::vector<ccPolyline*>> batchPolys(batchSize);
+			std::vector<char> batchSuccess(batchSize, 0);
+
+			auto extractEnvelope = [&](size_t sliceIndex, size_t k)
 			{
-				ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[i]);
+				ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[sliceIndex]);
 				assert(sliceCloud);
 
-				std::vector<ccPolyline*> polys;
-				if (ccEnvelopeExtractor::ExtractFlatEnvelope(sliceCloud,
-					multiPass,
-					maxEdgeLength,
-					polys,
-					envelopeType,
-					splitEnvelopes,
-					preferredNormDir,
-					preferredUpDir,
-					visualDebugMode))
+				batchPolys[k].clear();
+				batchSuccess[k] = ccEnvelopeExtractor::ExtractFlatEnvelope(	sliceCloud,
+																			multiPass,
+																			maxEdgeLength,
+																			batchPolys[k],
+																			envelopeType,
+																			splitEnvelopes,
+																			preferredNormDir,
+																			preferredUpDir,
+																			visualDebugMode) ? 1 : 0;
+			};
+
+			//process all the slices originating from point clouds
+			for (size_t firstSlice = 0; firstSlice < cloudSliceCount && !error; firstSlice += batchSize)
+			{
+				size_t batchSliceCount = std::min(batchSize, cloudSliceCount - firstSlice);
+				if (visualDebugMode)
+				{
+					//the debug dialog must be displayed by the main thread
+					extractEnvelope(firstSlice, 0);
+				}
+				else
+				{
+					std::vector<size_t> batchIndexes(batchSliceCount);
+					std::iota(batchIndexes.begin(), batchIndexes.end(), 0);
+
+					QtConcurrent::blockingMap(batchIndexes, [&](size_t k)
+					{
+						extractEnvelope(firstSlice + k, k);
+					});
+				}
+
+				//the envelopes are added in the slices order
+				for (size_t k = 0; k < batchSliceCount; ++k)
 				{
-					if (!polys.empty())
+					size_t i = firstSlice + k;
+					ccPointCloud* sliceCloud = ccHObjectCaster::ToPointCloud(outputSlices[i]);
+					const std::vector<ccPolyline*>& polys = batchPolys[k];
+
+					if (batchSuccess[k])
 					{
-						for (size_t p = 0; p < polys.size(); ++p)
+						if (!polys.empty())
 						{
-							ccPolyline* poly = polys[p];
-							poly->setColor(ccColor::green);
-							poly->showColors(true);
-							poly->setGlobalScale(sliceCloud->getGlobalScale());
-							poly->setGlobalShift(sliceCloud->getGlobalShift());
-							QString envelopeName = sliceCloud->getName();
-							envelopeName.replace("slice", "envelope");
-							if (polys.size() > 1)
+							for (size_t p = 0; p < polys.size(); ++p)
 							{
-								envelopeName += QString(" (part %1)").arg(p + 1);
-							}
-							poly->setName(envelopeName);
+								ccPolyline* poly = polys[p];
+								poly->setColor(ccColor::green);
+								poly->showColors(true);
+								poly->setGlobalScale(sliceCloud->getGlobalScale());
+								poly->setGlobalShift(sliceCloud->getGlobalShift());
+								QString envelopeName = sliceCloud->getName();
+								envelopeName.replace("slice", "envelope");
+								if (polys.size() > 1)
+								{
+									envelopeName += QString(" (part %1)").arg(p + 1);
+								}
+								poly->setName(envelopeName);
 
-							//set meta-data
-							poly->setMetaData(s_originEntityUUID, sliceCloud->getMetaData(s_originEntityUUID));
-							poly->setMetaData(s_sliceID, sliceCloud->getMetaData(s_sliceID));
-							poly->setMetaData("slice.origin.dim(0)", sliceCloud->getMetaData("slice.origin.dim(0)"));
-							poly->setMetaData("slice.origin.dim(1)", sliceCloud->getMetaData("slice.origin.dim(1)"));
-							poly->setMetaData("slice.origin.dim(2)", sliceCloud->getMetaData("slice.origin.dim(2)"));
+								//set meta-data
+								poly->setMetaData(s_originEntityUUID, sliceCloud->getMetaData(s_originEntityUUID));
+								poly->setMetaData(s_sliceID, sliceCloud->getMetaData(s_sliceID));
+								poly->setMetaData("slice.origin.dim(0)", sliceCloud->getMetaData("slice.origin.dim(0)"));
+								poly->setMetaData("slice.origin.dim(1)", sliceCloud->getMetaData("slice.origin.dim(1)"));
+								poly->setMetaData("slice.origin.dim(2)", sliceCloud->getMetaData("slice.origin.dim(2)"));
 
-							outputEnvelopes.push_back(poly);
+								outputEnvelopes.push_back(poly);
+							}
+						}
+						else
+						{
+							ccLog::Warning(tr("%1: points are too far from each other! Increase the max edge length").arg(sliceCloud->getName()));
+							warningsIssued = true;
 						}
 					}
 					else
 					{
-						ccLog::Warning(tr("%1: points are too far from each other! Increase the max edge length").arg(sliceCloud->getName()));
+						ccLog::Warning(tr("%1: envelope extraction failed!").arg(sliceCloud->getName()));
 						warningsIssued = true;
 					}
-				}
-				else
-				{
-					ccLog::Warning(tr("%1: envelope extraction failed!").arg(sliceCloud->getName()));
-					warningsIssued = true;
-				}
 
-				if (progressDialog && !visualDebugMode)
-				{
-					if (progressDialog->wasCanceled())
+					if (progressDialog && !visualDebugMode && !error)
 					{
-						error = true;
-						ccLog::Warning(tr("[ExtractSlicesAndContours] Process canceled by user"));
-						//early stop
-						break;
+						if (progressDialog->wasCanceled())
+						{
+							error = true;
+							ccLog::Warning(tr("[ExtractSlicesAndContours] Process canceled by user"));
+						}
+						progressDialog->setValue(static_cast<int>(i));
 					}
-					progressDialog->setValue(static_cast<int>(i));
 				}
 			}
 
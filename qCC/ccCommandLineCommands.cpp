@@ -9,6 +9,7 @@
 #include <DistanceComputationTools.h>
 
 //qCC_db
+#include <ccArrayCodec.h>
 #include <ccHObjectCaster.h>
 #include <ccNormalVectors.h>
 #include <ccPlane.h>
@@ -54,6 +55,7 @@ constexpr char COMMAND_HIERARCHY_EXPORT_FORMAT[]		= "H_EXPORT_FMT";
 constexpr char COMMAND_OPEN[]							= "O";				//+ file name
 constexpr char COMMAND_OPEN_SKIP_LINES[]				= "SKIP";			//+ number of lines to skip
 constexpr char COMMAND_OPEN_NO_LABEL[]					= "NO_LABEL";
+constexpr char COMMAND_OPEN_SCANS[]						= "SCANS";			//+ comma separated list of scans (index, name or GUID)
 constexpr char COMMAND_COMMAND_FILE[]					= "COMMAND_FILE";	//+ file name
 constexpr char COMMAND_SUBSAMPLE[]						= "SS";				//+ method (RANDOM/SPATIAL/OCTREE) + parameter (resp. point count / spatial step / octree level)
 constexpr char COMMAND_EXTRACT_CC[]						= "EXTRACT_CC";
@@ -87,6 +89,8 @@ constexpr char COMMAND_BEST_FIT_PLANE[]					= "BEST_FIT_PLANE";
 constexpr char COMMAND_BEST_FIT_PLANE_MAKE_HORIZ[]		= "MAKE_HORIZ";
 constexpr char COMMAND_BEST_FIT_PLANE_KEEP_LOADED[]		= "KEEP_LOADED";
 constexpr char COMMAND_ORIENT_NORMALS[]					= "ORIENT_NORMS_MST";
+constexpr char COMMAND_ORIENT_NORMALS_FM[]				= "ORIENT_NORMS_FM";
+constexpr char COMMAND_ORIENT_NORMALS_FM_CONCURRENT[]	= "CONCURRENT";
 constexpr char COMMAND_SOR_FILTER[]						= "SOR";
 constexpr char COMMAND_NOISE_FILTER[]					= "NOISE";
 constexpr char COMMAND_NOISE_FILTER_KNN[]				= "KNN";
@@ -171,6 +175,7 @@ constexpr char COMMAND_POP_CLOUDS[]						= "POP_CLOUDS";
 constexpr char COMMAND_CLEAR_MESHES[]					= "CLEAR_MESHES";
 constexpr char COMMAND_POP_MESHES[]						= "POP_MESHES";
 constexpr char COMMAND_NO_TIMESTAMP[]					= "NO_TIMESTAMP";
+constexpr char COMMAND_COMPRESS_BIN[]					= "COMPRESS_BIN";
 constexpr char COMMAND_MOMENT[]							= "MOMENT";
 constexpr char COMMAND_FEATURE[]						= "FEATURE";
 constexpr char COMMAND_RGB_CONVERT_TO_SF[]				= "RGB_CONVERT_TO_SF";
@@ -208,6 +213,7 @@ constexpr char OPTION_SIGMA[]							= "SIGMA";
 constexpr char OPTION_SIGMA_SF[]						= "SIGMA_SF";
 constexpr char OPTION_BURNT_COLOR_THRESHOLD[]			= "BURNT_COLOR_THRESHOLD";
 constexpr char OPTION_BLEND_GRAYSCALE[]					= "BLEND_GRAYSCALE";
+constexpr char OPTION_VOXEL_GRID[]						= "VOXEL_GRID";
 
 static bool GetSFIndexOrName(ccCommandLineInterface& cmd, int& sfIndex, QString& sfName, bool allowMinusOne = false)
 {
@@ -626,6 +632,8 @@ bool CommandLoad::process(ccCommandLineInterface& cmd)
 	int skipLines = 0;
 	ccCommandLineInterface::GlobalShiftOptions globalShiftOptions;
 	bool doNotCreateLabels = false;
+	QStringList scanSelection;
+	int maxThreadCount = 0;
 
 	while (!cmd.arguments().empty())
 	{
@@ -658,6 +666,41 @@ bool CommandLoad::process(ccCommandLineInterface& cmd)
 			
 			cmd.print(QObject::tr("Will skip %1 lines").arg(skipLines));
 		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_OPEN_SCANS))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			if (cmd.arguments().empty())
+			{
+				return cmd.error(QObject::tr("Missing parameter: list of scans after '%1'").arg(COMMAND_OPEN_SCANS));
+			}
+
+			scanSelection = cmd.arguments().takeFirst().split(',', QString::SkipEmptyParts);
+			for (QString& scan : scanSelection)
+			{
+				scan = scan.trimmed();
+			}
+
+			cmd.print(QObject::tr("Will only load scan(s): %1").arg(scanSelection.join(", ")));
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_MAX_THREAD_COUNT))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			if (cmd.arguments().empty())
+			{
+				return cmd.error(QObject::tr("Missing parameter: max thread count after '%1'").arg(COMMAND_MAX_THREAD_COUNT));
+			}
+
+			bool ok;
+			maxThreadCount = cmd.arguments().takeFirst().toInt(&ok);
+			if (!ok || maxThreadCount < 0)
+			{
+				return cmd.error(QObject::tr("Invalid thread count! (after %1)").arg(COMMAND_MAX_THREAD_COUNT));
+			}
+		}
 		else if (cmd.nextCommandIsGlobalShift())
 		{
 			//local option confirmed, we can move on
@@ -681,9 +724,18 @@ bool CommandLoad::process(ccCommandLineInterface& cmd)
 	}
 	AsciiFilter::SetNoLabelCreated(doNotCreateLabels);
 	
+	//the scan selection and thread count only apply to this file
+	cmd.fileLoadingParams().scanSelection = scanSelection;
+	cmd.fileLoadingParams().maxThreadCount = maxThreadCount;
+
 	//open specified file
 	QString filename(cmd.arguments().takeFirst());
-	if (!cmd.importFile(filename, globalShiftOptions))
+	bool success = cmd.importFile(filename, globalShiftOptions);
+
+	cmd.fileLoadingParams().scanSelection.clear();
+	cmd.fileLoadingParams().maxThreadCount = 0;
+
+	if (!success)
 	{
 		return false;
 	}
@@ -1354,7 +1406,7 @@ bool CommandSubsample::process(ccCommandLineInterface& cmd)
 				cmd.print(QObject::tr("\tOutput points: %1 * %2% = %3").arg(nrOfPoints).arg(percent).arg(count));
 			}
 
-			CCCoreLib::ReferenceCloud* refCloud = CCCoreLib::CloudSamplingTools::subsampleCloudRandomly(desc.pc, count, cmd.progressDialog());
+			CCCoreLib::ReferenceCloud* refCloud = CCCoreLib::CloudSamplingTools::subsampleCloudRandomly(desc.pc, count, cmd.progressCallback());
 			if (!refCloud)
 			{
 				return cmd.error(QObject::tr("Subsampling process failed!"));
@@ -1504,7 +1556,7 @@ bool CommandSubsample::process(ccCommandLineInterface& cmd)
 				cmd.print(QObject::tr("\t'Use active SF' disabled. Falling back to constant spacing."));
 			}
 
-			CCCoreLib::ReferenceCloud* refCloud = CCCoreLib::CloudSamplingTools::resampleCloudSpatially(desc.pc, static_cast<PointCoordinateType>(step), modParams, nullptr, cmd.progressDialog());
+			CCCoreLib::ReferenceCloud* refCloud = CCCoreLib::CloudSamplingTools::resampleCloudSpatially(desc.pc, static_cast<PointCoordinateType>(step), modParams, nullptr, cmd.progressCallback());
 			if (!refCloud)
 			{
 				return cmd.error("Subsampling process failed!");
@@ -3978,6 +4030,83 @@ bool CommandOrientNormalsMST::process(ccCommandLineInterface& cmd)
 	return true;
 }
 
+CommandOrientNormalsFM::CommandOrientNormalsFM()
+	: ccCommandLineInterface::Command(QObject::tr("Orient normals (Fast Marching)"), COMMAND_ORIENT_NORMALS_FM)
+{}
+
+bool CommandOrientNormalsFM::process(ccCommandLineInterface& cmd)
+{
+	if (cmd.arguments().empty())
+	{
+		return cmd.error(QObject::tr("Missing parameter: octree level after \"-%1\"").arg(COMMAND_ORIENT_NORMALS_FM));
+	}
+	
+	QString levelStr = cmd.arguments().takeFirst();
+	bool ok;
+	int level = levelStr.toInt(&ok);
+	if (!ok || level < 1 || level > CCCoreLib::DgmOctree::MAX_OCTREE_LEVEL)
+	{
+		return cmd.error(QObject::tr("Invalid parameter: octree level (%1)").arg(levelStr));
+	}
+
+	//optional parameters
+	bool concurrent = false;
+	if (!cmd.arguments().empty() && ccCommandLineInterface::IsCommand(cmd.arguments().front(), COMMAND_ORIENT_NORMALS_FM_CONCURRENT))
+	{
+		//local option confirmed, we can move on
+		cmd.arguments().pop_front();
+		concurrent = true;
+	}
+	
+	if (cmd.clouds().empty())
+	{
+		return cmd.error(QObject::tr("No cloud available. Be sure to open one first!"));
+	}
+	
+	QScopedPointer<ccProgressDialog> progressDialog(nullptr);
+	if (!cmd.silentMode())
+	{
+		progressDialog.reset(new ccProgressDialog(false, cmd.widgetParent()));
+		progressDialog->setAutoClose(false);
+	}
+	
+	for (CLCloudDesc& desc : cmd.clouds())
+	{
+		assert(desc.pc);
+		
+		if (!desc.pc->hasNormals())
+		{
+			continue;
+		}
+		
+		//computation
+		if (desc.pc->orientNormalsWithFM(static_cast<unsigned char>(level), progressDialog.data(), concurrent))
+		{
+			desc.basename += QObject::tr("_NORMS_REORIENTED");
+			if (cmd.autoSaveMode())
+			{
+				QString errorStr = cmd.exportEntity(desc);
+				if (!errorStr.isEmpty())
+				{
+					cmd.warning(errorStr);
+				}
+			}
+		}
+		else
+		{
+			return cmd.error(QObject::tr("Failed to orient the normals of cloud '%1'!").arg(desc.pc->getName()));
+		}
+	}
+	
+	if (progressDialog)
+	{
+		progressDialog->close();
+		QCoreApplication::processEvents();
+	}
+	
+	return true;
+}
+
 CommandSORFilter::CommandSORFilter()
 	: ccCommandLineInterface::Command(QObject::tr("S.O.R. filter"), COMMAND_SOR_FILTER)
 {}
@@ -6374,6 +6503,11 @@ bool CommandFilter::process(ccCommandLineInterface& cmd)
 			filterParams.blendGrayscalePercent = static_cast<double>(grayscalePercent) / 100;
 
 		}
+		else if (ccCommandLineInterface::IsCommand(argument, OPTION_VOXEL_GRID))
+		{
+			cmd.arguments().pop_front();
+			filterParams.useVoxelGrid = true;
+		}
 
 		else
 		{
@@ -7663,6 +7797,18 @@ bool CommandSetNoTimestamp::process(ccCommandLineInterface& cmd)
 	return true;
 }
 
+CommandCompressBin::CommandCompressBin()
+	: ccCommandLineInterface::Command(QObject::tr("Compress BIN"), COMMAND_COMPRESS_BIN)
+{}
+
+bool CommandCompressBin::process(ccCommandLineInterface& cmd)
+{
+	//the arrays of the BIN files saved afterwards will be compressed
+	ccArrayCodec::SetCompressionEnabled(true);
+	cmd.print(QObject::tr("BIN files will be compressed"));
+	return true;
+}
+
 CommandMoment::CommandMoment()
 	: ccCommandLineInterface::Command(QObject::tr("1st order moment"), COMMAND_MOMENT)
 {}
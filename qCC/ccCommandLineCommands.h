@@ -281,6 +281,13 @@ struct CommandOrientNormalsMST : public ccCommandLineInterface::Command
 	bool process(ccCommandLineInterface& cmd) override;
 };
 
+struct CommandOrientNormalsFM : public ccCommandLineInterface::Command
+{
+	CommandOrientNormalsFM();
+
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
 struct CommandSORFilter : public ccCommandLineInterface::Command
 {
 	CommandSORFilter();
@@ -589,6 +596,13 @@ struct CommandSetNoTimestamp : public ccCommandLineInterface::Command
 	bool process(ccCommandLineInterface& cmd) override;
 };
 
+struct CommandCompressBin : public ccCommandLineInterface::Command
+{
+	CommandCompressBin();
+
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
 struct CommandMoment : public ccCommandLineInterface::Command
 {
 	CommandMoment();
@@ -863,6 +863,7 @@ void ccCommandLineParser::registerBuiltInCommands()
 	registerCommand(Command::Shared(new CommandMatchBBCenters));
 	registerCommand(Command::Shared(new CommandMatchBestFitPlane));
 	registerCommand(Command::Shared(new CommandOrientNormalsMST));
+	registerCommand(Command::Shared(new CommandOrientNormalsFM));
 	registerCommand(Command::Shared(new CommandSORFilter));
 	registerCommand(Command::Shared(new CommandNoiseFilter));
 	registerCommand(Command::Shared(new CommandRemoveDuplicatePoints));
@@ -908,6 +909,7 @@ void ccCommandLineParser::registerBuiltInCommands()
 	registerCommand(Command::Shared(new CommandClearMeshes));
 	registerCommand(Command::Shared(new CommandPopMeshes));
 	registerCommand(Command::Shared(new CommandSetNoTimestamp));
+	registerCommand(Command::Shared(new CommandCompressBin));
 	registerCommand(Command::Shared(new CommandVolume25D));
 	registerCommand(Command::Shared(new CommandRasterize));
 	registerCommand(Command::Shared(new CommandOctreeNormal));
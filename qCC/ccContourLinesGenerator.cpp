@@ -17,6 +17,9 @@
 
 #include "ccContourLinesGenerator.h"
 
+//CCPluginAPI
+#include <ccQtHelpers.h>
+
 //qCC_db
 #include <ccPointCloud.h>
 #include <ccPolyline.h>
@@ -24,8 +27,118 @@
 #include <ccRasterGrid.h>
 #include <ccScalarField.h>
 
+//Qt
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
+
 //System
 #include <cassert>
+#include <memory>
+#include <numeric>
+
+//! Reads the raster values fed to the contour lines generator
+/** Rows are independent and can be read concurrently.
+**/
+class RasterValuesReader
+{
+public:
+
+	//! Default constructor
+	RasterValuesReader(const ccRasterGrid& grid, const ccContourLinesGenerator::Parameters& params, bool sparseLayer)
+		: m_grid(grid)
+		, m_params(params)
+		, m_sparseLayer(sparseLayer)
+	{}
+
+	//! Initializes the reader
+	/** \warning May throw std::bad_alloc
+	**/
+	void init()
+	{
+		if (!m_params.altitudes)
+		{
+			return;
+		}
+
+		//index of the first altitude of each row
+		m_rowStartIndexes.resize(static_cast<size_t>(m_grid.height) + 1, 0);
+		if (m_sparseLayer)
+		{
+			//only the non-empty cells have an altitude
+			std::vector<unsigned> rowIndexes(m_grid.height);
+			std::iota(rowIndexes.begin(), rowIndexes.end(), 0);
+			QtConcurrent::blockingMap(rowIndexes, [this](unsigned j)
+			{
+				size_t count = 0;
+				for (const ccRasterCell& cell : m_grid.rows[j])
+				{
+					if (cell.nbPoints)
+					{
+						++count;
+					}
+				}
+				m_rowStartIndexes[j + 1] = count;
+			});
+			std::partial_sum(m_rowStartIndexes.begin(), m_rowStartIndexes.end(), m_rowStartIndexes.begin());
+		}
+		else
+		{
+			for (unsigned j = 0; j <= m_grid.height; ++j)
+			{
+				m_rowStartIndexes[j] = static_cast<size_t>(j) * m_grid.width;
+			}
+		}
+	}
+
+	//! Reads one row of the grid
+	void readRow(unsigned j, double* row) const
+	{
+		const ccRasterGrid::Row& cellRow = m_grid.rows[j];
+		size_t layerIndex = (m_params.altitudes ? m_rowStartIndexes[j] : 0);
+		for (unsigned i = 0; i < m_grid.width; ++i)
+		{
+			if (cellRow[i].nbPoints || !m_sparseLayer)
+			{
+				if (m_params.altitudes)
+				{
+					ScalarType value = m_params.altitudes->getValue(layerIndex++);
+					row[i] = ccScalarField::ValidValue(value) ? value : m_params.emptyCellsValue;
+				}
+				else
+				{
+					row[i] = std::isfinite(cellRow[i].h) ? cellRow[i].h : m_params.emptyCellsValue;
+				}
+			}
+			else
+			{
+				row[i] = m_params.emptyCellsValue;
+			}
+		}
+	}
+
+	//! Reads consecutive rows of the grid (concurrently)
+	/** \param firstRow index of the first row to read
+		\param rowCount number of rows to read
+		\param rows output buffer
+		\param rowStride gap between the start of two consecutive rows in the output buffer
+	**/
+	void readRows(unsigned firstRow, unsigned rowCount, double* rows, size_t rowStride) const
+	{
+		std::vector<unsigned> rowIndexes(rowCount);
+		std::iota(rowIndexes.begin(), rowIndexes.end(), firstRow);
+		QtConcurrent::blockingMap(rowIndexes, [&](unsigned j)
+		{
+			readRow(j, rows + (j - firstRow) * rowStride);
+		});
+	}
+
+protected:
+
+	const ccRasterGrid& m_grid;
+	const ccContourLinesGenerator::Parameters& m_params;
+	bool m_sparseLayer;
+	std::vector<size_t> m_rowStartIndexes;
+};
 
 #ifndef CC_GDAL_SUPPORT
 
@@ -34,6 +147,118 @@
 //Qt
 #include <QCoreApplication>
 
+//! Maximum amount of memory used by the additional isolines extractors (see GenerateContourLines)
+static const size_t s_maxIsolinesPoolMemory = (size_t(1) << 31); //2 Gb
+
+//! Converts the isolines extracted for a given level to polylines
+static bool ConvertIsolines(const Isolines<double>& iso,
+							int lineCount,
+							double v,
+							const ccRasterGrid& rasterGrid,
+							const CCVector2d& gridMinCornerXY,
+							const ccContourLinesGenerator::Parameters& params,
+							int margin,
+							std::vector<ccPolyline*>& contourLines)
+{
+	int realCount = 0;
+	for (int i = 0; i < lineCount; ++i)
+	{
+		int vertCount = iso.getContourLength(i);
+		if (vertCount >= params.minVertexCount)
+		{
+			int startVi = 0; //we may have to split the polyline in multiple chunks
+			while (startVi < vertCount)
+			{
+				ccPointCloud* vertices = new ccPointCloud("vertices");
+				ccPolyline* poly = new ccPolyline(vertices);
+				poly->addChild(vertices);
+				bool isClosed = (startVi == 0 ? iso.isContourClosed(i) : false);
+				if (poly->reserve(vertCount - startVi) && vertices->reserve(vertCount - startVi))
+				{
+					unsigned localIndex = 0;
+					for (int vi = startVi; vi < vertCount; ++vi)
+					{
+						++startVi;
+
+						double x = iso.getContourX(i, vi) - margin;
+						double y = iso.getContourY(i, vi) - margin;
+
+						CCVector3 P;
+						//DGM: we will only do the dimension mapping at export time
+						//(otherwise the contour lines appear in the wrong orientation compared to the grid/raster which
+						// is in the XY plane by default!)
+						/*P.u[X] = */P.x = static_cast<PointCoordinateType>((x + 0.5) * rasterGrid.gridStep + gridMinCornerXY.x);
+						/*P.u[Y] = */P.y = static_cast<PointCoordinateType>((y + 0.5) * rasterGrid.gridStep + gridMinCornerXY.y);
+						if (params.projectContourOnAltitudes)
+						{
+							int xi = std::min(std::max(static_cast<int>(x), 0), static_cast<int>(rasterGrid.width) - 1);
+							int yi = std::min(std::max(static_cast<int>(y), 0), static_cast<int>(rasterGrid.height) - 1);
+							double h = rasterGrid.rows[yi][xi].h;
+							if (std::isfinite(h))
+							{
+								/*P.u[Z] = */P.z = static_cast<PointCoordinateType>(h);
+							}
+							else
+							{
+								//DGM: we stop the current polyline
+								isClosed = false;
+								break;
+							}
+						}
+						else
+						{
+							/*P.u[Z] = */P.z = static_cast<PointCoordinateType>(v);
+						}
+
+						vertices->addPoint(P);
+						assert(localIndex < vertices->size());
+						poly->addPointIndex(localIndex++);
+					}
+
+					assert(poly);
+					if (poly->size() > 1)
+					{
+						poly->setClosed(isClosed); //if we have less vertices, it means we have 'chopped' the original contour
+						vertices->setEnabled(false);
+
+						++realCount;
+						poly->setMetaData(ccContourLinesGenerator::MetaKeySubIndex(), realCount);
+
+						//add the 'const altitude' meta-data as well
+						poly->setMetaData(ccPolyline::MetaKeyConstAltitude(), QVariant(v));
+
+						//add contour
+						poly->setName(QString("Contour line value = %1 (#%2)").arg(v).arg(realCount));
+						try
+						{
+							contourLines.push_back(poly);
+						}
+						catch (const std::bad_alloc&)
+						{
+							ccLog::Warning("[ccContourLinesGenerator] Not enough memory");
+							return false;
+						}
+					}
+					else
+					{
+						delete poly;
+						poly = nullptr;
+					}
+				}
+				else
+				{
+					delete poly;
+					poly = nullptr;
+					ccLog::Warning("Not enough memory!");
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
 #else
 
 //GDAL
@@ -191,6 +416,15 @@ bool ccContourLinesGenerator::GenerateContourLines(	ccRasterGrid* rasterGrid,
 	{
 #ifdef CC_GDAL_SUPPORT //use GDAL (more robust) - otherwise we will use an old code found on the Internet (with a strange behavior)
 
+		RasterValuesReader reader(*rasterGrid, params, sparseLayer);
+		reader.init();
+
+		//the scan lines are read concurrently, by blocks, while GDAL processes the previous block
+		static const unsigned BlockRowCount = 256;
+		const size_t blockSize = static_cast<size_t>(BlockRowCount) * rasterGrid->width;
+		std::vector<double> currentBlock(blockSize);
+		std::vector<double> nextBlock(blockSize);
+
 		//invoke the GDAL 'Contour Generator'
 		ContourGenerationParameters gdalParams;
 		gdalParams.grid = rasterGrid;
@@ -211,51 +445,44 @@ bool ccContourLinesGenerator::GenerateContourLines(	ccRasterGrid* rasterGrid,
 
 		//feed the scan lines
 		{
-			double* scanline = static_cast<double*>(CPLMalloc(sizeof(double) * rasterGrid->width));
-			if (!scanline)
-			{
-				ccLog::Error("[GDAL] Not enough memory");
-				return false;
-			}
-											
-			unsigned layerIndex = 0;
+			unsigned currentRowCount = std::min(BlockRowCount, rasterGrid->height);
+			reader.readRows(0, currentRowCount, currentBlock.data(), rasterGrid->width);
 
-			for (unsigned j = 0; j < rasterGrid->height; ++j)
+			for (unsigned j = 0; j < rasterGrid->height; )
 			{
-				const ccRasterGrid::Row& cellRow = rasterGrid->rows[j];
-				for (unsigned i = 0; i < rasterGrid->width; ++i)
+				unsigned nextFirstRow = j + currentRowCount;
+				unsigned nextRowCount = (nextFirstRow < rasterGrid->height ? std::min(BlockRowCount, rasterGrid->height - nextFirstRow) : 0);
+				QFuture<void> nextBlockFuture;
+				if (nextRowCount != 0)
 				{
-					if (cellRow[i].nbPoints || !sparseLayer)
+					double* nextBlockData = nextBlock.data();
+					nextBlockFuture = QtConcurrent::run([&reader, nextFirstRow, nextRowCount, nextBlockData, rasterGrid]()
 					{
-						if (params.altitudes)
-						{
-							ScalarType value = params.altitudes->getValue(layerIndex++);
-							scanline[i] = ccScalarField::ValidValue(value) ? value : params.emptyCellsValue;
-						}
-						else
-						{
-							scanline[i] = std::isfinite(cellRow[i].h) ? cellRow[i].h : params.emptyCellsValue;
-						}
-					}
-					else
+						reader.readRows(nextFirstRow, nextRowCount, nextBlockData, rasterGrid->width);
+					});
+				}
+
+				CPLErr error = CE_None;
+				for (unsigned k = 0; k < currentRowCount; ++k)
+				{
+					error = GDAL_CG_FeedLine(hCG, currentBlock.data() + static_cast<size_t>(k) * rasterGrid->width);
+					if (error != CE_None)
 					{
-						scanline[i] = params.emptyCellsValue;
+						break;
 					}
 				}
 
-				CPLErr error = GDAL_CG_FeedLine(hCG, scanline);
+				nextBlockFuture.waitForFinished();
 				if (error != CE_None)
 				{
 					ccLog::Error("[GDAL] An error occurred during contour lines generation");
 					break;
 				}
-			}
 
-			if (scanline)
-			{
-				CPLFree(scanline);
+				currentBlock.swap(nextBlock);
+				j = nextFirstRow;
+				currentRowCount = nextRowCount;
 			}
-			scanline = nullptr;
 
 			//have we generated any contour line?
 			if (!gdalParams.contourLines.empty())
@@ -310,158 +537,116 @@ bool ccContourLinesGenerator::GenerateContourLines(	ccRasterGrid* rasterGrid,
 
 		//fill grid
 		{
-			unsigned layerIndex = 0;
-			for (unsigned j = 0; j < rasterGrid->height; ++j)
+			RasterValuesReader reader(*rasterGrid, params, sparseLayer);
+			reader.init();
+			reader.readRows(0, rasterGrid->height, &(grid[margin * xDim + margin]), xDim);
+		}
+
+		//the levels are computed exactly as they would be if we were processing them sequentially
+		std::vector<double> levels;
+		for (double v = params.startAltitude; v <= params.maxAltitude; v += params.step)
+		{
+			levels.push_back(v);
+			if (!CCCoreLib::GreaterThanEpsilon(params.step))
 			{
-				const ccRasterGrid::Row& cellRow = rasterGrid->rows[j];
-				double* row = &(grid[(j + margin)*xDim + margin]);
-				for (unsigned i = 0; i < rasterGrid->width; ++i)
+				break;
+			}
+		}
+
+		//generate contour lines
+		if (!levels.empty())
+		{
+			//the levels are processed concurrently (each one with its own isolines extractor)
+			std::vector< std::unique_ptr< Isolines<double> > > isolines;
+			isolines.emplace_back(new Isolines<double>(static_cast<int>(xDim), static_cast<int>(yDim)));
+			{
+				//each extractor requires as many codes as the grid has cells
+				size_t isolinesMemory = sizeof(int) * static_cast<size_t>(xDim) * yDim;
+				size_t maxIsolinesCount = std::min(	levels.size(),
+													static_cast<size_t>(std::max(ccQtHelpers::GetMaxThreadCount(), 1)) );
+				maxIsolinesCount = std::min(maxIsolinesCount, 1 + s_maxIsolinesPoolMemory / std::max<size_t>(isolinesMemory, 1));
+				try
 				{
-					if (cellRow[i].nbPoints || !sparseLayer)
+					while (isolines.size() < maxIsolinesCount)
 					{
-						if (params.altitudes)
-						{
-							ScalarType value = params.altitudes->getValue(layerIndex++);
-							row[i] = ccScalarField::ValidValue(value) ? value : params.emptyCellsValue;
-						}
-						else
-						{
-							row[i] = std::isfinite(cellRow[i].h) ? cellRow[i].h : params.emptyCellsValue;
-						}
-					}
-					else
-					{
-						row[i] = params.emptyCellsValue;
+						isolines.emplace_back(new Isolines<double>(static_cast<int>(xDim), static_cast<int>(yDim)));
 					}
 				}
+				catch (const std::bad_alloc&)
+				{
+					//we'll use less threads
+				}
 			}
-		}
 
-		//generate contour lines
-		{
-			Isolines<double> iso(static_cast<int>(xDim), static_cast<int>(yDim));
 			if (!params.ignoreBorders)
 			{
-				iso.createOnePixelBorder(grid.data(), params.startAltitude - 1.0);
+				isolines.front()->createOnePixelBorder(grid.data(), params.startAltitude - 1.0);
 			}
 
-			ccProgressDialog pDlg(true, params.parentWidget);
-			pDlg.setMethodTitle(QObject::tr("Contour plot"));
-			pDlg.setInfo(QObject::tr("Levels: %1\nCells: %2 x %3").arg(levelCount).arg(rasterGrid->width).arg(rasterGrid->height));
-			pDlg.start();
-			pDlg.show();
-			QCoreApplication::processEvents();
-			CCCoreLib::NormalizedProgress nProgress(&pDlg, levelCount);
-
-			for (double v = params.startAltitude; v <= params.maxAltitude; v += params.step)
+			std::unique_ptr<ccProgressDialog> pDlg;
+			if (params.showProgress)
 			{
-				//extract contour lines for the current level
-				iso.setThreshold(v);
-				int lineCount = iso.find(grid.data());
+				pDlg.reset(new ccProgressDialog(true, params.parentWidget));
+				pDlg->setMethodTitle(QObject::tr("Contour plot"));
+				pDlg->setInfo(QObject::tr("Levels: %1\nCells: %2 x %3").arg(levelCount).arg(rasterGrid->width).arg(rasterGrid->height));
+				pDlg->start();
+				pDlg->show();
+				QCoreApplication::processEvents();
+			}
+			CCCoreLib::NormalizedProgress nProgress(pDlg.get(), levelCount);
 
-				ccLog::PrintDebug(QString("[Rasterize][Isolines] value=%1 : %2 lines").arg(v).arg(lineCount));
+			std::vector<int> lineCounts(isolines.size(), 0);
+			std::vector<size_t> isolinesIndexes(isolines.size());
+			std::iota(isolinesIndexes.begin(), isolinesIndexes.end(), 0);
+			bool cancelled = false;
 
-				//convert them to poylines
-				int realCount = 0;
-				for (int i = 0; i < lineCount; ++i)
+			for (size_t firstLevel = 0; firstLevel < levels.size() && !cancelled; firstLevel += isolines.size())
+			{
+				size_t batchLevelCount = std::min(isolines.size(), levels.size() - firstLevel);
+				if (batchLevelCount < isolinesIndexes.size())
 				{
-					int vertCount = iso.getContourLength(i);
-					if (vertCount >= params.minVertexCount)
+					isolinesIndexes.resize(batchLevelCount);
+				}
+
+				//extract the contour lines of the current levels (concurrently)
+				QtConcurrent::blockingMap(isolinesIndexes, [&](size_t k)
+				{
+					Isolines<double>& iso = *isolines[k];
+					iso.setThreshold(levels[firstLevel + k]);
+					try
 					{
-						int startVi = 0; //we may have to split the polyline in multiple chunks
-						while (startVi < vertCount)
-						{
-							ccPointCloud* vertices = new ccPointCloud("vertices");
-							ccPolyline* poly = new ccPolyline(vertices);
-							poly->addChild(vertices);
-							bool isClosed = (startVi == 0 ? iso.isContourClosed(i) : false);
-							if (poly->reserve(vertCount - startVi) && vertices->reserve(vertCount - startVi))
-							{
-								unsigned localIndex = 0;
-								for (int vi = startVi; vi < vertCount; ++vi)
-								{
-									++startVi;
-								
-									double x = iso.getContourX(i, vi) - margin;
-									double y = iso.getContourY(i, vi) - margin;
-
-									CCVector3 P;
-									//DGM: we will only do the dimension mapping at export time
-									//(otherwise the contour lines appear in the wrong orientation compared to the grid/raster which
-									// is in the XY plane by default!)
-									/*P.u[X] = */P.x = static_cast<PointCoordinateType>((x + 0.5) * rasterGrid->gridStep + gridMinCornerXY.x);
-									/*P.u[Y] = */P.y = static_cast<PointCoordinateType>((y + 0.5) * rasterGrid->gridStep + gridMinCornerXY.y);
-									if (params.projectContourOnAltitudes)
-									{
-										int xi = std::min(std::max(static_cast<int>(x), 0), static_cast<int>(rasterGrid->width) - 1);
-										int yi = std::min(std::max(static_cast<int>(y), 0), static_cast<int>(rasterGrid->height) - 1);
-										double h = rasterGrid->rows[yi][xi].h;
-										if (std::isfinite(h))
-										{
-											/*P.u[Z] = */P.z = static_cast<PointCoordinateType>(h);
-										}
-										else
-										{
-											//DGM: we stop the current polyline
-											isClosed = false;
-											break;
-										}
-									}
-									else
-									{
-										/*P.u[Z] = */P.z = static_cast<PointCoordinateType>(v);
-									}
-
-									vertices->addPoint(P);
-									assert(localIndex < vertices->size());
-									poly->addPointIndex(localIndex++);
-								}
-
-								assert(poly);
-								if (poly->size() > 1)
-								{
-									poly->setClosed(isClosed); //if we have less vertices, it means we have 'chopped' the original contour
-									vertices->setEnabled(false);
-
-									++realCount;
-									poly->setMetaData(ccContourLinesGenerator::MetaKeySubIndex(), realCount);
-
-									//add the 'const altitude' meta-data as well
-									poly->setMetaData(ccPolyline::MetaKeyConstAltitude(), QVariant(v));
-
-									//add contour
-									poly->setName(QString("Contour line value = %1 (#%2)").arg(v).arg(realCount));
-									try
-									{
-										contourLines.push_back(poly);
-									}
-									catch (const std::bad_alloc&)
-									{
-										ccLog::Warning("[ccContourLinesGenerator] Not enough memory");
-										return false;
-									}
-								}
-								else
-								{
-									delete poly;
-									poly = nullptr;
-								}
-							}
-							else
-							{
-								delete poly;
-								poly = nullptr;
-								ccLog::Warning("Not enough memory!");
-								return false;
-							}
-						}
+						lineCounts[k] = iso.find(grid.data());
 					}
-				}
+					catch (const std::bad_alloc&)
+					{
+						lineCounts[k] = -1;
+					}
+				});
 
-				if (!nProgress.oneStep())
+				//convert them to polylines (sequentially, to keep the same order)
+				for (size_t k = 0; k < batchLevelCount; ++k)
 				{
-					//process cancelled by user
-					break;
+					double v = levels[firstLevel + k];
+					int lineCount = lineCounts[k];
+					if (lineCount < 0)
+					{
+						ccLog::Warning("[ccContourLinesGenerator] Not enough memory");
+						return false;
+					}
+
+					ccLog::PrintDebug(QString("[Rasterize][Isolines] value=%1 : %2 lines").arg(v).arg(lineCount));
+
+					if (!ConvertIsolines(*isolines[k], lineCount, v, *rasterGrid, gridMinCornerXY, params, margin, contourLines))
+					{
+						return false;
+					}
+
+					if (!nProgress.oneStep())
+					{
+						//process cancelled by user
+						cancelled = true;
+						break;
+					}
 				}
 			}
 		}
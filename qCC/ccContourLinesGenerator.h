@@ -46,6 +46,7 @@ public:
 
 		/* The parameters below are only required if GDAL is not required */
 		QWidget* parentWidget = nullptr; //for progress dialog
+		bool showProgress = true; //must be false if not called from the main thread
 		bool ignoreBorders = false;
 
 	};
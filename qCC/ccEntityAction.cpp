@@ -38,6 +38,7 @@
 #include <ccPointCloudInterpolator.h>
 #include <ccPolyline.h>
 #include <ccSensor.h>
+#include <ccVoxelGridFilter.h>
 
 //qCC_gl
 #include "ccGuiParameters.h"
@@ -78,6 +79,12 @@
 
 namespace ccEntityAction
 {
+	//! Whether the spatial filters should use the voxel grid engine (semi-persistent)
+	static bool s_filterWithVoxelGrid = false;
+
+	static QString VoxelGridFilterCheckboxLabel() { return QObject::tr("Voxel grid (faster)"); }
+	static QString VoxelGridFilterCheckboxTooltip() { return QObject::tr("Use the multi-threaded voxel grid engine instead of the octree\n(the mean, Gaussian and bilateral filters are then approximated)"); }
+
 	static QString GetFirstAvailableSFName(const ccPointCloud* cloud, const QString& baseName)
 	{
 		if (cloud == nullptr)
@@ -793,6 +800,7 @@ namespace ccEntityAction
 				dlg.doubleSpinBox1->setStatusTip(QObject::tr("3*sigma = 99.7% attenuation"));
 				dlg.doubleSpinBox2->setStatusTip(QObject::tr("Scalar sigma controls how much the filter behaves as a Gaussian Filter\nSigma at +inf uses the whole range of scalars"));
 				dlg.doubleSpinBox3->setStatusTip(QObject::tr("For averaging, it will only use colors for which all components are in the range[threshold:255 - threshold]"));
+				dlg.showCheckbox(VoxelGridFilterCheckboxLabel(), s_filterWithVoxelGrid, VoxelGridFilterCheckboxTooltip());
 				if (!dlg.exec())
 				{
 					return false;
@@ -802,6 +810,7 @@ namespace ccEntityAction
 				spatialSigma = dlg.doubleSpinBox1->value();
 				sigmaSF = dlg.doubleSpinBox2->value();
 				filterParams.burntOutColorThreshold = dlg.doubleSpinBox3->value();
+				filterParams.useVoxelGrid = s_filterWithVoxelGrid = dlg.getCheckboxState();
 			}
 			else
 			{
@@ -818,6 +827,7 @@ namespace ccEntityAction
 
 				dlg.doubleSpinBox1->setStatusTip(QObject::tr("3*sigma = 99.7% attenuation"));
 				dlg.doubleSpinBox2->setStatusTip(QObject::tr("For averaging, it will only use colors for which all components are in the range [threshold:255-threshold]"));
+				dlg.showCheckbox(VoxelGridFilterCheckboxLabel(), s_filterWithVoxelGrid, VoxelGridFilterCheckboxTooltip());
 				if (!dlg.exec())
 				{
 					return false;
@@ -826,6 +836,7 @@ namespace ccEntityAction
 				//get values
 				spatialSigma = dlg.doubleSpinBox1->value();
 				filterParams.burntOutColorThreshold = dlg.doubleSpinBox2->value();
+				filterParams.useVoxelGrid = s_filterWithVoxelGrid = dlg.getCheckboxState();
 			}
 		}
 
@@ -884,14 +895,18 @@ namespace ccEntityAction
 
 			}
 
-			ccOctree::Shared octree = pc->getOctree();
-			if (!octree)
+			//the voxel grid engine doesn't need the octree (see ccPointCloud::applyFilterToRGB)
+			if (!filterParams.useVoxelGrid)
 			{
-				octree = pc->computeOctree(parent ? pDlg.data() : nullptr);
+				ccOctree::Shared octree = pc->getOctree();
 				if (!octree)
 				{
-					ccConsole::Error(QObject::tr("Couldn't compute octree for cloud '%1'!").arg(pc->getName()));
-					continue;
+					octree = pc->computeOctree(parent ? pDlg.data() : nullptr);
+					if (!octree)
+					{
+						ccConsole::Error(QObject::tr("Couldn't compute octree for cloud '%1'!").arg(pc->getName()));
+						continue;
+					}
 				}
 			}
 
@@ -978,29 +993,39 @@ namespace ccEntityAction
 
 				dlg.doubleSpinBox1->setStatusTip(QObject::tr("3*sigma = 99.7% attenuation"));
 				dlg.doubleSpinBox2->setStatusTip(QObject::tr("Scalar field's sigma controls how much the filter behaves as a Gaussian Filter\nSigma at +inf uses the whole range of scalars"));
+				dlg.showCheckbox(VoxelGridFilterCheckboxLabel(), s_filterWithVoxelGrid, VoxelGridFilterCheckboxTooltip());
 				if (!dlg.exec())
 					return false;
 
 				//get values
 				spatialSigma = dlg.doubleSpinBox1->value();
 				scalarFieldSigma = dlg.doubleSpinBox2->value();
+				filterParams.useVoxelGrid = s_filterWithVoxelGrid = dlg.getCheckboxState();
 			}
 			else
 			{
-				bool ok = false;
+				//only the first value is used
+				ccAskTwoDoubleValuesDlg dlg(QObject::tr("sigma"),
+											QString(),
+											DBL_MIN,
+											1.0e9,
+											spatialSigma,
+											0.0,
+											8,
+											QObject::tr("SF gaussian/mean/median filter"),
+											parent);
+				dlg.label2->setVisible(false);
+				dlg.doubleSpinBox2->setVisible(false);
 
-				spatialSigma = QInputDialog::getDouble(	parent,
-														QObject::tr("SF gaussian/mean/median filter"),
-														"sigma:",
-														spatialSigma,
-														DBL_MIN,
-														1.0e9,
-														8,
-														&ok);
-				if (!ok)
+				dlg.doubleSpinBox1->setStatusTip(QObject::tr("3*sigma = 99.7% attenuation"));
+				dlg.showCheckbox(VoxelGridFilterCheckboxLabel(), s_filterWithVoxelGrid, VoxelGridFilterCheckboxTooltip());
+				if (!dlg.exec())
 				{
 					return false;
 				}
+
+				spatialSigma = dlg.doubleSpinBox1->value();
+				filterParams.useVoxelGrid = s_filterWithVoxelGrid = dlg.getCheckboxState();
 			}
 		}
 
@@ -1061,28 +1086,45 @@ namespace ccEntityAction
 					return false;
 				}
 				
-				ccOctree::Shared octree = pc->getOctree();
-				if (!octree)
-				{
-					octree = pc->computeOctree(parent ? pDlg.data() : nullptr);
-					if (!octree)
+				QElapsedTimer eTimer;
+				eTimer.start();
+				
+				if (filterParams.useVoxelGrid)
+				{
+					if (!ccVoxelGridFilter::Apply(	*pc,
+													static_cast<PointCoordinateType>(spatialSigma),
+													static_cast<PointCoordinateType>(scalarFieldSigma),
+													filterParams,
+													false,
+													true,
+													parent ? pDlg.data() : nullptr))
 					{
-						ccConsole::Error(QObject::tr("Couldn't compute octree for cloud '%1'!").arg(pc->getName()));
+						ccConsole::Warning(QObject::tr("[Bilateral/Gaussian/Mean/Median filter]  Failed to apply filter"));
 						return false;
 					}
 				}
-				
-				QElapsedTimer eTimer;
-				eTimer.start();
-				
-				if (!CCCoreLib::ScalarFieldTools::applyScalarFieldGaussianFilter(	static_cast<PointCoordinateType>(spatialSigma),
-																					pc,
-																					static_cast<PointCoordinateType>(scalarFieldSigma),
-																					parent ? pDlg.data() : nullptr,
-																					octree.data()))
+				else
 				{
-					ccConsole::Warning(QObject::tr("[Bilateral/Gaussian/Mean/Median filter]  Failed to apply filter"));
-					return false;
+					ccOctree::Shared octree = pc->getOctree();
+					if (!octree)
+					{
+						octree = pc->computeOctree(parent ? pDlg.data() : nullptr);
+						if (!octree)
+						{
+							ccConsole::Error(QObject::tr("Couldn't compute octree for cloud '%1'!").arg(pc->getName()));
+							return false;
+						}
+					}
+
+					if (!CCCoreLib::ScalarFieldTools::applyScalarFieldGaussianFilter(	static_cast<PointCoordinateType>(spatialSigma),
+																						pc,
+																						static_cast<PointCoordinateType>(scalarFieldSigma),
+																						parent ? pDlg.data() : nullptr,
+																						octree.data()))
+					{
+						ccConsole::Warning(QObject::tr("[Bilateral/Gaussian/Mean/Median filter]  Failed to apply filter"));
+						return false;
+					}
 				}
 				
 				ccConsole::Print("SF [Bilateral/Gaussian/Mean/Median filter] Timing: %3.2f s.", eTimer.elapsed() / 1000.0);
@@ -2445,6 +2487,21 @@ namespace ccEntityAction
 		Q_ASSERT(value >= 0 && value <= 255);
 		
 		unsigned char level = static_cast<unsigned char>(value);
+
+		//propagation mode
+		const QStringList modes{	QObject::tr("Single front (sequential)"),
+									QObject::tr("Concurrent fronts (faster on big clouds)") };
+		QString mode = QInputDialog::getItem(	parent,
+												QObject::tr("Orient normals (FM)"),
+												QObject::tr("Propagation"),
+												modes,
+												0,
+												false,
+												&ok);
+		if (!ok)
+			return false;
+
+		bool concurrent = (mode == modes[1]);
 		
 		ccProgressDialog pDlg(false, parent);
 		pDlg.setAutoClose(false);
@@ -2464,7 +2521,7 @@ namespace ccEntityAction
 			}
 			
 			//orient normals with Fast Marching
-			if (cloud->orientNormalsWithFM(level, &pDlg))
+			if (cloud->orientNormalsWithFM(level, &pDlg, concurrent))
 			{
 				cloud->prepareDisplayForRefresh();
 			}
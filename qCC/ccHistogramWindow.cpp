@@ -281,6 +281,18 @@ bool ccHistogramWindow::computeBinArrayFromSF(size_t binCount)
 		return true;
 	}
 
+	//shortcut: same range as the SF (the histogram is derived from the fine histogram of the SF
+	//when the bin count allows it, and computed by an exact parallel scan otherwise)
+	if (m_minVal == m_associatedSF->getMin() && m_maxVal == m_associatedSF->getMax())
+	{
+		ccScalarField::Histogram histogram;
+		if (m_associatedSF->computeHistogram(static_cast<unsigned>(binCount), histogram))
+		{
+			m_histoValues = std::move(histogram);
+			return true;
+		}
+	}
+
 	//(try to) create new array
 	try
 	{
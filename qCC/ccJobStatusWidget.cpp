@@ -0,0 +1,155 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                    COPYRIGHT: CloudCompare project                     #
+//#                                                                        #
+//##########################################################################
+
+#include "ccJobStatusWidget.h"
+
+//CCPluginAPI
+#include <ccJobScheduler.h>
+
+//Qt
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QMenu>
+#include <QProgressBar>
+#include <QToolButton>
+
+ccJobStatusWidget::ccJobStatusWidget(QWidget* parent/*=nullptr*/)
+	: QWidget(parent)
+	, m_label(new QLabel(this))
+	, m_progressBar(new QProgressBar(this))
+	, m_cancelButton(new QToolButton(this))
+{
+	m_progressBar->setMaximumWidth(150);
+	m_progressBar->setMaximumHeight(16);
+	m_progressBar->setTextVisible(false);
+
+	m_cancelButton->setText(tr("Cancel"));
+	m_cancelButton->setToolTip(tr("Cancel the background jobs"));
+	m_cancelButton->setPopupMode(QToolButton::InstantPopup);
+	m_cancelButton->setMenu(new QMenu(m_cancelButton));
+
+	QHBoxLayout* layout = new QHBoxLayout(this);
+	layout->setContentsMargins(0, 0, 0, 0);
+	layout->addWidget(m_label);
+	layout->addWidget(m_progressBar);
+	layout->addWidget(m_cancelButton);
+
+	ccJobScheduler* scheduler = ccJobScheduler::Instance();
+	connect(scheduler, &ccJobScheduler::jobQueued, this, &ccJobStatusWidget::onJobQueued);
+	connect(scheduler, &ccJobScheduler::jobStarted, this, &ccJobStatusWidget::onJobStarted);
+	connect(scheduler, &ccJobScheduler::jobProgress, this, &ccJobStatusWidget::onJobProgress);
+	connect(scheduler, &ccJobScheduler::jobFinished, this, &ccJobStatusWidget::onJobFinished);
+
+	setVisible(false);
+}
+
+void ccJobStatusWidget::onJobQueued(unsigned jobID, QString name)
+{
+	m_jobs[jobID].name = name;
+
+	updateCancelMenu();
+	updateDisplay();
+}
+
+void ccJobStatusWidget::onJobStarted(unsigned jobID, QString name)
+{
+	JobInfo& info = m_jobs[jobID];
+	info.name = name;
+	info.running = true;
+
+	updateCancelMenu();
+	updateDisplay();
+}
+
+void ccJobStatusWidget::onJobProgress(unsigned jobID, int percent)
+{
+	std::map<unsigned, JobInfo>::iterator it = m_jobs.find(jobID);
+	if (it != m_jobs.end())
+	{
+		it->second.progress = percent;
+		updateDisplay();
+	}
+}
+
+void ccJobStatusWidget::onJobFinished(unsigned jobID, bool success)
+{
+	Q_UNUSED(success);
+
+	m_jobs.erase(jobID);
+
+	updateCancelMenu();
+	updateDisplay();
+}
+
+void ccJobStatusWidget::updateCancelMenu()
+{
+	QMenu* menu = m_cancelButton->menu();
+	menu->clear();
+
+	for (const auto& job : m_jobs)
+	{
+		unsigned jobID = job.first;
+		QString text = job.second.running ? job.second.name : tr("%1 (pending)").arg(job.second.name);
+		menu->addAction(text, [jobID]() { ccJobScheduler::Instance()->cancel(jobID); });
+	}
+
+	if (m_jobs.size() > 1)
+	{
+		menu->addSeparator();
+		menu->addAction(tr("Cancel all"), []() { ccJobScheduler::Instance()->cancelAll(); });
+	}
+}
+
+void ccJobStatusWidget::updateDisplay()
+{
+	if (m_jobs.empty())
+	{
+		setVisible(false);
+		return;
+	}
+
+	//we display the oldest running job (if any)
+	const JobInfo* current = nullptr;
+	for (const auto& job : m_jobs)
+	{
+		if (job.second.running)
+		{
+			current = &job.second;
+			break;
+		}
+	}
+
+	QString text = (current ? current->name : tr("Waiting"));
+	if (m_jobs.size() > 1)
+	{
+		text += tr(" (%1 jobs)").arg(m_jobs.size());
+	}
+	m_label->setText(text);
+
+	if (current && current->progress > 0)
+	{
+		m_progressBar->setRange(0, 100);
+		m_progressBar->setValue(current->progress);
+	}
+	else
+	{
+		//some processes don't report their progress
+		m_progressBar->setRange(0, 0);
+	}
+
+	setVisible(true);
+}
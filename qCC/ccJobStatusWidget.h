@@ -0,0 +1,69 @@
+#pragma once
+
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                    COPYRIGHT: CloudCompare project                     #
+//#                                                                        #
+//##########################################################################
+
+//Qt
+#include <QWidget>
+
+//system
+#include <map>
+
+class QLabel;
+class QProgressBar;
+class QToolButton;
+
+//! Status bar widget showing the background jobs (see ccJobScheduler)
+/** Displays the progress of the oldest running job, the number of
+	jobs and lets the user cancel them. Hidden when there's no job.
+**/
+class ccJobStatusWidget : public QWidget
+{
+	Q_OBJECT
+
+public:
+
+	//! Default constructor
+	explicit ccJobStatusWidget(QWidget* parent = nullptr);
+
+protected:
+
+	void onJobQueued(unsigned jobID, QString name);
+	void onJobStarted(unsigned jobID, QString name);
+	void onJobProgress(unsigned jobID, int percent);
+	void onJobFinished(unsigned jobID, bool success);
+
+	//! Updates the cancel menu
+	void updateCancelMenu();
+	//! Updates the widget
+	void updateDisplay();
+
+	//! Job information
+	struct JobInfo
+	{
+		QString name;
+		bool running = false;
+		int progress = 0;
+	};
+
+	//! Pending and running jobs (by ID, i.e. in submission order)
+	std::map<unsigned, JobInfo> m_jobs;
+
+	QLabel* m_label;
+	QProgressBar* m_progressBar;
+	QToolButton* m_cancelButton;
+};
@@ -618,8 +618,18 @@ void ccPropertiesTreeDelegate::fillWithPointCloud(ccGenericPointCloud* _obj)
 			appendRow(ITEM( tr( "Waves" ) ), ITEM(QString::number(cloud->waveforms().size()))); //DGM: in fact some of them might be null/invalid!
 			appendRow(ITEM( tr("Descriptors" ) ), ITEM(QString::number(cloud->fwfDescriptors().size())));
 
-			double dataSize_mb = (cloud->fwfData() ? cloud->fwfData()->size() : 0) / static_cast<double>(1 << 20);
-			appendRow(ITEM( tr( "Data size" ) ), ITEM(QStringLiteral("%1 Mb").arg(dataSize_mb, 0, 'f', 2)));
+			if (cloud->isFWFDataPacked())
+			{
+				//don't unpack the data just to display its size!
+				double dataSize_mb = cloud->fwfBlocks()->size() / static_cast<double>(1 << 20);
+				double packedSize_mb = cloud->fwfBlocks()->compressedSize() / static_cast<double>(1 << 20);
+				appendRow(ITEM( tr( "Data size" ) ), ITEM(QStringLiteral("%1 Mb (packed: %2 Mb)").arg(dataSize_mb, 0, 'f', 2).arg(packedSize_mb, 0, 'f', 2)));
+			}
+			else
+			{
+				double dataSize_mb = (cloud->fwfData() ? cloud->fwfData()->size() : 0) / static_cast<double>(1 << 20);
+				appendRow(ITEM( tr( "Data size" ) ), ITEM(QStringLiteral("%1 Mb").arg(dataSize_mb, 0, 'f', 2)));
+			}
 		}
 
 		//normals
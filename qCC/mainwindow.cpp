@@ -121,6 +121,7 @@
 #include "ccWaveformDialog.h"
 #include "ccEntitySelectionDlg.h"
 #include "ccSmoothPolylineDlg.h"
+#include "ccJobStatusWidget.h"
 
 //other
 #include "ccCropTool.h"
@@ -309,6 +310,8 @@ MainWindow::MainWindow()
 	updateUI();
 
 	QMainWindow::statusBar()->showMessage(tr("Ready"));
+	//background jobs
+	QMainWindow::statusBar()->addPermanentWidget(new ccJobStatusWidget(this));
 	
 #ifdef CC_CORE_LIB_USES_TBB
 	ccConsole::Print( QStringLiteral( "[TBB] Using Intel's Threading Building Blocks %1" )
@@ -11678,8 +11681,14 @@ void MainWindow::doActionCompressFWFData()
 		}
 
 		ccPointCloud* cloud = static_cast<ccPointCloud*>(entity);
-		cloud->compressFWFData();
+		if (cloud->compressFWFData())
+		{
+			//the waveforms remain accessible without unpacking the whole data
+			cloud->packFWFData();
+		}
 	}
+
+	updateUI();
 }
 
 void MainWindow::doActionShowWaveDialog()